@@ -0,0 +1,144 @@
+/**********************************************************************
+ *
+ * PostGIS - Spatial Types for PostgreSQL
+ * http://postgis.net
+ *
+ * This is free software; you can redistribute and/or modify it under
+ * the terms of the GNU General Public Licence. See the COPYING file.
+ *
+ **********************************************************************/
+
+/*
+* Microbenchmark for the geodetic circle trees behind geography
+* ST_Distance and ST_DWithin. Builds trees on two large polygons
+* and times the tree-to-tree distance with no tolerance (distance),
+* a tolerance short of the gap (dwithin false) and one past it
+* (dwithin true), plus a polygon against a many-point multipoint.
+*
+*   make bench && ./bench_circ_tree [npoints] [iterations]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <time.h>
+
+#include "liblwgeom_internal.h"
+#include "lwgeodetic.h"
+#include "lwgeodetic_tree.h"
+
+static double
+now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* A wiggly ring of npoints around (lon, lat) */
+static LWGEOM*
+make_polygon(int npoints, double lon, double lat, double radius)
+{
+	POINTARRAY *pa = ptarray_construct_empty(0, 0, npoints + 1);
+	POINTARRAY **rings = lwalloc(sizeof(POINTARRAY*));
+	POINT4D pt;
+	int i;
+
+	pt.z = pt.m = 0.0;
+	for ( i = 0; i < npoints; i++ )
+	{
+		double a = 2.0 * M_PI * i / npoints;
+		double r = radius * (1.0 + 0.05 * sin(37.0 * a));
+		pt.x = lon + r * cos(a);
+		pt.y = lat + r * sin(a);
+		ptarray_append_point(pa, &pt, LW_TRUE);
+	}
+	getPoint4d_p(pa, 0, &pt);
+	ptarray_append_point(pa, &pt, LW_TRUE);
+
+	rings[0] = pa;
+	return lwpoly_as_lwgeom(lwpoly_construct(4326, NULL, 1, rings));
+}
+
+static LWGEOM*
+make_multipoint(int npoints, double lon, double lat, double radius)
+{
+	LWMPOINT *mpt = lwmpoint_construct_empty(4326, 0, 0);
+	int i;
+
+	for ( i = 0; i < npoints; i++ )
+	{
+		double a = 2.0 * M_PI * i / npoints;
+		mpt = lwmpoint_add_lwpoint(mpt, lwpoint_make2d(4326, lon + radius * cos(a), lat + radius * sin(a)));
+	}
+	return lwmpoint_as_lwgeom(mpt);
+}
+
+static double
+time_distance(const CIRC_NODE *t1, const CIRC_NODE *t2, const SPHEROID *s, double threshold, int iterations, double *d)
+{
+	double t0 = now();
+	int i;
+	for ( i = 0; i < iterations; i++ )
+		*d = circ_tree_distance_tree(t1, t2, s, threshold);
+	return (now() - t0) / iterations;
+}
+
+int
+main(int argc, char **argv)
+{
+	int npoints = argc > 1 ? atoi(argv[1]) : 50000;
+	int iterations = argc > 2 ? atoi(argv[2]) : 10;
+	LWGEOM *g1, *g2, *g3;
+	CIRC_NODE *t1, *t2, *t3;
+	SPHEROID s;
+	double t0, tbuild, tdist, tnear, tfar, tmpt;
+	double d, gap;
+	int i;
+
+	if ( npoints < 4 || iterations < 1 )
+	{
+		fprintf(stderr, "usage: %s [npoints >= 4] [iterations >= 1]\n", argv[0]);
+		return 1;
+	}
+
+	spheroid_init(&s, WGS84_MAJOR_AXIS, WGS84_MINOR_AXIS);
+	g1 = make_polygon(npoints, 0.0, 0.0, 10.0);
+	g2 = make_polygon(npoints, 25.0, 5.0, 10.0);
+	g3 = make_multipoint(npoints / 10, 60.0, -20.0, 15.0);
+	lwgeom_set_geodetic(g1, LW_TRUE);
+	lwgeom_set_geodetic(g2, LW_TRUE);
+	lwgeom_set_geodetic(g3, LW_TRUE);
+
+	t0 = now();
+	for ( i = 0; i < iterations; i++ )
+	{
+		t1 = lwgeom_calculate_circ_tree(g1);
+		circ_tree_free(t1);
+	}
+	tbuild = (now() - t0) / iterations;
+
+	t1 = lwgeom_calculate_circ_tree(g1);
+	t2 = lwgeom_calculate_circ_tree(g2);
+	t3 = lwgeom_calculate_circ_tree(g3);
+
+	tdist = time_distance(t1, t2, &s, 0.0, iterations, &gap);
+	tnear = time_distance(t1, t2, &s, gap * 0.5, iterations, &d);
+	tfar = time_distance(t1, t2, &s, gap * 2.0, iterations, &d);
+	tmpt = time_distance(t1, t3, &s, 0.0, iterations, &d);
+
+	printf("%d vertex polygons, %d iterations, gap %.0f m\n", npoints, iterations, gap);
+	printf("%-22s %10.1f us\n", "build", tbuild * 1e6);
+	printf("%-22s %10.1f us\n", "distance", tdist * 1e6);
+	printf("%-22s %10.1f us\n", "dwithin (false)", tnear * 1e6);
+	printf("%-22s %10.1f us\n", "dwithin (true)", tfar * 1e6);
+	printf("%-22s %10.1f us (%d points)\n", "distance multipoint", tmpt * 1e6, npoints / 10);
+
+	circ_tree_free(t1);
+	circ_tree_free(t2);
+	circ_tree_free(t3);
+	lwgeom_free(g1);
+	lwgeom_free(g2);
+	lwgeom_free(g3);
+	return 0;
+}
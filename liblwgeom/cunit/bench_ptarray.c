@@ -0,0 +1,105 @@
+/**********************************************************************
+ *
+ * PostGIS - Spatial Types for PostgreSQL
+ * http://postgis.net
+ *
+ * This is free software; you can redistribute and/or modify it under
+ * the terms of the GNU General Public Licence. See the COPYING file.
+ *
+ **********************************************************************/
+
+/*
+* Microbenchmark for the point array kernels in ptarray_simd.c.
+* Runs bounding box, 2D length and signed area over one large ring at
+* every kernel level the CPU supports and prints the time per point.
+*
+*   make bench && ./bench_ptarray [npoints] [iterations]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <time.h>
+
+#include "liblwgeom_internal.h"
+
+static const char *level_names[] = { "scalar", "sse2", "avx2" };
+
+static double
+now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+int
+main(int argc, char **argv)
+{
+	int npoints = argc > 1 ? atoi(argv[1]) : 100000;
+	int iterations = argc > 2 ? atoi(argv[2]) : 200;
+	int max_level, level, ndims, i, j;
+	double *ords;
+	double min[4], max[4];
+	double sink = 0.0;
+	double t0, tbox, tlen, tarea;
+
+	if ( npoints < 3 || iterations < 1 )
+	{
+		fprintf(stderr, "usage: %s [npoints >= 3] [iterations >= 1]\n", argv[0]);
+		return 1;
+	}
+
+	ords = malloc(sizeof(double) * 4 * npoints);
+	for ( i = 0; i < npoints; i++ )
+	{
+		double a = 2.0 * M_PI * i / npoints;
+		double r = 1000.0 + 50.0 * sin(17.0 * a);
+		ords[4*i] = r * cos(a);
+		ords[4*i+1] = r * sin(a);
+		ords[4*i+2] = i;
+		ords[4*i+3] = -i;
+	}
+
+	max_level = lw_simd_level();
+	printf("%d points, %d iterations, ns per point\n", npoints, iterations);
+	printf("%-8s %5s %10s %10s %10s\n", "level", "ndims", "bbox", "length", "area");
+
+	for ( ndims = 2; ndims <= 4; ndims++ )
+	{
+		for ( level = LW_SIMD_NONE; level <= max_level; level++ )
+		{
+			lw_simd_set_level(level);
+
+			t0 = now();
+			for ( j = 0; j < iterations; j++ )
+			{
+				lw_ordinates_minmax(ords, npoints, ndims, min, max);
+				sink += min[0] + max[1];
+			}
+			tbox = now() - t0;
+
+			t0 = now();
+			for ( j = 0; j < iterations; j++ )
+				sink += lw_ordinates_length_2d(ords, npoints, ndims);
+			tlen = now() - t0;
+
+			t0 = now();
+			for ( j = 0; j < iterations; j++ )
+				sink += lw_ordinates_signed_area(ords, npoints, ndims);
+			tarea = now() - t0;
+
+			printf("%-8s %5d %10.3f %10.3f %10.3f\n", level_names[level], ndims,
+			       1e9 * tbox / iterations / npoints,
+			       1e9 * tlen / iterations / npoints,
+			       1e9 * tarea / iterations / npoints);
+		}
+	}
+
+	/* Keep the compiler from dropping the loops */
+	if ( sink == 42.0 )
+		printf("%g\n", sink);
+
+	free(ords);
+	return 0;
+}
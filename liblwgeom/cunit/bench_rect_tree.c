@@ -0,0 +1,209 @@
+/**********************************************************************
+ *
+ * PostGIS - Spatial Types for PostgreSQL
+ * http://postgis.net
+ *
+ * This is free software; you can redistribute and/or modify it under
+ * the terms of the GNU General Public Licence. See the COPYING file.
+ *
+ **********************************************************************/
+
+/*
+* Microbenchmark for the planar rect trees behind cached ST_Distance,
+* ST_DWithin and point in polygon. Builds trees on a fractal coastline
+* (a ring refined by random midpoint displacement, as jagged as a
+* digitized shore) and an archipelago of small fractal islands lying
+* in its bays, then times the build, tree-to-tree intersection and
+* distance, point in polygon, and the distance to points scattered in
+* no particular order.
+*
+*   make bench && ./bench_rect_tree [npoints] [iterations]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <time.h>
+
+#include "liblwgeom_internal.h"
+#include "lwtree.h"
+
+static double
+now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* A closed ring of about npoints around (x, y), roughness is the displacement per edge length */
+static POINTARRAY*
+make_coastline(int npoints, double x, double y, double radius, double roughness)
+{
+	int n = 8, i;
+	double *xs = lwalloc(sizeof(double) * 2 * npoints + 16);
+	double *ys = lwalloc(sizeof(double) * 2 * npoints + 16);
+	POINTARRAY *pa;
+	POINT4D pt;
+
+	for ( i = 0; i < n; i++ )
+	{
+		xs[i] = x + radius * cos(2.0 * M_PI * i / n);
+		ys[i] = y + radius * sin(2.0 * M_PI * i / n);
+	}
+
+	/* Insert a displaced midpoint in every edge until there are enough */
+	while ( 2 * n <= npoints )
+	{
+		for ( i = n - 1; i >= 0; i-- )
+		{
+			xs[2*i] = xs[i];
+			ys[2*i] = ys[i];
+		}
+		for ( i = 0; i < n; i++ )
+		{
+			int j = (2 * i + 2) % (2 * n);
+			double dx = xs[j] - xs[2*i];
+			double dy = ys[j] - ys[2*i];
+			double d = roughness * (2.0 * rand() / RAND_MAX - 1.0);
+			xs[2*i+1] = (xs[2*i] + xs[j]) / 2.0 - dy * d;
+			ys[2*i+1] = (ys[2*i] + ys[j]) / 2.0 + dx * d;
+		}
+		n *= 2;
+	}
+
+	pa = ptarray_construct_empty(0, 0, n + 1);
+	pt.z = pt.m = 0.0;
+	for ( i = 0; i <= n; i++ )
+	{
+		pt.x = xs[i % n];
+		pt.y = ys[i % n];
+		ptarray_append_point(pa, &pt, LW_TRUE);
+	}
+	lwfree(xs);
+	lwfree(ys);
+	return pa;
+}
+
+static LWGEOM*
+make_multipoint(int npoints, double radius)
+{
+	LWMPOINT *mpt = lwmpoint_construct_empty(SRID_UNKNOWN, 0, 0);
+	int i;
+
+	for ( i = 0; i < npoints; i++ )
+	{
+		double x = radius * (2.0 * rand() / RAND_MAX - 1.0);
+		double y = radius * (2.0 * rand() / RAND_MAX - 1.0);
+		mpt = lwmpoint_add_lwpoint(mpt, lwpoint_make2d(SRID_UNKNOWN, x, y));
+	}
+	return lwmpoint_as_lwgeom(mpt);
+}
+
+static LWGEOM*
+make_polygon(POINTARRAY *pa)
+{
+	POINTARRAY **rings = lwalloc(sizeof(POINTARRAY*));
+	rings[0] = pa;
+	return lwpoly_as_lwgeom(lwpoly_construct(SRID_UNKNOWN, NULL, 1, rings));
+}
+
+/* Islands strewn across the box of the coastline, so most of them overlap its branches */
+static LWGEOM*
+make_archipelago(int nislands, int npoints, double radius)
+{
+	LWMPOLY *mpoly = lwmpoly_construct_empty(SRID_UNKNOWN, 0, 0);
+	int i;
+
+	for ( i = 0; i < nislands; i++ )
+	{
+		double x = radius * (2.0 * rand() / RAND_MAX - 1.0);
+		double y = radius * (2.0 * rand() / RAND_MAX - 1.0);
+		LWGEOM *island = make_polygon(make_coastline(npoints, x, y, radius * 0.01, 0.2));
+		mpoly = lwmpoly_add_lwpoly(mpoly, (LWPOLY*)island);
+	}
+	return lwmpoly_as_lwgeom(mpoly);
+}
+
+int
+main(int argc, char **argv)
+{
+	int npoints = argc > 1 ? atoi(argv[1]) : 50000;
+	int iterations = argc > 2 ? atoi(argv[2]) : 10;
+	LWGEOM *g1, *g2, *g3, *g4;
+	RECT_NODE *t1, *t2, *t3, *t4;
+	double t0, tbuild, tinter, tdist, tpip, tmpt;
+	double d = 0.0, dmpt = 0.0;
+	int i, j, inter = 0, inside = 0;
+	POINT2D pt;
+
+	if ( npoints < 16 || iterations < 1 )
+	{
+		fprintf(stderr, "usage: %s [npoints >= 16] [iterations >= 1]\n", argv[0]);
+		return 1;
+	}
+
+	srand(1);
+	g1 = make_polygon(make_coastline(npoints, 0.0, 0.0, 10.0, 0.2));
+	g2 = make_archipelago(npoints / 256, 128, 10.0);
+	g3 = make_polygon(make_coastline(npoints, 0.0, 20.5, 10.0, 0.2));
+	g4 = make_multipoint(npoints / 10, 10.0);
+
+	t0 = now();
+	for ( i = 0; i < iterations; i++ )
+	{
+		t1 = lwgeom_calculate_rect_tree(g1);
+		rect_tree_free(t1);
+	}
+	tbuild = (now() - t0) / iterations;
+
+	t1 = lwgeom_calculate_rect_tree(g1);
+	t2 = lwgeom_calculate_rect_tree(g2);
+	t3 = lwgeom_calculate_rect_tree(g3);
+	t4 = lwgeom_calculate_rect_tree(g4);
+
+	t0 = now();
+	for ( i = 0; i < iterations; i++ )
+		inter = rect_tree_intersects_tree(t1, t2);
+	tinter = (now() - t0) / iterations;
+
+	t0 = now();
+	for ( i = 0; i < iterations; i++ )
+		d = rect_tree_distance_tree(t1, t3, 0.0);
+	tdist = (now() - t0) / iterations;
+
+	t0 = now();
+	for ( i = 0; i < iterations; i++ )
+	{
+		inside = 0;
+		for ( j = 0; j < 1000; j++ )
+		{
+			pt.x = -10.0 + 20.0 * (j % 40) / 40.0;
+			pt.y = -10.0 + 20.0 * (j / 40) / 25.0;
+			inside += rect_tree_polygon_contains_point(t1, &pt);
+		}
+	}
+	tpip = (now() - t0) / iterations;
+
+	t0 = now();
+	for ( i = 0; i < iterations; i++ )
+		dmpt = rect_tree_distance_tree(t1, t4, 0.0);
+	tmpt = (now() - t0) / iterations;
+
+	printf("%d vertex coastlines, %d islands, %d iterations\n", npoints, npoints / 256, iterations);
+	printf("%-22s %10.1f us\n", "build", tbuild * 1e6);
+	printf("%-22s %10.1f us (%s)\n", "intersects", tinter * 1e6, inter ? "true" : "false");
+	printf("%-22s %10.1f us (%g)\n", "distance", tdist * 1e6, d);
+	printf("%-22s %10.1f us (%d inside)\n", "point in polygon x1000", tpip * 1e6, inside);
+	printf("%-22s %10.1f us (%d points, %g)\n", "distance multipoint", tmpt * 1e6, npoints / 10, dmpt);
+
+	rect_tree_free(t1);
+	rect_tree_free(t2);
+	rect_tree_free(t3);
+	rect_tree_free(t4);
+	lwgeom_free(g1);
+	lwgeom_free(g2);
+	lwgeom_free(g3);
+	lwgeom_free(g4);
+	return 0;
+}
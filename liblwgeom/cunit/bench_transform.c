@@ -0,0 +1,109 @@
+/**********************************************************************
+ *
+ * PostGIS - Spatial Types for PostgreSQL
+ * http://postgis.net
+ *
+ * This is free software; you can redistribute and/or modify it under
+ * the terms of the GNU General Public Licence. See the COPYING file.
+ *
+ **********************************************************************/
+
+/*
+* Microbenchmark for the batched point array reprojection. Times
+* ptarray_transform against the old loop of point4d_transform calls
+* on a long zig-zag line, from long/lat to a UTM zone with a datum
+* shift.
+*
+*   make bench && ./bench_transform [npoints] [iterations]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "liblwgeom_internal.h"
+
+#define LONGLAT_WGS84 "+proj=longlat +datum=WGS84 +no_defs"
+#define UTM33_ED50 "+proj=utm +zone=33 +ellps=intl +towgs84=-87,-98,-121,0,0,0,0 +units=m +no_defs"
+
+static double
+now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* A zig-zag of npoints across central Europe */
+static POINTARRAY*
+make_line_ptarray(int npoints)
+{
+	POINTARRAY *pa = ptarray_construct(0, 0, npoints);
+	POINT4D p;
+	int i;
+
+	p.z = p.m = 0.0;
+	for ( i = 0; i < npoints; i++ )
+	{
+		p.x = 12.0 + 6.0 * i / npoints;
+		p.y = 45.0 + (i % 2 ? 0.1 : -0.1) + 4.0 * i / npoints;
+		ptarray_set_point4d(pa, i, &p);
+	}
+	return pa;
+}
+
+int
+main(int argc, char **argv)
+{
+	int npoints = argc > 1 ? atoi(argv[1]) : 100000;
+	int iterations = argc > 2 ? atoi(argv[2]) : 10;
+	projPJ pj_from, pj_to;
+	POINTARRAY *pa;
+	POINT4D p;
+	double t0, tpoint = 0.0, tarray = 0.0;
+	int i, j;
+
+	if ( npoints < 1 || iterations < 1 )
+	{
+		fprintf(stderr, "usage: %s [npoints >= 1] [iterations >= 1]\n", argv[0]);
+		return 1;
+	}
+
+	pj_from = lwproj_from_string(LONGLAT_WGS84);
+	pj_to = lwproj_from_string(UTM33_ED50);
+	if ( ! pj_from || ! pj_to )
+	{
+		fprintf(stderr, "%s: could not set up the projections\n", argv[0]);
+		return 1;
+	}
+
+	for ( i = 0; i < iterations; i++ )
+	{
+		pa = make_line_ptarray(npoints);
+		t0 = now();
+		for ( j = 0; j < pa->npoints; j++ )
+		{
+			getPoint4d_p(pa, j, &p);
+			point4d_transform(&p, pj_from, pj_to);
+			ptarray_set_point4d(pa, j, &p);
+		}
+		tpoint += now() - t0;
+		ptarray_free(pa);
+
+		pa = make_line_ptarray(npoints);
+		t0 = now();
+		ptarray_transform(pa, pj_from, pj_to);
+		tarray += now() - t0;
+		ptarray_free(pa);
+	}
+	tpoint /= iterations;
+	tarray /= iterations;
+
+	printf("%d vertices, %d iterations\n", npoints, iterations);
+	printf("%-22s %10.1f us (%.0f vertices/s)\n", "point4d_transform", tpoint * 1e6, npoints / tpoint);
+	printf("%-22s %10.1f us (%.0f vertices/s)\n", "ptarray_transform", tarray * 1e6, npoints / tarray);
+
+	pj_free(pj_from);
+	pj_free(pj_to);
+	return 0;
+}
@@ -13,6 +13,8 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <float.h>
+#include <math.h>
 #include "CUnit/Basic.h"
 
 #include "liblwgeom_internal.h"
@@ -900,6 +902,63 @@ static void test_geohash_point_as_int(void)
 }
 
 
+static void test_hilbert_xy_as_int(void)
+{
+	/* Cells of a 16 by 16 grid, in curve order, each next to the one before */
+	uint64_t keys[256];
+	int cells[256];
+	int i, j, k, t;
+	int ok = LW_TRUE;
+
+	for ( i = 0; i < 256; i++ )
+	{
+		keys[i] = hilbert_xy_as_int((uint32_t)(i % 16) << 28, (uint32_t)(i / 16) << 28);
+		cells[i] = i;
+	}
+	for ( i = 1; i < 256; i++ )
+	{
+		for ( j = i; j > 0 && keys[cells[j-1]] > keys[cells[j]]; j-- )
+		{
+			t = cells[j]; cells[j] = cells[j-1]; cells[j-1] = t;
+		}
+	}
+	CU_ASSERT_EQUAL(keys[0], 0);
+	for ( i = 1; i < 256; i++ )
+	{
+		j = cells[i-1];
+		k = cells[i];
+		if ( keys[j] == keys[k] || abs(j % 16 - k % 16) + abs(j / 16 - k / 16) != 1 )
+			ok = LW_FALSE;
+	}
+	CU_ASSERT(ok);
+
+	/* The last cell is the far end of the bottom edge */
+	CU_ASSERT_EQUAL(hilbert_xy_as_int(UINT32_MAX, 0), UINT64_MAX);
+}
+
+static void test_hilbert_float_point_as_int(void)
+{
+	POINT2D p1, p2;
+	uint64_t k[4];
+
+	/* Sign quadrants in curve order */
+	p1.x = -1; p1.y = -1; k[0] = hilbert_float_point_as_int(&p1);
+	p1.x = -1; p1.y = 1;  k[1] = hilbert_float_point_as_int(&p1);
+	p1.x = 1;  p1.y = 1;  k[2] = hilbert_float_point_as_int(&p1);
+	p1.x = 1;  p1.y = -1; k[3] = hilbert_float_point_as_int(&p1);
+	CU_ASSERT(k[0] < k[1]);
+	CU_ASSERT(k[1] < k[2]);
+	CU_ASSERT(k[2] < k[3]);
+
+	/* Beyond float range clamps, NaN counts as 0 */
+	p1.x = 1e300; p1.y = -1e300;
+	p2.x = FLT_MAX; p2.y = -FLT_MAX;
+	CU_ASSERT_EQUAL(hilbert_float_point_as_int(&p1), hilbert_float_point_as_int(&p2));
+	p1.x = NAN; p1.y = 0;
+	p2.x = 0; p2.y = 0;
+	CU_ASSERT_EQUAL(hilbert_float_point_as_int(&p1), hilbert_float_point_as_int(&p2));
+}
+
 /*
 ** Used by test harness to register the tests in this file.
 */
@@ -920,6 +979,8 @@ CU_TestInfo algorithms_tests[] =
 	PG_TEST(test_geohash_precision),
 	PG_TEST(test_geohash),
 	PG_TEST(test_geohash_point_as_int),
+	PG_TEST(test_hilbert_xy_as_int),
+	PG_TEST(test_hilbert_float_point_as_int),
 	PG_TEST(test_isclosed),
 	CU_TEST_INFO_NULL
 };
@@ -0,0 +1,258 @@
+/**********************************************************************
+ *
+ * PostGIS - Spatial Types for PostgreSQL
+ * http://postgis.net
+ *
+ * This is free software; you can redistribute and/or modify it under
+ * the terms of the GNU General Public Licence. See the COPYING file.
+ *
+ **********************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "CUnit/Basic.h"
+
+#include "liblwgeom_internal.h"
+#include "cu_tester.h"
+
+/*
+** Global variables to hold TWKB strings
+*/
+static char *hex_a;
+static char *hex_b;
+static char *wkt_b;
+
+/*
+** The suite initialization function.
+** Create any re-used objects.
+*/
+static int init_twkb_in_suite(void)
+{
+	hex_a = NULL;
+	hex_b = NULL;
+	wkt_b = NULL;
+	return 0;
+}
+
+/*
+** The suite cleanup function.
+** Frees any global objects.
+*/
+static int clean_twkb_in_suite(void)
+{
+	if (hex_a) free(hex_a);
+	if (hex_b) free(hex_b);
+	if (wkt_b) free(wkt_b);
+	hex_a = NULL;
+	hex_b = NULL;
+	wkt_b = NULL;
+	return 0;
+}
+
+/*
+** Write the geometry as TWKB, read it back and write it again.
+** Leaves both TWKB strings in hex_a and hex_b, and the read
+** geometry as WKT in wkt_b.
+*/
+static void cu_twkb_in(char *wkt, uint8_t variant, int8_t prec, int64_t id)
+{
+	LWGEOM *g_a, *g_b;
+	uint8_t *twkb_a, *twkb_b;
+	size_t twkb_size_a, twkb_size_b;
+
+	if ( hex_a ) free(hex_a);
+	if ( hex_b ) free(hex_b);
+	if ( wkt_b ) free(wkt_b);
+
+	/* Turn WKT into geom */
+	g_a = lwgeom_from_wkt(wkt, LW_PARSER_CHECK_NONE);
+
+	/* Turn geom into TWKB */
+	twkb_a = lwgeom_to_twkb(g_a, variant, &twkb_size_a, prec, id);
+
+	/* Turn TWKB back into geom  */
+	g_b = lwgeom_from_twkb(twkb_a, twkb_size_a, LW_PARSER_CHECK_NONE);
+
+	/* Turn geom to TWKB again */
+	twkb_b = lwgeom_to_twkb(g_b, variant, &twkb_size_b, prec, id);
+
+	/* Turn TWKB into hex for comparisons */
+	hex_a = hexbytes_from_bytes(twkb_a, twkb_size_a);
+	hex_b = hexbytes_from_bytes(twkb_b, twkb_size_b);
+	wkt_b = lwgeom_to_wkt(g_b, WKT_ISO, 8, NULL);
+
+	/* Clean up */
+	lwfree(twkb_a);
+	lwfree(twkb_b);
+	lwgeom_free(g_a);
+	lwgeom_free(g_b);
+}
+
+static void test_twkb_in_point(void)
+{
+	cu_twkb_in("POINT(0 0 0 0)", TWKB_ID, 0, 1);
+	CU_ASSERT_STRING_EQUAL(hex_a, hex_b);
+	CU_ASSERT_STRING_EQUAL(wkt_b, "POINT ZM (0 0 0 0)");
+
+	/* TWKB only knows there are three dimensions */
+	cu_twkb_in("SRID=4;POINTM(1 1 1)", TWKB_ID, 0, 1);
+	CU_ASSERT_STRING_EQUAL(hex_a, hex_b);
+	CU_ASSERT_STRING_EQUAL(wkt_b, "POINT Z (1 1 1)");
+
+	cu_twkb_in("POINT(78 -78)", TWKB_ID, 0, -10);
+	CU_ASSERT_STRING_EQUAL(hex_a, hex_b);
+	CU_ASSERT_STRING_EQUAL(wkt_b, "POINT(78 -78)");
+
+	cu_twkb_in("POINT(123.456789 987.654321)", 0, 2, 0);
+	CU_ASSERT_STRING_EQUAL(hex_a, hex_b);
+	CU_ASSERT_STRING_EQUAL(wkt_b, "POINT(123.46 987.65)");
+
+	cu_twkb_in("POINT EMPTY", 0, 0, 0);
+	CU_ASSERT_STRING_EQUAL(hex_a, hex_b);
+	CU_ASSERT_STRING_EQUAL(wkt_b, "MULTIPOINT EMPTY");
+}
+
+static void test_twkb_in_linestring(void)
+{
+	cu_twkb_in("LINESTRING(0 0,1 1)", TWKB_ID, 0, 1);
+	CU_ASSERT_STRING_EQUAL(hex_a, hex_b);
+	CU_ASSERT_STRING_EQUAL(wkt_b, "LINESTRING(0 0,1 1)");
+
+	cu_twkb_in("LINESTRING(0 0 1,1 1 2,2 2 3)", TWKB_ID, 0, 1);
+	CU_ASSERT_STRING_EQUAL(hex_a, hex_b);
+	CU_ASSERT_STRING_EQUAL(wkt_b, "LINESTRING Z (0 0 1,1 1 2,2 2 3)");
+
+	cu_twkb_in("LINESTRING(120.54 10.78, -50.2 20.878, 300.789 -21)", TWKB_ID, 2, 300);
+	CU_ASSERT_STRING_EQUAL(hex_a, hex_b);
+	CU_ASSERT_STRING_EQUAL(wkt_b, "LINESTRING(120.54 10.78,-50.2 20.88,300.79 -21)");
+
+	cu_twkb_in("LINESTRING EMPTY", TWKB_ID, 0, 1);
+	CU_ASSERT_STRING_EQUAL(hex_a, hex_b);
+	CU_ASSERT_STRING_EQUAL(wkt_b, "LINESTRING EMPTY");
+}
+
+static void test_twkb_in_polygon(void)
+{
+	cu_twkb_in("SRID=4;POLYGON((0 0 0,0 1 0,1 1 0,1 0 0,0 0 0))", TWKB_ID, 0, 1);
+	CU_ASSERT_STRING_EQUAL(hex_a, hex_b);
+	CU_ASSERT_STRING_EQUAL(wkt_b, "POLYGON Z ((0 0 0,0 1 0,1 1 0,1 0 0,0 0 0))");
+
+	cu_twkb_in("SRID=14;POLYGON((0 0 0 1,0 1 0 2,1 1 0 3,1 0 0 4,0 0 0 5))", TWKB_ID, 0, 1);
+	CU_ASSERT_STRING_EQUAL(hex_a, hex_b);
+	CU_ASSERT_STRING_EQUAL(wkt_b, "POLYGON ZM ((0 0 0 1,0 1 0 2,1 1 0 3,1 0 0 4,0 0 0 5))");
+
+	/* Deltas carry on from one ring to the next */
+	cu_twkb_in("POLYGON((1 1, 1 20, 20 20, 20 1, 1 1),(3 3,3 4, 4 4,4 3,3 3))", 0, 0, 0);
+	CU_ASSERT_STRING_EQUAL(hex_a, hex_b);
+	CU_ASSERT_STRING_EQUAL(wkt_b, "POLYGON((1 1,1 20,20 20,20 1,1 1),(3 3,3 4,4 4,4 3,3 3))");
+
+	cu_twkb_in("POLYGON EMPTY", TWKB_ID, 0, 1);
+	CU_ASSERT_STRING_EQUAL(hex_a, hex_b);
+	CU_ASSERT_STRING_EQUAL(wkt_b, "POLYGON EMPTY");
+}
+
+static void test_twkb_in_multipoint(void)
+{
+	cu_twkb_in("SRID=4;MULTIPOINT(0 0 0,0 1 0,1 1 0,1 0 0,0 0 0)", TWKB_ID, 0, 1);
+	CU_ASSERT_STRING_EQUAL(hex_a, hex_b);
+	CU_ASSERT_STRING_EQUAL(wkt_b, "MULTIPOINT Z (0 0 0,0 1 0,1 1 0,1 0 0,0 0 0)");
+
+	cu_twkb_in("MULTIPOINT(0 0 0, 0.26794919243112270647255365849413 1 3)", TWKB_ID, 7, 1);
+	CU_ASSERT_STRING_EQUAL(hex_a, hex_b);
+	CU_ASSERT_STRING_EQUAL(wkt_b, "MULTIPOINT Z (0 0 0,0.2679492 1 3)");
+}
+
+static void test_twkb_in_multilinestring(void)
+{
+	cu_twkb_in("MULTILINESTRING((1 1,1 2,2 2),(3 3,3 4,4 4))", 0, 0, 0);
+	CU_ASSERT_STRING_EQUAL(hex_a, hex_b);
+	CU_ASSERT_STRING_EQUAL(wkt_b, "MULTILINESTRING((1 1,1 2,2 2),(3 3,3 4,4 4))");
+}
+
+static void test_twkb_in_multipolygon(void)
+{
+	cu_twkb_in("SRID=14;MULTIPOLYGON(((0 0 0,0 1 0,1 1 0,1 0 0,0 0 0)),((-1 -1 0,-1 2 0,2 2 0,2 -1 0,-1 -1 0),(0 0 0,0 1 0,1 1 0,1 0 0,0 0 0)))", TWKB_ID, 0, 1);
+	CU_ASSERT_STRING_EQUAL(hex_a, hex_b);
+	CU_ASSERT_STRING_EQUAL(wkt_b, "MULTIPOLYGON Z (((0 0 0,0 1 0,1 1 0,1 0 0,0 0 0)),((-1 -1 0,-1 2 0,2 2 0,2 -1 0,-1 -1 0),(0 0 0,0 1 0,1 1 0,1 0 0,0 0 0)))");
+}
+
+static void test_twkb_in_collection(void)
+{
+	cu_twkb_in("SRID=14;GEOMETRYCOLLECTION(POLYGON((0 0 0,0 1 0,1 1 0,1 0 0,0 0 0)),POINT(1 1 1))", TWKB_ID, 0, 1);
+	CU_ASSERT_STRING_EQUAL(hex_a, hex_b);
+	CU_ASSERT_STRING_EQUAL(wkt_b, "GEOMETRYCOLLECTION Z (POLYGON Z ((0 0 0,0 1 0,1 1 0,1 0 0,0 0 0)),POINT Z (1 1 1))");
+
+	cu_twkb_in("GEOMETRYCOLLECTION(MULTIPOINT(1 1,2 2),POINT(78 -78),LINESTRING EMPTY,POLYGON((1 1,1 2,2 2,2 1,1 1)))", 0, 0, 0);
+	CU_ASSERT_STRING_EQUAL(hex_a, hex_b);
+	CU_ASSERT_STRING_EQUAL(wkt_b, "GEOMETRYCOLLECTION(MULTIPOINT(1 1,2 2),POINT(78 -78),LINESTRING EMPTY,POLYGON((1 1,1 2,2 2,2 1,1 1)))");
+
+	cu_twkb_in("GEOMETRYCOLLECTION EMPTY", TWKB_ID, 0, 1);
+	CU_ASSERT_STRING_EQUAL(hex_a, hex_b);
+	CU_ASSERT_STRING_EQUAL(wkt_b, "GEOMETRYCOLLECTION EMPTY");
+}
+
+static void test_twkb_in_variants(void)
+{
+	/* Stored sizes */
+	cu_twkb_in("LINESTRING(120 10, -50 20, 300 -2)", TWKB_ID | TWKB_SIZES, 0, 300);
+	CU_ASSERT_STRING_EQUAL(hex_a, hex_b);
+	CU_ASSERT_STRING_EQUAL(wkt_b, "LINESTRING(120 10,-50 20,300 -2)");
+
+	/* An empty with an id flag byte that looks like a POINT type byte */
+	cu_twkb_in("POLYGON EMPTY", TWKB_ID, 4, 1);
+	CU_ASSERT_STRING_EQUAL(hex_a, hex_b);
+	CU_ASSERT_STRING_EQUAL(wkt_b, "POLYGON EMPTY");
+
+	/* ... and the POINT it looks like */
+	cu_twkb_in("POINT(1 1)", TWKB_ID, 4, 1);
+	CU_ASSERT_STRING_EQUAL(hex_a, hex_b);
+	CU_ASSERT_STRING_EQUAL(wkt_b, "POINT(1 1)");
+}
+
+static void test_twkb_in_agg(void)
+{
+	lwgeom_id points[2];
+	twkb_geom_arrays arrays;
+	uint8_t *twkb;
+	size_t twkb_size;
+	LWGEOM *geom;
+	char *wkt;
+
+	memset(&arrays, 0, sizeof(twkb_geom_arrays));
+	points[0].id = 3;
+	points[0].geom = lwgeom_from_wkt("POINT(1 1)", LW_PARSER_CHECK_NONE);
+	points[1].id = 2;
+	points[1].geom = lwgeom_from_wkt("POINT(2 2)", LW_PARSER_CHECK_NONE);
+	arrays.points = points;
+	arrays.n_points = 2;
+
+	twkb = lwgeom_agg_to_twkb(&arrays, TWKB_ID, &twkb_size, 0);
+	geom = lwgeom_from_twkb(twkb, twkb_size, LW_PARSER_CHECK_NONE);
+	wkt = lwgeom_to_wkt(geom, WKT_ISO, 8, NULL);
+	CU_ASSERT_STRING_EQUAL(wkt, "MULTIPOINT(1 1,2 2)");
+
+	lwfree(wkt);
+	lwfree(twkb);
+	lwgeom_free(geom);
+	lwgeom_free(points[0].geom);
+	lwgeom_free(points[1].geom);
+}
+
+/*
+** Used by test harness to register the tests in this file.
+*/
+CU_TestInfo twkb_in_tests[] =
+{
+	PG_TEST(test_twkb_in_point),
+	PG_TEST(test_twkb_in_linestring),
+	PG_TEST(test_twkb_in_polygon),
+	PG_TEST(test_twkb_in_multipoint),
+	PG_TEST(test_twkb_in_multilinestring),
+	PG_TEST(test_twkb_in_multipolygon),
+	PG_TEST(test_twkb_in_collection),
+	PG_TEST(test_twkb_in_variants),
+	PG_TEST(test_twkb_in_agg),
+	CU_TEST_INFO_NULL
+};
+CU_SuiteInfo twkb_in_suite = {"TWKB In Suite",  init_twkb_in_suite,  clean_twkb_in_suite, twkb_in_tests};
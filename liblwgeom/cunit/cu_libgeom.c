@@ -395,6 +395,78 @@ static void test_on_gser_lwgeom_count_vertices(void)
 
 }
 
+static void test_gserialized_iterator(void)
+{
+	LWGEOM *lwgeom;
+	GSERIALIZED *g;
+	GSERIALIZED_ITERATOR it;
+	POINTARRAY pa;
+	GBOX gbox1, gbox2;
+	int i, rv1, rv2;
+	char *wkt[] = {
+		"POINT EMPTY",
+		"POINT(1 2)",
+		"LINESTRING(0 0,3 4,3 10)",
+		"POLYGON((0 0,10 0,10 10,0 10,0 0),(1 1,1 2,2 2,2 1,1 1),(5 5,5 6,6 6,6 5,5 5))",
+		"POLYGON Z((0 0 1,10 0 2,10 10 3,0 10 4,0 0 1))",
+		"TRIANGLE((0 0,1 0,0 1,0 0))",
+		"CIRCULARSTRING(0 0,1 1,2 0)",
+		"MULTIPOINT M(1 2 3,4 5 6)",
+		"MULTILINESTRING((0 0,1 1),EMPTY,(2 2,2 5))",
+		"MULTIPOLYGON(((0 0,4 0,4 4,0 4,0 0)),((10 10,12 10,12 12,10 10)))",
+		"GEOMETRYCOLLECTION(POINT(9 9),GEOMETRYCOLLECTION(LINESTRING(0 0,1 1),POLYGON((0 0,4 0,4 4,0 0))),POINT EMPTY)",
+		"GEOMETRYCOLLECTION(POINT EMPTY)",
+		"COMPOUNDCURVE(CIRCULARSTRING(0 0,1 1,1 0),(1 0,0 1))",
+		"CURVEPOLYGON(CIRCULARSTRING(0 0,4 0,4 4,0 4,0 0),(1 1,3 3,3 1,1 1))",
+		"MULTISURFACE(CURVEPOLYGON(CIRCULARSTRING(0 0,4 0,4 4,0 4,0 0)),((10 10,14 12,11 10,10 10)))",
+		"POLYHEDRALSURFACE(((0 0 0,0 0 1,0 1 1,0 1 0,0 0 0)),((0 0 0,0 1 0,1 1 0,1 0 0,0 0 0)))",
+		"TIN(((0 0 0,0 0 1,0 1 0,0 0 0)),((0 0 0,0 1 0,1 1 0,0 0 0)))"
+	};
+
+	for ( i = 0; i < sizeof(wkt)/sizeof(char*); i++ )
+	{
+		lwgeom = lwgeom_from_wkt(wkt[i], LW_PARSER_CHECK_NONE);
+		g = gserialized_from_lwgeom(lwgeom, 0, NULL);
+
+		CU_ASSERT_EQUAL(gserialized_count_vertices(g), lwgeom_count_vertices(lwgeom));
+		CU_ASSERT_DOUBLE_EQUAL(gserialized_length_2d(g), lwgeom_length_2d(lwgeom), 0.0);
+		CU_ASSERT_DOUBLE_EQUAL(gserialized_area(g), lwgeom_area(lwgeom), 0.0);
+
+		rv1 = gserialized_calculate_gbox_cartesian_p(g, &gbox1);
+		rv2 = lwgeom_calculate_gbox_cartesian(lwgeom, &gbox2);
+		CU_ASSERT_EQUAL(rv1, rv2);
+		if ( rv1 == LW_SUCCESS && rv2 == LW_SUCCESS )
+		{
+			CU_ASSERT_DOUBLE_EQUAL(gbox1.xmin, gbox2.xmin, 0.0);
+			CU_ASSERT_DOUBLE_EQUAL(gbox1.xmax, gbox2.xmax, 0.0);
+			CU_ASSERT_DOUBLE_EQUAL(gbox1.ymin, gbox2.ymin, 0.0);
+			CU_ASSERT_DOUBLE_EQUAL(gbox1.ymax, gbox2.ymax, 0.0);
+		}
+
+		lwgeom_free(lwgeom);
+		lwfree(g);
+	}
+
+	/* Rings come out in order, with the polygon type and ring number */
+	lwgeom = lwgeom_from_wkt("MULTIPOLYGON(((0 0,4 0,4 4,0 0),(1 1,2 1,2 2,1 1)),((5 5,6 5,6 6,5 5)))", LW_PARSER_CHECK_NONE);
+	g = gserialized_from_lwgeom(lwgeom, 0, NULL);
+	gserialized_iterator_init(&it, g);
+	CU_ASSERT(gserialized_iterator_next(&it, &pa));
+	CU_ASSERT_EQUAL(it.type, POLYGONTYPE);
+	CU_ASSERT_EQUAL(it.ring, 0);
+	CU_ASSERT_EQUAL(pa.npoints, 4);
+	CU_ASSERT(FLAGS_GET_READONLY(pa.flags));
+	CU_ASSERT(gserialized_iterator_next(&it, &pa));
+	CU_ASSERT_EQUAL(it.ring, 1);
+	CU_ASSERT_DOUBLE_EQUAL(getPoint2d_cp(&pa, 1)->x, 2.0, 0.0);
+	CU_ASSERT(gserialized_iterator_next(&it, &pa));
+	CU_ASSERT_EQUAL(it.ring, 0);
+	CU_ASSERT_DOUBLE_EQUAL(getPoint2d_cp(&pa, 0)->x, 5.0, 0.0);
+	CU_ASSERT_FALSE(gserialized_iterator_next(&it, &pa));
+	lwgeom_free(lwgeom);
+	lwfree(g);
+}
+
 static void test_lwcollection_extract(void)
 {
 
@@ -976,6 +1048,7 @@ CU_TestInfo libgeom_tests[] =
 	PG_TEST(test_lwgeom_from_gserialized),
 	PG_TEST(test_lwgeom_count_vertices),
 	PG_TEST(test_on_gser_lwgeom_count_vertices),
+	PG_TEST(test_gserialized_iterator),
 	PG_TEST(test_geometry_type_from_string),
 	PG_TEST(test_lwcollection_extract),
 	PG_TEST(test_lwgeom_free),
@@ -399,6 +399,198 @@ static void test_rect_tree_intersects_tree(void)
 
 }
 
+static void
+do_test_rect_tree_distance_tree(char *in1, char *in2, int line)
+{
+	LWGEOM *lw1 = lwgeom_from_wkt(in1, LW_PARSER_CHECK_NONE);
+	LWGEOM *lw2 = lwgeom_from_wkt(in2, LW_PARSER_CHECK_NONE);
+	RECT_NODE *tree1 = lwgeom_calculate_rect_tree(lw1);
+	RECT_NODE *tree2 = lwgeom_calculate_rect_tree(lw2);
+	double expected = lwgeom_mindistance2d(lw1, lw2);
+	double distance = rect_tree_distance_tree(tree1, tree2, 0.0);
+
+	if ( fabs(distance - expected) > 0.00001 )
+	{
+		printf("test_rect_tree_distance_tree failed (got %g expected %g) at line %d\n", distance, expected, line);
+		CU_FAIL();
+	}
+	else
+	{
+		CU_PASS();
+	}
+
+	rect_tree_free(tree1);
+	rect_tree_free(tree2);
+	lwgeom_free(lw1);
+	lwgeom_free(lw2);
+}
+
+#define RECTTREEDISTTEST(str1, str2) do_test_rect_tree_distance_tree(str1, str2, __LINE__)
+
+static void test_rect_tree_distance_tree(void)
+{
+	LWGEOM *lw1, *lw2;
+	LWPOLY *poly;
+	RECT_NODE *tree1, *tree2;
+	POINT2D p;
+
+	/* Edge to edge distances should match the brute force answers */
+	RECTTREEDISTTEST("POINT(0 0)", "POINT(3 4)");
+	RECTTREEDISTTEST("POINT(0 0)", "LINESTRING(1 -1, 1 1)");
+	RECTTREEDISTTEST("LINESTRING(0 0, 1 1, 2 0, 3 1, 4 0)", "LINESTRING(0 3, 4 3)");
+	RECTTREEDISTTEST("LINESTRING(0 0, 10 10)", "LINESTRING(0 10, 10 0)");
+	RECTTREEDISTTEST("LINESTRING(0 0, 0 0, 0 0)", "LINESTRING(2 0, 2 5)");
+	RECTTREEDISTTEST("MULTIPOINT(0 0, 10 10, 20 0)", "MULTILINESTRING((9 -1, 11 -1), (30 30, 31 31))");
+	RECTTREEDISTTEST("POLYGON((0 0, 3 1, 0 2, 3 3, 0 4, 3 5, 0 6, 5 6, 5 0, 0 0))", "POLYGON((-1 -1, -2 -1, -2 -2, -1 -2, -1 -1))");
+	RECTTREEDISTTEST("POLYGON((0 0, 10 0, 10 10, 0 10, 0 0), (2 2, 8 2, 8 8, 2 8, 2 2))", "LINESTRING(4 4, 5 6)");
+	RECTTREEDISTTEST("MULTIPOLYGON(((0 0, 1 0, 1 1, 0 1, 0 0)), ((5 5, 6 5, 6 6, 5 6, 5 5)))", "POINT(3 4)");
+
+	/* A positive threshold stops the search at the first close enough pair */
+	lw1 = lwgeom_from_wkt("LINESTRING(0 0, 10 0)", LW_PARSER_CHECK_NONE);
+	lw2 = lwgeom_from_wkt("LINESTRING(0 1, 10 1)", LW_PARSER_CHECK_NONE);
+	tree1 = lwgeom_calculate_rect_tree(lw1);
+	tree2 = lwgeom_calculate_rect_tree(lw2);
+	CU_ASSERT(rect_tree_distance_tree(tree1, tree2, 2.0) <= 2.0);
+	rect_tree_free(tree1);
+	rect_tree_free(tree2);
+	lwgeom_free(lw1);
+	lwgeom_free(lw2);
+
+	/* Curves are not supported */
+	lw1 = lwgeom_from_wkt("CIRCULARSTRING(0 0, 1 1, 2 0)", LW_PARSER_CHECK_NONE);
+	CU_ASSERT_PTR_NULL(lwgeom_calculate_rect_tree(lw1));
+	lwgeom_free(lw1);
+
+	/* Containment test on a polygon with a hole */
+	poly = (LWPOLY*)lwgeom_from_wkt("POLYGON((0 0, 10 0, 10 10, 0 10, 0 0), (2 2, 8 2, 8 8, 2 8, 2 2))", LW_PARSER_CHECK_NONE);
+	tree1 = lwgeom_calculate_rect_tree((LWGEOM*)poly);
+	p.x = 1.0; p.y = 5.0;
+	CU_ASSERT_EQUAL(rect_tree_polygon_contains_point(tree1, &p), LW_TRUE);
+	p.x = 5.0; p.y = 5.0;
+	CU_ASSERT_EQUAL(rect_tree_polygon_contains_point(tree1, &p), LW_FALSE);
+	p.x = 11.0; p.y = 5.0;
+	CU_ASSERT_EQUAL(rect_tree_polygon_contains_point(tree1, &p), LW_FALSE);
+	p.x = 1.0; p.y = 2.0;
+	CU_ASSERT_EQUAL(rect_tree_polygon_contains_point(tree1, &p), LW_TRUE);
+	rect_tree_get_point(tree1, &p);
+	CU_ASSERT_DOUBLE_EQUAL(p.x, 0.0, 0.000001);
+	CU_ASSERT_DOUBLE_EQUAL(p.y, 0.0, 0.000001);
+	rect_tree_free(tree1);
+	lwpoly_free(poly);
+}
+
+static void test_rect_tree_flatten(void)
+{
+	LWGEOM *lw1, *lw2;
+	RECT_NODE *tree1, *tree2, *flat1, *flat2;
+	void *buf1, *buf2;
+	size_t size1, size2;
+	POINT2D p;
+
+	lw1 = lwgeom_from_wkt("POLYGON((0 0, 10 0, 10 10, 0 10, 0 0), (2 2, 8 2, 8 8, 2 8, 2 2))", LW_PARSER_CHECK_NONE);
+	lw2 = lwgeom_from_wkt("MULTIPOINT(4 4, 20 20, 5 -3)", LW_PARSER_CHECK_NONE);
+	tree1 = lwgeom_calculate_rect_tree(lw1);
+	tree2 = lwgeom_calculate_rect_tree(lw2);
+	buf1 = rect_tree_flatten(tree1, &size1);
+	buf2 = rect_tree_flatten(tree2, &size2);
+
+	/* The rebuilt trees no longer need the geometries */
+	rect_tree_free(tree1);
+	rect_tree_free(tree2);
+	lwgeom_free(lw1);
+	lwgeom_free(lw2);
+
+	flat1 = rect_tree_unflatten(buf1, size1);
+	flat2 = rect_tree_unflatten(buf2, size2);
+	CU_ASSERT_PTR_NOT_NULL(flat1);
+	CU_ASSERT_PTR_NOT_NULL(flat2);
+	CU_ASSERT_DOUBLE_EQUAL(rect_tree_distance_tree(flat1, flat2, 0.0), 2.0, 0.000001);
+	p.x = 1.0; p.y = 5.0;
+	CU_ASSERT_EQUAL(rect_tree_polygon_contains_point(flat1, &p), LW_TRUE);
+	p.x = 5.0; p.y = 5.0;
+	CU_ASSERT_EQUAL(rect_tree_polygon_contains_point(flat1, &p), LW_FALSE);
+
+	/* Not a flattened tree */
+	CU_ASSERT_PTR_NULL(rect_tree_unflatten(buf1, size1 - 1));
+	CU_ASSERT_PTR_NULL(rect_tree_unflatten(buf1, 4));
+
+	rect_tree_free(flat1);
+	rect_tree_free(flat2);
+	lwfree(buf1);
+	lwfree(buf2);
+}
+
+/* Check the fan-out and depth of every node, return the number of leaves */
+static int rect_tree_check(const RECT_NODE *node, int depth, int *leaf_depth)
+{
+	int i, leaves = 0;
+
+	if ( node->p1 )
+	{
+		CU_ASSERT_EQUAL(node->num_nodes, 0);
+		if ( *leaf_depth < 0 )
+			*leaf_depth = depth;
+		CU_ASSERT_EQUAL(depth, *leaf_depth);
+		return 1;
+	}
+
+	CU_ASSERT(node->num_nodes > 0 && node->num_nodes <= RECT_NODE_SIZE);
+	CU_ASSERT(node->first_child > 0);
+	for ( i = 0; i < node->num_nodes; i++ )
+	{
+		const RECT_NODE *child = node + node->first_child + i;
+		CU_ASSERT(child->xmin >= node->xmin && child->xmax <= node->xmax);
+		CU_ASSERT(child->ymin >= node->ymin && child->ymax <= node->ymax);
+		leaves += rect_tree_check(child, depth + 1, leaf_depth);
+	}
+	return leaves;
+}
+
+static void test_rect_tree_str(void)
+{
+	LWGEOM *comb, *lw;
+	RECT_NODE *tree1, *tree2;
+	POINTARRAY *pa;
+	POINT4D pt;
+	int i, depth = -1;
+
+	/* A long zig-zag, the worst case for merging edges in vertex order */
+	pa = ptarray_construct_empty(0, 0, 1001);
+	pt.z = pt.m = 0.0;
+	for ( i = 0; i <= 1000; i++ )
+	{
+		pt.x = (i % 2) ? 100.0 : 0.0;
+		pt.y = i * 0.1;
+		ptarray_append_point(pa, &pt, LW_TRUE);
+	}
+	comb = lwline_as_lwgeom(lwline_construct(SRID_UNKNOWN, NULL, pa));
+	tree1 = lwgeom_calculate_rect_tree(comb);
+
+	/* Every edge has a leaf, all at the same depth, with no node over full */
+	CU_ASSERT_EQUAL(rect_tree_check(tree1, 0, &depth), 1000);
+	CU_ASSERT_EQUAL(depth, 4);
+
+	/* Parts of a multi-geometry are packed together */
+	lw = lwgeom_from_wkt("MULTILINESTRING((50 20.05, 50.5 20.05), (50 -1, 50 -2), (200 0, 200 1), (-5 50, -5 51))", LW_PARSER_CHECK_NONE);
+	tree2 = lwgeom_calculate_rect_tree(lw);
+	depth = -1;
+	CU_ASSERT_EQUAL(rect_tree_check(tree2, 0, &depth), 4);
+	CU_ASSERT_EQUAL(rect_tree_intersects_tree(tree1, tree2), LW_TRUE);
+	CU_ASSERT_DOUBLE_EQUAL(rect_tree_distance_tree(tree1, tree2, 0.0), lwgeom_mindistance2d(comb, lw), 0.000001);
+	rect_tree_free(tree2);
+	lwgeom_free(lw);
+
+	lw = lwgeom_from_wkt("LINESTRING(50 20.04, 50.5 20.04)", LW_PARSER_CHECK_NONE);
+	tree2 = lwgeom_calculate_rect_tree(lw);
+	CU_ASSERT_EQUAL(rect_tree_intersects_tree(tree1, tree2), LW_FALSE);
+	CU_ASSERT_DOUBLE_EQUAL(rect_tree_distance_tree(tree1, tree2, 0.0), lwgeom_mindistance2d(comb, lw), 0.000001);
+	rect_tree_free(tree2);
+	lwgeom_free(lw);
+
+	rect_tree_free(tree1);
+	lwgeom_free(comb);
+}
+
 static void
 test_lwgeom_segmentize2d(void)
 {
@@ -830,6 +1022,95 @@ test_lw_dist2d_ptarray_ptarrayarc(void)
 	lwline_free(lwline1);
 }
 
+/* Every pair of edges (or of vertices for DIST_MAX), the way it's done for small arrays */
+static double
+dist2d_ptarray_ptarray_pairs(const POINTARRAY *pa, const POINTARRAY *pb, int mode)
+{
+	DISTPTS dl;
+	int i, j;
+
+	lw_dist2d_distpts_init(&dl, mode);
+	for ( i = 0; i < pa->npoints; i++ )
+	{
+		for ( j = 0; j < pb->npoints; j++ )
+		{
+			if ( mode == DIST_MAX )
+				lw_dist2d_pt_pt(getPoint2d_cp(pa, i), getPoint2d_cp(pb, j), &dl);
+			else if ( i > 0 && j > 0 )
+				lw_dist2d_seg_seg(getPoint2d_cp(pa, i-1), getPoint2d_cp(pa, i), getPoint2d_cp(pb, j-1), getPoint2d_cp(pb, j), &dl);
+		}
+	}
+	return dl.distance;
+}
+
+static void
+test_lw_dist2d_ptarray_ptarray_tree(void)
+{
+	LWGEOM *lw1, *lw2;
+	POINTARRAY *pa, *pb;
+	POINT4D p;
+	DISTPTS dl, dl1;
+	int i, rv;
+
+	/* A wiggly line and a copy shifted up, with overlapping boxes and too many edge pairs to try them all */
+	pa = ptarray_construct_empty(0, 0, 200);
+	pb = ptarray_construct_empty(0, 0, 200);
+	p.z = p.m = 0.0;
+	for ( i = 0; i < 200; i++ )
+	{
+		p.x = i * 0.1;
+		p.y = 5.0 * sin(i * 0.7);
+		ptarray_append_point(pa, &p, LW_TRUE);
+		p.y += 0.5;
+		ptarray_append_point(pb, &p, LW_TRUE);
+	}
+
+	lw_dist2d_distpts_init(&dl, DIST_MIN);
+	dl.twisted = 1;
+	rv = lw_dist2d_ptarray_ptarray(pa, pb, &dl);
+	CU_ASSERT_EQUAL(rv, LW_TRUE);
+	CU_ASSERT_DOUBLE_EQUAL(dl.distance, dist2d_ptarray_ptarray_pairs(pa, pb, DIST_MIN), 0.000000001);
+	CU_ASSERT(dl.distance > 0.0 && dl.distance < 0.5);
+
+	/* The closest points are on their own arrays, in argument order */
+	lw_dist2d_distpts_init(&dl1, DIST_MIN);
+	lw_dist2d_pt_ptarray(&(dl.p1), pa, &dl1);
+	CU_ASSERT_DOUBLE_EQUAL(dl1.distance, 0.0, 0.000000001);
+	lw_dist2d_distpts_init(&dl1, DIST_MIN);
+	lw_dist2d_pt_ptarray(&(dl.p2), pb, &dl1);
+	CU_ASSERT_DOUBLE_EQUAL(dl1.distance, 0.0, 0.000000001);
+	CU_ASSERT_DOUBLE_EQUAL(distance2d_pt_pt(&(dl.p1), &(dl.p2)), dl.distance, 0.000000001);
+
+	/* Twisted, as when the geometries were swapped on the way down */
+	lw_dist2d_distpts_init(&dl1, DIST_MIN);
+	dl1.twisted = -1;
+	lw_dist2d_ptarray_ptarray(pa, pb, &dl1);
+	CU_ASSERT_DOUBLE_EQUAL(dl1.distance, dl.distance, 0.000000001);
+	CU_ASSERT_DOUBLE_EQUAL(distance2d_pt_pt(&(dl1.p2), &(dl.p1)), 0.0, 0.000000001);
+	CU_ASSERT_DOUBLE_EQUAL(distance2d_pt_pt(&(dl1.p1), &(dl.p2)), 0.0, 0.000000001);
+
+	/* A tolerance stops the search at the first pair within it */
+	lw_dist2d_distpts_init(&dl, DIST_MIN);
+	dl.tolerance = 1.0;
+	lw_dist2d_ptarray_ptarray(pa, pb, &dl);
+	CU_ASSERT(dl.distance <= 1.0);
+
+	/* The longest distance is between vertices */
+	lw_dist2d_distpts_init(&dl, DIST_MAX);
+	dl.twisted = 1;
+	lw_dist2d_ptarray_ptarray(pa, pb, &dl);
+	CU_ASSERT_DOUBLE_EQUAL(dl.distance, dist2d_ptarray_ptarray_pairs(pa, pb, DIST_MAX), 0.000000001);
+	CU_ASSERT_DOUBLE_EQUAL(distance2d_pt_pt(&(dl.p1), &(dl.p2)), dl.distance, 0.000000001);
+
+	/* And through the geometry functions */
+	lw1 = lwline_as_lwgeom(lwline_construct(SRID_UNKNOWN, NULL, pa));
+	lw2 = lwline_as_lwgeom(lwline_construct(SRID_UNKNOWN, NULL, pb));
+	CU_ASSERT_DOUBLE_EQUAL(lwgeom_mindistance2d(lw1, lw2), dist2d_ptarray_ptarray_pairs(pa, pb, DIST_MIN), 0.000000001);
+	CU_ASSERT_DOUBLE_EQUAL(lwgeom_maxdistance2d(lw1, lw2), dist2d_ptarray_ptarray_pairs(pa, pb, DIST_MAX), 0.000000001);
+	lwgeom_free(lw1);
+	lwgeom_free(lw2);
+}
+
 /*
 ** Used by test harness to register the tests in this file.
 */
@@ -838,6 +1119,9 @@ CU_TestInfo measures_tests[] =
 	PG_TEST(test_mindistance2d_tolerance),
 	PG_TEST(test_rect_tree_contains_point),
 	PG_TEST(test_rect_tree_intersects_tree),
+	PG_TEST(test_rect_tree_distance_tree),
+	PG_TEST(test_rect_tree_flatten),
+	PG_TEST(test_rect_tree_str),
 	PG_TEST(test_lwgeom_segmentize2d),
 	PG_TEST(test_lwgeom_locate_along),
 	PG_TEST(test_lw_dist2d_pt_arc),
@@ -846,6 +1130,7 @@ CU_TestInfo measures_tests[] =
 	PG_TEST(test_lw_arc_length),
 	PG_TEST(test_lw_dist2d_pt_ptarrayarc),
 	PG_TEST(test_lw_dist2d_ptarray_ptarrayarc),
+	PG_TEST(test_lw_dist2d_ptarray_ptarray_tree),
 	CU_TEST_INFO_NULL
 };
 CU_SuiteInfo measures_suite = {"measures", NULL,  NULL, measures_tests};
@@ -119,6 +119,65 @@ static void test_misc_wkb(void)
 		
 }
 
+static void test_misc_arena(void)
+{
+	LWARENA *arena, *old;
+	LWGEOM *geom, *geom2;
+	POINTARRAY *pa;
+	POINT4D pt;
+	uint8_t *wkb;
+	size_t wkb_size;
+	char *plain, *wkt_out;
+	int i;
+
+	/* Allocated before the arena, freed while it is current */
+	plain = lwalloc(16);
+
+	arena = lwarena_create(0);
+	old = lwarena_switch(arena);
+	CU_ASSERT(old == NULL);
+
+	lwfree(plain);
+
+	/* Readers build straight into the arena */
+	geom = lwgeom_from_wkt("MULTIPOLYGON(((0 0,10 0,10 10,0 10,0 0),(1 1,2 1,2 2,1 1)),((20 20,21 20,21 21,20 20)))", LW_PARSER_CHECK_ALL);
+	wkb = lwgeom_to_wkb(geom, WKB_EXTENDED, &wkb_size);
+	geom2 = lwgeom_from_wkb(wkb, wkb_size, LW_PARSER_CHECK_ALL);
+	CU_ASSERT(lwgeom_same(geom, geom2));
+
+	/* Freeing arena memory is a no-op */
+	lwgeom_free(geom2);
+	lwfree(wkb);
+
+	/* Growing point arrays spill over several blocks */
+	pa = ptarray_construct_empty(0, 0, 2);
+	for ( i = 0; i < 20000; i++ )
+	{
+		pt.x = i; pt.y = -i; pt.z = pt.m = 0.0;
+		ptarray_append_point(pa, &pt, LW_TRUE);
+	}
+	CU_ASSERT_EQUAL(pa->npoints, 20000);
+	CU_ASSERT_DOUBLE_EQUAL(getPoint2d_cp(pa, 19999)->y, -19999.0, 0.0);
+	CU_ASSERT_DOUBLE_EQUAL(getPoint2d_cp(pa, 0)->x, 0.0, 0.0);
+
+	/* Results that outlive the arena are built once it is switched out */
+	old = lwarena_switch(NULL);
+	CU_ASSERT(old == arena);
+	wkt_out = lwgeom_to_ewkt(geom);
+	CU_ASSERT_STRING_EQUAL(wkt_out, "MULTIPOLYGON(((0 0,10 0,10 10,0 10,0 0),(1 1,2 1,2 2,1 1)),((20 20,21 20,21 21,20 20)))");
+	lwfree(wkt_out);
+
+	/* A reset arena can be used again */
+	lwarena_reset(arena);
+	lwarena_switch(arena);
+	geom = lwgeom_from_wkt("POINT(1 2)", LW_PARSER_CHECK_ALL);
+	CU_ASSERT_DOUBLE_EQUAL(lwpoint_get_y((LWPOINT*)geom), 2.0, 0.0);
+
+	/* Destroying the current arena switches it out */
+	lwarena_destroy(arena);
+	CU_ASSERT(lwarena_switch(NULL) == NULL);
+}
+
 /*
 ** Used by the test harness to register the tests in this file.
 */
@@ -129,6 +188,7 @@ CU_TestInfo misc_tests[] =
 	PG_TEST(test_misc_count_vertices),
 	PG_TEST(test_misc_area),
 	PG_TEST(test_misc_wkb),
+	PG_TEST(test_misc_arena),
 	CU_TEST_INFO_NULL
 };
 CU_SuiteInfo misc_suite = {"misc", NULL, NULL, misc_tests };
@@ -15,6 +15,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <math.h>
 #include "CUnit/Basic.h"
 #include "CUnit/CUnit.h"
 
@@ -342,6 +343,127 @@ static void test_ptarray_signed_area()
 }
 
 
+/*
+* Every kernel level has to agree exactly with the scalar one, for
+* each point stride and for counts that exercise the loop tails.
+*/
+static void test_ptarray_simd_kernels(void)
+{
+	double ords[4 * 203];
+	double min0[4], max0[4], min1[4], max1[4];
+	double len0, len1, area0, area1;
+	int ndims, npoints, level, d, i;
+	int old = lw_simd_level();
+
+	for ( i = 0; i < 4 * 203; i++ )
+		ords[i] = sin(i * 0.7) * 1000.0 + (i % 7);
+
+	for ( ndims = 2; ndims <= 4; ndims++ )
+	{
+		for ( npoints = 1; npoints <= 203; npoints += (npoints < 12 ? 1 : 19) )
+		{
+			lw_simd_set_level(LW_SIMD_NONE);
+			lw_ordinates_minmax(ords, npoints, ndims, min0, max0);
+			len0 = lw_ordinates_length_2d(ords, npoints, ndims);
+			area0 = lw_ordinates_signed_area(ords, npoints, ndims);
+
+			for ( level = LW_SIMD_SSE2; level <= LW_SIMD_AVX2; level++ )
+			{
+				lw_simd_set_level(level);
+				lw_ordinates_minmax(ords, npoints, ndims, min1, max1);
+				len1 = lw_ordinates_length_2d(ords, npoints, ndims);
+				area1 = lw_ordinates_signed_area(ords, npoints, ndims);
+				for ( d = 0; d < ndims; d++ )
+				{
+					CU_ASSERT_EQUAL(min0[d], min1[d]);
+					CU_ASSERT_EQUAL(max0[d], max1[d]);
+				}
+				CU_ASSERT_EQUAL(len0, len1);
+				CU_ASSERT_EQUAL(area0, area1);
+			}
+		}
+	}
+	lw_simd_set_level(old);
+}
+
+static void test_ptarray_simd_gbox(void)
+{
+	LWGEOM *geom;
+	GBOX box;
+
+	/* The measure is the third ordinate in XYM */
+	geom = lwgeom_from_text("LINESTRING M(0 5 3,-1 2 9,4 1 -2)");
+	ptarray_calculate_gbox_cartesian(lwgeom_as_lwline(geom)->points, &box);
+	CU_ASSERT_EQUAL(box.xmin, -1);
+	CU_ASSERT_EQUAL(box.xmax, 4);
+	CU_ASSERT_EQUAL(box.ymin, 1);
+	CU_ASSERT_EQUAL(box.ymax, 5);
+	CU_ASSERT_EQUAL(box.mmin, -2);
+	CU_ASSERT_EQUAL(box.mmax, 9);
+	CU_ASSERT(! FLAGS_GET_Z(box.flags));
+	CU_ASSERT(FLAGS_GET_M(box.flags));
+	lwgeom_free(geom);
+
+	geom = lwgeom_from_text("LINESTRING ZM(0 5 3 1,-1 2 9 7,4 1 -2 0)");
+	ptarray_calculate_gbox_cartesian(lwgeom_as_lwline(geom)->points, &box);
+	CU_ASSERT_EQUAL(box.zmin, -2);
+	CU_ASSERT_EQUAL(box.zmax, 9);
+	CU_ASSERT_EQUAL(box.mmin, 0);
+	CU_ASSERT_EQUAL(box.mmax, 7);
+	lwgeom_free(geom);
+}
+
+/*
+* The batched point in ring test has to agree with the one point at a
+* time version at every kernel level, on the boundary too.
+*/
+static void test_ptarray_contains_points(void)
+{
+	LWPOLY *poly;
+	POINT2D pts[121];
+	int results[121];
+	int i, level, nfail;
+	int old = lw_simd_level();
+
+	/* A comb with a zero length edge and a horizontal edge at y=2 */
+	poly = (LWPOLY*)lwgeom_from_text("POLYGON((0 0,10 0,10 10,8 10,8 2,6 2,6 10,4 10,4 10,4 2,2 2,2 10,0 10,0 0))");
+	for ( i = 0; i < 121; i++ )
+	{
+		pts[i].x = (i % 11) - 0.5;
+		pts[i].y = (i / 11) - 0.5;
+		/* Every third point on the grid of vertices instead */
+		if ( i % 3 == 0 )
+		{
+			pts[i].x += 0.5;
+			pts[i].y += 0.5;
+		}
+	}
+
+	for ( level = LW_SIMD_NONE; level <= LW_SIMD_AVX2; level++ )
+	{
+		lw_simd_set_level(level);
+		/* Odd counts leave a tail for the scalar code */
+		ptarray_contains_points(poly->rings[0], pts, 119, results);
+		nfail = 0;
+		for ( i = 0; i < 119; i++ )
+		{
+			if ( results[i] != ptarray_contains_point(poly->rings[0], pts + i) )
+				nfail++;
+		}
+		CU_ASSERT_EQUAL(nfail, 0);
+	}
+
+	/* Spot checks */
+	ptarray_contains_points(poly->rings[0], pts, 121, results);
+	CU_ASSERT_EQUAL(results[0], LW_BOUNDARY); /* 0 0 */
+	CU_ASSERT_EQUAL(results[12], LW_INSIDE); /* 1 1 */
+	CU_ASSERT_EQUAL(results[3], LW_BOUNDARY); /* 3 0 */
+	CU_ASSERT_EQUAL(results[1], LW_OUTSIDE); /* 0.5 -0.5 */
+	CU_ASSERT_EQUAL(results[52], LW_OUTSIDE); /* 7.5 3.5, between the teeth */
+
+	lw_simd_set_level(old);
+	lwpoly_free(poly);
+}
 
 static void test_ptarray_desegmentize() 
 {
@@ -703,6 +825,9 @@ CU_TestInfo ptarray_tests[] =
 	PG_TEST(test_ptarray_insert_point),
 	PG_TEST(test_ptarray_contains_point),
 	PG_TEST(test_ptarrayarc_contains_point),
+	PG_TEST(test_ptarray_simd_kernels),
+	PG_TEST(test_ptarray_simd_gbox),
+	PG_TEST(test_ptarray_contains_points),
 	CU_TEST_INFO_NULL
 };
 CU_SuiteInfo ptarray_suite = {"ptarray", NULL, NULL, ptarray_tests };
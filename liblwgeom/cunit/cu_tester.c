@@ -33,6 +33,7 @@ extern CU_SuiteInfo node_suite;
 extern CU_SuiteInfo wkt_out_suite;
 extern CU_SuiteInfo wkt_in_suite;
 extern CU_SuiteInfo twkb_out_suite;
+extern CU_SuiteInfo twkb_in_suite;
 extern CU_SuiteInfo wkb_out_suite;
 extern CU_SuiteInfo wkb_in_suite;
 extern CU_SuiteInfo libgeom_suite;
@@ -55,6 +56,7 @@ extern CU_SuiteInfo out_x3d_suite;
 extern CU_SuiteInfo out_encoded_polyline_suite;
 extern CU_SuiteInfo in_encoded_polyline_suite;
 extern CU_SuiteInfo varint_suite;
+extern CU_SuiteInfo transform_suite;
 
 /*
 ** The main() function for setting up and running the tests.
@@ -77,6 +79,7 @@ int main(int argc, char *argv[])
 		wkt_out_suite,
 		wkt_in_suite,
 		twkb_out_suite,
+		twkb_in_suite,
 		wkb_out_suite,
 		wkb_in_suite,
 		libgeom_suite,
@@ -103,6 +106,7 @@ int main(int argc, char *argv[])
 		out_encoded_polyline_suite,
 		in_encoded_polyline_suite,
 		varint_suite,
+		transform_suite,
 		CU_SUITE_INFO_NULL
 	};
 
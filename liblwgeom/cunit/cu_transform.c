@@ -0,0 +1,121 @@
+/**********************************************************************
+ *
+ * PostGIS - Spatial Types for PostgreSQL
+ * http://postgis.net
+ *
+ * This is free software; you can redistribute and/or modify it under
+ * the terms of the GNU General Public Licence. See the COPYING file.
+ *
+ **********************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "CUnit/Basic.h"
+
+#include "liblwgeom_internal.h"
+#include "cu_tester.h"
+
+#define LONGLAT_WGS84 "+proj=longlat +datum=WGS84 +no_defs"
+#define MERCATOR_WGS84 "+proj=merc +datum=WGS84 +units=m +no_defs"
+/* ED50 UTM 33N, with a three parameter datum shift to exercise pj_datum_transform */
+#define UTM33_ED50 "+proj=utm +zone=33 +ellps=intl +towgs84=-87,-98,-121,0,0,0,0 +units=m +no_defs"
+
+static POINTARRAY*
+make_line_ptarray(int npoints, int hasz)
+{
+	POINTARRAY *pa = ptarray_construct(hasz, 0, npoints);
+	POINT4D p;
+	int i;
+
+	for ( i = 0; i < npoints; i++ )
+	{
+		/* A zig-zag across central Europe */
+		p.x = 12.0 + 6.0 * i / npoints;
+		p.y = 45.0 + (i % 2 ? 0.1 : -0.1) + 4.0 * i / npoints;
+		p.z = 100.0 + i % 50;
+		p.m = 0.0;
+		ptarray_set_point4d(pa, i, &p);
+	}
+	return pa;
+}
+
+/*
+* The batched transform must give the same answer as 
+* transforming one point at a time.
+*/
+static void
+do_test_ptarray_transform(const char *from, const char *to, int hasz)
+{
+	projPJ pj_from = lwproj_from_string(from);
+	projPJ pj_to = lwproj_from_string(to);
+	POINTARRAY *pa = make_line_ptarray(1000, hasz);
+	POINT4D p, q;
+	int i;
+
+	CU_ASSERT_PTR_NOT_NULL_FATAL(pj_from);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(pj_to);
+
+	CU_ASSERT_EQUAL(ptarray_transform(pa, pj_from, pj_to), LW_SUCCESS);
+
+	for ( i = 0; i < pa->npoints; i += 97 )
+	{
+		POINTARRAY *single = make_line_ptarray(1000, hasz);
+		getPoint4d_p(single, i, &p);
+		CU_ASSERT_EQUAL(point4d_transform(&p, pj_from, pj_to), LW_SUCCESS);
+		getPoint4d_p(pa, i, &q);
+		CU_ASSERT_DOUBLE_EQUAL(p.x, q.x, 0.000001);
+		CU_ASSERT_DOUBLE_EQUAL(p.y, q.y, 0.000001);
+		if ( hasz )
+			CU_ASSERT_DOUBLE_EQUAL(p.z, q.z, 0.000001);
+		ptarray_free(single);
+	}
+
+	/* And back again */
+	CU_ASSERT_EQUAL(ptarray_transform(pa, pj_to, pj_from), LW_SUCCESS);
+	getPoint4d_p(pa, 500, &q);
+	CU_ASSERT_DOUBLE_EQUAL(q.x, 12.0 + 6.0 * 500 / 1000, 0.0000001);
+	CU_ASSERT_DOUBLE_EQUAL(q.y, 45.0 - 0.1 + 4.0 * 500 / 1000, 0.0000001);
+
+	ptarray_free(pa);
+	pj_free(pj_from);
+	pj_free(pj_to);
+}
+
+static void test_ptarray_transform(void)
+{
+	do_test_ptarray_transform(LONGLAT_WGS84, MERCATOR_WGS84, 0);
+	do_test_ptarray_transform(LONGLAT_WGS84, MERCATOR_WGS84, 1);
+	do_test_ptarray_transform(LONGLAT_WGS84, UTM33_ED50, 0);
+	do_test_ptarray_transform(LONGLAT_WGS84, UTM33_ED50, 1);
+}
+
+static void test_lwgeom_transform(void)
+{
+	projPJ pj_from = lwproj_from_string(LONGLAT_WGS84);
+	projPJ pj_to = lwproj_from_string(MERCATOR_WGS84);
+	LWGEOM *geom = lwgeom_from_wkt("MULTIPOLYGON(((0 0,0 10,10 10,10 0,0 0),(1 1,2 1,2 2,1 1)),((20 20,20 30,30 30,20 20)))", LW_PARSER_CHECK_NONE);
+	char *wkt;
+
+	CU_ASSERT_EQUAL(lwgeom_transform(geom, pj_from, pj_to), LW_SUCCESS);
+	CU_ASSERT_EQUAL(lwgeom_transform(geom, pj_to, pj_from), LW_SUCCESS);
+	wkt = lwgeom_to_wkt(geom, WKT_ISO, 6, NULL);
+	CU_ASSERT_STRING_EQUAL(wkt, "MULTIPOLYGON(((0 0,0 10,10 10,10 0,0 0),(1 1,2 1,2 2,1 1)),((20 20,20 30,30 30,20 20)))");
+
+	lwfree(wkt);
+	lwgeom_free(geom);
+	pj_free(pj_from);
+	pj_free(pj_to);
+}
+
+/*
+** Used by test harness to register the tests in this file.
+*/
+CU_TestInfo transform_tests[] =
+{
+	PG_TEST(test_ptarray_transform),
+	PG_TEST(test_lwgeom_transform),
+	CU_TEST_INFO_NULL
+};
+CU_SuiteInfo transform_suite = {"transform", NULL, NULL, transform_tests};
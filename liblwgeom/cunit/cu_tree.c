@@ -329,6 +329,59 @@ static void test_tree_circ_distance(void)
 
 
 
+static void test_tree_circ_flatten(void)
+{
+	LWGEOM *lwg1, *lwg2;
+	CIRC_NODE *c1, *c2, *f1, *f2;
+	SPHEROID s;
+	POINT2D pt, pt_outside;
+	double d1, d2;
+	size_t size1, size2;
+	void *buf1, *buf2;
+	int on_boundary;
+
+	spheroid_init(&s, 1.0, 1.0);
+
+	lwg1 = lwgeom_from_wkt("MULTIPOINT(-10 40,-10 65,10 40,10 65,30 40,30 65,50 40,50 65)", LW_PARSER_CHECK_NONE);
+	lwg2 = lwgeom_from_wkt("MULTIPOLYGON(((-1 -1,0 -1,1 -1,1 0,1 1,0 0,-1 1,-1 0,-1 -1)),((20 20,30 20,30 30,20 30,20 20)))", LW_PARSER_CHECK_NONE);
+	c1 = lwgeom_calculate_circ_tree(lwg1);
+	c2 = lwgeom_calculate_circ_tree(lwg2);
+	buf1 = circ_tree_flatten(c1, &size1);
+	buf2 = circ_tree_flatten(c2, &size2);
+	f1 = circ_tree_unflatten(buf1, size1);
+	f2 = circ_tree_unflatten(buf2, size2);
+	CU_ASSERT(f1 != NULL);
+	CU_ASSERT(f2 != NULL);
+
+	/* Same answers from the rebuilt trees */
+	d1 = circ_tree_distance_tree(c1, c2, &s, 0.0);
+	d2 = circ_tree_distance_tree(f1, f2, &s, 0.0);
+	CU_ASSERT_DOUBLE_EQUAL(d1, d2, 0.0000001);
+	CU_ASSERT_EQUAL(f2->geom_type, c2->geom_type);
+	CU_ASSERT_EQUAL(f2->num_nodes, c2->num_nodes);
+
+	pt.x = 0.8;
+	pt.y = 0.0;
+	pt_outside.x = -2.0;
+	pt_outside.y = 0.0;
+	CU_ASSERT_EQUAL(circ_tree_contains_point(f2, &pt, &pt_outside, &on_boundary), 1);
+	pt.x = 2.0;
+	CU_ASSERT_EQUAL(circ_tree_contains_point(f2, &pt, &pt_outside, &on_boundary), 0);
+
+	/* Not a flattened tree */
+	CU_ASSERT(circ_tree_unflatten(buf1, size1 - 1) == NULL);
+
+	circ_tree_free(f1);
+	circ_tree_free(f2);
+	lwfree(buf1);
+	lwfree(buf2);
+	circ_tree_free(c1);
+	circ_tree_free(c2);
+	lwgeom_free(lwg1);
+	lwgeom_free(lwg2);
+}
+
+
 /*
 ** Used by test harness to register the tests in this file.
 */
@@ -338,6 +391,7 @@ CU_TestInfo tree_tests[] =
 	PG_TEST(test_tree_circ_pip),
 	PG_TEST(test_tree_circ_pip2),
 	PG_TEST(test_tree_circ_distance),
+	PG_TEST(test_tree_circ_flatten),
 	CU_TEST_INFO_NULL
 };
 CU_SuiteInfo tree_suite = {"Internal Spatial Trees",  NULL,  NULL, tree_tests};
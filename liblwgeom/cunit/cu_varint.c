@@ -179,6 +179,54 @@ static void test_varint(void)
 
 }
 
+static void do_test_u64_varint_decode(char *hex, uint64_t expected, size_t expected_size)
+{
+	uint8_t *buf = bytes_from_hexbytes(hex, strlen(hex));
+	size_t size;
+	uint64_t nr = varint_u64_decode(buf, buf + strlen(hex) / 2, &size);
+	CU_ASSERT_EQUAL(nr, expected);
+	CU_ASSERT_EQUAL(size, expected_size);
+	CU_ASSERT_EQUAL(varint_size(buf, buf + strlen(hex) / 2), expected_size);
+	lwfree(buf);
+}
+
+static void do_test_s64_varint_decode(char *hex, int64_t expected, size_t expected_size)
+{
+	uint8_t *buf = bytes_from_hexbytes(hex, strlen(hex));
+	size_t size;
+	int64_t nr = varint_s64_decode(buf, buf + strlen(hex) / 2, &size);
+	CU_ASSERT_EQUAL(nr, expected);
+	CU_ASSERT_EQUAL(size, expected_size);
+	lwfree(buf);
+}
+
+static void test_varint_decode(void)
+{
+	uint8_t buf[2] = { 0xAC, 0x02 };
+	size_t size;
+
+	do_test_u64_varint_decode("01", 1, 1);
+	do_test_u64_varint_decode("AC02", 300, 2);
+	do_test_u64_varint_decode("808001", 0x4000, 3);
+	do_test_u64_varint_decode("FFFFFFFF07", 2147483647, 5);
+	/* Trailing bytes are left alone */
+	do_test_u64_varint_decode("9601FF", 150, 2);
+
+	do_test_s64_varint_decode("02", 1, 1);
+	do_test_s64_varint_decode("01", -1, 1);
+	do_test_s64_varint_decode("03", -2, 1);
+	do_test_s64_varint_decode("FEFFFFFF0F", 2147483647, 5);
+	do_test_s64_varint_decode("FFFFFFFF0F", -2147483648LL, 5);
+
+	/* Truncated varint */
+	cu_error_msg_reset();
+	varint_u64_decode(buf, buf + 1, &size);
+	CU_ASSERT_STRING_EQUAL(cu_error_msg, "varint_u64_decode: varint extends past end of buffer");
+	CU_ASSERT_EQUAL(size, 0);
+	CU_ASSERT_EQUAL(varint_size(buf, buf + 1), 0);
+	cu_error_msg_reset();
+}
+
 
 /*
 ** Used by the test harness to register the tests in this file.
@@ -186,6 +234,7 @@ static void test_varint(void)
 CU_TestInfo varint_tests[] =
 {
 	PG_TEST(test_varint),
+	PG_TEST(test_varint_decode),
 	CU_TEST_INFO_NULL
 };
 CU_SuiteInfo varint_suite = {"varint", NULL, NULL, varint_tests };
@@ -473,8 +473,7 @@ static int lw_arc_calculate_gbox_cartesian(const POINT4D *p1, const POINT4D *p2,
 
 int ptarray_calculate_gbox_cartesian(const POINTARRAY *pa, GBOX *gbox )
 {
-	int i;
-	POINT4D p;
+	double min[4], max[4];
 	int has_z, has_m;
 
 	if ( ! pa ) return LW_FAILURE;
@@ -486,31 +485,23 @@ int ptarray_calculate_gbox_cartesian(const POINTARRAY *pa, GBOX *gbox )
 	gbox->flags = gflags(has_z, has_m, 0);
 	LWDEBUGF(4, "ptarray_calculate_gbox Z: %d M: %d", has_z, has_m);
 
-	getPoint4d_p(pa, 0, &p);
-	gbox->xmin = gbox->xmax = p.x;
-	gbox->ymin = gbox->ymax = p.y;
+	lw_ordinates_minmax((const double*)pa->serialized_pointlist, pa->npoints,
+	                    FLAGS_NDIMS(pa->flags), min, max);
+
+	gbox->xmin = min[0];
+	gbox->xmax = max[0];
+	gbox->ymin = min[1];
+	gbox->ymax = max[1];
 	if ( has_z )
-		gbox->zmin = gbox->zmax = p.z;
+	{
+		gbox->zmin = min[2];
+		gbox->zmax = max[2];
+	}
+	/* In XYM the measure is the third ordinate */
 	if ( has_m )
-		gbox->mmin = gbox->mmax = p.m;
-
-	for ( i = 1 ; i < pa->npoints; i++ )
 	{
-		getPoint4d_p(pa, i, &p);
-		gbox->xmin = FP_MIN(gbox->xmin, p.x);
-		gbox->xmax = FP_MAX(gbox->xmax, p.x);
-		gbox->ymin = FP_MIN(gbox->ymin, p.y);
-		gbox->ymax = FP_MAX(gbox->ymax, p.y);
-		if ( has_z )
-		{
-			gbox->zmin = FP_MIN(gbox->zmin, p.z);
-			gbox->zmax = FP_MAX(gbox->zmax, p.z);
-		}
-		if ( has_m )
-		{
-			gbox->mmin = FP_MIN(gbox->mmin, p.m);
-			gbox->mmax = FP_MAX(gbox->mmax, p.m);
-		}
+		gbox->mmin = min[has_z ? 3 : 2];
+		gbox->mmax = max[has_z ? 3 : 2];
 	}
 	return LW_SUCCESS;
 }
@@ -247,6 +247,261 @@ int gserialized_read_gbox_p(const GSERIALIZED *g, GBOX *gbox)
 }
 
 
+/***********************************************************************
+* Walk the point arrays of a GSERIALIZED in place.
+*/
+
+void gserialized_iterator_init(GSERIALIZED_ITERATOR *it, const GSERIALIZED *g)
+{
+	assert(it && g);
+
+	it->ptr = g->data;
+	if ( FLAGS_GET_BBOX(g->flags) )
+		it->ptr += gbox_serialized_size(g->flags); /* Skip the box */
+	it->ring_npoints = NULL;
+	it->nrings = 0;
+	it->flags = g->flags;
+	it->done = LW_FALSE;
+	it->depth = 0;
+	it->type = 0;
+	it->ring = 0;
+}
+
+static void gserialized_iterator_read_pointarray(GSERIALIZED_ITERATOR *it, uint32_t npoints, POINTARRAY *pa)
+{
+	/* Same flags as ptarray_construct_reference_data */
+	pa->flags = gflags(FLAGS_GET_Z(it->flags), FLAGS_GET_M(it->flags), 0);
+	FLAGS_SET_READONLY(pa->flags, 1);
+	pa->npoints = pa->maxpoints = npoints;
+	pa->serialized_pointlist = (uint8_t*)(it->ptr);
+	it->ptr += FLAGS_NDIMS(it->flags) * npoints * sizeof(double);
+}
+
+int gserialized_iterator_next(GSERIALIZED_ITERATOR *it, POINTARRAY *pa)
+{
+	uint32_t type, count;
+
+	while ( LW_TRUE )
+	{
+		/* Hand out the remaining rings of the current polygon first */
+		if ( it->nrings > 0 )
+		{
+			count = lw_get_uint32_t(it->ring_npoints);
+			it->ring_npoints += 4;
+			it->nrings--;
+			it->ring++;
+			gserialized_iterator_read_pointarray(it, count, pa);
+			return LW_TRUE;
+		}
+
+		/* Close the collections that have no sub-geometries left */
+		while ( it->depth > 0 && it->ngeoms[it->depth-1] == 0 )
+			it->depth--;
+
+		/* Move to the next geometry */
+		if ( it->depth > 0 )
+			it->ngeoms[it->depth-1]--;
+		else if ( it->done )
+			return LW_FALSE;
+		else
+			it->done = LW_TRUE;
+
+		type = lw_get_uint32_t(it->ptr);
+		count = lw_get_uint32_t(it->ptr + 4); /* npoints, nrings or ngeoms */
+		it->ptr += 8; /* Skip past the type and count. */
+
+		switch (type)
+		{
+		case POINTTYPE:
+		case LINETYPE:
+		case CIRCSTRINGTYPE:
+		case TRIANGLETYPE:
+			it->type = type;
+			it->ring = 0;
+			gserialized_iterator_read_pointarray(it, count, pa);
+			return LW_TRUE;
+		case POLYGONTYPE:
+			it->type = type;
+			it->ring = -1;
+			it->nrings = count;
+			it->ring_npoints = it->ptr;
+			it->ptr += count * 4; /* Move past all the npoints values. */
+			if ( count % 2 ) /* If there is padding, move past that too. */
+				it->ptr += 4;
+			break;
+		case MULTIPOINTTYPE:
+		case MULTILINETYPE:
+		case MULTIPOLYGONTYPE:
+		case COMPOUNDTYPE:
+		case CURVEPOLYTYPE:
+		case MULTICURVETYPE:
+		case MULTISURFACETYPE:
+		case POLYHEDRALSURFACETYPE:
+		case TINTYPE:
+		case COLLECTIONTYPE:
+			if ( it->depth == GSERIALIZED_ITERATOR_MAXDEPTH )
+			{
+				lwerror("gserialized_iterator_next: collections nested more than %d levels deep", GSERIALIZED_ITERATOR_MAXDEPTH);
+				return LW_FALSE;
+			}
+			it->types[it->depth] = type;
+			it->ngeoms[it->depth] = count;
+			it->depth++;
+			break;
+		default:
+			lwerror("gserialized_iterator_next: unknown geometry type: %d - %s", type, lwtype_name(type));
+			return LW_FALSE;
+		}
+	}
+}
+
+/* Is the current point array part of a collection of the given type? */
+static int gserialized_iterator_within(const GSERIALIZED_ITERATOR *it, uint32_t type)
+{
+	int i;
+	for ( i = 0; i < it->depth; i++ )
+	{
+		if ( it->types[i] == type )
+			return LW_TRUE;
+	}
+	return LW_FALSE;
+}
+
+int gserialized_count_vertices(const GSERIALIZED *g)
+{
+	GSERIALIZED_ITERATOR it;
+	POINTARRAY pa;
+	int result = 0;
+
+	gserialized_iterator_init(&it, g);
+	while ( gserialized_iterator_next(&it, &pa) )
+		result += pa.npoints;
+
+	return result;
+}
+
+double gserialized_length_2d(const GSERIALIZED *g)
+{
+	GSERIALIZED_ITERATOR it;
+	POINTARRAY pa;
+	double length = 0.0;
+
+	gserialized_iterator_init(&it, g);
+	while ( gserialized_iterator_next(&it, &pa) )
+	{
+		/* Compound curves are measured on their linearization, leave them to lwgeom_length_2d */
+		if ( gserialized_iterator_within(&it, COMPOUNDTYPE) )
+		{
+			LWGEOM *lwgeom = lwgeom_from_gserialized(g);
+			length = lwgeom_length_2d(lwgeom);
+			lwgeom_free(lwgeom);
+			return length;
+		}
+
+		/* Rings of curve polygons are lines and count, polygon rings do not */
+		if ( it.type == LINETYPE )
+			length += ptarray_length_2d(&pa);
+		else if ( it.type == CIRCSTRINGTYPE && pa.npoints > 0 )
+			length += ptarray_arc_length_2d(&pa);
+	}
+
+	return length;
+}
+
+double gserialized_area(const GSERIALIZED *g)
+{
+	GSERIALIZED_ITERATOR it;
+	POINTARRAY pa;
+	LWTRIANGLE triangle;
+	double area = 0.0;
+	double ringarea;
+
+	gserialized_iterator_init(&it, g);
+	while ( gserialized_iterator_next(&it, &pa) )
+	{
+		/* Curve polygons need linearizing, leave them to lwgeom_area */
+		if ( gserialized_iterator_within(&it, CURVEPOLYTYPE) )
+		{
+			LWGEOM *lwgeom = lwgeom_from_gserialized(g);
+			area = lwgeom_area(lwgeom);
+			lwgeom_free(lwgeom);
+			return area;
+		}
+
+		if ( it.type == POLYGONTYPE )
+		{
+			/* Empty or messed-up ring. */
+			if ( pa.npoints < 3 )
+				continue;
+
+			/* Same as lwpoly_area: outer ring adds, inner rings subtract */
+			ringarea = fabs(ptarray_signed_area(&pa));
+			if ( it.ring == 0 )
+				area += ringarea;
+			else
+				area -= ringarea;
+		}
+		else if ( it.type == TRIANGLETYPE )
+		{
+			triangle.type = TRIANGLETYPE;
+			triangle.flags = pa.flags;
+			triangle.bbox = NULL;
+			triangle.srid = SRID_UNKNOWN;
+			triangle.points = &pa;
+			area += lwtriangle_area(&triangle);
+		}
+	}
+
+	return area;
+}
+
+int gserialized_calculate_gbox_cartesian_p(const GSERIALIZED *g, GBOX *gbox)
+{
+	GSERIALIZED_ITERATOR it;
+	POINTARRAY pa;
+	LWCIRCSTRING curve;
+	GBOX subbox;
+	int result = LW_FAILURE;
+	int rv;
+
+	gbox->flags = g->flags;
+	subbox.flags = g->flags;
+
+	gserialized_iterator_init(&it, g);
+	while ( gserialized_iterator_next(&it, &pa) )
+	{
+		/* Just need to check the outer ring of polygons */
+		if ( it.type == POLYGONTYPE && it.ring > 0 )
+			continue;
+
+		if ( it.type == CIRCSTRINGTYPE )
+		{
+			curve.type = CIRCSTRINGTYPE;
+			curve.flags = pa.flags;
+			curve.bbox = NULL;
+			curve.srid = SRID_UNKNOWN;
+			curve.points = &pa;
+			rv = lwgeom_calculate_gbox_cartesian((LWGEOM*)&curve, &subbox);
+		}
+		else
+		{
+			rv = ptarray_calculate_gbox_cartesian(&pa, &subbox);
+		}
+
+		if ( rv == LW_FAILURE )
+			continue;
+
+		if ( result == LW_FAILURE )
+			gbox_duplicate(&subbox, gbox);
+		else
+			gbox_merge(&subbox, gbox);
+		result = LW_SUCCESS;
+	}
+
+	return result;
+}
+
+
 /**
 * Read the bounding box off a serialization and calculate one if
 * it is not already there.
@@ -257,6 +512,13 @@ int gserialized_get_gbox_p(const GSERIALIZED *geom, GBOX *box)
 	int ret = gserialized_read_gbox_p(geom, box);
 	if ( LW_FAILURE == ret ) {
 		/* See http://trac.osgeo.org/postgis/ticket/1023 */
+		if ( ! FLAGS_GET_GEODETIC(geom->flags) )
+		{
+			/* Cartesian boxes can be read straight off the coordinates */
+			ret = gserialized_calculate_gbox_cartesian_p(geom, box);
+			gbox_float_round(box);
+			return ret;
+		}
 		lwgeom = lwgeom_from_gserialized(geom);
 		ret = lwgeom_calculate_gbox(lwgeom, box);
 		gbox_float_round(box);
@@ -318,6 +318,20 @@ int ptarray_has_z(const POINTARRAY *pa);
 int ptarray_has_m(const POINTARRAY *pa);
 double ptarray_signed_area(const POINTARRAY *pa);
 
+/*
+* Ordinate array kernels, scalar or SIMD depending on the CPU.
+* The arrays hold npoints points of ndims doubles each.
+*/
+#define LW_SIMD_NONE 0
+#define LW_SIMD_SSE2 1
+#define LW_SIMD_AVX2 2
+int lw_simd_level(void);
+/** Force a kernel level (capped to what the CPU has), returns the old one. */
+int lw_simd_set_level(int level);
+void lw_ordinates_minmax(const double *ords, int npoints, int ndims, double *min, double *max);
+double lw_ordinates_length_2d(const double *ords, int npoints, int ndims);
+double lw_ordinates_signed_area(const double *ords, int npoints, int ndims);
+
 /*
 * Clone support
 */
@@ -384,6 +398,7 @@ int pt_in_ring_2d(const POINT2D *p, const POINTARRAY *ring);
 int ptarray_contains_point(const POINTARRAY *pa, const POINT2D *pt);
 int ptarrayarc_contains_point(const POINTARRAY *pa, const POINT2D *pt);
 int ptarray_contains_point_partial(const POINTARRAY *pa, const POINT2D *pt, int check_closed, int *winding_number);
+int ptarray_contains_points(const POINTARRAY *pa, const POINT2D *pts, int npoints, int *results);
 int ptarrayarc_contains_point_partial(const POINTARRAY *pa, const POINT2D *pt, int check_closed, int *winding_number);
 int lwcompound_contains_point(const LWCOMPOUND *comp, const POINT2D *pt);
 int lwgeom_contains_point(const LWGEOM *geom, const POINT2D *pt);
@@ -13,6 +13,7 @@
 #include "liblwgeom_internal.h"
 #include "lwgeom_log.h"
 #include <ctype.h> /* for tolower */
+#include <float.h> /* for FLT_MAX */
 
 
 /**
@@ -690,6 +691,60 @@ unsigned int geohash_point_as_int(POINT2D *pt)
 	return ch;
 }
 
+/*
+** Position of a cell along the Hilbert curve through the 2^32 by 2^32
+** grid, walking the quadrants from the top bit down and rotating the
+** remaining coordinates into the frame of the quadrant taken.
+*/
+uint64_t hilbert_xy_as_int(uint32_t x, uint32_t y)
+{
+	uint64_t d = 0;
+	uint32_t s, rx, ry, t;
+
+	for ( s = 0x80000000u; s > 0; s >>= 1 )
+	{
+		rx = (x & s) > 0;
+		ry = (y & s) > 0;
+		d += (uint64_t)s * s * ((3 * rx) ^ ry);
+
+		if ( ry == 0 )
+		{
+			if ( rx == 1 )
+			{
+				x = ~x;
+				y = ~y;
+			}
+			t = x;
+			x = y;
+			y = t;
+		}
+	}
+	return d;
+}
+
+/*
+** Bits of a float, flipped so that they sort as unsigned integers
+** in the order of the floats: negatives reversed below positives.
+*/
+static uint32_t hilbert_float_coord(double v)
+{
+	union { float f; uint32_t u; } bits;
+
+	if ( v > FLT_MAX )
+		v = FLT_MAX;
+	else if ( v < -FLT_MAX )
+		v = -FLT_MAX;
+	else if ( ! (v == v) )
+		v = 0.0; /* NaN */
+	bits.f = (float)v;
+	return (bits.u & 0x80000000u) ? ~bits.u : bits.u | 0x80000000u;
+}
+
+uint64_t hilbert_float_point_as_int(const POINT2D *pt)
+{
+	return hilbert_xy_as_int(hilbert_float_coord(pt->x), hilbert_float_coord(pt->y));
+}
+
 /*
 ** Decode a GeoHash into a bounding box. The lat and lon arguments should
 ** both be passed as double arrays of length 2 at a minimum where the values
@@ -3,8 +3,18 @@
 #include "lwgeom_log.h"
 
 
+/*
+* While a tree is built bottom-up its nodes are linked by pointers,
+* then circ_tree_pack lays them out in one breadth-first array.
+*/
+typedef struct circ_build_node
+{
+	CIRC_NODE node;
+	struct circ_build_node** children;
+} CIRC_BUILD_NODE;
+
 /* Internal prototype */
-static CIRC_NODE* circ_nodes_merge(CIRC_NODE** nodes, int num_nodes);
+static CIRC_BUILD_NODE* circ_nodes_merge(CIRC_BUILD_NODE** nodes, int num_nodes);
 static double circ_tree_distance_tree_internal(const CIRC_NODE* n1, const CIRC_NODE* n2, double threshold, double* min_dist, double* max_dist, GEOGRAPHIC_POINT* closest1, GEOGRAPHIC_POINT* closest2);
 
 
@@ -18,32 +28,81 @@ circ_node_is_leaf(const CIRC_NODE* node)
 }
 
 /**
-* Recurse from top of node tree and free all children.
+* Child i of an internal node, the children are consecutive
+* in the tree array.
+*/
+static inline const CIRC_NODE*
+circ_node_child(const CIRC_NODE* node, int i)
+{
+	return node + node->first_child + i;
+}
+
+/**
+* Free the node array of a tree.
 * does not free underlying point array.
 */
 void 
 circ_tree_free(CIRC_NODE* node)
 {
-	int i;
 	if ( ! node ) return;
-	
-	for ( i = 0; i < node->num_nodes; i++ )
-		circ_tree_free(node->nodes[i]);
-
-	if ( node->nodes ) lwfree(node->nodes);
 	lwfree(node);
 }
 
+static int
+circ_build_count(const CIRC_BUILD_NODE* node)
+{
+	int i, count = 1;
+	for ( i = 0; i < node->node.num_nodes; i++ )
+		count += circ_build_count(node->children[i]);
+	return count;
+}
+
+/**
+* Copy a built tree into one array in breadth-first order, so
+* that siblings, which the traversals visit together, are
+* adjacent in memory, and free the working nodes.
+*/
+static CIRC_NODE*
+circ_tree_pack(CIRC_BUILD_NODE* root)
+{
+	CIRC_BUILD_NODE** queue;
+	CIRC_NODE* tree;
+	int num_nodes, i, j, next = 1;
+
+	if ( ! root ) return NULL;
+
+	num_nodes = circ_build_count(root);
+	tree = lwalloc(num_nodes * sizeof(CIRC_NODE));
+	queue = lwalloc(num_nodes * sizeof(CIRC_BUILD_NODE*));
+	queue[0] = root;
+	for ( i = 0; i < num_nodes; i++ )
+	{
+		tree[i] = queue[i]->node;
+		tree[i].first_child = tree[i].num_nodes ? next - i : 0;
+		for ( j = 0; j < tree[i].num_nodes; j++ )
+			queue[next++] = queue[i]->children[j];
+	}
+
+	for ( i = 0; i < num_nodes; i++ )
+	{
+		if ( queue[i]->children ) lwfree(queue[i]->children);
+		lwfree(queue[i]);
+	}
+	lwfree(queue);
+	return tree;
+}
+
 
 /**
 * Create a new leaf node, storing pointers back to the end points for later.
 */
-static CIRC_NODE* 
+static CIRC_BUILD_NODE* 
 circ_node_leaf_new(const POINTARRAY* pa, int i)
 {
 	POINT2D *p1, *p2;
 	POINT3D q1, q2, c;
 	GEOGRAPHIC_POINT g1, g2, gc;
+	CIRC_BUILD_NODE *leaf;
 	CIRC_NODE *node;
 	double diameter;
 
@@ -61,7 +120,9 @@ circ_node_leaf_new(const POINTARRAY* pa, int i)
 		return NULL;
 
 	/* Allocate */
-	node = lwalloc(sizeof(CIRC_NODE));
+	leaf = lwalloc(sizeof(CIRC_BUILD_NODE));
+	leaf->children = NULL;
+	node = &(leaf->node);
 	node->p1 = p1;
 	node->p2 = p2;
 	
@@ -78,7 +139,7 @@ circ_node_leaf_new(const POINTARRAY* pa, int i)
 
 	/* Leaf has no children */
 	node->num_nodes = 0;
-	node->nodes = NULL;
+	node->first_child = 0;
 	node->edge_num = i;
     
     /* Zero out metadata */
@@ -86,26 +147,28 @@ circ_node_leaf_new(const POINTARRAY* pa, int i)
     node->pt_outside.y = 0.0;
     node->geom_type = 0;
 	
-	return node;
+	return leaf;
 }
 
 /**
 * Return a point node (zero radius, referencing one point)
 */
-static CIRC_NODE* 
+static CIRC_BUILD_NODE* 
 circ_node_leaf_point_new(const POINTARRAY* pa)
 {
-	CIRC_NODE* tree = lwalloc(sizeof(CIRC_NODE));
+	CIRC_BUILD_NODE* leaf = lwalloc(sizeof(CIRC_BUILD_NODE));
+	CIRC_NODE* tree = &(leaf->node);
+	leaf->children = NULL;
 	tree->p1 = tree->p2 = (POINT2D*)getPoint_internal(pa, 0);
 	geographic_point_init(tree->p1->x, tree->p1->y, &(tree->center));
 	tree->radius = 0.0;
-	tree->nodes = NULL;
+	tree->first_child = 0;
 	tree->num_nodes = 0;
 	tree->edge_num = 0;
     tree->geom_type = POINTTYPE;
     tree->pt_outside.x = 0.0;
     tree->pt_outside.y = 0.0;
-	return tree;
+	return leaf;
 }
 
 /**
@@ -117,8 +180,8 @@ circ_node_compare(const void* v1, const void* v2)
 {
 	POINT2D p1, p2;
 	unsigned int u1, u2;
-	CIRC_NODE *c1 = *((CIRC_NODE**)v1);
-	CIRC_NODE *c2 = *((CIRC_NODE**)v2);
+	const CIRC_NODE *c1 = &((*((CIRC_BUILD_NODE**)v1))->node);
+	const CIRC_NODE *c2 = &((*((CIRC_BUILD_NODE**)v2))->node);
 	p1.x = rad2deg((c1->center).lon);
 	p1.y = rad2deg((c1->center).lat);
 	p2.x = rad2deg((c2->center).lon);
@@ -200,10 +263,11 @@ circ_center_cartesian(const GEOGRAPHIC_POINT* c1, const GEOGRAPHIC_POINT* c2, do
 * Create a new internal node, calculating the new measure range for the node,
 * and storing pointers to the child nodes.
 */
-static CIRC_NODE* 
-circ_node_internal_new(CIRC_NODE** c, int num_nodes)
+static CIRC_BUILD_NODE* 
+circ_node_internal_new(CIRC_BUILD_NODE** c, int num_nodes)
 {
-	CIRC_NODE *node = NULL;
+	CIRC_BUILD_NODE *parent = NULL;
+	CIRC_NODE *node;
 	GEOGRAPHIC_POINT new_center, c1;
 	double new_radius;
 	double offset1, dist, D, r1, ri;
@@ -213,12 +277,12 @@ circ_node_internal_new(CIRC_NODE** c, int num_nodes)
 
 	/* Can't do anything w/ empty input */
 	if ( num_nodes < 1 )
-		return node;
+		return parent;
 	
 	/* Initialize calculation with values of the first circle */
-	new_center = c[0]->center;
-	new_radius = c[0]->radius;
-	new_geom_type = c[0]->geom_type;
+	new_center = c[0]->node.center;
+	new_radius = c[0]->node.radius;
+	new_geom_type = c[0]->node.geom_type;
 	
 	/* Merge each remaining circle into the new circle */
 	for ( i = 1; i < num_nodes; i++ )
@@ -226,20 +290,20 @@ circ_node_internal_new(CIRC_NODE** c, int num_nodes)
 		c1 = new_center; 
 		r1 = new_radius;
 		
-		dist = sphere_distance(&c1, &(c[i]->center));
-		ri = c[i]->radius;
+		dist = sphere_distance(&c1, &(c[i]->node.center));
+		ri = c[i]->node.radius;
 
 		/* Promote geometry types up the tree, getting more and more collected */
 		/* Go until we find a value */
 		if ( ! new_geom_type )
 		{
-			new_geom_type = c[i]->geom_type;
+			new_geom_type = c[i]->node.geom_type;
 		}
 		/* Promote singleton to a multi-type */
 		else if ( ! lwtype_is_collection(new_geom_type) )
 		{
 			/* Anonymous collection if types differ */
-			if ( new_geom_type != c[i]->geom_type )
+			if ( new_geom_type != c[i]->node.geom_type )
 			{
 				new_geom_type = COLLECTIONTYPE;
 			}
@@ -249,13 +313,13 @@ circ_node_internal_new(CIRC_NODE** c, int num_nodes)
 			}
 		}
 		/* If we can't add next feature to this collection cleanly, promote again to anonymous collection */
-		else if ( new_geom_type != lwtype_get_collectiontype(c[i]->geom_type) )
+		else if ( new_geom_type != lwtype_get_collectiontype(c[i]->node.geom_type) )
 		{
 			new_geom_type = COLLECTIONTYPE;
 		}
 
 
-		LWDEBUGF(3, "distance between new (%g %g) and %i (%g %g) is %g", c1.lon, c1.lat, i, c[i]->center.lon, c[i]->center.lat, dist);
+		LWDEBUGF(3, "distance between new (%g %g) and %i (%g %g) is %g", c1.lon, c1.lat, i, c[i]->node.center.lon, c[i]->node.center.lat, dist);
 		
 		if ( FP_EQUALS(dist, 0) )
 		{
@@ -276,7 +340,7 @@ circ_node_internal_new(CIRC_NODE** c, int num_nodes)
 			else
 			{
 				LWDEBUG(3, "  ci contains c1");
-				new_center = c[i]->center;
+				new_center = c[i]->node.center;
 				new_radius = ri;
 			}
 		}
@@ -298,40 +362,42 @@ circ_node_internal_new(CIRC_NODE** c, int num_nodes)
 			/* to fail too. In that case, we're going to fall back ot a cartesian calculation, which */
 			/* is less exact, so we also have to pad the radius by (hack alert) an arbitrary amount */
 			/* which is hopefully always big enough to contain the input edges */
-			if ( circ_center_spherical(&c1, &(c[i]->center), dist, offset1, &new_center) == LW_FAILURE )
+			if ( circ_center_spherical(&c1, &(c[i]->node.center), dist, offset1, &new_center) == LW_FAILURE )
 			{
-				circ_center_cartesian(&c1, &(c[i]->center), dist, offset1, &new_center);
+				circ_center_cartesian(&c1, &(c[i]->node.center), dist, offset1, &new_center);
 				new_radius *= 1.1;
 			}
 		}
 		LWDEBUGF(3, " new center is (%g %g) new radius is %g", new_center.lon, new_center.lat, new_radius);	
 	}
 	
-	node = lwalloc(sizeof(CIRC_NODE));
+	parent = lwalloc(sizeof(CIRC_BUILD_NODE));
+	parent->children = c;
+	node = &(parent->node);
 	node->p1 = NULL;
 	node->p2 = NULL;
 	node->center = new_center;
 	node->radius = new_radius;
 	node->num_nodes = num_nodes;
-	node->nodes = c;
+	node->first_child = 0;
 	node->edge_num = -1;
     node->geom_type = new_geom_type;
     node->pt_outside.x = 0.0;
     node->pt_outside.y = 0.0;
-	return node;
+	return parent;
 }
 
 /**
 * Build a tree of nodes from a point array, one node per edge.
 */
-CIRC_NODE* 
-circ_tree_new(const POINTARRAY* pa)
+static CIRC_BUILD_NODE* 
+circ_build_tree(const POINTARRAY* pa)
 {
 	int num_edges;
 	int i, j;
-	CIRC_NODE **nodes;
-	CIRC_NODE *node;
-	CIRC_NODE *tree;
+	CIRC_BUILD_NODE **nodes;
+	CIRC_BUILD_NODE *node;
+	CIRC_BUILD_NODE *tree;
 
 	/* Can't do anything with no points */
 	if ( pa->npoints < 1 )
@@ -343,7 +409,7 @@ circ_tree_new(const POINTARRAY* pa)
 		
 	/* First create a flat list of nodes, one per edge. */
 	num_edges = pa->npoints - 1;
-	nodes = lwalloc(sizeof(CIRC_NODE*) * pa->npoints);
+	nodes = lwalloc(sizeof(CIRC_BUILD_NODE*) * pa->npoints);
 	j = 0;
 	for ( i = 0; i < num_edges; i++ )
 	{
@@ -367,22 +433,28 @@ circ_tree_new(const POINTARRAY* pa)
 	return tree;
 }
 
+CIRC_NODE* 
+circ_tree_new(const POINTARRAY* pa)
+{
+	return circ_tree_pack(circ_build_tree(pa));
+}
+
 /**
 * Given a list of nodes, sort them into a spatially consistent
 * order, then pairwise merge them up into a tree. Should make
 * handling multipoints and other collections more efficient
 */
 static void
-circ_nodes_sort(CIRC_NODE** nodes, int num_nodes)
+circ_nodes_sort(CIRC_BUILD_NODE** nodes, int num_nodes)
 {
-	qsort(nodes, num_nodes, sizeof(CIRC_NODE*), circ_node_compare);
+	qsort(nodes, num_nodes, sizeof(CIRC_BUILD_NODE*), circ_node_compare);
 }
 
 
-static CIRC_NODE*
-circ_nodes_merge(CIRC_NODE** nodes, int num_nodes)
+static CIRC_BUILD_NODE*
+circ_nodes_merge(CIRC_BUILD_NODE** nodes, int num_nodes)
 {
-	CIRC_NODE **inodes = NULL;
+	CIRC_BUILD_NODE **inodes = NULL;
 	int num_children = num_nodes;
 	int inode_num = 0;
 	int num_parents = 0;
@@ -397,7 +469,7 @@ circ_nodes_merge(CIRC_NODE** nodes, int num_nodes)
 		{
 			inode_num = (j % CIRC_NODE_SIZE);
 			if ( inode_num == 0 )
-				inodes = lwalloc(sizeof(CIRC_NODE*)*CIRC_NODE_SIZE);
+				inodes = lwalloc(sizeof(CIRC_BUILD_NODE*)*CIRC_NODE_SIZE);
 
 			inodes[inode_num] = nodes[j];
 			
@@ -440,7 +512,7 @@ int circ_tree_get_point(const CIRC_NODE* node, POINT2D* pt)
     }
     else
     {
-        return circ_tree_get_point(node->nodes[0], pt);
+        return circ_tree_get_point(circ_node_child(node, 0), pt);
     }
 }
 
@@ -517,7 +589,7 @@ int circ_tree_contains_point(const CIRC_NODE* node, const POINT2D* pt, const POI
 			{
 				LWDEBUG(3,"internal node calculation");
 				LWDEBUGF(3," calling circ_tree_contains_point on child %d!", i);
-				c += circ_tree_contains_point(node->nodes[i], pt, pt_outside, on_boundary);
+				c += circ_tree_contains_point(circ_node_child(node, i), pt, pt_outside, on_boundary);
 			}
 			return c % 2;
 		}
@@ -715,7 +787,7 @@ circ_tree_distance_tree_internal(const CIRC_NODE* n1, const CIRC_NODE* n2, doubl
 		{
 			for ( i = 0; i < n1->num_nodes; i++ )
 			{
-				d = circ_tree_distance_tree_internal(n1->nodes[i], n2, threshold, min_dist, max_dist, closest1, closest2);
+				d = circ_tree_distance_tree_internal(circ_node_child(n1, i), n2, threshold, min_dist, max_dist, closest1, closest2);
 				d_min = FP_MIN(d_min, d);
 			}
 		}
@@ -723,7 +795,7 @@ circ_tree_distance_tree_internal(const CIRC_NODE* n1, const CIRC_NODE* n2, doubl
 		{
 			for ( i = 0; i < n2->num_nodes; i++ )
 			{
-				d = circ_tree_distance_tree_internal(n1, n2->nodes[i], threshold, min_dist, max_dist, closest1, closest2);
+				d = circ_tree_distance_tree_internal(n1, circ_node_child(n2, i), threshold, min_dist, max_dist, closest1, closest2);
 				d_min = FP_MIN(d_min, d);
 			}
 		}
@@ -731,7 +803,7 @@ circ_tree_distance_tree_internal(const CIRC_NODE* n1, const CIRC_NODE* n2, doubl
 		{
 			for ( i = 0; i < n1->num_nodes; i++ )
 			{
-				d = circ_tree_distance_tree_internal(n1->nodes[i], n2, threshold, min_dist, max_dist, closest1, closest2);
+				d = circ_tree_distance_tree_internal(circ_node_child(n1, i), n2, threshold, min_dist, max_dist, closest1, closest2);
 				d_min = FP_MIN(d_min, d);
 			}
 		}
@@ -739,7 +811,7 @@ circ_tree_distance_tree_internal(const CIRC_NODE* n1, const CIRC_NODE* n2, doubl
 		{
 			for ( i = 0; i < n2->num_nodes; i++ )
 			{
-				d = circ_tree_distance_tree_internal(n1, n2->nodes[i], threshold, min_dist, max_dist, closest1, closest2);
+				d = circ_tree_distance_tree_internal(n1, circ_node_child(n2, i), threshold, min_dist, max_dist, closest1, closest2);
 				d_min = FP_MIN(d_min, d);
 			}
 		}
@@ -799,49 +871,177 @@ void circ_tree_print(const CIRC_NODE* node, int depth)
 	}
 	for ( i = 0; i < node->num_nodes; i++ )
 	{
-		circ_tree_print(node->nodes[i], depth + 1);
+		circ_tree_print(circ_node_child(node, i), depth + 1);
 	}
 	return;
 }
 
 
-static CIRC_NODE*
-lwpoint_calculate_circ_tree(const LWPOINT* lwpoint)
+/*
+* Layout of a flattened tree: a header, then one record per node
+* in the breadth-first order of the tree array, so the children
+* of a node are the num_nodes records starting first_child 
+* records after it.
+*/
+#define CIRC_TREE_FLAT_MAGIC 0x43495243 /* "CIRC" */
+
+typedef struct
 {
-	CIRC_NODE* node;
-    node = circ_tree_new(lwpoint->point);
-    node->geom_type = lwgeom_get_type((LWGEOM*)lwpoint);;
+	uint32_t magic;
+	uint32_t num_nodes;
+} CIRC_TREE_FLAT;
+
+typedef struct
+{
+	GEOGRAPHIC_POINT center;
+	double radius;
+	POINT2D pt_outside;
+	POINT2D pts[2];      /* Edge end points of leaves */
+	int32_t num_nodes;
+	int32_t first_child;
+	int32_t edge_num;
+	int32_t geom_type;
+	int32_t is_point;    /* Leaf of a point, p1 == p2 */
+	int32_t padding;
+} CIRC_NODE_FLAT;
+
+static uint32_t
+circ_tree_count(const CIRC_NODE* node)
+{
+	uint32_t count = 1;
+	int i;
+	for ( i = 0; i < node->num_nodes; i++ )
+		count += circ_tree_count(circ_node_child(node, i));
+	return count;
+}
+
+void* 
+circ_tree_flatten(const CIRC_NODE* node, size_t* size)
+{
+	uint32_t num_nodes = circ_tree_count(node);
+	uint32_t i;
+	CIRC_TREE_FLAT* flat;
+	CIRC_NODE_FLAT* records;
+
+	*size = sizeof(CIRC_TREE_FLAT) + num_nodes * sizeof(CIRC_NODE_FLAT);
+	flat = lwalloc(*size);
+	memset(flat, 0, *size);
+	flat->magic = CIRC_TREE_FLAT_MAGIC;
+	flat->num_nodes = num_nodes;
+	records = (CIRC_NODE_FLAT*)(flat + 1);
+
+	/* The tree array is already in breadth-first order */
+	for ( i = 0; i < num_nodes; i++ )
+	{
+		const CIRC_NODE* n = &(node[i]);
+		CIRC_NODE_FLAT* r = &(records[i]);
+
+		r->center = n->center;
+		r->radius = n->radius;
+		r->pt_outside = n->pt_outside;
+		r->num_nodes = n->num_nodes;
+		r->first_child = n->first_child;
+		r->edge_num = n->edge_num;
+		r->geom_type = n->geom_type;
+		if ( circ_node_is_leaf(n) )
+		{
+			r->pts[0] = *(n->p1);
+			r->pts[1] = *(n->p2);
+			r->is_point = (n->p1 == n->p2);
+		}
+	}
+
+	return flat;
+}
+
+CIRC_NODE* 
+circ_tree_unflatten(const void* buf, size_t size)
+{
+	const CIRC_TREE_FLAT* flat = buf;
+	const CIRC_NODE_FLAT* records;
+	CIRC_NODE* tree;
+	uint32_t i;
+
+	if ( size < sizeof(CIRC_TREE_FLAT) || flat->magic != CIRC_TREE_FLAT_MAGIC || 
+	     flat->num_nodes == 0 || size != sizeof(CIRC_TREE_FLAT) + flat->num_nodes * sizeof(CIRC_NODE_FLAT) )
+		return NULL;
+	records = (const CIRC_NODE_FLAT*)(flat + 1);
+
+	/* Children always come after their parent, so a bad buffer can't make a loop */
+	for ( i = 0; i < flat->num_nodes; i++ )
+	{
+		const CIRC_NODE_FLAT* r = &(records[i]);
+		if ( r->num_nodes < 0 || r->num_nodes > CIRC_NODE_SIZE ||
+		     ( r->num_nodes > 0 && ( r->first_child <= 0 ||
+		       (int64_t)i + r->first_child + r->num_nodes > (int64_t)flat->num_nodes ) ) )
+			return NULL;
+	}
+
+	tree = lwalloc(flat->num_nodes * sizeof(CIRC_NODE));
+	for ( i = 0; i < flat->num_nodes; i++ )
+	{
+		const CIRC_NODE_FLAT* r = &(records[i]);
+		CIRC_NODE* n = &(tree[i]);
+
+		n->center = r->center;
+		n->radius = r->radius;
+		n->pt_outside = r->pt_outside;
+		n->num_nodes = r->num_nodes;
+		n->first_child = r->first_child;
+		n->edge_num = r->edge_num;
+		n->geom_type = r->geom_type;
+		n->p1 = n->p2 = NULL;
+		if ( ! r->num_nodes )
+		{
+			/* Point leaves are recognized by p1 == p2 */
+			n->p1 = (POINT2D*)&(r->pts[0]);
+			n->p2 = r->is_point ? n->p1 : (POINT2D*)&(r->pts[1]);
+		}
+	}
+
+	return tree;
+}
+
+
+static CIRC_BUILD_NODE* lwgeom_build_circ_tree(const LWGEOM* lwgeom);
+
+static CIRC_BUILD_NODE*
+lwpoint_build_circ_tree(const LWPOINT* lwpoint)
+{
+	CIRC_BUILD_NODE* node;
+    node = circ_build_tree(lwpoint->point);
+    node->node.geom_type = lwgeom_get_type((LWGEOM*)lwpoint);;
 	return node;
 }
 
-static CIRC_NODE*
-lwline_calculate_circ_tree(const LWLINE* lwline)
+static CIRC_BUILD_NODE*
+lwline_build_circ_tree(const LWLINE* lwline)
 {
-	CIRC_NODE* node;
-    node = circ_tree_new(lwline->points);
-    node->geom_type = lwgeom_get_type((LWGEOM*)lwline);
+	CIRC_BUILD_NODE* node;
+    node = circ_build_tree(lwline->points);
+    node->node.geom_type = lwgeom_get_type((LWGEOM*)lwline);
 	return node;
 }
 
-static CIRC_NODE*
-lwpoly_calculate_circ_tree(const LWPOLY* lwpoly)
+static CIRC_BUILD_NODE*
+lwpoly_build_circ_tree(const LWPOLY* lwpoly)
 {
 	int i = 0, j = 0;
-	CIRC_NODE** nodes;
-	CIRC_NODE* node;
+	CIRC_BUILD_NODE** nodes;
+	CIRC_BUILD_NODE* node;
 
 	/* One ring? Handle it like a line. */
 	if ( lwpoly->nrings == 1 )
 	{
-		node = circ_tree_new(lwpoly->rings[0]);			
+		node = circ_build_tree(lwpoly->rings[0]);			
 	}
 	else
 	{
 		/* Calculate a tree for each non-trivial ring of the polygon */
-		nodes = lwalloc(lwpoly->nrings * sizeof(CIRC_NODE*));
+		nodes = lwalloc(lwpoly->nrings * sizeof(CIRC_BUILD_NODE*));
 		for ( i = 0; i < lwpoly->nrings; i++ )
 		{
-			node = circ_tree_new(lwpoly->rings[i]);
+			node = circ_build_tree(lwpoly->rings[i]);
 			if ( node )
 				nodes[j++] = node;
 		}
@@ -855,28 +1055,28 @@ lwpoly_calculate_circ_tree(const LWPOLY* lwpoly)
 
 	/* Metatdata about polygons, we need this to apply P-i-P tests */
 	/* selectively when doing distance calculations */
-    node->geom_type = lwgeom_get_type((LWGEOM*)lwpoly);
-	lwpoly_pt_outside(lwpoly, &(node->pt_outside));
+    node->node.geom_type = lwgeom_get_type((LWGEOM*)lwpoly);
+	lwpoly_pt_outside(lwpoly, &(node->node.pt_outside));
 	
 	return node;
 }
 
-static CIRC_NODE*
-lwcollection_calculate_circ_tree(const LWCOLLECTION* lwcol)
+static CIRC_BUILD_NODE*
+lwcollection_build_circ_tree(const LWCOLLECTION* lwcol)
 {
 	int i = 0, j = 0;
-	CIRC_NODE** nodes;
-	CIRC_NODE* node;
+	CIRC_BUILD_NODE** nodes;
+	CIRC_BUILD_NODE* node;
 
 	/* One geometry? Done! */
 	if ( lwcol->ngeoms == 1 )
-		return lwgeom_calculate_circ_tree(lwcol->geoms[0]);	
+		return lwgeom_build_circ_tree(lwcol->geoms[0]);	
 	
 	/* Calculate a tree for each sub-geometry*/
-	nodes = lwalloc(lwcol->ngeoms * sizeof(CIRC_NODE*));
+	nodes = lwalloc(lwcol->ngeoms * sizeof(CIRC_BUILD_NODE*));
 	for ( i = 0; i < lwcol->ngeoms; i++ )
 	{
-		node = lwgeom_calculate_circ_tree(lwcol->geoms[i]);
+		node = lwgeom_build_circ_tree(lwcol->geoms[i]);
 		if ( node )
 			nodes[j++] = node;
 	}
@@ -887,13 +1087,13 @@ lwcollection_calculate_circ_tree(const LWCOLLECTION* lwcol)
 	/* Don't need the working list any more */
 	lwfree(nodes);
 	
-    node->geom_type = lwgeom_get_type((LWGEOM*)lwcol);
+    node->node.geom_type = lwgeom_get_type((LWGEOM*)lwcol);
     
 	return node;
 }
 
-CIRC_NODE*
-lwgeom_calculate_circ_tree(const LWGEOM* lwgeom)
+static CIRC_BUILD_NODE*
+lwgeom_build_circ_tree(const LWGEOM* lwgeom)
 {
 	if ( lwgeom_is_empty(lwgeom) )
 		return NULL;
@@ -901,19 +1101,25 @@ lwgeom_calculate_circ_tree(const LWGEOM* lwgeom)
 	switch ( lwgeom->type )
 	{
 		case POINTTYPE:
-			return lwpoint_calculate_circ_tree((LWPOINT*)lwgeom);
+			return lwpoint_build_circ_tree((LWPOINT*)lwgeom);
 		case LINETYPE:
-			return lwline_calculate_circ_tree((LWLINE*)lwgeom);
+			return lwline_build_circ_tree((LWLINE*)lwgeom);
 		case POLYGONTYPE:
-			return lwpoly_calculate_circ_tree((LWPOLY*)lwgeom);
+			return lwpoly_build_circ_tree((LWPOLY*)lwgeom);
 		case MULTIPOINTTYPE:
 		case MULTILINETYPE:
 		case MULTIPOLYGONTYPE:
 		case COLLECTIONTYPE:
-			return lwcollection_calculate_circ_tree((LWCOLLECTION*)lwgeom);
+			return lwcollection_build_circ_tree((LWCOLLECTION*)lwgeom);
 		default:
 			lwerror("Unable to calculate spherical index tree for type %s", lwtype_name(lwgeom->type));
 			return NULL;
 	}
 	
 }
+
+CIRC_NODE*
+lwgeom_calculate_circ_tree(const LWGEOM* lwgeom)
+{
+	return circ_tree_pack(lwgeom_build_circ_tree(lwgeom));
+}
@@ -7,14 +7,17 @@
 #define CIRC_NODE_SIZE 8
 
 /**
-* Note that p1 and p2 are pointers into an independent POINTARRAY, do not free them.
+* A tree is a single array of nodes in breadth-first order, the
+* children of a node are the num_nodes nodes starting first_child
+* nodes after it. Note that p1 and p2 are pointers into an independent 
+* POINTARRAY, do not free them.
 */
 typedef struct circ_node
 {
 	GEOGRAPHIC_POINT center;
 	double radius;
 	int num_nodes;
-	struct circ_node** nodes;
+	int first_child;
 	int edge_num;
     int geom_type;
     POINT2D pt_outside;
@@ -30,6 +33,21 @@ double circ_tree_distance_tree(const CIRC_NODE* n1, const CIRC_NODE* n2, const S
 CIRC_NODE* lwgeom_calculate_circ_tree(const LWGEOM* lwgeom);
 int circ_tree_get_point(const CIRC_NODE* node, POINT2D* pt);
 
+/**
+* Copy a tree into a single position-independent buffer, with the
+* edge end points inline, so it can be stored and shared. The size of the buffer is returned
+* in size.
+*/
+void* circ_tree_flatten(const CIRC_NODE* node, size_t* size);
+
+/**
+* Rebuild a tree from a circ_tree_flatten buffer. The node array
+* is allocated (free it with circ_tree_free) but the edge end 
+* points are read from the buffer, which has to outlive the tree.
+* Returns NULL if the buffer is not a flattened tree.
+*/
+CIRC_NODE* circ_tree_unflatten(const void* buf, size_t size);
+
 #endif /* _LWGEODETIC_TREE_H */
 
 
@@ -14,6 +14,7 @@
 #include "liblwgeom.h"
 #include "lwgeom_log.h"
 #include <string.h>
+#include <math.h>
 
 
 /** convert decimal degress to radians */
@@ -32,22 +33,97 @@ to_dec(POINT4D *pt)
 	pt->y *= 180.0/M_PI;
 }
 
+/**
+ * Transform given POINTARRAY one point at a time. Slow, but
+ * reports the exact point that failed to project.
+ */
+static int
+ptarray_transform_pointwise(POINTARRAY *pa, projPJ inpj, projPJ outpj)
+{
+	int i;
+	POINT4D p;
+
+	for ( i = 0; i < pa->npoints; i++ )
+	{
+		getPoint4d_p(pa, i, &p);
+		if ( ! point4d_transform(&p, inpj, outpj) ) return LW_FAILURE;
+		ptarray_set_point4d(pa, i, &p);
+	}
+
+	return LW_SUCCESS;
+}
+
 /**
  * Transform given POINTARRAY
  * from inpj projection to outpj projection
+ *
+ * The ordinates are handed to PROJ in place, in a single call, using
+ * the number of dimensions of the array as the stride between points,
+ * so the projection setup and datum shift preparation are paid once
+ * per array rather than once per vertex. If anything goes wrong the
+ * original coordinates are restored and the array is re-run point by
+ * point so the error names the offending point.
  */
 int
 ptarray_transform(POINTARRAY *pa, projPJ inpj, projPJ outpj)
 {
-  int i;
-	POINT4D p;
+	int i;
+	int* pj_errno_ref;
+	int stride = FLAGS_NDIMS(pa->flags);
+	size_t size = ptarray_point_size(pa) * pa->npoints;
+	double *d = (double*)(pa->serialized_pointlist);
+	double *orig;
+	int failed;
+
+	/* Nothing to batch up */
+	if ( pa->npoints < 2 )
+		return ptarray_transform_pointwise(pa, inpj, outpj);
+
+	/* Keep the input around in case we have to report an error */
+	orig = lwalloc(size);
+	memcpy(orig, d, size);
 
-  for ( i = 0; i < pa->npoints; i++ )
-  {
-    getPoint4d_p(pa, i, &p);
-    if ( ! point4d_transform(&p, inpj, outpj) ) return LW_FAILURE;
-    ptarray_set_point4d(pa, i, &p);
-  }
+	if ( pj_is_latlong(inpj) )
+	{
+		for ( i = 0; i < pa->npoints; i++ )
+		{
+			d[i*stride] *= M_PI/180.0;
+			d[i*stride+1] *= M_PI/180.0;
+		}
+	}
+
+	LWDEBUGF(4, "transforming %d points from '%s' to '%s'", pa->npoints, pj_get_def(inpj,0), pj_get_def(outpj,0));
+
+	/* Perform the transform, leaving Z alone if we don't have one */
+	pj_errno_ref = pj_get_errno_ref();
+	*pj_errno_ref = 0;
+	failed = pj_transform(inpj, outpj, pa->npoints, stride, d, d+1, FLAGS_GET_Z(pa->flags) ? d+2 : NULL);
+	failed = failed || *pj_errno_ref;
+
+	/* With more than one point, PROJ flags individual failures with HUGE_VAL */
+	for ( i = 0; ! failed && i < pa->npoints; i++ )
+	{
+		if ( d[i*stride] == HUGE_VAL || d[i*stride+1] == HUGE_VAL )
+			failed = LW_TRUE;
+	}
+
+	if ( failed )
+	{
+		memcpy(d, orig, size);
+		lwfree(orig);
+		*pj_errno_ref = 0;
+		return ptarray_transform_pointwise(pa, inpj, outpj);
+	}
+	lwfree(orig);
+
+	if ( pj_is_latlong(outpj) )
+	{
+		for ( i = 0; i < pa->npoints; i++ )
+		{
+			d[i*stride] *= 180.0/M_PI;
+			d[i*stride+1] *= 180.0/M_PI;
+		}
+	}
 
 	return LW_SUCCESS;
 }
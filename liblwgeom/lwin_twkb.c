@@ -0,0 +1,660 @@
+/**********************************************************************
+ *
+ * PostGIS - Spatial Types for PostgreSQL
+ * http://postgis.net
+ *
+ * Copyright (C) 2014 Nicklas Avén
+ *
+ * This is free software; you can redistribute and/or modify it under
+ * the terms of the GNU General Public Licence. See the COPYING file.
+ *
+ **********************************************************************
+ *
+ * Read the TWKB produced by lwout_twkb.c back into an LWGEOM.
+ *
+ * Coordinates are stored as zig-zag varints holding the difference
+ * from the previous coordinate (across the whole document, not per
+ * ring), scaled by 10^precision. We keep the accumulated integer
+ * coordinate in the parse state and decode straight into the
+ * serialized point list of a preallocated POINTARRAY.
+ *
+ * Things TWKB does not carry and which therefore don't round-trip:
+ * the SRID, geometry ids, the Z/M flavour of three dimensional
+ * coordinates (we read them as Z), and the difference between
+ * POINT EMPTY and MULTIPOINT EMPTY.
+ *
+ **********************************************************************/
+
+#include <math.h>
+
+#include "liblwgeom_internal.h"
+#include "lwgeom_log.h"
+#include "varint.h"
+
+/**
+* First byte of a TWKB document: id, sizes and bboxes flags
+* in the low bits, precision in the high nibble.
+*/
+#define TWKB_FLAG_HAS_ID(flag) ((flag) & 0x01)
+#define TWKB_FLAG_HAS_SIZES(flag) ((flag) & 0x02)
+#define TWKB_FLAG_PRECISION(flag) (((flag) & 0xF0) >> 4)
+
+/**
+* Type byte: type number in the low 5 bits, number of
+* dimensions in the high 3 bits.
+*/
+#define TWKB_TYPE_GET_TYPE(type) ((type) & 0x1F)
+#define TWKB_TYPE_GET_DIMS(type) (((type) & 0xE0) >> 5)
+
+/**
+* Type numbers used by ST_AsTWKBAgg for arrays of identified
+* geometries of a single kind.
+*/
+#define TWKB_AGG_POINT_TYPE 21
+#define TWKB_AGG_LINESTRING_TYPE 22
+#define TWKB_AGG_POLYGON_TYPE 23
+#define TWKB_AGG_COLLECTION_TYPE 24
+
+/**
+* Used for passing the parse state between the parsing functions.
+*/
+typedef struct
+{
+	const uint8_t *twkb; /* Points to start of TWKB */
+	const uint8_t *twkb_end; /* Points just past the end of TWKB */
+	int check; /* Simple validity checks on geometries */
+	uint32_t lwtype; /* Current type we are handling */
+	int has_z; /* Z? */
+	int has_m; /* M? */
+	int ndims; /* Number of coordinates per point */
+	double factor; /* Integer coordinates are scaled by this */
+	int64_t coords[4]; /* Accumulated integer coordinates of the last point read */
+	const uint8_t *pos; /* Current parse position */
+} twkb_parse_state;
+
+
+/**
+* Internal function declarations.
+*/
+static LWGEOM* lwgeom_from_twkb_state(twkb_parse_state *s, int has_id);
+
+
+/**********************************************************************/
+
+/**
+* Check that we are not about to read off the end of the TWKB
+* array.
+*/
+static inline void twkb_parse_state_check(twkb_parse_state *s, size_t next)
+{
+	if( (s->pos + next) > s->twkb_end )
+		lwerror("TWKB structure does not match expected size!");
+}
+
+/**
+* Check that a count read from the TWKB could possibly be backed by the
+* remaining bytes, given each item takes at least min_bytes. This keeps
+* a malformed count from making us allocate a huge array up front.
+*/
+static inline void twkb_parse_state_check_count(twkb_parse_state *s, uint64_t count, size_t min_bytes)
+{
+	if( count > (uint64_t)(s->twkb_end - s->pos) / min_bytes )
+		lwerror("TWKB structure does not match expected size!");
+}
+
+static uint8_t byte_from_twkb_state(twkb_parse_state *s)
+{
+	uint8_t val;
+	twkb_parse_state_check(s, WKB_BYTE_SIZE);
+	val = *(s->pos);
+	s->pos += WKB_BYTE_SIZE;
+	return val;
+}
+
+static uint64_t twkb_parse_state_uvarint(twkb_parse_state *s)
+{
+	size_t size;
+	uint64_t val = varint_u64_decode(s->pos, s->twkb_end, &size);
+	s->pos += size;
+	return val;
+}
+
+static void twkb_parse_state_varint_skip(twkb_parse_state *s)
+{
+	size_t size = varint_size(s->pos, s->twkb_end);
+	if( size == 0 )
+		lwerror("%s: varint extends past end of buffer", __func__);
+	s->pos += size;
+}
+
+/**
+* Is this a type byte we know how to read? Type 7 is also written with
+* four dimensions by ST_AsTWKBAgg, so dimensions 2 to 4 are all valid.
+*/
+static int twkb_is_type_byte(uint8_t type_byte)
+{
+	int type = TWKB_TYPE_GET_TYPE(type_byte);
+	int dims = TWKB_TYPE_GET_DIMS(type_byte);
+
+	if ( dims < 2 || dims > 4 )
+		return LW_FALSE;
+
+	return (type >= WKB_POINT_TYPE && type <= WKB_GEOMETRYCOLLECTION_TYPE) ||
+	       (type >= TWKB_AGG_POINT_TYPE && type <= TWKB_AGG_COLLECTION_TYPE);
+}
+
+/**
+* Turn a TWKB type number into an lwtype. Aggregates come back as
+* the multi-type they are read into.
+*/
+static uint32_t lwtype_from_twkb_type(uint8_t twkb_type)
+{
+	switch ( twkb_type )
+	{
+		case WKB_POINT_TYPE:
+			return POINTTYPE;
+		case WKB_LINESTRING_TYPE:
+			return LINETYPE;
+		case WKB_POLYGON_TYPE:
+			return POLYGONTYPE;
+		case WKB_MULTIPOINT_TYPE:
+		case TWKB_AGG_POINT_TYPE:
+			return MULTIPOINTTYPE;
+		case WKB_MULTILINESTRING_TYPE:
+		case TWKB_AGG_LINESTRING_TYPE:
+			return MULTILINETYPE;
+		case WKB_MULTIPOLYGON_TYPE:
+		case TWKB_AGG_POLYGON_TYPE:
+			return MULTIPOLYGONTYPE;
+		case WKB_GEOMETRYCOLLECTION_TYPE:
+		case TWKB_AGG_COLLECTION_TYPE:
+			return COLLECTIONTYPE;
+		default:
+			lwerror("Unknown TWKB type number %d", twkb_type);
+	}
+	return 0;
+}
+
+/**
+* Set the dimensionality of the geometry we're about to read.
+* TWKB only stores a count, so a third dimension is taken as Z.
+*/
+static void twkb_parse_state_set_dims(twkb_parse_state *s, int ndims)
+{
+	s->ndims = ndims;
+	s->has_z = (ndims > 2);
+	s->has_m = (ndims > 3);
+}
+
+/**
+* POINTARRAY
+* Read npoints points of delta encoded coordinates directly into a
+* freshly allocated point array.
+*/
+static POINTARRAY* ptarray_from_twkb_state(twkb_parse_state *s, uint32_t npoints)
+{
+	POINTARRAY *pa = NULL;
+	double *dlist;
+	int ndims = s->ndims;
+	int i, j;
+	size_t size;
+
+	LWDEBUGF(4,"Pointarray has %d points", npoints);
+
+	/* Empty! */
+	if( npoints == 0 )
+		return ptarray_construct(s->has_z, s->has_m, npoints);
+
+	/* Every coordinate takes at least one byte */
+	twkb_parse_state_check_count(s, npoints, ndims);
+
+	pa = ptarray_construct(s->has_z, s->has_m, npoints);
+	dlist = (double*)(pa->serialized_pointlist);
+	for( i = 0; i < npoints; i++ )
+	{
+		for( j = 0; j < ndims; j++ )
+		{
+			s->coords[j] += varint_s64_decode(s->pos, s->twkb_end, &size);
+			s->pos += size;
+			*dlist++ = s->coords[j] / s->factor;
+		}
+	}
+
+	return pa;
+}
+
+/**
+* POINT
+* Just the coordinates, there is no point count.
+*/
+static LWPOINT* lwpoint_from_twkb_state(twkb_parse_state *s)
+{
+	POINTARRAY *pa = ptarray_from_twkb_state(s, 1);
+	return lwpoint_construct(SRID_UNKNOWN, NULL, pa);
+}
+
+/**
+* LINESTRING
+* Point count followed by the coordinates. Optionally
+* check for minimal following of rules (two point minimum).
+*/
+static LWLINE* lwline_from_twkb_state(twkb_parse_state *s)
+{
+	uint64_t npoints = twkb_parse_state_uvarint(s);
+	POINTARRAY *pa;
+
+	if( npoints == 0 )
+		return lwline_construct_empty(SRID_UNKNOWN, s->has_z, s->has_m);
+
+	pa = ptarray_from_twkb_state(s, npoints);
+
+	if( s->check & LW_PARSER_CHECK_MINPOINTS && pa->npoints < 2 )
+	{
+		lwerror("%s must have at least two points", lwtype_name(s->lwtype));
+		return NULL;
+	}
+
+	return lwline_construct(SRID_UNKNOWN, NULL, pa);
+}
+
+/**
+* POLYGON
+* Ring count followed by each ring as a point count
+* and the coordinates.
+*/
+static LWPOLY* lwpoly_from_twkb_state(twkb_parse_state *s)
+{
+	uint64_t nrings = twkb_parse_state_uvarint(s);
+	LWPOLY *poly = lwpoly_construct_empty(SRID_UNKNOWN, s->has_z, s->has_m);
+	int i;
+
+	LWDEBUGF(4,"Polygon has %d rings", nrings);
+
+	/* Empty polygon? */
+	if( nrings == 0 )
+		return poly;
+
+	/* Every ring takes at least its point count */
+	twkb_parse_state_check_count(s, nrings, 1);
+
+	for( i = 0; i < nrings; i++ )
+	{
+		uint64_t npoints = twkb_parse_state_uvarint(s);
+		POINTARRAY *pa = ptarray_from_twkb_state(s, npoints);
+
+		/* Check for at least four points. */
+		if( s->check & LW_PARSER_CHECK_MINPOINTS && pa->npoints < 4 )
+		{
+			LWDEBUGF(2, "%s must have at least four points in each ring", lwtype_name(s->lwtype));
+			lwerror("%s must have at least four points in each ring", lwtype_name(s->lwtype));
+			return NULL;
+		}
+
+		/* Check that first and last points are the same. */
+		if( s->check & LW_PARSER_CHECK_CLOSURE && ! ptarray_is_closed_2d(pa) )
+		{
+			LWDEBUGF(2, "%s must have closed rings", lwtype_name(s->lwtype));
+			lwerror("%s must have closed rings", lwtype_name(s->lwtype));
+			return NULL;
+		}
+
+		/* Add ring to polygon */
+		if ( lwpoly_add_ring(poly, pa) == LW_FAILURE )
+		{
+			LWDEBUG(2, "Unable to add ring to polygon");
+			lwerror("Unable to add ring to polygon");
+		}
+	}
+	return poly;
+}
+
+/**
+* Read the body of a single point, line or polygon, without
+* type byte, as found in multi-geometries and aggregates.
+*/
+static LWGEOM* lwgeom_from_twkb_state_body(twkb_parse_state *s, uint32_t lwtype)
+{
+	switch( lwtype )
+	{
+		case POINTTYPE:
+			return (LWGEOM*)lwpoint_from_twkb_state(s);
+		case LINETYPE:
+			return (LWGEOM*)lwline_from_twkb_state(s);
+		case POLYGONTYPE:
+			return (LWGEOM*)lwpoly_from_twkb_state(s);
+		default:
+			lwerror("Unsupported geometry type: %s [%d]", lwtype_name(lwtype), lwtype);
+	}
+	return NULL;
+}
+
+/**
+* MULTIPOINTTYPE, MULTILINETYPE, MULTIPOLYGONTYPE
+* Component count followed by the components, which share the
+* dimensionality of the parent and have no type byte. In the
+* aggregate flavour every component is preceded by its id.
+*/
+static LWCOLLECTION* lwmulti_from_twkb_state(twkb_parse_state *s, uint32_t lwtype, int has_ids)
+{
+	uint64_t ngeoms = twkb_parse_state_uvarint(s);
+	uint32_t subtype;
+	LWGEOM **geoms;
+	int i;
+
+	LWDEBUGF(4,"Multi-geometry has %d components", ngeoms);
+
+	if ( ngeoms == 0 )
+		return lwcollection_construct_empty(lwtype, SRID_UNKNOWN, s->has_z, s->has_m);
+
+	switch( lwtype )
+	{
+		case MULTIPOINTTYPE:
+			subtype = POINTTYPE;
+			break;
+		case MULTILINETYPE:
+			subtype = LINETYPE;
+			break;
+		case MULTIPOLYGONTYPE:
+			subtype = POLYGONTYPE;
+			break;
+		default:
+			lwerror("Unsupported geometry type: %s [%d]", lwtype_name(lwtype), lwtype);
+			return NULL;
+	}
+
+	/* Every component takes at least one byte */
+	twkb_parse_state_check_count(s, ngeoms, 1);
+
+	/* Fill the component array directly, components can't repeat */
+	geoms = lwalloc(sizeof(LWGEOM*) * ngeoms);
+	for ( i = 0; i < ngeoms; i++ )
+	{
+		if ( has_ids )
+			twkb_parse_state_varint_skip(s);
+		geoms[i] = lwgeom_from_twkb_state_body(s, subtype);
+	}
+
+	return lwcollection_construct(lwtype, SRID_UNKNOWN, NULL, ngeoms, geoms);
+}
+
+/**
+* COLLECTION
+* Component count followed by complete geometries, each
+* with its own type byte. Components never carry ids.
+*/
+static LWCOLLECTION* lwcollection_from_twkb_state(twkb_parse_state *s)
+{
+	uint64_t ngeoms = twkb_parse_state_uvarint(s);
+	LWCOLLECTION *col = lwcollection_construct_empty(COLLECTIONTYPE, SRID_UNKNOWN, s->has_z, s->has_m);
+	LWGEOM *geom = NULL;
+	int i;
+
+	LWDEBUGF(4,"Collection has %d components", ngeoms);
+
+	/* Empty collection? */
+	if ( ngeoms == 0 )
+		return col;
+
+	/* Every component takes at least its type byte */
+	twkb_parse_state_check_count(s, ngeoms, 1);
+
+	for ( i = 0; i < ngeoms; i++ )
+	{
+		geom = lwgeom_from_twkb_state(s, LW_FALSE);
+		if ( lwcollection_add_lwgeom(col, geom) == NULL )
+		{
+			lwerror("Unable to add geometry (%p) to collection (%p)", geom, col);
+			return NULL;
+		}
+	}
+
+	return col;
+}
+
+/**
+* Aggregated COLLECTION
+* Component count followed by id, component count and
+* components of each collection.
+*/
+static LWCOLLECTION* lwcollection_agg_from_twkb_state(twkb_parse_state *s, int has_ids)
+{
+	uint64_t ngeoms = twkb_parse_state_uvarint(s);
+	LWCOLLECTION *col = lwcollection_construct_empty(COLLECTIONTYPE, SRID_UNKNOWN, s->has_z, s->has_m);
+	LWGEOM *geom = NULL;
+	int i;
+
+	twkb_parse_state_check_count(s, ngeoms, 1);
+
+	for ( i = 0; i < ngeoms; i++ )
+	{
+		if ( has_ids )
+			twkb_parse_state_varint_skip(s);
+		geom = (LWGEOM*)lwcollection_from_twkb_state(s);
+		if ( lwcollection_add_lwgeom(col, geom) == NULL )
+		{
+			lwerror("Unable to add geometry (%p) to collection (%p)", geom, col);
+			return NULL;
+		}
+	}
+
+	return col;
+}
+
+/**
+* EMPTY
+* Empties are written as a flag byte, an id, the type byte and
+* a zero count, where other geometries start with their type byte.
+*/
+static LWGEOM* lwgeom_empty_from_twkb_state(twkb_parse_state *s)
+{
+	uint8_t type_byte;
+
+	/* Flag byte and id, which is written whether or not ids are in use */
+	byte_from_twkb_state(s);
+	twkb_parse_state_varint_skip(s);
+
+	type_byte = byte_from_twkb_state(s);
+	if ( ! twkb_is_type_byte(type_byte) )
+		lwerror("Invalid TWKB type byte 0x%02X", type_byte);
+
+	twkb_parse_state_set_dims(s, TWKB_TYPE_GET_DIMS(type_byte));
+	s->lwtype = lwtype_from_twkb_type(TWKB_TYPE_GET_TYPE(type_byte));
+
+	if ( twkb_parse_state_uvarint(s) != 0 )
+		lwerror("Invalid TWKB empty geometry");
+
+	return lwgeom_construct_empty(s->lwtype, SRID_UNKNOWN, s->has_z, s->has_m);
+}
+
+/**
+* Does the input at the parse position hold an empty geometry
+* running to the end of the buffer? Only needed when a flag byte
+* with the id bit set can't be told from a POINT type byte.
+*/
+static int twkb_is_empty_to_end(twkb_parse_state *s)
+{
+	const uint8_t *ptr = s->pos + 1;
+	size_t size;
+
+	/* Id */
+	size = varint_size(ptr, s->twkb_end);
+	if ( ! size )
+		return LW_FALSE;
+	ptr += size;
+
+	/* Type byte, zero count, and nothing more */
+	return (s->twkb_end - ptr) == 2 && twkb_is_type_byte(ptr[0]) && ptr[1] == 0;
+}
+
+/**
+* Does the input at the parse position, just past a collection type byte,
+* hold a count followed by an aggregate type byte? That is how
+* ST_AsTWKBAgg writes aggregates of mixed types, with no id.
+*/
+static int twkb_is_agg_collection(twkb_parse_state *s)
+{
+	const uint8_t *ptr = s->pos;
+	size_t size = varint_size(ptr, s->twkb_end);
+
+	if ( ! size || ptr + size >= s->twkb_end )
+		return LW_FALSE;
+	ptr += size;
+
+	return twkb_is_type_byte(*ptr) && TWKB_TYPE_GET_TYPE(*ptr) >= TWKB_AGG_POINT_TYPE;
+}
+
+/**
+* Mixed aggregate COLLECTION
+* Component count followed by aggregates, each with its own type byte.
+*/
+static LWCOLLECTION* lwcollection_mixed_agg_from_twkb_state(twkb_parse_state *s, int has_ids)
+{
+	uint64_t ngeoms = twkb_parse_state_uvarint(s);
+	LWCOLLECTION *col = lwcollection_construct_empty(COLLECTIONTYPE, SRID_UNKNOWN, LW_FALSE, LW_FALSE);
+	LWGEOM *geom = NULL;
+	int i;
+
+	twkb_parse_state_check_count(s, ngeoms, 1);
+
+	for ( i = 0; i < ngeoms; i++ )
+	{
+		geom = lwgeom_from_twkb_state(s, has_ids);
+		if ( lwcollection_add_lwgeom(col, geom) == NULL )
+		{
+			lwerror("Unable to add geometry (%p) to collection (%p)", geom, col);
+			return NULL;
+		}
+	}
+
+	/* The type byte dimensions are a placeholder, take them from the components */
+	if ( geom )
+	{
+		FLAGS_SET_Z(col->flags, FLAGS_GET_Z(geom->flags));
+		FLAGS_SET_M(col->flags, FLAGS_GET_M(geom->flags));
+	}
+
+	return col;
+}
+
+/**
+* GEOMETRY
+* Generic handling for TWKB geometries. Every geometry, apart from the
+* components of multi-geometries, starts with a type byte and, when ids
+* are in use at this level, an id. We handle those here, then pass to
+* the appropriate handler for the specific type.
+*/
+static LWGEOM* lwgeom_from_twkb_state(twkb_parse_state *s, int has_id)
+{
+	uint8_t type_byte;
+	uint8_t twkb_type;
+
+	LWDEBUG(4,"Entered function");
+
+	twkb_parse_state_check(s, WKB_BYTE_SIZE);
+	type_byte = *(s->pos);
+
+	/*
+	* Empties start with a flag byte. Without an id bit its type
+	* number is zero, with one it can look like a POINT type byte
+	* for some precisions.
+	*/
+	if ( ! twkb_is_type_byte(type_byte) ||
+	     ( TWKB_FLAG_HAS_ID(type_byte) && TWKB_TYPE_GET_TYPE(type_byte) == WKB_POINT_TYPE && twkb_is_empty_to_end(s) ) )
+	{
+		if ( type_byte & 0x0E )
+			lwerror("Invalid TWKB type byte 0x%02X", type_byte);
+		return lwgeom_empty_from_twkb_state(s);
+	}
+	s->pos += WKB_BYTE_SIZE;
+
+	twkb_type = TWKB_TYPE_GET_TYPE(type_byte);
+	twkb_parse_state_set_dims(s, TWKB_TYPE_GET_DIMS(type_byte));
+	s->lwtype = lwtype_from_twkb_type(twkb_type);
+	LWDEBUGF(4,"Got TWKB type %d with %d dimensions", twkb_type, s->ndims);
+
+	/* Aggregates carry one id per component instead */
+	if ( twkb_type >= TWKB_AGG_POINT_TYPE )
+	{
+		if ( twkb_type == TWKB_AGG_COLLECTION_TYPE )
+			return (LWGEOM*)lwcollection_agg_from_twkb_state(s, has_id);
+		return (LWGEOM*)lwmulti_from_twkb_state(s, s->lwtype, has_id);
+	}
+
+	/* Mixed aggregates don't have an id of their own */
+	if ( twkb_type == WKB_GEOMETRYCOLLECTION_TYPE && twkb_is_agg_collection(s) )
+		return (LWGEOM*)lwcollection_mixed_agg_from_twkb_state(s, has_id);
+
+	/* Skip the geometry id, LWGEOM has nowhere to keep it */
+	if ( has_id )
+		twkb_parse_state_varint_skip(s);
+
+	switch( s->lwtype )
+	{
+		case POINTTYPE:
+		case LINETYPE:
+		case POLYGONTYPE:
+			return lwgeom_from_twkb_state_body(s, s->lwtype);
+		case MULTIPOINTTYPE:
+		case MULTILINETYPE:
+		case MULTIPOLYGONTYPE:
+			return (LWGEOM*)lwmulti_from_twkb_state(s, s->lwtype, LW_FALSE);
+		case COLLECTIONTYPE:
+			return (LWGEOM*)lwcollection_from_twkb_state(s);
+
+		/* Unknown type! */
+		default:
+			lwerror("Unsupported geometry type: %s [%d]", lwtype_name(s->lwtype), s->lwtype);
+	}
+
+	/* Return value to keep compiler happy. */
+	return NULL;
+}
+
+/**
+* TWKB inputs *must* have a declared size, to prevent malformed TWKB from
+* reading off the end of the memory segment.
+*
+* Check is a bitmask of: LW_PARSER_CHECK_MINPOINTS, LW_PARSER_CHECK_ODD,
+* LW_PARSER_CHECK_CLOSURE, LW_PARSER_CHECK_NONE, LW_PARSER_CHECK_ALL
+*/
+LWGEOM* lwgeom_from_twkb(const uint8_t *twkb, size_t twkb_size, char check)
+{
+	twkb_parse_state s;
+	uint8_t flag;
+	int precision;
+
+	LWDEBUGF(2, "Entered %s", __func__);
+
+	/* Initialize the state appropriately */
+	memset(&s, 0, sizeof(twkb_parse_state));
+	s.twkb = twkb;
+	s.twkb_end = twkb + twkb_size;
+	s.pos = twkb;
+
+	/* Hand the check catch-all values */
+	if ( check & LW_PARSER_CHECK_NONE )
+		s.check = 0;
+	else
+		s.check = check;
+
+	flag = byte_from_twkb_state(&s);
+
+	/* Precision is a signed 4 bit number */
+	precision = TWKB_FLAG_PRECISION(flag);
+	if ( precision > 7 )
+		precision -= 16;
+	s.factor = pow(10, precision);
+
+	/* The size counts the bytes following it */
+	if ( TWKB_FLAG_HAS_SIZES(flag) )
+	{
+		uint64_t size = twkb_parse_state_uvarint(&s);
+		if ( size > (uint64_t)(s.twkb_end - s.pos) )
+			lwerror("TWKB structure does not match expected size!");
+		s.twkb_end = s.pos + size;
+	}
+
+	/* The bboxes flag has no data behind it in the current format */
+
+	return lwgeom_from_twkb_state(&s, TWKB_FLAG_HAS_ID(flag));
+}
@@ -1,6 +1,9 @@
+#include <math.h>
+
 #include "liblwgeom_internal.h"
 #include "lwgeom_log.h"
 #include "lwtree.h"
+#include "measures.h"
 
 
 /**
@@ -11,22 +14,17 @@ static int rect_node_is_leaf(const RECT_NODE *node)
 	return (node->p1 != NULL);
 }
 
+static const RECT_NODE* rect_node_child(const RECT_NODE *node, int i)
+{
+	return node + node->first_child + i;
+}
+
 /**
-* Recurse from top of node tree and free all children.
-* does not free underlying point array.
+* The whole tree is one array, root first.
+* Does not free underlying point array.
 */
 void rect_tree_free(RECT_NODE *node)
 {
-	if ( node->left_node )
-	{
-		rect_tree_free(node->left_node);
-		node->left_node = 0;
-	}
-	if ( node->right_node )
-	{
-		rect_tree_free(node->right_node);
-		node->right_node = 0;
-	}
 	lwfree(node);
 }
 
@@ -44,8 +42,10 @@ int rect_tree_contains_point(const RECT_NODE *node, const POINT2D *pt, int *on_b
 		}
 		else
 		{
-			return rect_tree_contains_point(node->left_node, pt, on_boundary) +
-			       rect_tree_contains_point(node->right_node, pt, on_boundary);
+			int i, sum = 0;
+			for ( i = 0; i < node->num_nodes; i++ )
+				sum += rect_tree_contains_point(rect_node_child(node, i), pt, on_boundary);
+			return sum;
 		}
 	}
 	/* printf("NOT in measure range\n"); */
@@ -58,6 +58,8 @@ int rect_tree_intersects_tree(const RECT_NODE *n1, const RECT_NODE *n2)
 	/* There can only be an edge intersection if the rectangles overlap */
 	if ( ! ( FP_GT(n1->xmin, n2->xmax) || FP_GT(n2->xmin, n1->xmax) || FP_GT(n1->ymin, n2->ymax) || FP_GT(n2->ymin, n1->ymax) ) )
 	{
+		int i;
+
 		LWDEBUG(4," interaction found");
 		/* We can only test for a true intersection if the nodes are both leaf nodes */
 		if ( rect_node_is_leaf(n1) && rect_node_is_leaf(n2) )
@@ -75,18 +77,21 @@ int rect_tree_intersects_tree(const RECT_NODE *n1, const RECT_NODE *n2)
 			/* Recurse to children */
 			if ( rect_node_is_leaf(n1) )
 			{
-				if ( rect_tree_intersects_tree(n2->left_node, n1) || rect_tree_intersects_tree(n2->right_node, n1) )
-					return LW_TRUE;
-				else
-					return LW_FALSE;
+				for ( i = 0; i < n2->num_nodes; i++ )
+				{
+					if ( rect_tree_intersects_tree(rect_node_child(n2, i), n1) )
+						return LW_TRUE;
+				}
 			}
 			else
 			{
-				if ( rect_tree_intersects_tree(n1->left_node, n2) || rect_tree_intersects_tree(n1->right_node, n2) )
-					return LW_TRUE;
-				else
-					return LW_FALSE;
+				for ( i = 0; i < n1->num_nodes; i++ )
+				{
+					if ( rect_tree_intersects_tree(rect_node_child(n1, i), n2) )
+						return LW_TRUE;
+				}
 			}
+			return LW_FALSE;
 		}
 	}
 	else
@@ -98,127 +103,662 @@ int rect_tree_intersects_tree(const RECT_NODE *n1, const RECT_NODE *n2)
 
 
 /**
-* Create a new leaf node, calculating a measure value for each point on the
-* edge and storing pointers back to the end points for later.
+* Fill in a leaf node for edge i of the point array, storing pointers 
+* back to the end points for later. Zero length edges don't get a node,
+* and LW_FALSE is returned.
 */
-RECT_NODE* rect_node_leaf_new(const POINTARRAY *pa, int i)
+static int rect_node_leaf_init(RECT_NODE *node, const POINTARRAY *pa, int i)
 {
 	POINT2D *p1, *p2;
-	RECT_NODE *node;
 
 	p1 = (POINT2D*)getPoint_internal(pa, i);
 	p2 = (POINT2D*)getPoint_internal(pa, i+1);
 
 	/* Zero length edge, doesn't get a node */
 	if ( FP_EQUALS(p1->x, p2->x) && FP_EQUALS(p1->y, p2->y) )
-		return NULL;
+		return LW_FALSE;
 
-	node = lwalloc(sizeof(RECT_NODE));
 	node->p1 = p1;
 	node->p2 = p2;
 	node->xmin = FP_MIN(p1->x,p2->x);
 	node->xmax = FP_MAX(p1->x,p2->x);
 	node->ymin = FP_MIN(p1->y,p2->y);
 	node->ymax = FP_MAX(p1->y,p2->y);
-	node->left_node = NULL;
-	node->right_node = NULL;
-	return node;
+	node->num_nodes = 0;
+	node->first_child = 0;
+	return LW_TRUE;
+}
+
+/**
+* Fill in a leaf node for a single vertex, used for points and for
+* point arrays that collapse to one location. Both end point references
+* are set to the same vertex, so distance calculations degrade to
+* point/segment cases naturally.
+*/
+static void rect_node_point_init(RECT_NODE *node, const POINTARRAY *pa, int i)
+{
+	POINT2D *p = (POINT2D*)getPoint_internal(pa, i);
+	node->p1 = p;
+	node->p2 = p;
+	node->xmin = node->xmax = p->x;
+	node->ymin = node->ymax = p->y;
+	node->num_nodes = 0;
+	node->first_child = 0;
 }
 
 /**
-* Create a new internal node, calculating the new measure range for the node,
-* and storing pointers to the child nodes.
+* Fill in an internal node over num_nodes nodes of the level below,
+* starting at first. Until the levels are laid out in one array,
+* first_child holds the position of the first child in its level.
 */
-RECT_NODE* rect_node_internal_new(RECT_NODE *left_node, RECT_NODE *right_node)
+static void rect_node_internal_init(RECT_NODE *node, const RECT_NODE *level, int first, int num_nodes)
 {
-	RECT_NODE *node = lwalloc(sizeof(RECT_NODE));
+	int i;
+
 	node->p1 = NULL;
 	node->p2 = NULL;
-	node->xmin = FP_MIN(left_node->xmin, right_node->xmin);
-	node->xmax = FP_MAX(left_node->xmax, right_node->xmax);
-	node->ymin = FP_MIN(left_node->ymin, right_node->ymin);
-	node->ymax = FP_MAX(left_node->ymax, right_node->ymax);
-	node->left_node = left_node;
-	node->right_node = right_node;
-	return node;
+	node->num_nodes = num_nodes;
+	node->first_child = first;
+	node->xmin = level[first].xmin;
+	node->xmax = level[first].xmax;
+	node->ymin = level[first].ymin;
+	node->ymax = level[first].ymax;
+	for ( i = first + 1; i < first + num_nodes; i++ )
+	{
+		node->xmin = FP_MIN(node->xmin, level[i].xmin);
+		node->xmax = FP_MAX(node->xmax, level[i].xmax);
+		node->ymin = FP_MIN(node->ymin, level[i].ymin);
+		node->ymax = FP_MAX(node->ymax, level[i].ymax);
+	}
 }
 
 /**
-* Build a tree of nodes from a point array, one node per edge, and each
-* with an associated measure range along a one-dimensional space. We
-* can then search that space as a range tree.
+* Add a leaf per non-zero length edge of a point array, or a single
+* vertex leaf if it has no such edge, to the end of leaves.
 */
-RECT_NODE* rect_tree_new(const POINTARRAY *pa)
+static void rect_tree_add_leaves(const POINTARRAY *pa, RECT_NODE *leaves, int *num_leaves)
 {
-	int num_edges, num_children, num_parents;
+	int i, n = *num_leaves;
+
+	if ( pa->npoints < 1 )
+		return;
+
+	for ( i = 0; i < (int)pa->npoints - 1; i++ )
+	{
+		if ( rect_node_leaf_init(&(leaves[n]), pa, i) )
+			n++;
+	}
+
+	/* A lone vertex, or every edge was zero length, so the array is really just a point */
+	if ( n == *num_leaves )
+		rect_node_point_init(&(leaves[n++]), pa, 0);
+
+	*num_leaves = n;
+}
+
+/* Sort key of a node, the nodes themselves are too big to shuffle around */
+typedef struct
+{
+	double key;
+	int i;
+} RECT_NODE_KEY;
+
+static int rect_node_key_cmp(const void *a, const void *b)
+{
+	double k1 = ((const RECT_NODE_KEY*)a)->key;
+	double k2 = ((const RECT_NODE_KEY*)b)->key;
+	return (k1 < k2) ? -1 : ((k1 > k2) ? 1 : 0);
+}
+
+/**
+* Sort-Tile-Recursive order for one level: sort the nodes into 
+* horizontal slices by the Y of their centers, then each slice by X,
+* so that each run of RECT_NODE_SIZE nodes is a compact tile. Slices
+* hold a whole number of runs, so no parent straddles two of them.
+* Slicing across Y keeps the rays of the point in polygon test, which
+* run along X, inside one slice at every level.
+*/
+static void rect_nodes_sort_str(RECT_NODE *nodes, int num_nodes, int num_parents)
+{
+	int num_slices = (int)ceil(sqrt((double)num_parents));
+	int slice_size = ((num_parents + num_slices - 1) / num_slices) * RECT_NODE_SIZE;
+	RECT_NODE_KEY *keys = lwalloc(num_nodes * sizeof(RECT_NODE_KEY));
+	RECT_NODE *sorted;
 	int i, j;
-	RECT_NODE **nodes;
-	RECT_NODE *node;
+
+	for ( i = 0; i < num_nodes; i++ )
+	{
+		keys[i].key = nodes[i].ymin + nodes[i].ymax;
+		keys[i].i = i;
+	}
+	qsort(keys, num_nodes, sizeof(RECT_NODE_KEY), rect_node_key_cmp);
+
+	for ( i = 0; i < num_nodes; i += slice_size )
+	{
+		int n = FP_MIN(slice_size, num_nodes - i);
+		for ( j = i; j < i + n; j++ )
+			keys[j].key = nodes[keys[j].i].xmin + nodes[keys[j].i].xmax;
+		qsort(keys + i, n, sizeof(RECT_NODE_KEY), rect_node_key_cmp);
+	}
+
+	sorted = lwalloc(num_nodes * sizeof(RECT_NODE));
+	for ( i = 0; i < num_nodes; i++ )
+		sorted[i] = nodes[keys[i].i];
+	memcpy(nodes, sorted, num_nodes * sizeof(RECT_NODE));
+	lwfree(sorted);
+	lwfree(keys);
+}
+
+/**
+* Whether the runs of a level as it stands are already about as compact
+* as STR tiles would be: their boxes add up to no more than the square
+* tiles the level's box would be cut into. Edges along a line or ring
+* come in such an order, since consecutive edges are next to each other,
+* and sorting them is most of the cost of a build. Zig-zags, scattered
+* points and parts listed in no spatial order are what STR is for.
+*/
+static int rect_nodes_are_tiled(const RECT_NODE *nodes, int num_nodes, int num_parents)
+{
+	double xmin = nodes[0].xmin, xmax = nodes[0].xmax;
+	double ymin = nodes[0].ymin, ymax = nodes[0].ymax;
+	double tiles = 0.0;
+	int i, num_slices = (int)ceil(sqrt((double)num_parents));
+
+	for ( i = 0; i < num_nodes; i += RECT_NODE_SIZE )
+	{
+		RECT_NODE run;
+		rect_node_internal_init(&run, nodes, i, FP_MIN(RECT_NODE_SIZE, num_nodes - i));
+		tiles += (run.xmax - run.xmin) + (run.ymax - run.ymin);
+		xmin = FP_MIN(xmin, run.xmin);
+		xmax = FP_MAX(xmax, run.xmax);
+		ymin = FP_MIN(ymin, run.ymin);
+		ymax = FP_MAX(ymax, run.ymax);
+	}
+	return tiles <= num_slices * ((xmax - xmin) + (ymax - ymin));
+}
+
+/* Deep enough for RECT_NODE_SIZE^32 leaves */
+#define RECT_TREE_MAX_LEVELS 32
+
+/**
+* Bulk load a tree over a list of leaves, which is consumed. Each 
+* level is put in STR order, unless it is tiled well enough as it is,
+* and packed into parents of up to RECT_NODE_SIZE nodes, until one
+* node is left. The levels are then copied into one array, root first,
+* and the child positions made relative to their parents.
+*/
+static RECT_NODE* rect_tree_pack(RECT_NODE *leaves, int num_leaves)
+{
+	RECT_NODE *levels[RECT_TREE_MAX_LEVELS];
+	int counts[RECT_TREE_MAX_LEVELS];
+	int starts[RECT_TREE_MAX_LEVELS];
+	int num_levels = 1;
+	int i, j, l, total;
 	RECT_NODE *tree;
 
-	if ( pa->npoints < 2 )
+	levels[0] = leaves;
+	counts[0] = total = num_leaves;
+
+	while ( counts[num_levels-1] > 1 && num_levels < RECT_TREE_MAX_LEVELS )
+	{
+		RECT_NODE *nodes = levels[num_levels-1];
+		int num_nodes = counts[num_levels-1];
+		int num_parents = (num_nodes + RECT_NODE_SIZE - 1) / RECT_NODE_SIZE;
+		RECT_NODE *parents = lwalloc(num_parents * sizeof(RECT_NODE));
+
+		if ( num_parents > 1 && ! rect_nodes_are_tiled(nodes, num_nodes, num_parents) )
+			rect_nodes_sort_str(nodes, num_nodes, num_parents);
+
+		for ( j = 0; j < num_parents; j++ )
+		{
+			int first = j * RECT_NODE_SIZE;
+			rect_node_internal_init(&(parents[j]), nodes, first, FP_MIN(RECT_NODE_SIZE, num_nodes - first));
+		}
+
+		levels[num_levels] = parents;
+		counts[num_levels] = num_parents;
+		total += num_parents;
+		num_levels++;
+	}
+
+	/* Root level first */
+	tree = lwalloc(total * sizeof(RECT_NODE));
+	i = 0;
+	for ( l = num_levels - 1; l >= 0; l-- )
+	{
+		starts[l] = i;
+		memcpy(tree + i, levels[l], counts[l] * sizeof(RECT_NODE));
+		i += counts[l];
+		lwfree(levels[l]);
+	}
+
+	for ( l = 1; l < num_levels; l++ )
+	{
+		for ( j = 0; j < counts[l]; j++ )
+		{
+			RECT_NODE *node = &(tree[starts[l] + j]);
+			node->first_child = starts[l-1] + node->first_child - (starts[l] + j);
+		}
+	}
+
+	return tree;
+}
+
+/**
+* Build a tree of nodes from a point array, one leaf per edge.
+*/
+RECT_NODE* rect_tree_new(const POINTARRAY *pa)
+{
+	RECT_NODE *leaves;
+	int num_leaves = 0;
+
+	if ( pa->npoints < 1 )
 	{
 		return NULL;
 	}
 
-	/*
-	** First create a flat list of nodes, one per edge.
-	** For each vertex, transform into our one-dimensional measure.
-	** Hopefully, when projected, the points turn into a fairly
-	** uniformly distributed collection of measures.
-	*/
-	num_edges = pa->npoints - 1;
-	nodes = lwalloc(sizeof(RECT_NODE*) * pa->npoints);
-	j = 0;
-	for ( i = 0; i < num_edges; i++ )
+	leaves = lwalloc(pa->npoints * sizeof(RECT_NODE));
+	rect_tree_add_leaves(pa, leaves, &num_leaves);
+	return rect_tree_pack(leaves, num_leaves);
+}
+
+static void lwgeom_add_rect_leaves(const LWGEOM *lwgeom, RECT_NODE *leaves, int *num_leaves)
+{
+	int i;
+
+	switch ( lwgeom->type )
 	{
-		node = rect_node_leaf_new(pa, i);
-		if ( node ) /* Not zero length? */
+		case POINTTYPE:
+			rect_tree_add_leaves(((LWPOINT*)lwgeom)->point, leaves, num_leaves);
+			break;
+		case LINETYPE:
+			rect_tree_add_leaves(((LWLINE*)lwgeom)->points, leaves, num_leaves);
+			break;
+		case TRIANGLETYPE:
+			rect_tree_add_leaves(((LWTRIANGLE*)lwgeom)->points, leaves, num_leaves);
+			break;
+		case POLYGONTYPE:
 		{
-			nodes[j] = node;
-			j++;
+			const LWPOLY *lwpoly = (LWPOLY*)lwgeom;
+			for ( i = 0; i < lwpoly->nrings; i++ )
+				rect_tree_add_leaves(lwpoly->rings[i], leaves, num_leaves);
+			break;
 		}
+		case MULTIPOINTTYPE:
+		case MULTILINETYPE:
+		case MULTIPOLYGONTYPE:
+		case POLYHEDRALSURFACETYPE:
+		case TINTYPE:
+		case COLLECTIONTYPE:
+		{
+			const LWCOLLECTION *lwcol = (LWCOLLECTION*)lwgeom;
+			for ( i = 0; i < lwcol->ngeoms; i++ )
+				lwgeom_add_rect_leaves(lwcol->geoms[i], leaves, num_leaves);
+			break;
+		}
+		default:
+			lwerror("Unable to calculate rect index tree for type %s", lwtype_name(lwgeom->type));
 	}
+}
 
-	/*
-	** If we sort the nodelist first, we'll get a more balanced tree
-	** in the end, but at the cost of sorting. For now, we just
-	** build the tree knowing that point arrays tend to have a
-	** reasonable amount of sorting already.
-	*/
+/**
+* Build a tree over every edge of a geometry. Points become degenerate
+* leaves, and the edges of all the rings and collection members are
+* packed together, so parts that are near each other share branches.
+* Curved geometries are not supported and return NULL, as do empty ones.
+*/
+RECT_NODE* lwgeom_calculate_rect_tree(const LWGEOM *lwgeom)
+{
+	RECT_NODE *leaves;
+	int num_leaves = 0;
 
-	num_children = j;
-	num_parents = num_children / 2;
-	while ( num_parents > 0 )
+	if ( lwgeom_is_empty(lwgeom) || lwgeom_has_arc(lwgeom) )
+		return NULL;
+
+	/* There are never more leaves than vertices */
+	leaves = lwalloc(lwgeom_count_vertices(lwgeom) * sizeof(RECT_NODE));
+	lwgeom_add_rect_leaves(lwgeom, leaves, &num_leaves);
+	if ( num_leaves == 0 )
 	{
-		j = 0;
-		while ( j < num_parents )
+		lwfree(leaves);
+		return NULL;
+	}
+	return rect_tree_pack(leaves, num_leaves);
+}
+
+/**
+* Return a vertex from somewhere in the tree, used as a probe when
+* testing containment of one geometry by another.
+*/
+int rect_tree_get_point(const RECT_NODE *node, POINT2D *pt)
+{
+	if ( rect_node_is_leaf(node) )
+	{
+		pt->x = node->p1->x;
+		pt->y = node->p1->y;
+		return LW_SUCCESS;
+	}
+	return rect_tree_get_point(rect_node_child(node, 0), pt);
+}
+
+/**
+* Count the crossings of a ray cast from the point along X, in the
+* positive direction if dir is positive and the negative one otherwise,
+* with the edges in the tree. Only the branches whose Y range spans
+* the point and that reach past it along the ray need to be visited.
+*/
+static int rect_tree_crossings(const RECT_NODE *node, const POINT2D *pt, int dir)
+{
+	int i, crossings = 0;
+
+	if ( pt->y < node->ymin || pt->y > node->ymax || 
+	     ( dir > 0 ? node->xmax < pt->x : node->xmin > pt->x ) )
+		return 0;
+
+	if ( rect_node_is_leaf(node) )
+	{
+		const POINT2D *p1 = node->p1;
+		const POINT2D *p2 = node->p2;
+		double x;
+
+		/* Half-open rule, so shared vertices are only counted once */
+		if ( (p1->y > pt->y) == (p2->y > pt->y) )
+			return 0;
+
+		x = p1->x + (pt->y - p1->y) * (p2->x - p1->x) / (p2->y - p1->y);
+		return ( dir > 0 ? x > pt->x : x < pt->x ) ? 1 : 0;
+	}
+
+	for ( i = 0; i < node->num_nodes; i++ )
+		crossings += rect_tree_crossings(rect_node_child(node, i), pt, dir);
+	return crossings;
+}
+
+/**
+* Point-in-polygon test for a tree built over the rings of a polygon or
+* multipolygon. Returns LW_TRUE when the crossing count is odd. The ray
+* is cast towards the nearer side of the tree, so it crosses fewer
+* branches. Points on the boundary give an arbitrary answer, but callers
+* only use this for distance short-circuits where the boundary distance
+* is zero anyway.
+*/
+int rect_tree_polygon_contains_point(const RECT_NODE *tree, const POINT2D *pt)
+{
+	int dir = ( tree->xmax - pt->x <= pt->x - tree->xmin ) ? 1 : -1;
+	return (rect_tree_crossings(tree, pt, dir) % 2) ? LW_TRUE : LW_FALSE;
+}
+
+/**
+* Minimum cartesian distance between the bounds of two nodes.
+*/
+static double rect_node_min_distance(const RECT_NODE *n1, const RECT_NODE *n2)
+{
+	double dx = 0.0, dy = 0.0;
+
+	if ( n1->xmax < n2->xmin )
+		dx = n2->xmin - n1->xmax;
+	else if ( n2->xmax < n1->xmin )
+		dx = n1->xmin - n2->xmax;
+
+	if ( n1->ymax < n2->ymin )
+		dy = n2->ymin - n1->ymax;
+	else if ( n2->ymax < n1->ymin )
+		dy = n1->ymin - n2->ymax;
+
+	return sqrt(dx*dx + dy*dy);
+}
+
+/**
+* Maximum cartesian distance between the bounds of two nodes.
+*/
+static double rect_node_max_distance(const RECT_NODE *n1, const RECT_NODE *n2)
+{
+	double dx = FP_MAX(n1->xmax - n2->xmin, n2->xmax - n1->xmin);
+	double dy = FP_MAX(n1->ymax - n2->ymin, n2->ymax - n1->ymin);
+	return sqrt(dx*dx + dy*dy);
+}
+
+static double rect_node_size(const RECT_NODE *node)
+{
+	return (node->xmax - node->xmin) + (node->ymax - node->ymin);
+}
+
+/**
+* The best distance anything under the two nodes could have, in the
+* direction of the search.
+*/
+static double rect_node_bound(const RECT_NODE *n1, const RECT_NODE *n2, int mode)
+{
+	return ( mode == DIST_MAX ) ? rect_node_max_distance(n1, n2) : rect_node_min_distance(n1, n2);
+}
+
+typedef struct
+{
+	double distance;
+	const RECT_NODE *node;
+} RECT_NODE_DIST;
+
+static void rect_tree_distance_tree_internal(const RECT_NODE *n1, const RECT_NODE *n2, int twist, DISTPTS *dl)
+{
+	RECT_NODE_DIST order[RECT_NODE_SIZE];
+	const RECT_NODE *split, *other;
+	int i, j;
+
+	/* Short circuit if we've already hit the tolerance */
+	if ( dl->mode == DIST_MIN && dl->distance <= dl->tolerance )
+		return;
+
+	/* If the boxes can't beat our best so far, prune */
+	if ( (dl->distance - rect_node_bound(n1, n2, dl->mode)) * dl->mode < 0 )
+		return;
+
+	/* Both leaf nodes, do a real distance calculation */
+	if ( rect_node_is_leaf(n1) && rect_node_is_leaf(n2) )
+	{
+		/* The longest distance is always between vertices */
+		if ( dl->mode == DIST_MAX )
 		{
-			/*
-			** Each new parent includes pointers to the children, so even though
-			** we are over-writing their place in the list, we still have references
-			** to them via the tree.
-			*/
-			nodes[j] = rect_node_internal_new(nodes[2*j], nodes[(2*j)+1]);
-			j++;
+			dl->twisted = twist;
+			lw_dist2d_pt_pt(n1->p1, n2->p1, dl);
+			dl->twisted = twist;
+			lw_dist2d_pt_pt(n1->p1, n2->p2, dl);
+			dl->twisted = twist;
+			lw_dist2d_pt_pt(n1->p2, n2->p1, dl);
+			dl->twisted = twist;
+			lw_dist2d_pt_pt(n1->p2, n2->p2, dl);
 		}
-		/* Odd number of children, just copy the last node up a level */
-		if ( num_children % 2 )
+		else
 		{
-			nodes[j] = nodes[num_children - 1];
-			num_parents++;
+			dl->twisted = twist;
+			lw_dist2d_seg_seg(n1->p1, n1->p2, n2->p1, n2->p2, dl);
 		}
-		num_children = num_parents;
-		num_parents = num_children / 2;
+		return;
 	}
 
-	/* Take a reference to the head of the tree*/
-	tree = nodes[0];
+	/* Split the bigger internal node */
+	if ( rect_node_is_leaf(n2) || ( ! rect_node_is_leaf(n1) && rect_node_size(n1) >= rect_node_size(n2) ) )
+	{
+		split = n1;
+		other = n2;
+	}
+	else
+	{
+		split = n2;
+		other = n1;
+	}
 
-	/* Free the old list structure, leaving the tree in place */
-	lwfree(nodes);
+	/* Order the children by their bound, so the best ones tighten the search first */
+	for ( i = 0; i < split->num_nodes; i++ )
+	{
+		const RECT_NODE *child = rect_node_child(split, i);
+		double d = rect_node_bound(child, other, dl->mode);
+		for ( j = i; j > 0 && (order[j-1].distance - d) * dl->mode > 0; j-- )
+			order[j] = order[j-1];
+		order[j].distance = d;
+		order[j].node = child;
+	}
 
-	return tree;
+	for ( i = 0; i < split->num_nodes; i++ )
+	{
+		/* The rest can do no better */
+		if ( (dl->distance - order[i].distance) * dl->mode < 0 )
+			break;
+		if ( split == n1 )
+			rect_tree_distance_tree_internal(order[i].node, n2, twist, dl);
+		else
+			rect_tree_distance_tree_internal(n1, order[i].node, twist, dl);
+	}
+}
+
+/**
+* Minimum distance between the edges of two trees, using branch-and-bound
+* on the node boxes. Stops descending as soon as a distance at or below
+* the threshold is found, so a threshold of zero gives the exact minimum
+* and a positive threshold gives a cheap "within" test. Note that this
+* is an edge-to-edge distance: containment of one polygon by the other
+* must be tested separately.
+*/
+double rect_tree_distance_tree(const RECT_NODE *n1, const RECT_NODE *n2, double threshold)
+{
+	DISTPTS dl;
+	lw_dist2d_distpts_init(&dl, DIST_MIN);
+	dl.tolerance = threshold;
+	rect_tree_distance_tree_internal(n1, n2, 1, &dl);
+	return dl.distance;
+}
+
+int rect_tree_dist2d(const RECT_NODE *n1, const RECT_NODE *n2, DISTPTS *dl)
+{
+	rect_tree_distance_tree_internal(n1, n2, dl->twisted, dl);
+	return LW_TRUE;
+}
+
+
+/**
+* Layout of a flattened tree: a header, then one record per node
+* in the order of the node array, root first. Children are referenced
+* the same way as in the array.
+*/
+#define RECT_TREE_FLAT_MAGIC 0x52454354 /* "RECT" */
+
+typedef struct
+{
+	uint32_t magic;
+	uint32_t num_nodes;
+} RECT_TREE_FLAT;
+
+typedef struct
+{
+	double xmin;
+	double xmax;
+	double ymin;
+	double ymax;
+	POINT2D pts[2];      /* Edge end points of leaves */
+	int32_t num_nodes;   /* Children, 0 for leaves */
+	int32_t first_child; /* Offset of the first child from this record */
+	int32_t is_point;    /* Leaf of a single vertex, p1 == p2 */
+	int32_t padding;
+} RECT_NODE_FLAT;
+
+/**
+* The array doesn't record its length, but the levels are laid out
+* one after the other and all the leaves are on the last one.
+*/
+static uint32_t rect_tree_count(const RECT_NODE *tree)
+{
+	uint32_t start = 0, count = 1, next, i;
+	while ( ! rect_node_is_leaf(&(tree[start])) )
+	{
+		next = 0;
+		for ( i = start; i < start + count; i++ )
+			next += tree[i].num_nodes;
+		start += count;
+		count = next;
+	}
+	return start + count;
+}
+
+void* rect_tree_flatten(const RECT_NODE *tree, size_t *size)
+{
+	uint32_t num_nodes = rect_tree_count(tree);
+	RECT_TREE_FLAT *flat;
+	RECT_NODE_FLAT *records;
+	uint32_t i;
+
+	*size = sizeof(RECT_TREE_FLAT) + num_nodes * sizeof(RECT_NODE_FLAT);
+	flat = lwalloc(*size);
+	memset(flat, 0, *size);
+	flat->magic = RECT_TREE_FLAT_MAGIC;
+	flat->num_nodes = num_nodes;
+	records = (RECT_NODE_FLAT*)(flat + 1);
 
+	for ( i = 0; i < num_nodes; i++ )
+	{
+		const RECT_NODE *node = &(tree[i]);
+		RECT_NODE_FLAT *r = &(records[i]);
+
+		r->xmin = node->xmin;
+		r->xmax = node->xmax;
+		r->ymin = node->ymin;
+		r->ymax = node->ymax;
+		if ( rect_node_is_leaf(node) )
+		{
+			r->pts[0] = *(node->p1);
+			r->pts[1] = *(node->p2);
+			r->is_point = (node->p1 == node->p2);
+		}
+		else
+		{
+			r->num_nodes = node->num_nodes;
+			r->first_child = node->first_child;
+		}
+	}
+	return flat;
 }
 
+RECT_NODE* rect_tree_unflatten(const void *buf, size_t size)
+{
+	const RECT_TREE_FLAT *flat = buf;
+	const RECT_NODE_FLAT *records;
+	RECT_NODE *tree;
+	uint32_t i;
+
+	if ( size < sizeof(RECT_TREE_FLAT) || flat->magic != RECT_TREE_FLAT_MAGIC || 
+	     flat->num_nodes == 0 || size != sizeof(RECT_TREE_FLAT) + flat->num_nodes * sizeof(RECT_NODE_FLAT) )
+		return NULL;
+	records = (const RECT_NODE_FLAT*)(flat + 1);
+
+	/* Children always come after their parent, so a bad buffer can't make a loop */
+	for ( i = 0; i < flat->num_nodes; i++ )
+	{
+		const RECT_NODE_FLAT *r = &(records[i]);
+		if ( r->num_nodes < 0 || r->num_nodes > RECT_NODE_SIZE ||
+		     ( r->num_nodes > 0 && ( r->first_child <= 0 || 
+		       (int64_t)i + r->first_child + r->num_nodes > (int64_t)flat->num_nodes ) ) )
+			return NULL;
+	}
+
+	tree = lwalloc(flat->num_nodes * sizeof(RECT_NODE));
+	for ( i = 0; i < flat->num_nodes; i++ )
+	{
+		const RECT_NODE_FLAT *r = &(records[i]);
+		RECT_NODE *n = &(tree[i]);
+
+		n->xmin = r->xmin;
+		n->xmax = r->xmax;
+		n->ymin = r->ymin;
+		n->ymax = r->ymax;
+		n->num_nodes = r->num_nodes;
+		n->first_child = r->first_child;
+		if ( r->num_nodes )
+		{
+			n->p1 = n->p2 = NULL;
+		}
+		else
+		{
+			n->p1 = (POINT2D*)&(r->pts[0]);
+			n->p2 = r->is_point ? n->p1 : (POINT2D*)&(r->pts[1]);
+		}
+	}
+	return tree;
+}
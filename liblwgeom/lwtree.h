@@ -1,5 +1,15 @@
+#ifndef _LWTREE_H
+#define _LWTREE_H 1
+
+#define RECT_NODE_SIZE 8
+
 /**
-* Note that p1 and p2 are pointers into an independent POINTARRAY, do not free them.
+* A tree is a single array of nodes, root first and then level by
+* level, bulk loaded with Sort-Tile-Recursive packing. The children
+* of an internal node are the num_nodes nodes starting first_child
+* nodes after it, leaves have no children. Internal nodes have p1
+* and p2 set to NULL. Note that p1 and p2 are pointers into an 
+* independent POINTARRAY, do not free them.
 */
 typedef struct rect_node
 {
@@ -7,8 +17,8 @@ typedef struct rect_node
 	double xmax;
 	double ymin;
 	double ymax;
-	struct rect_node *left_node;
-	struct rect_node *right_node;
+	int num_nodes;
+	int first_child;
 	POINT2D *p1;
 	POINT2D *p2;
 } RECT_NODE;	
@@ -16,6 +26,25 @@ typedef struct rect_node
 int rect_tree_contains_point(const RECT_NODE *tree, const POINT2D *pt, int *on_boundary);
 int rect_tree_intersects_tree(const RECT_NODE *tree1, const RECT_NODE *tree2);
 void rect_tree_free(RECT_NODE *node);
-RECT_NODE* rect_node_leaf_new(const POINTARRAY *pa, int i);
-RECT_NODE* rect_node_internal_new(RECT_NODE *left_node, RECT_NODE *right_node);
 RECT_NODE* rect_tree_new(const POINTARRAY *pa);
+RECT_NODE* lwgeom_calculate_rect_tree(const LWGEOM *lwgeom);
+int rect_tree_get_point(const RECT_NODE *node, POINT2D *pt);
+int rect_tree_polygon_contains_point(const RECT_NODE *tree, const POINT2D *pt);
+double rect_tree_distance_tree(const RECT_NODE *n1, const RECT_NODE *n2, double threshold);
+
+/**
+* Copy a tree into a single position-independent buffer, with the
+* edge end points inline, so it can be shared between backends.
+* The size of the buffer is returned in size.
+*/
+void* rect_tree_flatten(const RECT_NODE *tree, size_t *size);
+
+/**
+* Rebuild a tree from a rect_tree_flatten buffer. The node array
+* is allocated (free it with rect_tree_free) but the edge end
+* points are read from the buffer, which has to outlive the tree.
+* Returns NULL if the buffer is not a flattened tree.
+*/
+RECT_NODE* rect_tree_unflatten(const void *buf, size_t size);
+
+#endif /* _LWTREE_H */
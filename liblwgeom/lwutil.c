@@ -16,6 +16,45 @@ lwallocator lwalloc_var = default_allocator;
 lwreallocator lwrealloc_var = default_reallocator;
 lwfreeor lwfree_var = default_freeor;
 
+/* Arena allocator, see lwarena_create */
+#define LWARENA_ALIGN(size) (((size) + 7) & ~((size_t)7))
+#define LWARENA_MIN_BLOCK_SIZE 8192
+#define LWARENA_MAX_BLOCK_SIZE (8 * 1024 * 1024)
+
+typedef struct LWARENA_BLOCK_T
+{
+	struct LWARENA_BLOCK_T *next; /* Block filled before this one */
+	size_t size;                  /* Bytes available after the block header */
+	size_t used;                  /* Bytes handed out so far */
+} LWARENA_BLOCK;
+
+#define LWARENA_BLOCK_HDRSZ LWARENA_ALIGN(sizeof(LWARENA_BLOCK))
+#define LWARENA_BLOCK_DATA(block) ((uint8_t*)(block) + LWARENA_BLOCK_HDRSZ)
+
+/*
+* Every allocation is preceded by its (aligned) size, so that lwrealloc
+* knows how much to copy.
+*/
+#define LWARENA_CHUNK_HDRSZ LWARENA_ALIGN(sizeof(size_t))
+
+/*
+* The blocks are also kept in an array sorted by address, so that lwfree
+* and lwrealloc find out whether memory is the arena's with a binary
+* search instead of a walk over every block. Blocks double in size, so
+* the array stays short.
+*/
+struct LWARENA_T
+{
+	LWARENA_BLOCK *block;   /* Block being filled, chained to the older ones */
+	size_t block_size;      /* Size of the next block to allocate */
+	size_t *last;           /* Header of the last allocation, it can grow in place */
+	LWARENA_BLOCK **sorted; /* All the blocks, by address */
+	int nblocks;
+	int maxblocks;
+};
+
+static LWARENA *lwarena_current = NULL;
+
 /* Default reporters */
 static void default_noticereporter(const char *fmt, va_list ap);
 static void default_errorreporter(const char *fmt, va_list ap);
@@ -171,10 +210,189 @@ lwtype_name(uint8_t type)
 	return lwgeomTypeName[(int ) type];
 }
 
+/* Add a new block to the address ordered array */
+static void
+lwarena_add_sorted(LWARENA *arena, LWARENA_BLOCK *block)
+{
+	int i;
+
+	if ( ! arena->sorted )
+	{
+		arena->maxblocks = 8;
+		arena->sorted = lwalloc_var(arena->maxblocks * sizeof(LWARENA_BLOCK*));
+	}
+	else if ( arena->nblocks == arena->maxblocks )
+	{
+		arena->maxblocks *= 2;
+		arena->sorted = lwrealloc_var(arena->sorted, arena->maxblocks * sizeof(LWARENA_BLOCK*));
+	}
+
+	for ( i = arena->nblocks; i > 0 && arena->sorted[i-1] > block; i-- )
+		arena->sorted[i] = arena->sorted[i-1];
+	arena->sorted[i] = block;
+	arena->nblocks++;
+}
+
+static void *
+lwarena_alloc(LWARENA *arena, size_t size)
+{
+	LWARENA_BLOCK *block = arena->block;
+	size_t need;
+	size_t *chunk;
+
+	/* Even empty allocations take room, so that lwarena_owns sees them */
+	if ( size == 0 )
+		size = 1;
+	need = LWARENA_CHUNK_HDRSZ + LWARENA_ALIGN(size);
+
+	if ( ! block || block->used + need > block->size )
+	{
+		size_t block_size = arena->block_size;
+
+		while ( block_size < need )
+			block_size *= 2;
+
+		block = lwalloc_var(LWARENA_BLOCK_HDRSZ + block_size);
+		block->next = arena->block;
+		block->size = block_size;
+		block->used = 0;
+		arena->block = block;
+		lwarena_add_sorted(arena, block);
+
+		if ( arena->block_size < LWARENA_MAX_BLOCK_SIZE )
+			arena->block_size *= 2;
+	}
+
+	chunk = (size_t*)(LWARENA_BLOCK_DATA(block) + block->used);
+	*chunk = LWARENA_ALIGN(size);
+	block->used += need;
+	arena->last = chunk;
+
+	return (uint8_t*)chunk + LWARENA_CHUNK_HDRSZ;
+}
+
+/* Was mem handed out by the arena? */
+static int
+lwarena_owns(const LWARENA *arena, const void *mem)
+{
+	const uint8_t *ptr = mem;
+	const uint8_t *data;
+	int lo = 0, hi = arena->nblocks;
+
+	/* Find the last block starting at or below ptr */
+	while ( lo < hi )
+	{
+		int mid = (lo + hi) / 2;
+		if ( (const uint8_t*)arena->sorted[mid] <= ptr )
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	if ( lo == 0 )
+		return LW_FALSE;
+
+	data = LWARENA_BLOCK_DATA(arena->sorted[lo-1]);
+	return ptr > data && ptr < data + arena->sorted[lo-1]->used;
+}
+
+static void *
+lwarena_realloc(LWARENA *arena, void *mem, size_t size)
+{
+	size_t *chunk = (size_t*)((uint8_t*)mem - LWARENA_CHUNK_HDRSZ);
+	size_t oldsize = *chunk;
+	void *newmem;
+
+	if ( LWARENA_ALIGN(size) <= oldsize )
+		return mem;
+
+	/* The last allocation can grow in place if its block has room */
+	if ( chunk == arena->last )
+	{
+		LWARENA_BLOCK *block = arena->block;
+		size_t grow = LWARENA_ALIGN(size) - oldsize;
+		if ( block->used + grow <= block->size )
+		{
+			block->used += grow;
+			*chunk = LWARENA_ALIGN(size);
+			return mem;
+		}
+	}
+
+	newmem = lwarena_alloc(arena, size);
+	memcpy(newmem, mem, oldsize);
+	return newmem;
+}
+
+LWARENA *
+lwarena_create(size_t size)
+{
+	LWARENA *arena = lwalloc_var(sizeof(LWARENA));
+	arena->block = NULL;
+	arena->block_size = LWARENA_MIN_BLOCK_SIZE;
+	while ( arena->block_size < size && arena->block_size < LWARENA_MAX_BLOCK_SIZE )
+		arena->block_size *= 2;
+	arena->last = NULL;
+	arena->sorted = NULL;
+	arena->nblocks = arena->maxblocks = 0;
+	return arena;
+}
+
+LWARENA *
+lwarena_switch(LWARENA *arena)
+{
+	LWARENA *old = lwarena_current;
+	lwarena_current = arena;
+	return old;
+}
+
+void
+lwarena_reset(LWARENA *arena)
+{
+	LWARENA_BLOCK *block = arena->block;
+
+	if ( ! block )
+		return;
+
+	/* The newest block is the largest, keep it */
+	while ( block->next )
+	{
+		LWARENA_BLOCK *next = block->next->next;
+		lwfree_var(block->next);
+		block->next = next;
+	}
+	block->used = 0;
+	arena->last = NULL;
+	arena->sorted[0] = block;
+	arena->nblocks = 1;
+}
+
+void
+lwarena_destroy(LWARENA *arena)
+{
+	LWARENA_BLOCK *block = arena->block;
+
+	if ( lwarena_current == arena )
+		lwarena_current = NULL;
+
+	while ( block )
+	{
+		LWARENA_BLOCK *next = block->next;
+		lwfree_var(block);
+		block = next;
+	}
+	if ( arena->sorted )
+		lwfree_var(arena->sorted);
+	lwfree_var(arena);
+}
+
 void *
 lwalloc(size_t size)
 {
-	void *mem = lwalloc_var(size);
+	void *mem;
+	if ( lwarena_current )
+		mem = lwarena_alloc(lwarena_current, size);
+	else
+		mem = lwalloc_var(size);
 	LWDEBUGF(5, "lwalloc: %d@%p", size, mem);
 	return mem;
 }
@@ -183,12 +401,17 @@ void *
 lwrealloc(void *mem, size_t size)
 {
 	LWDEBUGF(5, "lwrealloc: %d@%p", size, mem);
+	if ( lwarena_current && lwarena_owns(lwarena_current, mem) )
+		return lwarena_realloc(lwarena_current, mem, size);
 	return lwrealloc_var(mem, size);
 }
 
 void
 lwfree(void *mem)
 {
+	/* Arena memory goes away with the arena */
+	if ( lwarena_current && lwarena_owns(lwarena_current, mem) )
+		return;
 	lwfree_var(mem);
 }
 
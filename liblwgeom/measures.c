@@ -17,6 +17,9 @@
 #include "measures.h"
 #include "lwgeom_log.h"
 
+/* Edge pairs above which point arrays are compared through edge trees */
+#define DIST_TREE_MIN_PAIRS 4096
+
 
 /*------------------------------------------------------------------------------------------------------------
 Initializing functions
@@ -1087,6 +1090,7 @@ lw_dist2d_pt_ptarrayarc(const POINT2D *p, const POINTARRAY *pa, DISTPTS *dl)
 
 /**
 * test each segment of l1 against each segment of l2.
+* Big pairs are handed to lw_dist2d_ptarray_ptarray_tree.
 */
 int
 lw_dist2d_ptarray_ptarray(POINTARRAY *l1, POINTARRAY *l2,DISTPTS *dl)
@@ -1098,6 +1102,10 @@ lw_dist2d_ptarray_ptarray(POINTARRAY *l1, POINTARRAY *l2,DISTPTS *dl)
 
 	LWDEBUGF(2, "lw_dist2d_ptarray_ptarray called (points: %d-%d)",l1->npoints, l2->npoints);
 
+	if ( l1->npoints > 1 && l2->npoints > 1 && 
+	     (double)l1->npoints * l2->npoints >= DIST_TREE_MIN_PAIRS )
+		return lw_dist2d_ptarray_ptarray_tree(l1, l2, dl);
+
 	if (dl->mode == DIST_MAX)/*If we are searching for maxdistance we go straight to point-point calculation since the maxdistance have to be between two vertexes*/
 	{
 		for (t=0; t<l1->npoints; t++) /*for each segment in L1 */
@@ -1137,6 +1145,33 @@ lw_dist2d_ptarray_ptarray(POINTARRAY *l1, POINTARRAY *l2,DISTPTS *dl)
 	return LW_TRUE;
 }
 
+/**
+* Same answer as lw_dist2d_ptarray_ptarray, but found with a
+* branch-and-bound search of edge trees over both arrays, which only
+* compares the edges whose boxes could hold a better distance. This
+* is what keeps big arrays with overlapping boxes, which the "fast"
+* projection method can't take, from trying every pair of edges.
+*/
+int
+lw_dist2d_ptarray_ptarray_tree(POINTARRAY *l1, POINTARRAY *l2, DISTPTS *dl)
+{
+	RECT_NODE *tree1, *tree2;
+	int rv = LW_TRUE;
+
+	LWDEBUGF(2, "lw_dist2d_ptarray_ptarray_tree called (points: %d-%d)",l1->npoints, l2->npoints);
+
+	tree1 = rect_tree_new(l1);
+	tree2 = rect_tree_new(l2);
+	if ( tree1 && tree2 )
+		rv = rect_tree_dist2d(tree1, tree2, dl);
+
+	if ( tree1 )
+		rect_tree_free(tree1);
+	if ( tree2 )
+		rect_tree_free(tree2);
+	return rv;
+}
+
 /**
 * Test each segment of pa against each arc of pb for distance.
 */
@@ -12,6 +12,7 @@
  **********************************************************************/
 
 #include "liblwgeom_internal.h"
+#include "lwtree.h"
 
 
 /**
@@ -77,6 +78,12 @@ int lw_dist2d_selected_seg_seg(POINT2D *A, POINT2D *B, POINT2D *C, POINT2D *D, D
 int struct_cmp_by_measure(const void *a, const void *b);
 int lw_dist2d_fast_ptarray_ptarray(POINTARRAY *l1,POINTARRAY *l2, DISTPTS *dl,  GBOX *box1, GBOX *box2);
 
+/*
+* Edge tree distance calculations, for big point arrays with overlapping boxes
+*/
+int lw_dist2d_ptarray_ptarray_tree(POINTARRAY *l1, POINTARRAY *l2, DISTPTS *dl);
+int rect_tree_dist2d(const RECT_NODE *n1, const RECT_NODE *n2, DISTPTS *dl);
+
 /*
 * Distance calculation primitives. 
 */
@@ -958,32 +958,11 @@ ptarrayarc_contains_point_partial(const POINTARRAY *pa, const POINT2D *pt, int c
 double
 ptarray_signed_area(const POINTARRAY *pa)
 {
-	const POINT2D *P1;
-	const POINT2D *P2;
-	const POINT2D *P3;
-	double sum = 0.0;
-	double x0, x, y1, y2;
-	int i;
-	
 	if (! pa || pa->npoints < 3 )
 		return 0.0;
-		
-	P1 = getPoint2d_cp(pa, 0);
-	P2 = getPoint2d_cp(pa, 1);
-	x0 = P1->x;
-	for ( i = 1; i < pa->npoints - 1; i++ )
-	{
-		P3 = getPoint2d_cp(pa, i+1);
-		x = P2->x - x0;
-		y1 = P3->y;
-		y2 = P1->y;
-		sum += x * (y2-y1);
-		
-		/* Move forwards! */
-		P1 = P2;
-		P2 = P3;
-	}
-	return sum / 2.0;	
+
+	return lw_ordinates_signed_area((const double*)pa->serialized_pointlist,
+	                                pa->npoints, FLAGS_NDIMS(pa->flags));
 }
 
 int
@@ -1567,25 +1546,10 @@ ptarray_arc_length_2d(const POINTARRAY *pts)
 double
 ptarray_length_2d(const POINTARRAY *pts)
 {
-	double dist = 0.0;
-	int i;
-	const POINT2D *frm;
-	const POINT2D *to;
-
 	if ( pts->npoints < 2 ) return 0.0;
 
-	frm = getPoint2d_cp(pts, 0);
-	
-	for ( i=1; i < pts->npoints; i++ )
-	{
-		to = getPoint2d_cp(pts, i);
-
-		dist += sqrt( ((frm->x - to->x)*(frm->x - to->x))  +
-		              ((frm->y - to->y)*(frm->y - to->y)) );
-		
-		frm = to;
-	}
-	return dist;
+	return lw_ordinates_length_2d((const double*)pts->serialized_pointlist,
+	                              pts->npoints, FLAGS_NDIMS(pts->flags));
 }
 
 /**
@@ -0,0 +1,634 @@
+/**********************************************************************
+ *
+ * PostGIS - Spatial Types for PostgreSQL
+ * http://postgis.net
+ *
+ * This is free software; you can redistribute and/or modify it under
+ * the terms of the GNU General Public Licence. See the COPYING file.
+ *
+ **********************************************************************/
+
+/*
+* Kernels for the hot point array reductions: bounding box, 2D length
+* and signed area. They read the ordinate array directly (npoints points
+* of ndims doubles each) instead of going through getPoint*_p, and come
+* in scalar, SSE2 and AVX2 flavours chosen at runtime from the CPU.
+*
+* Length and area add their terms up in the same order as the scalar
+* loops, only the per-term arithmetic is vectorized, so every flavour
+* returns bit-identical results.
+*/
+
+#include <math.h>
+
+#include "liblwgeom_internal.h"
+#include "lwgeom_log.h"
+
+#if defined(__GNUC__) && ( defined(__x86_64__) || defined(__i386__) ) && \
+    ( defined(__clang__) || __GNUC__ > 4 || ( __GNUC__ == 4 && __GNUC_MINOR__ >= 9 ) )
+#define LW_HAVE_X86_SIMD 1
+#include <immintrin.h>
+#define LW_TARGET_SSE2 __attribute__((target("sse2")))
+#define LW_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+/* Best level the CPU supports, and the level in use. -1 until probed. */
+static int lw_simd_max = -1;
+static int lw_simd_current = -1;
+
+static void
+lw_simd_probe(void)
+{
+	lw_simd_max = LW_SIMD_NONE;
+#ifdef LW_HAVE_X86_SIMD
+	__builtin_cpu_init();
+	if ( __builtin_cpu_supports("avx2") )
+		lw_simd_max = LW_SIMD_AVX2;
+	else if ( __builtin_cpu_supports("sse2") )
+		lw_simd_max = LW_SIMD_SSE2;
+#endif
+	lw_simd_current = lw_simd_max;
+	LWDEBUGF(3, "lw_simd_probe: using level %d", lw_simd_current);
+}
+
+int
+lw_simd_level(void)
+{
+	if ( lw_simd_current < 0 )
+		lw_simd_probe();
+	return lw_simd_current;
+}
+
+int
+lw_simd_set_level(int level)
+{
+	int old = lw_simd_level();
+	if ( level > lw_simd_max )
+		level = lw_simd_max;
+	if ( level < LW_SIMD_NONE )
+		level = LW_SIMD_NONE;
+	lw_simd_current = level;
+	return old;
+}
+
+
+/***********************************************************************
+* Bounding box.
+*/
+
+static void
+ordinates_minmax_scalar(const double *ords, int npoints, int ndims, double *min, double *max)
+{
+	int i, d;
+
+	for ( d = 0; d < ndims; d++ )
+		min[d] = max[d] = ords[d];
+
+	for ( i = 1; i < npoints; i++ )
+	{
+		const double *p = ords + i * ndims;
+		for ( d = 0; d < ndims; d++ )
+		{
+			min[d] = FP_MIN(min[d], p[d]);
+			max[d] = FP_MAX(max[d], p[d]);
+		}
+	}
+}
+
+#ifdef LW_HAVE_X86_SIMD
+
+/* minpd/maxpd pick the same operand as FP_MIN/FP_MAX, NaNs included */
+LW_TARGET_SSE2 static void
+ordinates_minmax_sse2(const double *ords, int npoints, int ndims, double *min, double *max)
+{
+	__m128d minxy, maxxy, minzm, maxzm, v;
+	int i;
+
+	minxy = maxxy = _mm_loadu_pd(ords);
+	minzm = maxzm = _mm_setzero_pd();
+	if ( ndims == 4 )
+		minzm = maxzm = _mm_loadu_pd(ords + 2);
+	else if ( ndims == 3 )
+		min[2] = max[2] = ords[2];
+
+	for ( i = 1; i < npoints; i++ )
+	{
+		const double *p = ords + i * ndims;
+		v = _mm_loadu_pd(p);
+		minxy = _mm_min_pd(minxy, v);
+		maxxy = _mm_max_pd(maxxy, v);
+		if ( ndims == 4 )
+		{
+			v = _mm_loadu_pd(p + 2);
+			minzm = _mm_min_pd(minzm, v);
+			maxzm = _mm_max_pd(maxzm, v);
+		}
+		else if ( ndims == 3 )
+		{
+			min[2] = FP_MIN(min[2], p[2]);
+			max[2] = FP_MAX(max[2], p[2]);
+		}
+	}
+
+	_mm_storeu_pd(min, minxy);
+	_mm_storeu_pd(max, maxxy);
+	if ( ndims == 4 )
+	{
+		_mm_storeu_pd(min + 2, minzm);
+		_mm_storeu_pd(max + 2, maxzm);
+	}
+}
+
+LW_TARGET_AVX2 static void
+ordinates_minmax_avx2(const double *ords, int npoints, int ndims, double *min, double *max)
+{
+	__m256d vmin, vmax, v;
+	double tmin[4], tmax[4];
+	int i, d;
+
+	if ( ndims == 2 )
+	{
+		/* Two XY points per register, even points in the low lanes */
+		if ( npoints < 2 )
+		{
+			ordinates_minmax_scalar(ords, npoints, ndims, min, max);
+			return;
+		}
+		vmin = vmax = _mm256_loadu_pd(ords);
+		for ( i = 2; i + 1 < npoints; i += 2 )
+		{
+			v = _mm256_loadu_pd(ords + 2 * i);
+			vmin = _mm256_min_pd(vmin, v);
+			vmax = _mm256_max_pd(vmax, v);
+		}
+		/* Odd count, overlap the last point with the one before */
+		if ( i < npoints )
+		{
+			v = _mm256_loadu_pd(ords + 2 * (npoints - 2));
+			vmin = _mm256_min_pd(vmin, v);
+			vmax = _mm256_max_pd(vmax, v);
+		}
+		_mm_storeu_pd(min, _mm_min_pd(_mm256_castpd256_pd128(vmin), _mm256_extractf128_pd(vmin, 1)));
+		_mm_storeu_pd(max, _mm_max_pd(_mm256_castpd256_pd128(vmax), _mm256_extractf128_pd(vmax, 1)));
+		return;
+	}
+
+	if ( ndims == 4 )
+	{
+		/* One XYZM point per register */
+		vmin = vmax = _mm256_loadu_pd(ords);
+		for ( i = 1; i < npoints; i++ )
+		{
+			v = _mm256_loadu_pd(ords + 4 * i);
+			vmin = _mm256_min_pd(vmin, v);
+			vmax = _mm256_max_pd(vmax, v);
+		}
+		_mm256_storeu_pd(min, vmin);
+		_mm256_storeu_pd(max, vmax);
+		return;
+	}
+
+	/*
+	* Three ordinates. The fourth lane reads the X of the next point and is
+	* ignored, so the last point (which has no next one) is done by hand.
+	*/
+	if ( npoints < 2 )
+	{
+		ordinates_minmax_scalar(ords, npoints, ndims, min, max);
+		return;
+	}
+	vmin = vmax = _mm256_loadu_pd(ords);
+	for ( i = 1; i < npoints - 1; i++ )
+	{
+		v = _mm256_loadu_pd(ords + 3 * i);
+		vmin = _mm256_min_pd(vmin, v);
+		vmax = _mm256_max_pd(vmax, v);
+	}
+	_mm256_storeu_pd(tmin, vmin);
+	_mm256_storeu_pd(tmax, vmax);
+	for ( d = 0; d < 3; d++ )
+	{
+		min[d] = FP_MIN(tmin[d], ords[3 * (npoints - 1) + d]);
+		max[d] = FP_MAX(tmax[d], ords[3 * (npoints - 1) + d]);
+	}
+}
+
+#endif /* LW_HAVE_X86_SIMD */
+
+void
+lw_ordinates_minmax(const double *ords, int npoints, int ndims, double *min, double *max)
+{
+	assert(npoints > 0);
+	assert(ndims >= 2 && ndims <= 4);
+
+	switch ( lw_simd_level() )
+	{
+#ifdef LW_HAVE_X86_SIMD
+	case LW_SIMD_AVX2:
+		ordinates_minmax_avx2(ords, npoints, ndims, min, max);
+		return;
+	case LW_SIMD_SSE2:
+		ordinates_minmax_sse2(ords, npoints, ndims, min, max);
+		return;
+#endif
+	default:
+		ordinates_minmax_scalar(ords, npoints, ndims, min, max);
+	}
+}
+
+
+/***********************************************************************
+* 2D length.
+*/
+
+static inline double
+segment_length_2d(const double *frm, const double *to)
+{
+	return sqrt( ((frm[0] - to[0])*(frm[0] - to[0]))  +
+	             ((frm[1] - to[1])*(frm[1] - to[1])) );
+}
+
+static double
+ordinates_length_2d_scalar(const double *ords, int npoints, int ndims)
+{
+	double dist = 0.0;
+	int i;
+
+	for ( i = 1; i < npoints; i++ )
+		dist += segment_length_2d(ords + (i - 1) * ndims, ords + i * ndims);
+
+	return dist;
+}
+
+#ifdef LW_HAVE_X86_SIMD
+
+/* Two segments per iteration */
+LW_TARGET_SSE2 static double
+ordinates_length_2d_sse2(const double *ords, int npoints, int ndims)
+{
+	double dist = 0.0;
+	double len[2];
+	__m128d a, b, c, d1, d2;
+	int i;
+
+	a = _mm_loadu_pd(ords);
+	for ( i = 0; i + 2 < npoints; i += 2 )
+	{
+		b = _mm_loadu_pd(ords + (i + 1) * ndims);
+		c = _mm_loadu_pd(ords + (i + 2) * ndims);
+		d1 = _mm_sub_pd(a, b);
+		d2 = _mm_sub_pd(b, c);
+		d1 = _mm_mul_pd(d1, d1);
+		d2 = _mm_mul_pd(d2, d2);
+		/* (dx1*dx1 + dy1*dy1, dx2*dx2 + dy2*dy2) */
+		_mm_storeu_pd(len, _mm_sqrt_pd(_mm_add_pd(_mm_unpacklo_pd(d1, d2), _mm_unpackhi_pd(d1, d2))));
+		dist += len[0];
+		dist += len[1];
+		a = c;
+	}
+	if ( i + 1 < npoints )
+		dist += segment_length_2d(ords + i * ndims, ords + (i + 1) * ndims);
+
+	return dist;
+}
+
+/* Four segments per iteration */
+LW_TARGET_AVX2 static double
+ordinates_length_2d_avx2(const double *ords, int npoints, int ndims)
+{
+	double dist = 0.0;
+	double len[4];
+	__m128d p0, p1, p2, p3, p4;
+	__m256d d1, d2;
+	int i;
+
+	p0 = _mm_loadu_pd(ords);
+	for ( i = 0; i + 4 < npoints; i += 4 )
+	{
+		p1 = _mm_loadu_pd(ords + (i + 1) * ndims);
+		p2 = _mm_loadu_pd(ords + (i + 2) * ndims);
+		p3 = _mm_loadu_pd(ords + (i + 3) * ndims);
+		p4 = _mm_loadu_pd(ords + (i + 4) * ndims);
+		/* (dx0, dy0, dx1, dy1) and (dx2, dy2, dx3, dy3) */
+		d1 = _mm256_sub_pd(_mm256_insertf128_pd(_mm256_castpd128_pd256(p0), p1, 1),
+		                   _mm256_insertf128_pd(_mm256_castpd128_pd256(p1), p2, 1));
+		d2 = _mm256_sub_pd(_mm256_insertf128_pd(_mm256_castpd128_pd256(p2), p3, 1),
+		                   _mm256_insertf128_pd(_mm256_castpd128_pd256(p3), p4, 1));
+		d1 = _mm256_mul_pd(d1, d1);
+		d2 = _mm256_mul_pd(d2, d2);
+		/* hadd interleaves the halves: segments 0, 2, 1, 3 */
+		_mm256_storeu_pd(len, _mm256_sqrt_pd(_mm256_hadd_pd(d1, d2)));
+		dist += len[0];
+		dist += len[2];
+		dist += len[1];
+		dist += len[3];
+		p0 = p4;
+	}
+	for ( ; i + 1 < npoints; i++ )
+		dist += segment_length_2d(ords + i * ndims, ords + (i + 1) * ndims);
+
+	return dist;
+}
+
+#endif /* LW_HAVE_X86_SIMD */
+
+double
+lw_ordinates_length_2d(const double *ords, int npoints, int ndims)
+{
+	if ( npoints < 2 )
+		return 0.0;
+
+	switch ( lw_simd_level() )
+	{
+#ifdef LW_HAVE_X86_SIMD
+	case LW_SIMD_AVX2:
+		return ordinates_length_2d_avx2(ords, npoints, ndims);
+	case LW_SIMD_SSE2:
+		return ordinates_length_2d_sse2(ords, npoints, ndims);
+#endif
+	default:
+		return ordinates_length_2d_scalar(ords, npoints, ndims);
+	}
+}
+
+
+/***********************************************************************
+* Signed area (shoelace), see ptarray_signed_area.
+*/
+
+static double
+ordinates_signed_area_scalar(const double *ords, int npoints, int ndims)
+{
+	double sum = 0.0;
+	double x0 = ords[0];
+	int i;
+
+	for ( i = 1; i < npoints - 1; i++ )
+	{
+		double x = ords[i * ndims] - x0;
+		double y1 = ords[(i + 1) * ndims + 1];
+		double y2 = ords[(i - 1) * ndims + 1];
+		sum += x * (y2 - y1);
+	}
+	return sum;
+}
+
+#ifdef LW_HAVE_X86_SIMD
+
+/* Two terms per iteration */
+LW_TARGET_SSE2 static double
+ordinates_signed_area_sse2(const double *ords, int npoints, int ndims)
+{
+	double sum = 0.0;
+	double term[2];
+	__m128d vx0 = _mm_set1_pd(ords[0]);
+	__m128d x, y1, y2;
+	int i;
+
+	for ( i = 1; i + 2 < npoints; i += 2 )
+	{
+		x  = _mm_set_pd(ords[(i + 1) * ndims], ords[i * ndims]);
+		y1 = _mm_set_pd(ords[(i + 2) * ndims + 1], ords[(i + 1) * ndims + 1]);
+		y2 = _mm_set_pd(ords[i * ndims + 1], ords[(i - 1) * ndims + 1]);
+		_mm_storeu_pd(term, _mm_mul_pd(_mm_sub_pd(x, vx0), _mm_sub_pd(y2, y1)));
+		sum += term[0];
+		sum += term[1];
+	}
+	for ( ; i < npoints - 1; i++ )
+		sum += (ords[i * ndims] - ords[0]) * (ords[(i - 1) * ndims + 1] - ords[(i + 1) * ndims + 1]);
+
+	return sum;
+}
+
+#endif /* LW_HAVE_X86_SIMD */
+
+double
+lw_ordinates_signed_area(const double *ords, int npoints, int ndims)
+{
+	double sum;
+
+	if ( npoints < 3 )
+		return 0.0;
+
+	switch ( lw_simd_level() )
+	{
+#ifdef LW_HAVE_X86_SIMD
+	/*
+	* Adding the terms in order makes this latency bound, wider
+	* registers only add shuffling, so AVX2 stays on the SSE2 kernel.
+	*/
+	case LW_SIMD_AVX2:
+	case LW_SIMD_SSE2:
+		sum = ordinates_signed_area_sse2(ords, npoints, ndims);
+		break;
+#endif
+	default:
+		sum = ordinates_signed_area_scalar(ords, npoints, ndims);
+	}
+	return sum / 2.0;
+}
+
+
+/***********************************************************************
+* Batched point in ring, see ptarray_contains_point_partial. Each lane
+* follows one point through the winding number loop, the edges are
+* broadcast. A block stops early once all its points are on the boundary.
+*/
+
+#ifdef LW_HAVE_X86_SIMD
+
+LW_TARGET_SSE2 static int
+ordinates_contains_points_sse2(const double *ords, int nverts, int ndims,
+                               const POINT2D *pts, int npts, int *results)
+{
+	const __m128d one = _mm_set1_pd(1.0);
+	int i, k, lane;
+
+	for ( k = 0; k + 2 <= npts; k += 2 )
+	{
+		__m128d px = _mm_set_pd(pts[k+1].x, pts[k].x);
+		__m128d py = _mm_set_pd(pts[k+1].y, pts[k].y);
+		__m128d wn = _mm_setzero_pd();
+		__m128d bnd = _mm_setzero_pd();
+		double wns[2];
+		int bmask;
+		const double *s1 = ords;
+
+		for ( i = 1; i < nverts; i++ )
+		{
+			const double *s2 = ords + i * ndims;
+			__m128d x1, y1, x2, y2, side, zero, inseg, up, down;
+
+			/* Zero length segments are ignored. */
+			if ( s1[0] == s2[0] && s1[1] == s2[1] )
+			{
+				s1 = s2;
+				continue;
+			}
+
+			x1 = _mm_set1_pd(s1[0]);
+			y1 = _mm_set1_pd(s1[1]);
+			x2 = _mm_set1_pd(s2[0]);
+			y2 = _mm_set1_pd(s2[1]);
+
+			/* Same expression as lw_segment_side */
+			side = _mm_sub_pd(_mm_mul_pd(_mm_sub_pd(px, x1), _mm_set1_pd(s2[1] - s1[1])),
+			                  _mm_mul_pd(_mm_set1_pd(s2[0] - s1[0]), _mm_sub_pd(py, y1)));
+			zero = _mm_setzero_pd();
+
+			/* On the boundary: collinear, in the y range and lw_pt_in_seg */
+			inseg = _mm_or_pd(
+			          _mm_or_pd(_mm_and_pd(_mm_cmple_pd(x1, px), _mm_cmplt_pd(px, x2)),
+			                    _mm_and_pd(_mm_cmpge_pd(x1, px), _mm_cmpgt_pd(px, x2))),
+			          _mm_or_pd(_mm_and_pd(_mm_cmple_pd(y1, py), _mm_cmplt_pd(py, y2)),
+			                    _mm_and_pd(_mm_cmpge_pd(y1, py), _mm_cmpgt_pd(py, y2))));
+			inseg = _mm_and_pd(inseg, _mm_cmpeq_pd(side, zero));
+			inseg = _mm_and_pd(inseg, _mm_cmple_pd(py, _mm_max_pd(y1, y2)));
+			inseg = _mm_and_pd(inseg, _mm_cmpge_pd(py, _mm_min_pd(y1, y2)));
+			bnd = _mm_or_pd(bnd, inseg);
+
+			/* Left of a rising edge, or right of a falling one */
+			up = _mm_and_pd(_mm_cmplt_pd(side, zero),
+			                _mm_and_pd(_mm_cmple_pd(y1, py), _mm_cmplt_pd(py, y2)));
+			down = _mm_and_pd(_mm_cmpgt_pd(side, zero),
+			                  _mm_and_pd(_mm_cmple_pd(y2, py), _mm_cmplt_pd(py, y1)));
+			wn = _mm_add_pd(wn, _mm_and_pd(up, one));
+			wn = _mm_sub_pd(wn, _mm_and_pd(down, one));
+
+			if ( _mm_movemask_pd(bnd) == 0x3 )
+				break;
+			s1 = s2;
+		}
+
+		_mm_storeu_pd(wns, wn);
+		bmask = _mm_movemask_pd(bnd);
+		for ( lane = 0; lane < 2; lane++ )
+		{
+			if ( bmask & (1 << lane) )
+				results[k+lane] = LW_BOUNDARY;
+			else
+				results[k+lane] = (wns[lane] == 0.0) ? LW_OUTSIDE : LW_INSIDE;
+		}
+	}
+	return k;
+}
+
+LW_TARGET_AVX2 static int
+ordinates_contains_points_avx2(const double *ords, int nverts, int ndims,
+                               const POINT2D *pts, int npts, int *results)
+{
+	const __m256d one = _mm256_set1_pd(1.0);
+	int i, k, lane;
+
+	for ( k = 0; k + 4 <= npts; k += 4 )
+	{
+		__m256d px = _mm256_set_pd(pts[k+3].x, pts[k+2].x, pts[k+1].x, pts[k].x);
+		__m256d py = _mm256_set_pd(pts[k+3].y, pts[k+2].y, pts[k+1].y, pts[k].y);
+		__m256d wn = _mm256_setzero_pd();
+		__m256d bnd = _mm256_setzero_pd();
+		double wns[4];
+		int bmask;
+		const double *s1 = ords;
+
+		for ( i = 1; i < nverts; i++ )
+		{
+			const double *s2 = ords + i * ndims;
+			__m256d x1, y1, x2, y2, side, zero, inseg, up, down;
+
+			/* Zero length segments are ignored. */
+			if ( s1[0] == s2[0] && s1[1] == s2[1] )
+			{
+				s1 = s2;
+				continue;
+			}
+
+			x1 = _mm256_set1_pd(s1[0]);
+			y1 = _mm256_set1_pd(s1[1]);
+			x2 = _mm256_set1_pd(s2[0]);
+			y2 = _mm256_set1_pd(s2[1]);
+
+			/* Same expression as lw_segment_side */
+			side = _mm256_sub_pd(_mm256_mul_pd(_mm256_sub_pd(px, x1), _mm256_set1_pd(s2[1] - s1[1])),
+			                     _mm256_mul_pd(_mm256_set1_pd(s2[0] - s1[0]), _mm256_sub_pd(py, y1)));
+			zero = _mm256_setzero_pd();
+
+			/* On the boundary: collinear, in the y range and lw_pt_in_seg */
+			inseg = _mm256_or_pd(
+			          _mm256_or_pd(_mm256_and_pd(_mm256_cmp_pd(x1, px, _CMP_LE_OQ), _mm256_cmp_pd(px, x2, _CMP_LT_OQ)),
+			                       _mm256_and_pd(_mm256_cmp_pd(x1, px, _CMP_GE_OQ), _mm256_cmp_pd(px, x2, _CMP_GT_OQ))),
+			          _mm256_or_pd(_mm256_and_pd(_mm256_cmp_pd(y1, py, _CMP_LE_OQ), _mm256_cmp_pd(py, y2, _CMP_LT_OQ)),
+			                       _mm256_and_pd(_mm256_cmp_pd(y1, py, _CMP_GE_OQ), _mm256_cmp_pd(py, y2, _CMP_GT_OQ))));
+			inseg = _mm256_and_pd(inseg, _mm256_cmp_pd(side, zero, _CMP_EQ_OQ));
+			inseg = _mm256_and_pd(inseg, _mm256_cmp_pd(py, _mm256_max_pd(y1, y2), _CMP_LE_OQ));
+			inseg = _mm256_and_pd(inseg, _mm256_cmp_pd(py, _mm256_min_pd(y1, y2), _CMP_GE_OQ));
+			bnd = _mm256_or_pd(bnd, inseg);
+
+			/* Left of a rising edge, or right of a falling one */
+			up = _mm256_and_pd(_mm256_cmp_pd(side, zero, _CMP_LT_OQ),
+			                   _mm256_and_pd(_mm256_cmp_pd(y1, py, _CMP_LE_OQ), _mm256_cmp_pd(py, y2, _CMP_LT_OQ)));
+			down = _mm256_and_pd(_mm256_cmp_pd(side, zero, _CMP_GT_OQ),
+			                     _mm256_and_pd(_mm256_cmp_pd(y2, py, _CMP_LE_OQ), _mm256_cmp_pd(py, y1, _CMP_LT_OQ)));
+			wn = _mm256_add_pd(wn, _mm256_and_pd(up, one));
+			wn = _mm256_sub_pd(wn, _mm256_and_pd(down, one));
+
+			if ( _mm256_movemask_pd(bnd) == 0xF )
+				break;
+			s1 = s2;
+		}
+
+		_mm256_storeu_pd(wns, wn);
+		bmask = _mm256_movemask_pd(bnd);
+		for ( lane = 0; lane < 4; lane++ )
+		{
+			if ( bmask & (1 << lane) )
+				results[k+lane] = LW_BOUNDARY;
+			else
+				results[k+lane] = (wns[lane] == 0.0) ? LW_OUTSIDE : LW_INSIDE;
+		}
+	}
+	return k;
+}
+
+#endif /* LW_HAVE_X86_SIMD */
+
+/**
+* Test npoints points against one closed ring, writing LW_INSIDE,
+* LW_BOUNDARY or LW_OUTSIDE for each of them into results. Gives the
+* same answers as calling ptarray_contains_point on every point.
+*/
+int
+ptarray_contains_points(const POINTARRAY *pa, const POINT2D *pts, int npoints, int *results)
+{
+	const double *ords = (const double*)pa->serialized_pointlist;
+	int ndims = FLAGS_NDIMS(pa->flags);
+	int done = 0;
+
+	if ( npoints < 1 )
+		return LW_SUCCESS;
+
+	if ( ! p2d_same(getPoint2d_cp(pa, 0), getPoint2d_cp(pa, pa->npoints-1)) )
+	{
+		lwerror("ptarray_contains_points called on unclosed ring");
+		return LW_FAILURE;
+	}
+
+	switch ( lw_simd_level() )
+	{
+#ifdef LW_HAVE_X86_SIMD
+	case LW_SIMD_AVX2:
+		done = ordinates_contains_points_avx2(ords, pa->npoints, ndims, pts, npoints, results);
+		break;
+	case LW_SIMD_SSE2:
+		done = ordinates_contains_points_sse2(ords, pa->npoints, ndims, pts, npoints, results);
+		break;
+#endif
+	default:
+		break;
+	}
+
+	/* The points that did not fill a whole register */
+	for ( ; done < npoints; done++ )
+		results[done] = ptarray_contains_point_partial(pa, pts + done, LW_FALSE, NULL);
+
+	return LW_SUCCESS;
+}
@@ -155,3 +155,56 @@ varint_u64_encode_buf(uint64_t val, uint8_t **buf)
   _varint_u64_encode_buf(val, buf);
   return 0;
 }
+
+/**
+ * Read an unsigned varint starting at the_start, never looking at
+ * the_end or beyond. The number of bytes consumed is written to size.
+ */
+uint64_t
+varint_u64_decode(const uint8_t *the_start, const uint8_t *the_end, size_t *size)
+{
+	uint64_t nVal = 0;
+	int nShift = 0;
+	const uint8_t *ptr = the_start;
+
+	/* Each byte carries 7 bits, a uint64 can't take more than 10 of them */
+	while ( ptr < the_end && nShift < 64 )
+	{
+		uint8_t nByte = *ptr++;
+
+		nVal |= ((uint64_t)(nByte & 0x7f)) << nShift;
+
+		/* Hibit is unset, so this is the last byte */
+		if ( ! (nByte & 0x80) )
+		{
+			*size = ptr - the_start;
+			return nVal;
+		}
+		nShift += 7;
+	}
+
+	lwerror("%s: varint extends past end of buffer", __func__);
+	*size = 0;
+	return 0;
+}
+
+int64_t
+varint_s64_decode(const uint8_t *the_start, const uint8_t *the_end, size_t *size)
+{
+	uint64_t q = varint_u64_decode(the_start, the_end, size);
+	return (int64_t)(q >> 1) ^ -(int64_t)(q & 1); /* zig-zag decode */
+}
+
+size_t
+varint_size(const uint8_t *the_start, const uint8_t *the_end)
+{
+	const uint8_t *ptr = the_start;
+
+	while ( ptr < the_end )
+	{
+		/* Hibit is unset, so this is the last byte */
+		if ( ! (*ptr++ & 0x80) )
+			return ptr - the_start;
+	}
+	return 0;
+}
@@ -20,6 +20,7 @@
 #define _LIBLWGEOM_VARINT_H 1
 
 #include <stdint.h>
+#include <stddef.h>
 
 /* Find encoded size for unsigned 32bit integer */
 unsigned varint_u32_encoded_size(uint32_t val);
@@ -45,4 +46,13 @@ unsigned varint_s64_encoded_size(int64_t val);
 /* Encode unsigned 64bit integer */
 int varint_s64_encode_buf(int64_t val, uint8_t **buf);
 
+/* Decode unsigned 64bit integer, reading at most up to the_end */
+uint64_t varint_u64_decode(const uint8_t *the_start, const uint8_t *the_end, size_t *size);
+
+/* Decode signed (zig-zag encoded) 64bit integer, reading at most up to the_end */
+int64_t varint_s64_decode(const uint8_t *the_start, const uint8_t *the_end, size_t *size);
+
+/* Find the number of bytes used by the varint starting at the_start */
+size_t varint_size(const uint8_t *the_start, const uint8_t *the_end);
+
 #endif /* !defined _LIBLWGEOM_VARINT_H  */
\ No newline at end of file
@@ -14,6 +14,7 @@
 #include "access/gist.h"    /* For GiST */
 #include "access/itup.h"
 #include "access/skey.h"
+#include "access/tuptoaster.h"  /* For VARATT_EXTERNAL_IS_COMPRESSED */
 
 #include "../postgis_config.h"
 
@@ -49,14 +50,68 @@ char* gidx_to_string(GIDX *a)
 #endif
 
 
-static uint8_t
-gserialized_datum_get_flags(Datum gsdatum)
+/*
+* Only an out-of-line, uncompressed datum can be read in part: a slice
+* of a compressed one decompresses all of it first.
+*/
+static bool
+gserialized_datum_is_sliceable(Datum gsdatum)
+{
+	struct varlena *attr = (struct varlena *) DatumGetPointer(gsdatum);
+	struct varatt_external toast_pointer;
+
+#if POSTGIS_PGSQL_VERSION >= 94
+	if ( ! VARATT_IS_EXTERNAL_ONDISK(attr) )
+#else
+	if ( ! VARATT_IS_EXTERNAL(attr) )
+#endif
+		return false;
+
+	VARATT_EXTERNAL_GET_POINTER(toast_pointer, attr);
+	return ! VARATT_EXTERNAL_IS_COMPRESSED(toast_pointer);
+}
+
+/**
+* Detoast no more of a #GSERIALIZED datum than its head: the header, the
+* largest cached box and the type and count of the top level geometry.
+* Any other datum is detoasted in full, once.
+*/
+GSERIALIZED*
+gserialized_datum_get_head(Datum gsdatum)
 {
-	GSERIALIZED *gpart;
 	POSTGIS_DEBUG(4, "entered function");
-	gpart = (GSERIALIZED*)PG_DETOAST_DATUM_SLICE(gsdatum, 0, 40);
-	POSTGIS_DEBUGF(4, "got flags %d", gpart->flags);
-	return gpart->flags;
+
+	if ( gserialized_datum_is_sliceable(gsdatum) )
+		return (GSERIALIZED*)PG_DETOAST_DATUM_SLICE(gsdatum, 0, GSERIALIZED_HEAD_SIZE);
+
+	return (GSERIALIZED*)PG_DETOAST_DATUM(gsdatum);
+}
+
+/**
+* The whole of a #GSERIALIZED datum, given the head read from it by
+* gserialized_datum_get_head, which is reused when it already is whole.
+*/
+GSERIALIZED*
+gserialized_datum_get_full(Datum gsdatum, GSERIALIZED *head)
+{
+	if ( gserialized_datum_is_sliceable(gsdatum) )
+		return (GSERIALIZED*)PG_DETOAST_DATUM(gsdatum);
+
+	return head;
+}
+
+/**
+* Read the gbox of a #GSERIALIZED datum from its head, as returned by
+* gserialized_datum_get_head. Objects without a cached box are small
+* enough to read the box from the whole datum instead.
+*/
+int
+gserialized_head_get_gbox_p(Datum gsdatum, const GSERIALIZED *head, GBOX *gbox)
+{
+	if ( gserialized_has_bbox(head) )
+		return gserialized_get_gbox_p(head, gbox);
+
+	return gserialized_get_gbox_p(gserialized_datum_get_full(gsdatum, (GSERIALIZED*)head), gbox);
 }
 
 /**
@@ -69,16 +124,7 @@ gserialized_datum_get_flags(Datum gsdatum)
 int 
 gserialized_datum_get_gbox_p(Datum gsdatum, GBOX *gbox)
 {
-	char gboxmem[GIDX_MAX_SIZE];
-	GIDX *gidx = (GIDX*)gboxmem;
-	
-	if( LW_FAILURE == gserialized_datum_get_gidx_p(gsdatum, gidx) )
-		return LW_FAILURE;
-		
-	gbox_from_gidx(gidx, gbox);
-	gbox->flags = gserialized_datum_get_flags(gsdatum);
-	
-	return LW_SUCCESS;
+	return gserialized_head_get_gbox_p(gsdatum, gserialized_datum_get_head(gsdatum), gbox);
 }
 
 
@@ -102,3 +102,14 @@ GSERIALIZED* gserialized_drop_gidx(GSERIALIZED *g);
 
 
 
+
+/*********************************************************************************
+** BRIN inclusion summaries.
+**
+** The inclusion operator classes keep three values for each page range,
+** in this order. The numbers are private to access/brin/brin_inclusion.c,
+** so they are repeated here for our own add_value functions.
+*/
+#define INCLUSION_UNION 0
+#define INCLUSION_UNMERGEABLE 1
+#define INCLUSION_CONTAINS_EMPTY 2
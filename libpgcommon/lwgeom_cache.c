@@ -12,9 +12,12 @@
 
 #include "postgres.h"
 #include "fmgr.h"
+#include "nodes/primnodes.h"
 
 #include "../postgis_config.h"
 #include "lwgeom_cache.h"
+#include "lwgeom_shared_cache.h"
+#include <math.h>
 
 /* 
 * Generic statement caching infrastructure. We cache 
@@ -47,6 +50,60 @@ typedef struct {
 	GenericCache* entry[NUM_CACHE_ENTRIES];
 } GenericCacheCollection;
 
+/*
+* The geometry slots hold a small LRU of keys rather than a
+* single one, so that an inner loop over a handful of geometries
+* (a nested loop join against a small table) keeps all their
+* indexes instead of rebuilding one on every row.
+*/
+typedef struct {
+	int type;
+	int size;          /* Maximum number of keys */
+	int count;         /* Keys in use */
+	size_t memory;     /* Bytes of key copied */
+	uint32 clock;      /* Ticks on every lookup */
+	int64 keys;        /* Keys ever inserted, and */
+	int64 hits;        /* lookups that found one, for the mean run length */
+	GeomCache** entries;
+} GeomCacheLRU;
+
+/* Size of newly created PROJ4 portal caches, set by the postgis.proj_cache_size GUC */
+int proj4_cache_size = PROJ4_CACHE_ITEMS;
+
+/* Keys per geometry cache slot, set by the postgis.geom_cache_size GUC */
+int geom_cache_size = GEOM_CACHE_ITEMS;
+
+/* kB of keys per geometry cache slot, set by the postgis.geom_cache_memory GUC */
+int geom_cache_memory = GEOM_CACHE_MEMORY;
+
+/* Hits before an index is built, 0 for adaptive; set by the postgis.geom_cache_build_hits GUC */
+int geom_cache_build_hits = GEOM_CACHE_BUILD_HITS;
+
+/* Backend-wide counters for postgis_geom_cache_stats() */
+static GeomCacheStats GeomStats = { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 };
+
+/*
+* Keys of up to this many vertices are cheap to index, and get
+* their index the first time they repeat.
+*/
+#define GEOM_CACHE_CHEAP_VERTICES 1024
+
+/*
+* Keys larger than GEOM_CACHE_FULL_COMPARE are compared on 
+* GEOM_CACHE_SAMPLES evenly spaced blocks, from the header to 
+* the tail, smaller ones in full.
+*/
+#define GEOM_CACHE_SAMPLE_BLOCK 64
+#define GEOM_CACHE_SAMPLES 32
+#define GEOM_CACHE_FULL_COMPARE (GEOM_CACHE_SAMPLE_BLOCK * GEOM_CACHE_SAMPLES)
+
+/* Out-of-line values: on-disk TOAST pointers only, not indirect/expanded ones */
+#ifdef VARATT_IS_EXTERNAL_ONDISK
+#define GEOM_CACHE_IS_TOASTED(ptr) VARATT_IS_EXTERNAL_ONDISK(ptr)
+#else
+#define GEOM_CACHE_IS_TOASTED(ptr) VARATT_IS_EXTERNAL(ptr)
+#endif
+
 /**
 * Utility function to read the upper memory context off a function call 
 * info data.
@@ -94,17 +151,26 @@ GetPROJ4SRSCache(FunctionCallInfoData* fcinfo)
 		if (cache)
 		{
 			int i;
+			int size = proj4_cache_size;
+
+			if ( size < PROJ4_CACHE_ITEMS_MIN )
+				size = PROJ4_CACHE_ITEMS_MIN;
+
+			POSTGIS_DEBUGF(3, "Allocating PROJ4Cache of %d items for portal with transform() MemoryContext %p", size, FIContext(fcinfo));
+			cache->PROJ4SRSCache = MemoryContextAlloc(FIContext(fcinfo), size * sizeof(PROJ4SRSCacheItem));
 
-			POSTGIS_DEBUGF(3, "Allocating PROJ4Cache for portal with transform() MemoryContext %p", FIContext(fcinfo));
 			/* Put in any required defaults */
-			for (i = 0; i < PROJ4_CACHE_ITEMS; i++)
+			for (i = 0; i < size; i++)
 			{
 				cache->PROJ4SRSCache[i].srid = SRID_UNKNOWN;
 				cache->PROJ4SRSCache[i].projection = NULL;
 				cache->PROJ4SRSCache[i].projection_mcxt = NULL;
+				cache->PROJ4SRSCache[i].lastused = 0;
 			}
 			cache->type = PROJ_CACHE_ENTRY;
+			cache->PROJ4SRSCacheSize = size;
 			cache->PROJ4SRSCacheCount = 0;
+			cache->PROJ4SRSCacheClock = 0;
 			cache->PROJ4SRSCacheContext = FIContext(fcinfo);
 
 			/* Store the pointer in GenericCache */
@@ -114,114 +180,693 @@ GetPROJ4SRSCache(FunctionCallInfoData* fcinfo)
 	return cache;
 }
 
+/**
+* Get the LRU for a geometry cache slot, allocating it (in the
+* upper context) the first time through.
+*/
+static GeomCacheLRU*
+GetGeomCacheLRU(FunctionCallInfoData* fcinfo, int entry_number)
+{
+	GenericCacheCollection* generic_cache = GetGenericCacheCollection(fcinfo);
+	GeomCacheLRU* lru = (GeomCacheLRU*)(generic_cache->entry[entry_number]);
+
+	if ( ! lru )
+	{
+		int size = geom_cache_size;
+
+		if ( size < GEOM_CACHE_ITEMS_MIN )
+			size = GEOM_CACHE_ITEMS_MIN;
+
+		POSTGIS_DEBUGF(3, "Allocating GeomCacheLRU of %d items for slot %d", size, entry_number);
+		lru = MemoryContextAllocZero(FIContext(fcinfo), sizeof(GeomCacheLRU));
+		lru->entries = MemoryContextAllocZero(FIContext(fcinfo), size * sizeof(GeomCache*));
+		lru->type = entry_number;
+		lru->size = size;
+		generic_cache->entry[entry_number] = (GenericCache*)lru;
+	}
+	return lru;
+}
+
+/**
+* 64-bit hash of a buffer. Eight independent lanes keep the 
+* multiplies from serializing, so this runs close to memory 
+* speed on large keys.
+*/
+static uint64
+GeomCacheHashBytes(const uint8* p, size_t size)
+{
+	const uint64 k = UINT64CONST(0x9E3779B97F4A7C15);
+	uint64 h[8], w[8];
+	size_t i = 0;
+	int j;
+
+	for ( j = 0; j < 8; j++ )
+		h[j] = size + j;
+
+	for ( ; i + sizeof(w) <= size; i += sizeof(w) )
+	{
+		memcpy(w, p + i, sizeof(w));
+		for ( j = 0; j < 8; j++ )
+		{
+			h[j] = (h[j] ^ w[j]) * k;
+			h[j] ^= h[j] >> 29;
+		}
+	}
+	/* Tail, zero padded */
+	if ( i < size )
+	{
+		memset(w, 0, sizeof(w));
+		memcpy(w, p + i, size - i);
+		for ( j = 0; j < 8; j++ )
+		{
+			h[j] = (h[j] ^ w[j]) * k;
+			h[j] ^= h[j] >> 29;
+		}
+	}
+	for ( j = 1; j < 8; j++ )
+	{
+		h[0] = (h[0] ^ (h[j] >> 31) ^ h[j]) * k;
+		h[0] ^= h[0] >> 32;
+	}
+	return h[0];
+}
+
+/**
+* Offset of sample block i of a key of the given size. Sample 0
+* covers the header and bounding box, the last one the tail.
+*/
+static size_t
+GeomCacheSampleOffset(size_t size, int i)
+{
+	if ( i == GEOM_CACHE_SAMPLES - 1 )
+		return size - GEOM_CACHE_SAMPLE_BLOCK;
+	return i * ((size - GEOM_CACHE_SAMPLE_BLOCK) / (GEOM_CACHE_SAMPLES - 1));
+}
+
+/**
+* Hash of the sample blocks only, for keys too big to hash in
+* full. Short keys are hashed in full.
+*/
+static uint64
+GeomCacheSampleHash(const GSERIALIZED* geom, size_t size)
+{
+	uint8 buf[GEOM_CACHE_FULL_COMPARE];
+	int i;
+
+	if ( size <= GEOM_CACHE_FULL_COMPARE )
+		return GeomCacheHashBytes((const uint8*)geom, size);
+
+	for ( i = 0; i < GEOM_CACHE_SAMPLES; i++ )
+		memcpy(buf + i * GEOM_CACHE_SAMPLE_BLOCK, (const uint8*)geom + GeomCacheSampleOffset(size, i), GEOM_CACHE_SAMPLE_BLOCK);
+	return GeomCacheHashBytes(buf, sizeof(buf)) ^ size;
+}
+
+/**
+* Confirm a hash match by comparing the sample blocks. Short 
+* keys are compared in full.
+*/
+static int
+GeomCacheSampleEqual(const GSERIALIZED* key, const GSERIALIZED* geom, size_t size)
+{
+	const uint8* a = (const uint8*)key;
+	const uint8* b = (const uint8*)geom;
+	int i;
+
+	if ( size <= GEOM_CACHE_FULL_COMPARE )
+		return memcmp(a, b, size) == 0;
+
+	for ( i = 0; i < GEOM_CACHE_SAMPLES; i++ )
+	{
+		size_t off = GeomCacheSampleOffset(size, i);
+		if ( memcmp(a + off, b + off, GEOM_CACHE_SAMPLE_BLOCK) )
+			return LW_FALSE;
+	}
+	return LW_TRUE;
+}
+
+/*
+* An argument being looked up by value. Its hashes are only
+* computed if an entry of the same size turns up.
+*/
+typedef struct {
+	const GSERIALIZED* geom;
+	size_t size;
+	uint64 hash;
+	uint64 sample;
+	int has_hash;
+	int has_sample;
+} GeomCacheProbe;
+
+static void
+GeomCacheProbeInit(GeomCacheProbe* probe, const GSERIALIZED* geom)
+{
+	memset(probe, 0, sizeof(GeomCacheProbe));
+	probe->geom = geom;
+	probe->size = geom ? VARSIZE(geom) : 0;
+}
+
+static uint64
+GeomCacheProbeHash(GeomCacheProbe* probe)
+{
+	if ( ! probe->has_hash )
+	{
+		probe->hash = GeomCacheHashBytes((const uint8*)probe->geom, probe->size);
+		probe->has_hash = LW_TRUE;
+	}
+	return probe->hash;
+}
+
+static uint64
+GeomCacheProbeSample(GeomCacheProbe* probe)
+{
+	if ( ! probe->has_sample )
+	{
+		probe->sample = GeomCacheSampleHash(probe->geom, probe->size);
+		probe->has_sample = LW_TRUE;
+	}
+	return probe->sample;
+}
+
+/**
+* Whether argument argno of the call is a Const node. Its datum
+* then sits in the plan and keeps both its address and its value
+* for as long as the call site lives. Parameters are stable too,
+* but a plpgsql variable can get a new value at the same address.
+*/
+static int
+GeomCacheArgIsConst(FmgrInfo* flinfo, int argno)
+{
+	Node* expr;
+	List* args;
+
+	if ( ! flinfo || ! flinfo->fn_expr )
+		return LW_FALSE;
+
+	expr = flinfo->fn_expr;
+	if ( IsA(expr, FuncExpr) )
+		args = ((FuncExpr*)expr)->args;
+	else if ( IsA(expr, OpExpr) )
+		args = ((OpExpr*)expr)->args;
+	else
+		return LW_FALSE;
+
+	if ( argno < 0 || argno >= list_length(args) )
+		return LW_FALSE;
+
+	return IsA(list_nth(args, argno), Const);
+}
+
+/**
+* Read the cheap identity of argument argno, if it has one.
+* Returns LW_FALSE when the key can only be recognised by value.
+*/
+static int
+GeomCacheArgIdent(FunctionCallInfoData* fcinfo, int argno, GeomCacheIdent* ident)
+{
+	Pointer ptr;
+
+	memset(ident, 0, sizeof(GeomCacheIdent));
+
+	if ( argno >= fcinfo->nargs || fcinfo->argnull[argno] )
+		return LW_FALSE;
+
+	ptr = DatumGetPointer(fcinfo->arg[argno]);
+	if ( GEOM_CACHE_IS_TOASTED(ptr) )
+	{
+		/* The TOAST value id names the value for as long as we can see it */
+		struct varatt_external toast;
+		memcpy(&toast, VARDATA_EXTERNAL(ptr), sizeof(toast));
+		ident->toastrelid = toast.va_toastrelid;
+		ident->toastvalueid = toast.va_valueid;
+		return LW_TRUE;
+	}
+	if ( GeomCacheArgIsConst(fcinfo->flinfo, argno) )
+	{
+		/* Constants don't move or change during the query */
+		ident->constptr = ptr;
+		return LW_TRUE;
+	}
+	return LW_FALSE;
+}
+
+static int
+GeomCacheIdentEqual(const GeomCacheIdent* a, const GeomCacheIdent* b)
+{
+	if ( a->constptr )
+		return a->constptr == b->constptr;
+	return a->toastvalueid &&
+	       a->toastvalueid == b->toastvalueid &&
+	       a->toastrelid == b->toastrelid;
+}
+
+/**
+* Find the cache entry for an argument by its identity.
+*/
+static GeomCache*
+GeomCacheFindIdent(const GeomCacheLRU* lru, const GeomCacheIdent* ident)
+{
+	int i;
+	for ( i = 0; i < lru->count; i++ )
+	{
+		GeomCache* cache = lru->entries[i];
+		if ( GeomCacheIdentEqual(ident, &(cache->ident)) )
+			return cache;
+	}
+	return NULL;
+}
+
+/**
+* Find the cache entry for an argument by its value. Indexed
+* entries hold a copy of their key, and match on the full hash
+* confirmed by the sample blocks. Entries seen only once match 
+* on the sample hash alone, which is safe because their index 
+* gets built from the argument itself.
+*/
+static GeomCache*
+GeomCacheFindValue(const GeomCacheLRU* lru, GeomCacheProbe* probe)
+{
+	int i;
+	for ( i = 0; i < lru->count; i++ )
+	{
+		GeomCache* cache = lru->entries[i];
+		if ( cache->key_size != probe->size )
+			continue;
+		if ( cache->key )
+		{
+			if ( cache->hash == GeomCacheProbeHash(probe) &&
+			     GeomCacheSampleEqual(cache->key, probe->geom, probe->size) )
+				return cache;
+		}
+		else if ( cache->hash == GeomCacheProbeSample(probe) )
+		{
+			return cache;
+		}
+	}
+	return NULL;
+}
+
+/**
+* Estimated cost of building the index for a key, in lookups 
+* answered without it. Small keys cost about one lookup; beyond
+* GEOM_CACHE_CHEAP_VERTICES the build (sorting edges, building 
+* trees) outgrows a linear scan by a log factor.
+*/
+static double
+GeomCacheBuildCost(const GSERIALIZED* geom, size_t size)
+{
+	double vertices = (double)size / (FLAGS_NDIMS(geom->flags) * sizeof(double));
+
+	if ( vertices <= GEOM_CACHE_CHEAP_VERTICES )
+		return 1.0;
+	return 1.0 + log2(vertices / GEOM_CACHE_CHEAP_VERTICES) / 2.0;
+}
+
+/**
+* Number of hits a key needs before its index gets built.
+*
+* Unless postgis.geom_cache_build_hits fixes it, this is the 
+* ski rental rule: wait until the key has been looked up as
+* many times as the build would cost, so a key that stops 
+* repeating never costs more than twice what it would have 
+* without an index. When keys in this slot have so far been 
+* hit at least twice that many times each on average, waiting
+* only delays the payoff, and the index is built on the first 
+* repeat.
+*/
+static uint32
+GeomCacheBuildHits(const GeomCacheLRU* lru, const GSERIALIZED* geom, size_t size)
+{
+	double cost;
+
+	if ( geom_cache_build_hits > 0 )
+		return geom_cache_build_hits;
+
+	cost = GeomCacheBuildCost(geom, size);
+	if ( lru->keys && (double)lru->hits / lru->keys >= 2.0 * cost )
+		return 1;
+	return (uint32)ceil(cost);
+}
+
+/**
+* Whether the index of a key is looked for among, and published to,
+* the indexes shared between backends. Small keys are quicker to
+* index than to look up there.
+*/
+static int
+GeomCacheShared(const GeomCacheMethods* cache_methods, const GSERIALIZED* geom, size_t size)
+{
+	return cache_methods->GeomIndexAttacher && GeomSharedCacheEnabled() &&
+	       GeomCacheBuildCost(geom, size) > 1.0;
+}
+
+/**
+* Drop entry i from the LRU: free its index and key, and move
+* the entry object to the unused tail of the array so it can be
+* recycled, keeping whatever per-object state the allocator set up.
+*/
+static void
+GeomCacheEvict(GeomCacheLRU* lru, const GeomCacheMethods* cache_methods, int i)
+{
+	GeomCache* cache = lru->entries[i];
+
+	/* Indexes may point into the key, so free them first */
+	if ( cache->argnum )
+	{
+		if ( cache->uses < GeomCacheBuildCost(cache->key, cache->key_size) )
+			GeomStats.wasted++;
+		cache_methods->GeomIndexFreer(cache);
+		cache->argnum = 0;
+	}
+	if ( cache->key )
+	{
+		lru->memory -= cache->key_size;
+		pfree(cache->key);
+		cache->key = NULL;
+	}
+	cache->key_size = 0;
+	memset(&(cache->ident), 0, sizeof(GeomCacheIdent));
+
+	lru->count--;
+	lru->entries[i] = lru->entries[lru->count];
+	lru->entries[lru->count] = cache;
+	GeomStats.evictions++;
+}
+
+/**
+* Index of the least recently used entry other than keep, 
+* optionally only among the entries that have no index built 
+* yet. -1 if there is none.
+*/
+static int
+GeomCacheOldest(const GeomCacheLRU* lru, const GeomCache* keep, int unindexed_only)
+{
+	int i, oldest = -1;
+	for ( i = 0; i < lru->count; i++ )
+	{
+		const GeomCache* cache = lru->entries[i];
+		if ( cache == keep || (unindexed_only && cache->argnum) )
+			continue;
+		/* Clock differences stay right across wraparound */
+		if ( oldest < 0 || (int32)(cache->lastused - lru->entries[oldest]->lastused) < 0 )
+			oldest = i;
+	}
+	return oldest;
+}
+
+/**
+* Remember a new, not yet indexed, entry for an argument. Only
+* its size, sample hash and identity are kept; the value is 
+* copied when the entry is seen again and gets an index.
+*
+* A scan of one-off geometries should not push out the indexed 
+* ones, so the unindexed entries are limited to a quarter of the 
+* slot and replace each other first.
+*/
+static void
+GeomCacheInsert(FunctionCallInfoData* fcinfo, GeomCacheLRU* lru, const GeomCacheMethods* cache_methods, GeomCacheProbe* probe, const GeomCacheIdent* ident)
+{
+	GeomCache* cache;
+	int i, unindexed = 0;
+
+	/* Never worth keeping */
+	if ( probe->size > (size_t)geom_cache_memory * 1024 )
+		return;
+
+	for ( i = 0; i < lru->count; i++ )
+		if ( ! lru->entries[i]->argnum )
+			unindexed++;
+
+	if ( unindexed >= Max(1, lru->size / 4) )
+		GeomCacheEvict(lru, cache_methods, GeomCacheOldest(lru, NULL, LW_TRUE));
+
+	if ( lru->count >= lru->size )
+		GeomCacheEvict(lru, cache_methods, GeomCacheOldest(lru, NULL, LW_FALSE));
+
+	cache = lru->entries[lru->count];
+	if ( ! cache )
+	{
+		MemoryContext old_context = MemoryContextSwitchTo(FIContext(fcinfo));
+		/* Allocate in the upper context */
+		cache = cache_methods->GeomCacheAllocator();
+		MemoryContextSwitchTo(old_context);
+		cache->type = lru->type;
+		lru->entries[lru->count] = cache;
+	}
+
+	cache->key = NULL;
+	cache->key_size = probe->size;
+	cache->hash = GeomCacheProbeSample(probe);
+	cache->ident = *ident;
+	cache->lastused = lru->clock;
+	cache->hits = 0;
+	cache->uses = 0;
+	cache->argnum = 0;
+
+	lru->count++;
+	lru->keys++;
+}
+
+/**
+* Copy the value of an entry that is about to be indexed,
+* making room under postgis.geom_cache_memory first. From 
+* here on the entry is matched on its full hash.
+*/
+static void
+GeomCacheCopyKey(FunctionCallInfoData* fcinfo, GeomCacheLRU* lru, const GeomCacheMethods* cache_methods, GeomCache* cache, GeomCacheProbe* probe)
+{
+	size_t memory = (size_t)geom_cache_memory * 1024;
+	int oldest;
+
+	while ( lru->memory + cache->key_size > memory &&
+	        (oldest = GeomCacheOldest(lru, cache, LW_FALSE)) >= 0 )
+	{
+		GeomCacheEvict(lru, cache_methods, oldest);
+	}
+
+	cache->key = MemoryContextAlloc(FIContext(fcinfo), cache->key_size);
+	memcpy(cache->key, probe->geom, cache->key_size);
+	cache->hash = GeomCacheProbeHash(probe);
+	lru->memory += cache->key_size;
+	GeomStats.copied += cache->key_size;
+}
+
 /**
 * Get an appropriate (based on the entry type number) 
 * GeomCache entry from the generic cache if one exists.
 * Returns a cache pointer if there is a cache hit and we have an
 * index built and ready to use. Returns NULL otherwise.
+*
+* g1 and g2 must be the (detoasted) values of the first and 
+* second argument of the calling function, or NULL. They are
+* first looked up by the identity of the argument datums, which
+* costs nothing, then by hash.
+*
+* Each slot keeps the last postgis.geom_cache_size distinct 
+* arguments it has seen. The index for a key is built once
+* the key has turned up again often enough to pay for it (see
+* GeomCacheBuildHits), and argnum on the returned entry says 
+* which argument (1 or 2) it was found as. Indexes of large keys
+* are taken from, or published to, the indexes shared between
+* backends when the slot type supports it (lwgeom_shared_cache.h).
+* Keys whose index is published already (ST_AddIndexTree) get it
+* attached on their first repeat.
 */
 GeomCache*            
 GetGeomCache(FunctionCallInfoData* fcinfo, const GeomCacheMethods* cache_methods, const GSERIALIZED* g1, const GSERIALIZED* g2)
 {
-	GeomCache* cache;
+	GeomCache* cache = NULL;
+	GeomCacheLRU* lru;
 	int cache_hit = 0;
-	MemoryContext old_context;
-	const GSERIALIZED *geom;
-	GenericCacheCollection* generic_cache = GetGenericCacheCollection(fcinfo);
+	GeomCacheProbe probe1, probe2;
+	GeomCacheProbe* probe;
+	GeomCacheIdent ident1, ident2;
+	int has_ident1 = LW_FALSE, has_ident2 = LW_FALSE;
 	int entry_number = cache_methods->entry_number;
+	int published = LW_FALSE;
+	size_t published_size;
 	
 	Assert(entry_number >= 0);
 	Assert(entry_number < NUM_CACHE_ENTRIES);
 	
-	cache = (GeomCache*)(generic_cache->entry[entry_number]);
-	
-	if ( ! cache )
-	{
-		old_context = MemoryContextSwitchTo(FIContext(fcinfo));
-		/* Allocate in the upper context */
-		cache = cache_methods->GeomCacheAllocator();
-		MemoryContextSwitchTo(old_context);
-		/* Store the pointer in GenericCache */
-		cache->type = entry_number;
-		generic_cache->entry[entry_number] = (GenericCache*)cache;
-	}	
+	lru = GetGeomCacheLRU(fcinfo, entry_number);
+	lru->clock++;
 
-	/* Cache hit on the first argument */
-	if ( g1 &&
-	     cache->argnum != 2 &&
-	     cache->geom1_size == VARSIZE(g1) &&
-	     memcmp(cache->geom1, g1, cache->geom1_size) == 0 )
-	{
+	GeomCacheProbeInit(&probe1, g1);
+	GeomCacheProbeInit(&probe2, g2);
+	if ( g1 )
+		has_ident1 = GeomCacheArgIdent(fcinfo, 0, &ident1);
+	if ( g2 )
+		has_ident2 = GeomCacheArgIdent(fcinfo, 1, &ident2);
+
+	/* Cache hit on the identity of either argument */
+	if ( has_ident1 && (cache = GeomCacheFindIdent(lru, &ident1)) )
 		cache_hit = 1;
-		geom = cache->geom1;
+	else if ( has_ident2 && (cache = GeomCacheFindIdent(lru, &ident2)) )
+		cache_hit = 2;
+	/* Cache hit on the value of the first argument */
+	else if ( g1 && (cache = GeomCacheFindValue(lru, &probe1)) )
+		cache_hit = 1;
+	/* Cache hit on the value of the second argument */
+	else if ( g2 && (cache = GeomCacheFindValue(lru, &probe2)) )
+		cache_hit = 2;
 
-	}
-	/* Cache hit on second argument */
-	else if ( g2 &&
-	          cache->argnum != 1 &&
-	          cache->geom2_size == VARSIZE(g2) &&
-	          memcmp(cache->geom2, g2, cache->geom2_size) == 0 )
+	/* No cache hit, remember the arguments for next time */
+	if ( ! cache_hit )
 	{
-		cache_hit = 2;
-		geom = cache->geom2;
+		GeomStats.misses++;
+		if ( g1 )
+			GeomCacheInsert(fcinfo, lru, cache_methods, &probe1, &ident1);
+		if ( g2 && ! (g1 && probe1.size == probe2.size && GeomCacheProbeSample(&probe1) == GeomCacheProbeSample(&probe2)) )
+			GeomCacheInsert(fcinfo, lru, cache_methods, &probe2, &ident2);
+		return NULL;
 	}
-	/* No cache hit. If we have a tree, free it. */
+
+	probe = (cache_hit == 1) ? &probe1 : &probe2;
+	if ( probe->has_hash || probe->has_sample )
+		GeomStats.hash_hits++;
 	else
+		GeomStats.ident_hits++;
+
+	/* Next time, find this key by identity */
+	if ( cache_hit == 1 && has_ident1 )
+		cache->ident = ident1;
+	else if ( cache_hit == 2 && has_ident2 )
+		cache->ident = ident2;
+	cache->lastused = lru->clock;
+	cache->hits++;
+	lru->hits++;
+
+	/* A key whose index is published costs nothing to index */
+	if ( ! cache->argnum && cache->hits == 1 && GeomCacheShared(cache_methods, probe->geom, probe->size) )
+		published = GeomSharedCacheLookup(entry_number, probe->geom, probe->size, GeomCacheProbeHash(probe), &published_size) != NULL;
+
+	/* Cache hit, but the index isn't worth building yet */
+	if ( ! cache->argnum && ! published && cache->hits < GeomCacheBuildHits(lru, probe->geom, probe->size) )
 	{
-		cache_hit = 0;
-		if ( cache->argnum )
-		{
-			cache_methods->GeomIndexFreer(cache);
-			cache->argnum = 0;
-		}
+		GeomStats.deferred++;
+		return NULL;
 	}
 
 	/* Cache hit, but no tree built yet, build it! */
-	if ( cache_hit && ! cache->argnum )
+	if ( ! cache->argnum )
 	{
-		int rv;
-		LWGEOM *lwgeom = lwgeom_from_gserialized(geom);
+		int rv, shared;
+		MemoryContext old_context;
+		LWGEOM *lwgeom;
+
+		if ( ! cache->key )
+			GeomCacheCopyKey(fcinfo, lru, cache_methods, cache, probe);
+		lwgeom = lwgeom_from_gserialized(cache->key);
 
 		/* Can't build a tree on a NULL or empty */
 		if ( (!lwgeom) || lwgeom_is_empty(lwgeom) )
 			return NULL;
 
 		old_context = MemoryContextSwitchTo(FIContext(fcinfo));
-		rv = cache_methods->GeomIndexBuilder(lwgeom, cache);
-		MemoryContextSwitchTo(old_context);
-		cache->argnum = cache_hit;
+		rv = LW_FAILURE;
+		shared = GeomCacheShared(cache_methods, cache->key, cache->key_size);
+
+		/* Another backend may have built this one already */
+		if ( shared )
+		{
+			size_t size;
+			const void* buf = GeomSharedCacheLookup(entry_number, cache->key, cache->key_size, cache->hash, &size);
+			if ( buf && (rv = cache_methods->GeomIndexAttacher(lwgeom, cache, buf, size)) )
+				GeomStats.shared_hits++;
+		}
 
-		/* Something went awry in the tree build phase */
 		if ( ! rv )
 		{
-			cache->argnum = 0;
-			return NULL;
+			rv = cache_methods->GeomIndexBuilder(lwgeom, cache);
+			if ( rv )
+				GeomStats.builds++;
+
+			/* Let the other backends have it */
+			if ( rv && shared )
+			{
+				size_t size;
+				void* buf = cache_methods->GeomIndexFlattener(cache, &size);
+				if ( buf )
+				{
+					if ( GeomSharedCachePublish(entry_number, cache->key, cache->key_size, cache->hash, buf, size) )
+						GeomStats.published++;
+					lwfree(buf);
+				}
+			}
 		}
+		MemoryContextSwitchTo(old_context);
 
+		/* Something went awry in the tree build phase */
+		if ( ! rv )
+			return NULL;
 	}
 
 	/* We have a hit and a calculated tree, we're done */
-	if ( cache_hit && cache->argnum )
-		return cache;
+	cache->argnum = cache_hit;
+	cache->uses++;
+	return cache;
+}
+
+/**
+* Build the index of geom with the methods of a slot type and
+* publish it to the indexes shared between backends, so that 
+* cached calls in any backend attach it on the first repeat of
+* geom instead of building their own (ST_AddIndexTree). Returns
+* LW_TRUE if the index is published, now or before.
+*/
+int
+GeomCachePublishIndex(const GeomCacheMethods* cache_methods, const GSERIALIZED* geom)
+{
+	size_t size = VARSIZE(geom);
+	size_t index_size;
+	uint64 hash;
+	LWGEOM* lwgeom;
+	GeomCache* cache;
+	void* buf = NULL;
+	int rv = LW_FALSE;
+
+	if ( ! cache_methods->GeomIndexFlattener || ! GeomCacheShared(cache_methods, geom, size) )
+		return LW_FALSE;
+
+	hash = GeomCacheHashBytes((const uint8*)geom, size);
+	if ( GeomSharedCacheLookup(cache_methods->entry_number, geom, size, hash, &index_size) )
+		return LW_TRUE;
 
-	/* Argument one didn't match, so copy the new value in. */
-	if ( g1 && cache_hit != 1 )
+	lwgeom = lwgeom_from_gserialized(geom);
+	if ( lwgeom_is_empty(lwgeom) )
 	{
-		if ( cache->geom1 ) pfree(cache->geom1);
-		cache->geom1_size = VARSIZE(g1);
-		cache->geom1 = MemoryContextAlloc(FIContext(fcinfo), cache->geom1_size);
-		memcpy(cache->geom1, g1, cache->geom1_size);
+		lwgeom_free(lwgeom);
+		return LW_FALSE;
 	}
-	/* Argument two didn't match, so copy the new value in. */
-	if ( g2 && cache_hit != 2 )
+
+	cache = cache_methods->GeomCacheAllocator();
+	if ( cache_methods->GeomIndexBuilder(lwgeom, cache) )
+		buf = cache_methods->GeomIndexFlattener(cache, &index_size);
+	if ( buf )
 	{
-		if ( cache->geom2 ) pfree(cache->geom2);
-		cache->geom2_size = VARSIZE(g2);
-		cache->geom2 = MemoryContextAlloc(FIContext(fcinfo), cache->geom2_size);
-		memcpy(cache->geom2, g2, cache->geom2_size);
+		rv = GeomSharedCachePublish(cache_methods->entry_number, geom, size, hash, buf, index_size);
+		if ( rv )
+			GeomStats.published++;
+		/* Another backend may have published it meanwhile */
+		else
+			rv = GeomSharedCacheLookup(cache_methods->entry_number, geom, size, hash, &index_size) != NULL;
+		lwfree(buf);
 	}
 
-	return NULL;
+	/* The index may point into lwgeom, so free it first */
+	cache_methods->GeomIndexFreer(cache);
+	pfree(cache);
+	lwgeom_free(lwgeom);
+	return rv;
+}
+
+/**
+* Counters accumulated by all the geometry caches of this backend.
+*/
+const GeomCacheStats*
+GetGeomCacheStats(void)
+{
+	return &GeomStats;
 }
 
 
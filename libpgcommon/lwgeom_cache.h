@@ -30,21 +30,62 @@
 #define NUM_CACHE_ENTRIES 16
 
 
+/*
+* Cheap identity of a cache key, when the argument it came
+* from has one: the TOAST pointer of an out-of-line value, or
+* the address of an argument that is a Const in the plan.
+* Either proves the key value without looking at it.
+*/
+typedef struct {
+	Oid                         toastrelid;
+	Oid                         toastvalueid;
+	const void*                 constptr;
+} GeomCacheIdent;
+
 /* 
 * A generic GeomCache just needs space for the cache type,
-* the cache keys (GSERIALIZED geometries), the key sizes, 
-* and the argument number the cached index/tree is going
-* to refer to.
+* the cache key (a GSERIALIZED geometry), the key size, hash
+* and identity, a last-used tick for LRU eviction, hit counts 
+* for the build policy, and the argument number the cached 
+* index/tree is going to refer to. An argnum of zero means no 
+* index has been built for the key yet, and the key itself is 
+* only copied once it is indexed.
 */
 typedef struct {
 	int                         type;
-	GSERIALIZED*                geom1;
-	GSERIALIZED*                geom2;
-	size_t                      geom1_size;
-	size_t                      geom2_size;
+	GSERIALIZED*                key;
+	size_t                      key_size;
+	uint64                      hash;
+	GeomCacheIdent              ident;
+	uint32                      lastused;
+	uint32                      hits;     /* Lookups that found this key */
+	uint32                      uses;     /* Of those, answered by the index */
 	int32                       argnum; 
 } GeomCache;
 
+/*
+* Each geometry cache slot holds up to postgis.geom_cache_size
+* keys, and up to postgis.geom_cache_memory kB of them.
+*/
+#define GEOM_CACHE_ITEMS	32
+#define GEOM_CACHE_ITEMS_MIN	1
+#define GEOM_CACHE_ITEMS_MAX	4096
+#define GEOM_CACHE_MEMORY	32768
+#define GEOM_CACHE_MEMORY_MIN	64
+#define GEOM_CACHE_MEMORY_MAX	(INT_MAX / 1024)
+
+/*
+* Hits a key needs before its index is built, 0 to decide from
+* the size of the key and how often keys repeat (postgis.geom_cache_build_hits)
+*/
+#define GEOM_CACHE_BUILD_HITS	0
+#define GEOM_CACHE_BUILD_HITS_MIN	0
+#define GEOM_CACHE_BUILD_HITS_MAX	1000000
+
+extern int geom_cache_size;
+extern int geom_cache_memory;
+extern int geom_cache_build_hits;
+
 /*
 * Other specific geometry cache types are the 
 * RTreeGeomCache - lwgeom_rtree.h
@@ -66,22 +107,32 @@ typedef struct struct_PROJ4SRSCacheItem
 	int srid;
 	projPJ projection;
 	MemoryContext projection_mcxt;
+	uint32 lastused; /* Portal clock value at last lookup, for LRU eviction */
 }
 PROJ4SRSCacheItem;
 
 /* PROJ 4 lookup transaction cache methods */
-#define PROJ4_CACHE_ITEMS	8
+#define PROJ4_CACHE_ITEMS	16
+#define PROJ4_CACHE_ITEMS_MIN	2
+#define PROJ4_CACHE_ITEMS_MAX	1024
+
+/* Number of entries in new portal caches (postgis.proj_cache_size) */
+extern int proj4_cache_size;
 
 /*
 * The proj4 cache holds a fixed number of reprojection
-* entries. In normal usage we don't expect it to have
-* many entries, so we always linearly scan the list.
+* entries, sized when the portal cache is created. In normal 
+* usage we don't expect it to have many entries, so we always 
+* linearly scan the list. When it fills up, the least recently 
+* used entry is replaced.
 */
 typedef struct struct_PROJ4PortalCache
 {
 	int type;
-	PROJ4SRSCacheItem PROJ4SRSCache[PROJ4_CACHE_ITEMS];
+	PROJ4SRSCacheItem *PROJ4SRSCache;
+	int PROJ4SRSCacheSize;
 	int PROJ4SRSCacheCount;
+	uint32 PROJ4SRSCacheClock;
 	MemoryContext PROJ4SRSCacheContext;
 }
 PROJ4PortalCache;
@@ -96,6 +147,8 @@ typedef struct
 	int (*GeomIndexBuilder)(const LWGEOM* lwgeom, GeomCache* cache); /* Build an index/tree and add it to your cache */
 	int (*GeomIndexFreer)(GeomCache* cache); /* Free the index/tree in your cache */
 	GeomCache* (*GeomCacheAllocator)(void); /* Allocate the kind of cache object you use (GeomCache+some extra space) */
+	void* (*GeomIndexFlattener)(const GeomCache* cache, size_t* size); /* Optional, copy your index into one position-independent buffer */
+	int (*GeomIndexAttacher)(const LWGEOM* lwgeom, GeomCache* cache, const void* buf, size_t size); /* Optional, rebuild your index on such a buffer, which outlives it */
 } GeomCacheMethods;
 
 /* 
@@ -104,4 +157,31 @@ typedef struct
 PROJ4PortalCache*  GetPROJ4SRSCache(FunctionCallInfoData *fcinfo);
 GeomCache*         GetGeomCache(FunctionCallInfoData *fcinfo, const GeomCacheMethods* cache_methods, const GSERIALIZED* g1, const GSERIALIZED* g2);
 
+/**
+* Build the index of a geometry for a slot type and publish it to
+* the indexes shared between backends. LW_FALSE if sharing is off,
+* or the geometry is small enough to index on its first repeat.
+*/
+int                GeomCachePublishIndex(const GeomCacheMethods* cache_methods, const GSERIALIZED* geom);
+
+/**
+* Backend-wide geometry cache counters
+*/
+typedef struct
+{
+	int64 ident_hits; /* Hits proven by TOAST pointer or constant argument */
+	int64 hash_hits;  /* Hits found by hash and sampled comparison */
+	int64 misses;     /* Lookups where neither argument was cached */
+	int64 builds;     /* Indexes built */
+	int64 deferred;   /* Hits that left the build for later */
+	int64 wasted;     /* Indexes evicted before paying for their build */
+	int64 evictions;  /* Keys dropped to make room for another */
+	int64 copied;     /* Bytes of key copied into caches */
+	int64 shared_hits; /* Indexes attached from another backend instead of built */
+	int64 published;  /* Indexes built here and shared with other backends */
+}
+GeomCacheStats;
+
+const GeomCacheStats* GetGeomCacheStats(void);
+
 #endif /* LWGEOM_CACHE_H_ */
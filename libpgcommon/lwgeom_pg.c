@@ -18,6 +18,7 @@
 #include <fmgr.h>
 #include <executor/spi.h>
 #include <miscadmin.h>
+#include <access/xact.h>
 
 #include "../postgis_config.h"
 #include "liblwgeom.h"
@@ -180,11 +181,44 @@ pg_notice(const char *fmt, va_list ap)
 	free(msg);
 }
 
+/*
+* An error raised while an LWARENA is current leaves it current, but its
+* blocks go away with the memory context of the failed call. Switch it
+* out before anything else gets to allocate.
+*/
+static void
+pg_lwarena_xact_callback(XactEvent event, void *arg)
+{
+	if ( event == XACT_EVENT_ABORT )
+		lwarena_switch(NULL);
+}
+
+static void
+pg_lwarena_subxact_callback(SubXactEvent event, SubTransactionId mySubid,
+                            SubTransactionId parentSubid, void *arg)
+{
+	if ( event == SUBXACT_EVENT_ABORT_SUB )
+		lwarena_switch(NULL);
+}
+
 void
 pg_install_lwgeom_handlers(void)
 {
+	static bool callbacks_registered = false;
+
 	/* install PostgreSQL handlers */
 	lwgeom_set_handlers(pg_alloc, pg_realloc, pg_free, pg_error, pg_notice);
+
+	/*
+	* postgis and rtpostgis both call this, and with the modules loaded
+	* globally both calls can land in the same copy, so register once
+	*/
+	if ( ! callbacks_registered )
+	{
+		RegisterXactCallback(pg_lwarena_xact_callback, NULL);
+		RegisterSubXactCallback(pg_lwarena_subxact_callback, NULL);
+		callbacks_registered = true;
+	}
 }
 
 /**
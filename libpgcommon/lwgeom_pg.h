@@ -105,6 +105,41 @@ GSERIALIZED* geography_serialize(LWGEOM *lwgeom);
 */
 int gserialized_datum_get_gbox_p(Datum gsdatum, GBOX *gbox);
 
+/**
+* The most of a #GSERIALIZED we need to read the SRID, flags, cached box,
+* type and count of the top level geometry: 8 bytes of header, 32 bytes of
+* XYZM box, 4 bytes of type and 4 bytes of count.
+*/
+#define GSERIALIZED_HEAD_SIZE 48
+
+/**
+* Detoast only the head of a #GSERIALIZED datum, when it is stored out of
+* line and uncompressed; any other datum is detoasted in full.
+* Only gserialized_get_srid, gserialized_get_type, gserialized_has_bbox,
+* gserialized_is_empty and (when there is a cached box)
+* gserialized_get_gbox_p may be called on the result.
+*
+* Functions that can answer from the SRID, emptiness or bounding box
+* alone run those checks on the heads of their arguments, and call
+* gserialized_datum_get_full only once the checks pass. Large
+* out-of-line geometries rejected by the box test are then never
+* fetched in full, and no datum is detoasted twice.
+*/
+GSERIALIZED* gserialized_datum_get_head(Datum gsdatum);
+
+/**
+* The whole of a #GSERIALIZED datum, reusing the head returned by
+* gserialized_datum_get_head when it already is the whole datum.
+*/
+GSERIALIZED* gserialized_datum_get_full(Datum gsdatum, GSERIALIZED *head);
+
+/**
+* Pull out a gbox bounding box from the head of a #GSERIALIZED datum, as
+* returned by gserialized_datum_get_head. If there is no cached box,
+* calculates box from the full datum. Fails on empty.
+*/
+int gserialized_head_get_gbox_p(Datum gsdatum, const GSERIALIZED *head, GBOX *gbox);
+
 /**
 * Convert cstrings (null-terminated byte array) to textp pointers 
 * (PgSQL varlena structure with VARSIZE header).
@@ -0,0 +1,261 @@
+/**********************************************************************
+ *
+ * PostGIS - Spatial Types for PostgreSQL
+ * http://postgis.net
+ *
+ * This is free software; you can redistribute and/or modify it under
+ * the terms of the GNU General Public Licence. See the COPYING file.
+ *
+ **********************************************************************/
+
+#include "postgres.h"
+#include "miscadmin.h"
+
+#include "../postgis_config.h"
+
+#if POSTGIS_PGSQL_VERSION >= 94
+#include "storage/dsm.h"
+#include "storage/ipc.h"
+#include "storage/lwlock.h"
+#include "storage/shmem.h"
+#include "storage/spin.h"
+#endif
+
+#include "lwgeom_shared_cache.h"
+
+
+/* Published index slots, set by the postgis.geom_cache_shared_entries GUC */
+int geom_shared_cache_entries = GEOM_SHARED_CACHE_ENTRIES;
+
+/* kB of published indexes, set by the postgis.geom_cache_shared_memory GUC */
+int geom_shared_cache_memory = GEOM_SHARED_CACHE_MEMORY;
+
+#if POSTGIS_PGSQL_VERSION >= 94
+
+/*
+* A published index: one segment holding a header, the key
+* it was built on, and the flattened index.
+*/
+#define GEOM_SHARED_CACHE_MAGIC 0x50474943 /* "PGIC" */
+
+typedef struct
+{
+	uint32 magic;
+	int type;
+	uint64 hash;
+	Size key_size;
+	Size index_size;
+} GeomSharedCacheSegment;
+
+#define GEOM_SHARED_CACHE_KEY_OFFSET MAXALIGN(sizeof(GeomSharedCacheSegment))
+#define GEOM_SHARED_CACHE_INDEX_OFFSET(key_size) (GEOM_SHARED_CACHE_KEY_OFFSET + MAXALIGN(key_size))
+
+typedef struct
+{
+	int type;
+	uint64 hash;
+	Size key_size;
+	dsm_handle handle;
+} GeomSharedCacheEntry;
+
+/*
+* The registry only maps keys to segments, and is only looked
+* at when a backend is about to build an index, so a spinlock
+* and a linear scan are enough.
+*/
+typedef struct
+{
+	slock_t mutex;
+	int size;      /* Slots, fixed at startup */
+	int count;     /* Slots in use */
+	Size memory;   /* Bytes of segments published */
+	GeomSharedCacheEntry entries[1];
+} GeomSharedCacheRegistry;
+
+static GeomSharedCacheRegistry* GeomSharedRegistry = NULL;
+static shmem_startup_hook_type prev_shmem_startup_hook = NULL;
+
+static Size
+GeomSharedCacheShmemSize(void)
+{
+	return add_size(offsetof(GeomSharedCacheRegistry, entries),
+	                mul_size(geom_shared_cache_entries, sizeof(GeomSharedCacheEntry)));
+}
+
+static void
+GeomSharedCacheShmemStartup(void)
+{
+	bool found;
+
+	if ( prev_shmem_startup_hook )
+		prev_shmem_startup_hook();
+
+	LWLockAcquire(AddinShmemInitLock, LW_EXCLUSIVE);
+	GeomSharedRegistry = ShmemInitStruct("PostGIS shared geometry indexes", GeomSharedCacheShmemSize(), &found);
+	if ( ! found )
+	{
+		SpinLockInit(&(GeomSharedRegistry->mutex));
+		GeomSharedRegistry->size = geom_shared_cache_entries;
+		GeomSharedRegistry->count = 0;
+		GeomSharedRegistry->memory = 0;
+	}
+	LWLockRelease(AddinShmemInitLock);
+}
+
+/* Registry slot of a key, -1 if absent. Call with the mutex held. */
+static int
+GeomSharedCacheFind(int type, size_t key_size, uint64 hash)
+{
+	int i;
+	for ( i = 0; i < GeomSharedRegistry->count; i++ )
+	{
+		const GeomSharedCacheEntry* entry = &(GeomSharedRegistry->entries[i]);
+		if ( entry->type == type && entry->hash == hash && entry->key_size == key_size )
+			return i;
+	}
+	return -1;
+}
+
+#endif /* POSTGIS_PGSQL_VERSION >= 94 */
+
+void
+GeomSharedCacheInit(void)
+{
+#if POSTGIS_PGSQL_VERSION >= 94
+	if ( ! process_shared_preload_libraries_in_progress || geom_shared_cache_entries <= 0 )
+		return;
+
+	RequestAddinShmemSpace(GeomSharedCacheShmemSize());
+	prev_shmem_startup_hook = shmem_startup_hook;
+	shmem_startup_hook = GeomSharedCacheShmemStartup;
+#endif
+}
+
+int
+GeomSharedCacheEnabled(void)
+{
+#if POSTGIS_PGSQL_VERSION >= 94
+	return GeomSharedRegistry != NULL && GeomSharedRegistry->size > 0;
+#else
+	return LW_FALSE;
+#endif
+}
+
+const void*
+GeomSharedCacheLookup(int type, const GSERIALIZED* key, size_t key_size, uint64 hash, size_t* size)
+{
+#if POSTGIS_PGSQL_VERSION >= 94
+	dsm_handle handle = 0;
+	dsm_segment* seg;
+	const GeomSharedCacheSegment* header;
+	int found;
+
+	if ( ! GeomSharedCacheEnabled() )
+		return NULL;
+
+	SpinLockAcquire(&(GeomSharedRegistry->mutex));
+	found = GeomSharedCacheFind(type, key_size, hash);
+	if ( found >= 0 )
+		handle = GeomSharedRegistry->entries[found].handle;
+	SpinLockRelease(&(GeomSharedRegistry->mutex));
+
+	if ( found < 0 )
+		return NULL;
+
+	/* Segments stay mapped once attached, other call sites may have done it */
+	seg = dsm_find_mapping(handle);
+	if ( ! seg )
+	{
+		seg = dsm_attach(handle);
+		if ( ! seg )
+			return NULL;
+		dsm_pin_mapping(seg);
+	}
+
+	/* Equal hashes are not proof enough between backends, compare the key */
+	header = dsm_segment_address(seg);
+	if ( header->magic != GEOM_SHARED_CACHE_MAGIC || header->type != type || header->key_size != key_size ||
+	     memcmp((const uint8*)header + GEOM_SHARED_CACHE_KEY_OFFSET, key, key_size) != 0 )
+		return NULL;
+
+	*size = header->index_size;
+	return (const uint8*)header + GEOM_SHARED_CACHE_INDEX_OFFSET(key_size);
+#else
+	return NULL;
+#endif
+}
+
+int
+GeomSharedCachePublish(int type, const GSERIALIZED* key, size_t key_size, uint64 hash, const void* index, size_t size)
+{
+#if POSTGIS_PGSQL_VERSION >= 94
+	Size seg_size = GEOM_SHARED_CACHE_INDEX_OFFSET(key_size) + size;
+	Size memory = (Size)geom_shared_cache_memory * 1024;
+	dsm_segment* seg;
+	GeomSharedCacheSegment* header;
+	GeomSharedCacheEntry* entry;
+	int published = LW_FALSE;
+
+	if ( ! GeomSharedCacheEnabled() )
+		return LW_FALSE;
+
+	/* Cheap check for room before building the segment */
+	SpinLockAcquire(&(GeomSharedRegistry->mutex));
+	if ( GeomSharedRegistry->count < GeomSharedRegistry->size &&
+	     GeomSharedRegistry->memory + seg_size <= memory &&
+	     GeomSharedCacheFind(type, key_size, hash) < 0 )
+		published = LW_TRUE;
+	SpinLockRelease(&(GeomSharedRegistry->mutex));
+
+	if ( ! published )
+		return LW_FALSE;
+
+#if POSTGIS_PGSQL_VERSION >= 95
+	seg = dsm_create(seg_size, DSM_CREATE_NULL_IF_MAXSEGMENTS);
+	if ( ! seg )
+		return LW_FALSE;
+#else
+	seg = dsm_create(seg_size);
+#endif
+
+	header = dsm_segment_address(seg);
+	header->magic = GEOM_SHARED_CACHE_MAGIC;
+	header->type = type;
+	header->hash = hash;
+	header->key_size = key_size;
+	header->index_size = size;
+	memcpy((uint8*)header + GEOM_SHARED_CACHE_KEY_OFFSET, key, key_size);
+	memcpy((uint8*)header + GEOM_SHARED_CACHE_INDEX_OFFSET(key_size), index, size);
+
+	/* Check again, someone may have taken the room or published the key meanwhile */
+	published = LW_FALSE;
+	SpinLockAcquire(&(GeomSharedRegistry->mutex));
+	if ( GeomSharedRegistry->count < GeomSharedRegistry->size &&
+	     GeomSharedRegistry->memory + seg_size <= memory &&
+	     GeomSharedCacheFind(type, key_size, hash) < 0 )
+	{
+		entry = &(GeomSharedRegistry->entries[GeomSharedRegistry->count++]);
+		entry->type = type;
+		entry->hash = hash;
+		entry->key_size = key_size;
+		entry->handle = dsm_segment_handle(seg);
+		GeomSharedRegistry->memory += seg_size;
+		published = LW_TRUE;
+	}
+	SpinLockRelease(&(GeomSharedRegistry->mutex));
+
+	/* Keep the segment past our detach, until the server stops */
+	if ( published )
+	{
+#if POSTGIS_PGSQL_VERSION >= 96
+		dsm_pin_segment(seg);
+#else
+		dsm_keep_segment(seg);
+#endif
+	}
+	dsm_detach(seg);
+	return published;
+#else
+	return LW_FALSE;
+#endif
+}
@@ -0,0 +1,69 @@
+/**********************************************************************
+ *
+ * PostGIS - Spatial Types for PostgreSQL
+ * http://postgis.net
+ *
+ * This is free software; you can redistribute and/or modify it under
+ * the terms of the GNU General Public Licence. See the COPYING file.
+ *
+ **********************************************************************/
+
+#ifndef LWGEOM_SHARED_CACHE_H_
+#define LWGEOM_SHARED_CACHE_H_ 1
+
+#include "postgres.h"
+
+#include "liblwgeom.h"
+
+
+/*
+* Indexes of large geometries that every backend keeps building
+* (the reference polygons of a busy lookup query) can be shared:
+* the first backend to build one publishes a flattened copy in a
+* dynamic shared memory segment, and the others attach to it
+* instead of building their own.
+*
+* The registry of published indexes lives in the main shared
+* memory, so sharing needs PostGIS in shared_preload_libraries
+* and PostgreSQL 9.4 or later. Published indexes stay until the
+* server restarts.
+*/
+
+/* Indexes that can be published (postgis.geom_cache_shared_entries), 0 disables sharing */
+#define GEOM_SHARED_CACHE_ENTRIES	0
+#define GEOM_SHARED_CACHE_ENTRIES_MIN	0
+#define GEOM_SHARED_CACHE_ENTRIES_MAX	1024
+
+/* kB of published indexes and their keys (postgis.geom_cache_shared_memory) */
+#define GEOM_SHARED_CACHE_MEMORY	65536
+#define GEOM_SHARED_CACHE_MEMORY_MIN	0
+#define GEOM_SHARED_CACHE_MEMORY_MAX	(INT_MAX / 1024)
+
+extern int geom_shared_cache_entries;
+extern int geom_shared_cache_memory;
+
+/**
+* Reserve the shared registry, from _PG_init. Does nothing unless
+* the library is being preloaded and sharing is enabled.
+*/
+void GeomSharedCacheInit(void);
+
+/**
+* Whether this backend has a shared registry to publish to.
+*/
+int GeomSharedCacheEnabled(void);
+
+/**
+* Find the published index of the given kind (cache entry number)
+* for key, whose full hash is hash. Returns a read-only buffer,
+* mapped for the rest of the session, and its size, or NULL.
+*/
+const void* GeomSharedCacheLookup(int type, const GSERIALIZED* key, size_t key_size, uint64 hash, size_t* size);
+
+/**
+* Publish a flattened index for key. Returns LW_FALSE if there
+* was no room, or another backend published the same key first.
+*/
+int GeomSharedCachePublish(int type, const GSERIALIZED* key, size_t key_size, uint64 hash, const void* index, size_t size);
+
+#endif /* LWGEOM_SHARED_CACHE_H_ */
@@ -18,7 +18,11 @@
 #include "utils/memutils.h"
 #include "executor/spi.h"
 #include "access/hash.h"
+#include "access/xact.h"
+#include "catalog/namespace.h"
+#include "utils/inval.h"
 #include "utils/hsearch.h"
+#include "portability/instr_time.h"
 
 /* PostGIS headers */
 #include "../postgis_config.h"
@@ -76,6 +80,47 @@ static void AddPJHashEntry(MemoryContext mcxt, projPJ projection);
 static projPJ GetPJHashEntry(MemoryContext mcxt);
 static void DeletePJHashEntry(MemoryContext mcxt);
 
+
+/**
+ * Backend proj4text hash table
+ *
+ * Reading the proj4text of an SRID costs an SPI query against
+ * spatial_ref_sys, which is paid again every time a portal cache
+ * (re)loads the projection. The strings are therefore kept, keyed by
+ * SRID, for the life of the backend.
+ *
+ * Row changes to a table send no cache invalidation by themselves, so
+ * the postgis_srs_invalidate() statement trigger on spatial_ref_sys
+ * sends a relcache invalidation for it, which every backend receives
+ * once the change commits (and the changing backend at once). The
+ * relcache callback drops the table when it sees spatial_ref_sys, or a
+ * full cache reset. A transaction that took its snapshot before the
+ * change may still read and cache the old text after the invalidation,
+ * so the table is dropped once more at the end of any transaction that
+ * received one.
+ */
+static HTAB *SRSTextHash = NULL;
+static MemoryContext SRSTextContext = NULL;
+static Oid SRSTextRelid = InvalidOid;
+static bool SRSTextInvalidated = false;
+
+typedef struct struct_SRSTextHashEntry
+{
+	int srid;
+	char *proj4text;
+}
+SRSTextHashEntry;
+
+static void CreateSRSTextHash(void);
+static void DeleteSRSTextHash(void);
+static char *GetSRSTextHashEntry(int srid);
+static void AddSRSTextHashEntry(int srid, const char *proj4text);
+static void SRSTextRelcacheCallback(Datum arg, Oid relid);
+static void SRSTextXactCallback(XactEvent event, void *arg);
+
+/* Backend-wide counters for postgis_proj_cache_stats() */
+static PROJ4CacheStats PROJ4Stats = { 0, 0, 0, 0.0 };
+
 /* Internal Cache API */
 /* static PROJ4PortalCache *GetPROJ4SRSCache(FunctionCallInfo fcinfo) ; */
 static bool IsInPROJ4SRSCache(PROJ4PortalCache *PROJ4Cache, int srid);
@@ -273,6 +318,120 @@ static void DeletePJHashEntry(MemoryContext mcxt)
 		elog(ERROR, "DeletePJHashEntry: There was an error removing the PROJ4 projection object from this MemoryContext (%p)", (void *)mcxt);
 }
 
+
+/*
+ * PROJ4 proj4text Hash Table functions
+ */
+
+static void CreateSRSTextHash(void)
+{
+	static bool callbacks_registered = false;
+	HASHCTL ctl;
+
+	SRSTextContext = AllocSetContextCreate(CacheMemoryContext,
+	                                       "PostGIS PROJ4 proj4text Context",
+	                                       ALLOCSET_SMALL_MINSIZE,
+	                                       ALLOCSET_SMALL_INITSIZE,
+	                                       ALLOCSET_SMALL_MAXSIZE);
+
+	memset(&ctl, 0, sizeof(ctl));
+	ctl.keysize = sizeof(int);
+	ctl.entrysize = sizeof(SRSTextHashEntry);
+	ctl.hash = tag_hash;
+	ctl.hcxt = SRSTextContext;
+
+	SRSTextHash = hash_create("PostGIS PROJ4 Backend proj4text Hash", PROJ4_BACKEND_HASH_SIZE, &ctl, (HASH_ELEM | HASH_FUNCTION | HASH_CONTEXT));
+
+	/* The callbacks can't be unregistered, so only do it once per backend */
+	if ( ! callbacks_registered )
+	{
+		CacheRegisterRelcacheCallback(SRSTextRelcacheCallback, (Datum) 0);
+		RegisterXactCallback(SRSTextXactCallback, NULL);
+		callbacks_registered = true;
+	}
+
+	/* The table our SPI lookups read, as resolved by the search path */
+	SRSTextRelid = RelnameGetRelid("spatial_ref_sys");
+}
+
+static void DeleteSRSTextHash(void)
+{
+	if ( ! SRSTextHash )
+		return;
+
+	POSTGIS_DEBUG(3, "flushing backend proj4text hash");
+
+	/* The hash table lives in SRSTextContext, so this frees everything */
+	MemoryContextDelete(SRSTextContext);
+	SRSTextContext = NULL;
+	SRSTextHash = NULL;
+}
+
+/**
+ * Return a palloc'ed copy of the cached proj4text for srid,
+ * or NULL if we haven't seen it yet.
+ */
+static char *GetSRSTextHashEntry(int srid)
+{
+	SRSTextHashEntry *he;
+
+	if ( ! SRSTextHash )
+		return NULL;
+
+	he = (SRSTextHashEntry *) hash_search(SRSTextHash, (void *)&srid, HASH_FIND, NULL);
+	if ( ! he )
+		return NULL;
+
+	return pstrdup(he->proj4text);
+}
+
+static void AddSRSTextHashEntry(int srid, const char *proj4text)
+{
+	SRSTextHashEntry *he;
+	char *copy;
+	bool found;
+
+	if ( ! SRSTextHash )
+		CreateSRSTextHash();
+
+	/* Copy first, so an out-of-memory error can't leave a half-filled entry */
+	copy = MemoryContextStrdup(SRSTextContext, proj4text);
+
+	he = (SRSTextHashEntry *) hash_search(SRSTextHash, (void *)&srid, HASH_ENTER, &found);
+	if ( found )
+		pfree(he->proj4text);
+
+	he->srid = srid;
+	he->proj4text = copy;
+}
+
+static void SRSTextRelcacheCallback(Datum arg, Oid relid)
+{
+	/* InvalidOid means the whole relcache was reset */
+	if ( relid == InvalidOid || relid == SRSTextRelid )
+	{
+		DeleteSRSTextHash();
+		SRSTextInvalidated = true;
+	}
+}
+
+static void SRSTextXactCallback(XactEvent event, void *arg)
+{
+	/* Drop what an older snapshot may have cached after an invalidation */
+	if ( SRSTextInvalidated )
+	{
+		DeleteSRSTextHash();
+		SRSTextInvalidated = false;
+	}
+}
+
+
+const PROJ4CacheStats*
+GetPROJ4CacheStats(void)
+{
+	return &PROJ4Stats;
+}
+
 bool
 IsInPROJ4Cache(Proj4Cache PROJ4Cache, int srid) {
 	return IsInPROJ4SRSCache((PROJ4PortalCache *)PROJ4Cache, srid) ;
@@ -292,10 +451,13 @@ IsInPROJ4SRSCache(PROJ4PortalCache *PROJ4Cache, int srid)
 
 	int i;
 
-	for (i = 0; i < PROJ4_CACHE_ITEMS; i++)
+	for (i = 0; i < PROJ4Cache->PROJ4SRSCacheCount; i++)
 	{
 		if (PROJ4Cache->PROJ4SRSCache[i].srid == srid)
+		{
+			PROJ4Stats.hits++;
 			return 1;
+		}
 	}
 
 	/* Otherwise not found */
@@ -310,16 +472,20 @@ projPJ GetProjectionFromPROJ4Cache(Proj4Cache cache, int srid)
 /**
  * Return the projection object from the cache (we should
  * already have checked it exists using IsInPROJ4SRSCache first)
+ * and mark it as the most recently used entry.
  */
 static projPJ
 GetProjectionFromPROJ4SRSCache(PROJ4PortalCache *PROJ4Cache, int srid)
 {
 	int i;
 
-	for (i = 0; i < PROJ4_CACHE_ITEMS; i++)
+	for (i = 0; i < PROJ4Cache->PROJ4SRSCacheCount; i++)
 	{
 		if (PROJ4Cache->PROJ4SRSCache[i].srid == srid)
+		{
+			PROJ4Cache->PROJ4SRSCache[i].lastused = ++PROJ4Cache->PROJ4SRSCacheClock;
 			return PROJ4Cache->PROJ4SRSCache[i].projection;
+		}
 	}
 
 	return NULL;
@@ -390,7 +556,18 @@ static char* GetProj4String(int srid)
 	/* SRIDs in SPATIAL_REF_SYS */
 	if ( srid < SRID_RESERVE_OFFSET )
 	{
-		return GetProj4StringSPI(srid);
+		char *proj_str = GetSRSTextHashEntry(srid);
+
+		if ( ! proj_str )
+		{
+			proj_str = GetProj4StringSPI(srid);
+			AddSRSTextHashEntry(srid, proj_str);
+		}
+		else
+		{
+			POSTGIS_DEBUGF(3, "using cached proj4text for SRID=%d: %s", srid, proj_str);
+		}
+		return proj_str;
 	}
 	/* Automagic SRIDs */
 	else
@@ -474,9 +651,10 @@ void AddToPROJ4Cache(Proj4Cache cache, int srid, int other_srid) {
 
 
 /**
- * Add an entry to the local PROJ4 SRS cache. If we need to wrap around then
- * we must make sure the entry we choose to delete does not contain other_srid
- * which is the definition for the other half of the transformation.
+ * Add an entry to the local PROJ4 SRS cache. If the cache is full we replace
+ * the least recently used entry, making sure the entry we choose to delete
+ * does not contain other_srid which is the definition for the other half
+ * of the transformation.
  */
 static void
 AddToPROJ4SRSCache(PROJ4PortalCache *PROJ4Cache, int srid, int other_srid)
@@ -484,6 +662,12 @@ AddToPROJ4SRSCache(PROJ4PortalCache *PROJ4Cache, int srid, int other_srid)
 	MemoryContext PJMemoryContext;
 	projPJ projection = NULL;
 	char *proj_str = NULL;
+	PROJ4SRSCacheItem *item;
+	instr_time start_time, init_time;
+	int slot;
+
+	PROJ4Stats.misses++;
+	INSTR_TIME_SET_CURRENT(start_time);
 
 	/*
 	** Turn the SRID number into a proj4 string, by reading from spatial_ref_sys
@@ -507,27 +691,46 @@ AddToPROJ4SRSCache(PROJ4PortalCache *PROJ4Cache, int srid, int other_srid)
 		    proj_str, pj_errstr);
 	}
 
+	INSTR_TIME_SET_CURRENT(init_time);
+	INSTR_TIME_SUBTRACT(init_time, start_time);
+	PROJ4Stats.init_time += INSTR_TIME_GET_MILLISEC(init_time);
+
 	/*
-	 * If the cache is already full then find the first entry
-	 * that doesn't contain other_srid and use this as the
-	 * subsequent value of PROJ4SRSCacheCount
+	 * While the cache is filling up take the next free slot. Once
+	 * it is full, reuse a slot emptied by DeleteFromPROJ4SRSCache or
+	 * else evict the least recently used entry that doesn't contain
+	 * other_srid.
 	 */
-	if (PROJ4Cache->PROJ4SRSCacheCount == PROJ4_CACHE_ITEMS)
+	if (PROJ4Cache->PROJ4SRSCacheCount < PROJ4Cache->PROJ4SRSCacheSize)
+	{
+		slot = PROJ4Cache->PROJ4SRSCacheCount++;
+	}
+	else
 	{
-		bool found = false;
 		int i;
 
-		for (i = 0; i < PROJ4_CACHE_ITEMS; i++)
+		slot = -1;
+		for (i = 0; i < PROJ4Cache->PROJ4SRSCacheCount; i++)
 		{
-			if (PROJ4Cache->PROJ4SRSCache[i].srid != other_srid && found == false)
+			item = &(PROJ4Cache->PROJ4SRSCache[i]);
+
+			if (!item->projection)
 			{
-				POSTGIS_DEBUGF(3, "choosing to remove item from query cache with SRID %d and index %d", PROJ4Cache->PROJ4SRSCache[i].srid, i);
+				slot = i;
+				break;
+			}
+			if (item->srid == other_srid)
+				continue;
+			if (slot < 0 || item->lastused < PROJ4Cache->PROJ4SRSCache[slot].lastused)
+				slot = i;
+		}
 
-				DeleteFromPROJ4SRSCache(PROJ4Cache, PROJ4Cache->PROJ4SRSCache[i].srid);
-				PROJ4Cache->PROJ4SRSCacheCount = i;
+		if (PROJ4Cache->PROJ4SRSCache[slot].projection)
+		{
+			POSTGIS_DEBUGF(3, "choosing to remove item from query cache with SRID %d and index %d", PROJ4Cache->PROJ4SRSCache[slot].srid, slot);
 
-				found = true;
-			}
+			DeleteFromPROJ4SRSCache(PROJ4Cache, PROJ4Cache->PROJ4SRSCache[slot].srid);
+			PROJ4Stats.evictions++;
 		}
 	}
 
@@ -535,7 +738,7 @@ AddToPROJ4SRSCache(PROJ4PortalCache *PROJ4Cache, int srid, int other_srid)
 	 * Now create a memory context for this projection and
 	 * store it in the backend hash
 	 */
-	POSTGIS_DEBUGF(3, "adding SRID %d with proj4text \"%s\" to query cache at index %d", srid, proj_str, PROJ4Cache->PROJ4SRSCacheCount);
+	POSTGIS_DEBUGF(3, "adding SRID %d with proj4text \"%s\" to query cache at index %d", srid, proj_str, slot);
 
 	PJMemoryContext = MemoryContextCreate(T_AllocSetContext, 8192,
 	                                      &PROJ4SRSCacheContextMethods,
@@ -554,10 +757,11 @@ AddToPROJ4SRSCache(PROJ4PortalCache *PROJ4Cache, int srid, int other_srid)
 
 	AddPJHashEntry(PJMemoryContext, projection);
 
-	PROJ4Cache->PROJ4SRSCache[PROJ4Cache->PROJ4SRSCacheCount].srid = srid;
-	PROJ4Cache->PROJ4SRSCache[PROJ4Cache->PROJ4SRSCacheCount].projection = projection;
-	PROJ4Cache->PROJ4SRSCache[PROJ4Cache->PROJ4SRSCacheCount].projection_mcxt = PJMemoryContext;
-	PROJ4Cache->PROJ4SRSCacheCount++;
+	item = &(PROJ4Cache->PROJ4SRSCache[slot]);
+	item->srid = srid;
+	item->projection = projection;
+	item->projection_mcxt = PJMemoryContext;
+	item->lastused = ++PROJ4Cache->PROJ4SRSCacheClock;
 
 	/* Free the projection string */
 	pfree(proj_str);
@@ -577,7 +781,7 @@ static void DeleteFromPROJ4SRSCache(PROJ4PortalCache *PROJ4Cache, int srid)
 
 	int i;
 
-	for (i = 0; i < PROJ4_CACHE_ITEMS; i++)
+	for (i = 0; i < PROJ4Cache->PROJ4SRSCacheCount; i++)
 	{
 		if (PROJ4Cache->PROJ4SRSCache[i].srid == srid)
 		{
@@ -35,6 +35,20 @@ int GetProjectionsUsingFCInfo(FunctionCallInfo fcinfo, int srid1, int srid2, pro
 int spheroid_init_from_srid(FunctionCallInfo fcinfo, int srid, SPHEROID *s);
 void srid_is_latlong(FunctionCallInfo fcinfo, int srid);
 
+/**
+ * Backend-wide projection cache counters
+ */
+typedef struct
+{
+	int64 hits;       /* SRID lookups answered by a portal cache */
+	int64 misses;     /* SRID lookups that had to build a projection */
+	int64 evictions;  /* Projections dropped to make room for another */
+	double init_time; /* Milliseconds spent reading proj4text and initializing projections */
+}
+PROJ4CacheStats;
+
+const PROJ4CacheStats* GetPROJ4CacheStats(void);
+
 /**
  * Builtin SRID values
  * @{
@@ -383,13 +383,17 @@ GeneratePointGeometry(SHPLOADERSTATE *state, SHPObject *obj, char **geometry, in
 	int u;
 
 	char *mem;
+	LWARENA *oldarena;
 	size_t mem_length;
 
 	FLAGS_SET_Z(dims, state->has_z);
 	FLAGS_SET_M(dims, state->has_m);
 
+	/* Build the geometry in the arena, it is dropped in one go once written out */
+	oldarena = lwarena_switch(state->arena);
+
 	/* Allocate memory for our array of LWPOINTs and our dynptarrays */
-	lwmultipoints = malloc(sizeof(LWPOINT *) * obj->nVertices);
+	lwmultipoints = lwalloc(sizeof(LWPOINT *) * obj->nVertices);
 
 	/* We need an array of pointers to each of our sub-geometries */
 	for (u = 0; u < obj->nVertices; u++)
@@ -425,6 +429,9 @@ GeneratePointGeometry(SHPLOADERSTATE *state, SHPObject *obj, char **geometry, in
 		lwfree(lwmultipoints);
 	}
 
+	/* The output string outlives the arena */
+	lwarena_switch(oldarena);
+
 	if (state->config->use_wkt)
 	{
 		mem = lwgeom_to_wkt(lwgeom, WKT_EXTENDED, WKT_PRECISION, &mem_length);
@@ -434,14 +441,14 @@ GeneratePointGeometry(SHPLOADERSTATE *state, SHPObject *obj, char **geometry, in
 		mem = lwgeom_to_hexwkb(lwgeom, WKB_EXTENDED, &mem_length);
 	}
 
+	/* Free all of the allocated items */
+	lwarena_reset(state->arena);
+
 	if ( !mem )
 	{
 		snprintf(state->message, SHPLOADERMSGLEN, "unable to write geometry");
 		return SHPLOADERERR;
 	}
-
-	/* Free all of the allocated items */
-	lwgeom_free(lwgeom);
 	
 	/* Return the string - everything ok */
 	*geometry = mem;
@@ -463,6 +470,7 @@ GenerateLineStringGeometry(SHPLOADERSTATE *state, SHPObject *obj, char **geometr
 	int dims = 0;
 	int u, v, start_vertex, end_vertex;
 	char *mem;
+	LWARENA *oldarena;
 	size_t mem_length;
 
 
@@ -476,8 +484,11 @@ GenerateLineStringGeometry(SHPLOADERSTATE *state, SHPObject *obj, char **geometr
 		return SHPLOADERERR;
 	}
 
+	/* Build the geometry in the arena, it is dropped in one go once written out */
+	oldarena = lwarena_switch(state->arena);
+
 	/* Allocate memory for our array of LWLINEs and our dynptarrays */
-	lwmultilinestrings = malloc(sizeof(LWPOINT *) * obj->nParts);
+	lwmultilinestrings = lwalloc(sizeof(LWPOINT *) * obj->nParts);
 
 	/* We need an array of pointers to each of our sub-geometries */
 	for (u = 0; u < obj->nParts; u++)
@@ -523,20 +534,23 @@ GenerateLineStringGeometry(SHPLOADERSTATE *state, SHPObject *obj, char **geometr
 		lwfree(lwmultilinestrings);
 	}
 
+	/* The output string outlives the arena */
+	lwarena_switch(oldarena);
+
 	if (!state->config->use_wkt)
 		mem = lwgeom_to_hexwkb(lwgeom, WKB_EXTENDED, &mem_length);
 	else
 		mem = lwgeom_to_wkt(lwgeom, WKT_EXTENDED, WKT_PRECISION, &mem_length);
 
+	/* Free all of the allocated items */
+	lwarena_reset(state->arena);
+
 	if ( !mem )
 	{
 		snprintf(state->message, SHPLOADERMSGLEN, "unable to write geometry");
 		return SHPLOADERERR;
 	}
 
-	/* Free all of the allocated items */
-	lwgeom_free(lwgeom);
-
 	/* Return the string - everything ok */
 	*geometry = mem;
 
@@ -756,6 +770,7 @@ GeneratePolygonGeometry(SHPLOADERSTATE *state, SHPObject *obj, char **geometry)
 	int dims = 0;
 
 	char *mem;
+	LWARENA *oldarena;
 	size_t mem_length;
 
 	FLAGS_SET_Z(dims, state->has_z);
@@ -770,8 +785,11 @@ GeneratePolygonGeometry(SHPLOADERSTATE *state, SHPObject *obj, char **geometry)
 		return SHPLOADERERR;
 	}
 
+	/* Build the geometry in the arena, it is dropped in one go once written out */
+	oldarena = lwarena_switch(state->arena);
+
 	/* Allocate memory for our array of LWPOLYs */
-	lwpolygons = malloc(sizeof(LWPOLY *) * polygon_total);
+	lwpolygons = lwalloc(sizeof(LWPOLY *) * polygon_total);
 
 	/* Cycle through each individual polygon */
 	for (pi = 0; pi < polygon_total; pi++)
@@ -834,20 +852,24 @@ GeneratePolygonGeometry(SHPLOADERSTATE *state, SHPObject *obj, char **geometry)
 		lwfree(lwpolygons);
 	}
 
+	/* The output string outlives the arena */
+	lwarena_switch(oldarena);
+
 	if (!state->config->use_wkt)
 		mem = lwgeom_to_hexwkb(lwgeom, WKB_EXTENDED, &mem_length);
 	else
 		mem = lwgeom_to_wkt(lwgeom, WKT_EXTENDED, WKT_PRECISION, &mem_length);
 
+	/* Free all of the allocated items */
+	lwarena_reset(state->arena);
+
 	if ( !mem )
 	{
+		ReleasePolygons(Outer, polygon_total);
 		snprintf(state->message, SHPLOADERMSGLEN, "unable to write geometry");
 		return SHPLOADERERR;
 	}
 
-	/* Free all of the allocated items */
-	lwgeom_free(lwgeom);
-
 	/* Free the linked list of rings */
 	ReleasePolygons(Outer, polygon_total);
 
@@ -922,6 +944,7 @@ ShpLoaderCreate(SHPLOADERCONFIG *config)
 	state->precisions = NULL;
 	state->col_names = NULL;
 	state->field_names = NULL;
+	state->arena = lwarena_create(0);
 
 	state->from_srid = config->shp_sr_id;
 	state->to_srid = config->sr_id;
@@ -2023,6 +2046,9 @@ ShpLoaderDestroy(SHPLOADERSTATE *state)
 
 		/* Free any column map fieldnames if specified */
 		colmap_clean(&state->column_map);
+
+		if (state->arena)
+			lwarena_destroy(state->arena);
 		
 		/* Free the state itself */
 		free(state);
@@ -28,6 +28,7 @@
 #include "getopt.h"
 
 #include "../liblwgeom/stringbuffer.h"
+#include "../liblwgeom/liblwgeom.h"
 
 #define S2P_RCSID "$Id$"
 
@@ -221,6 +222,9 @@ typedef struct shp_loader_state
 	/* Column map */
   colmap column_map;
 
+	/* Arena the geometry of each record is built in, reset after every record */
+	LWARENA *arena;
+
 } SHPLOADERSTATE;
 
 
@@ -286,6 +286,26 @@ Datum geography_distance_tree(PG_FUNCTION_ARGS)
 	PG_RETURN_FLOAT8(distance);
 }
 
+/*
+** geography_add_index_tree(GSERIALIZED *g) returns boolean
+** Builds the circle tree ST_Distance and ST_DWithin would build on
+** the geography and shares it with every backend. True if it is
+** shared, now or before.
+*/
+PG_FUNCTION_INFO_V1(geography_add_index_tree);
+Datum geography_add_index_tree(PG_FUNCTION_ARGS)
+{
+	GSERIALIZED *g = (GSERIALIZED*)PG_DETOAST_DATUM(PG_GETARG_DATUM(0));
+	int result = LW_FALSE;
+
+	/* Nothing to index */
+	if ( ! gserialized_is_empty(g) )
+		result = geography_tree_publish(g);
+
+	PG_FREE_IF_COPY(g, 0);
+	PG_RETURN_BOOL(result);
+}
+
 
 
 /*
@@ -10,10 +10,13 @@
 */
 typedef struct {
 	int                     type;       // <GeomCache>
-	GSERIALIZED*                geom1;      // 
-	GSERIALIZED*                geom2;      // 
-	size_t                      geom1_size; // 
-	size_t                      geom2_size; // 
+	GSERIALIZED*                key;        // 
+	size_t                      key_size;   // 
+	uint64                      hash;       // 
+	GeomCacheIdent              ident;      // 
+	uint32                      lastused;   // 
+	uint32                      hits;       // 
+	uint32                      uses;       // 
 	int32                       argnum;     // </GeomCache>
 	CIRC_NODE*                  index;
 } CircTreeGeomCache;
@@ -54,6 +57,33 @@ CircTreeFreer(GeomCache* cache)
 	return LW_SUCCESS;
 }
 
+/**
+* Flattener and attacher for the trees shared between backends,
+* see lwgeom_shared_cache.h
+*/
+static void*
+CircTreeFlattener(const GeomCache* cache, size_t* size)
+{
+	const CircTreeGeomCache* circ_cache = (const CircTreeGeomCache*)cache;
+	if ( ! circ_cache->index )
+		return NULL;
+	return circ_tree_flatten(circ_cache->index, size);
+}
+
+static int
+CircTreeAttacher(const LWGEOM* lwgeom, GeomCache* cache, const void* buf, size_t size)
+{
+	CircTreeGeomCache* circ_cache = (CircTreeGeomCache*)cache;
+	CIRC_NODE* tree = circ_tree_unflatten(buf, size);
+
+	if ( ! tree )
+		return LW_FAILURE;
+	if ( circ_cache->index )
+		circ_tree_free(circ_cache->index);
+	circ_cache->index = tree;
+	return LW_SUCCESS;
+}
+
 static GeomCache*
 CircTreeAllocator(void)
 {
@@ -67,7 +97,9 @@ static GeomCacheMethods CircTreeCacheMethods =
 	CIRC_CACHE_ENTRY,
 	CircTreeBuilder,
 	CircTreeFreer,
-	CircTreeAllocator
+	CircTreeAllocator,
+	CircTreeFlattener,
+	CircTreeAttacher
 };
 
 static CircTreeGeomCache*
@@ -76,6 +108,12 @@ GetCircTreeGeomCache(FunctionCallInfoData* fcinfo, const GSERIALIZED* g1, const
 	return (CircTreeGeomCache*)GetGeomCache(fcinfo, &CircTreeCacheMethods, g1, g2);
 }
 
+int
+geography_tree_publish(const GSERIALIZED* g)
+{
+	return GeomCachePublishIndex(&CircTreeCacheMethods, g);
+}
+
 
 static int
 CircTreePIP(const CIRC_NODE* tree1, const GSERIALIZED* g1, const POINT4D* in_point)
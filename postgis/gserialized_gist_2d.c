@@ -28,9 +28,22 @@
 #include "access/gist.h"    /* For GiST */
 #include "access/itup.h"
 #include "access/skey.h"
+#include <math.h>           /* For nextafter and HUGE_VAL */
 
 #include "../postgis_config.h"
 
+#if POSTGIS_PGSQL_VERSION >= 95
+#include "access/brin_tuple.h"  /* For BRIN */
+#endif
+
+#if POSTGIS_PGSQL_VERSION >= 96
+#include "access/spgist.h"      /* For SP-GiST */
+#include "catalog/pg_type.h"
+#include "nodes/makefuncs.h"
+#include "parser/parse_type.h"
+#include "utils/lsyscache.h"
+#endif
+
 #include "liblwgeom.h"         /* For standard geometry types. */
 #include "lwgeom_pg.h"       /* For debugging macros. */
 #include "gserialized_gist.h"	     /* For utility functions. */
@@ -84,6 +97,23 @@ Datum gserialized_gist_union_2d(PG_FUNCTION_ARGS);
 Datum gserialized_gist_same_2d(PG_FUNCTION_ARGS);
 Datum gserialized_gist_distance_2d(PG_FUNCTION_ARGS);
 
+/*
+** BRIN prototypes
+*/
+Datum gserialized_brin_add_value_2d(PG_FUNCTION_ARGS);
+Datum gserialized_brin_merge_2d(PG_FUNCTION_ARGS);
+Datum gserialized_brin_overlaps_2d(PG_FUNCTION_ARGS);
+Datum gserialized_brin_contains_2d(PG_FUNCTION_ARGS);
+
+/*
+** SP-GiST prototypes
+*/
+Datum gserialized_spgist_config_2d(PG_FUNCTION_ARGS);
+Datum gserialized_spgist_choose_2d(PG_FUNCTION_ARGS);
+Datum gserialized_spgist_picksplit_2d(PG_FUNCTION_ARGS);
+Datum gserialized_spgist_inner_consistent_2d(PG_FUNCTION_ARGS);
+Datum gserialized_spgist_leaf_consistent_2d(PG_FUNCTION_ARGS);
+
 /*
 ** GiST 2D operator prototypes
 */
@@ -258,6 +288,14 @@ static inline void box2df_validate(BOX2DF *b)
 	return;
 }
 
+/* Stand-in for the box of an empty geometry. It has min above max, so
+   it overlaps and contains nothing, and merging a real box replaces it. */
+static inline void box2df_set_inverted(BOX2DF *b)
+{
+	b->xmin = b->ymin = MAXFLOAT;
+	b->xmax = b->ymax = -1 * MAXFLOAT;
+}
+
 static bool box2df_overlaps(const BOX2DF *a, const BOX2DF *b)
 {
 	if ( ! a || ! b ) return FALSE; /* TODO: might be smarter for EMPTY */
@@ -391,6 +429,7 @@ static double box2df_distance_leaf_centroid(const BOX2DF *a, const BOX2DF *b)
     return sqrt((a_x - b_x) * (a_x - b_x) + (a_y - b_y) * (a_y - b_y));
 }
 
+#if POSTGIS_PGSQL_VERSION < 95
 /**
 * Calculate the The node_box_edge->query_centroid distance 
 * between the boxes.
@@ -464,6 +503,7 @@ static double box2df_distance_node_centroid(const BOX2DF *node, const BOX2DF *qu
     
     return sqrt(d);
 }
+#endif
 
 /* Quick distance function */
 static inline double pt_distance(double ax, double ay, double bx, double by)
@@ -472,7 +512,8 @@ static inline double pt_distance(double ax, double ay, double bx, double by)
 }
 
 /**
-* Calculate the box->box distance.
+* Calculate the box->box distance. The float coordinates are promoted
+* to double before any arithmetic, so the result is not rounded to float.
 */
 static double box2df_distance(const BOX2DF *a, const BOX2DF *b)
 {
@@ -487,7 +528,7 @@ static double box2df_distance(const BOX2DF *a, const BOX2DF *b)
 		if ( box2df_below(a, b) )
 			return pt_distance(a->xmax, a->ymax, b->xmin, b->ymin);
 		else
-			return b->xmin - a->xmax;
+			return (double)b->xmin - (double)a->xmax;
 	}
 	if ( box2df_right(a, b) )
 	{
@@ -496,7 +537,7 @@ static double box2df_distance(const BOX2DF *a, const BOX2DF *b)
 		if ( box2df_below(a, b) )
 			return pt_distance(a->xmin, a->ymax, b->xmax, b->ymin);
 		else
-			return a->xmin - b->xmax;
+			return (double)a->xmin - (double)b->xmax;
 	}
 	if ( box2df_above(a, b) )
 	{
@@ -505,7 +546,7 @@ static double box2df_distance(const BOX2DF *a, const BOX2DF *b)
 		if ( box2df_right(a, b) )
 			return pt_distance(a->xmin, a->ymin, b->xmax, b->ymax);
 		else
-			return a->ymin - b->ymax;
+			return (double)a->ymin - (double)b->ymax;
 	}
 	if ( box2df_below(a, b) )
 	{
@@ -514,7 +555,7 @@ static double box2df_distance(const BOX2DF *a, const BOX2DF *b)
 		if ( box2df_right(a, b) )
 			return pt_distance(a->xmin, a->ymax, b->xmax, b->ymin);
 		else
-			return b->ymin - a->ymax;
+			return (double)b->ymin - (double)a->ymax;
 	}
 	
 	return MAXFLOAT;
@@ -1059,7 +1100,8 @@ Datum gserialized_gist_consistent_2d(PG_FUNCTION_ARGS)
 ** represents the distance to the index entry; for an internal tree node, the
 ** result must be the smallest distance that any child entry could have.
 ** 
-** Strategy 13 = centroid-based distance tests
+** Strategy 13 = centroid-based distance tests, or from PostgreSQL 9.5
+**               exact distance tests, rechecked by the executor
 ** Strategy 14 = box-based distance tests
 */
 PG_FUNCTION_INFO_V1(gserialized_gist_distance_2d);
@@ -1070,6 +1112,9 @@ Datum gserialized_gist_distance_2d(PG_FUNCTION_ARGS)
 	BOX2DF *entry_box;
 	StrategyNumber strategy = (StrategyNumber) PG_GETARG_UINT16(2);
 	double distance;
+#if POSTGIS_PGSQL_VERSION >= 95
+	bool *recheck = (bool *) PG_GETARG_POINTER(4);
+#endif
 
 	POSTGIS_DEBUG(4, "[GIST] 'distance' function called");
 
@@ -1097,6 +1142,18 @@ Datum gserialized_gist_distance_2d(PG_FUNCTION_ARGS)
 		PG_RETURN_FLOAT8(distance);
 	}
 
+#if POSTGIS_PGSQL_VERSION >= 95
+	/*
+	** <-> is the exact distance. The box distance is a lower bound
+	** of it on every node, and the executor recomputes the exact
+	** distance of the leaves, as the index does not hold geometries.
+	** The executor errors out if a bound exceeds the distance it
+	** recomputes, so step down one ulp past any rounding in the sqrt.
+	*/
+	distance = nextafter(box2df_distance(entry_box, &query_box), 0.0);
+	if ( GIST_LEAF(entry) )
+		*recheck = true;
+#else
 	/* Treat leaf node tests different from internal nodes */
 	if (GIST_LEAF(entry))
 	{
@@ -1108,6 +1165,7 @@ Datum gserialized_gist_distance_2d(PG_FUNCTION_ARGS)
 	    /* Calculate distance for internal nodes */
 		distance = (double)box2df_distance_node_centroid(entry_box, &query_box);
 	}
+#endif
 
 	PG_RETURN_FLOAT8(distance);
 }
@@ -1199,6 +1257,513 @@ Datum gserialized_gist_same_2d(PG_FUNCTION_ARGS)
 	PG_RETURN_POINTER(result);
 }
 
+
+#if POSTGIS_PGSQL_VERSION >= 95
+/***********************************************************************
+* BRIN 2-D Index Support Functions
+**
+** The BRIN inclusion operator class keeps one BOX2DF per range of
+** table pages, the union of the boxes of all the rows in it. The
+** generic brin_inclusion_* functions do the rest, given our own
+** add_value (a geometry is not a box), a merge, and operators that
+** test a stored box against a query geometry.
+**
+** Empty geometries have no box. A range that holds one gets an
+** inverted box, which overlaps and contains nothing but is merged
+** away by the first real box, and the "contains empty" flag.
+*/
+
+/*
+** BRIN support function. Grow the box of a page range to take in a
+** new geometry. Returns true if the summary has changed.
+*/
+PG_FUNCTION_INFO_V1(gserialized_brin_add_value_2d);
+Datum gserialized_brin_add_value_2d(PG_FUNCTION_ARGS)
+{
+	BrinValues *column = (BrinValues *) PG_GETARG_POINTER(1);
+	Datum newval = PG_GETARG_DATUM(2);
+	bool isnull = PG_GETARG_BOOL(3);
+	BOX2DF box_geom, *box_key;
+	bool empty = FALSE;
+
+	POSTGIS_DEBUG(4, "[BRIN] 'add_value' function called");
+
+	if ( isnull )
+	{
+		if ( column->bv_hasnulls )
+			PG_RETURN_BOOL(FALSE);
+		column->bv_hasnulls = TRUE;
+		PG_RETURN_BOOL(TRUE);
+	}
+
+	if ( gserialized_datum_get_box2df_p(newval, &box_geom) == LW_FAILURE )
+	{
+		box2df_set_inverted(&box_geom);
+		empty = TRUE;
+	}
+
+	/* First value of the range */
+	if ( column->bv_allnulls )
+	{
+		column->bv_values[INCLUSION_UNION] = PointerGetDatum(box2df_copy(&box_geom));
+		column->bv_values[INCLUSION_UNMERGEABLE] = BoolGetDatum(FALSE);
+		column->bv_values[INCLUSION_CONTAINS_EMPTY] = BoolGetDatum(empty);
+		column->bv_allnulls = FALSE;
+		PG_RETURN_BOOL(TRUE);
+	}
+
+	if ( empty )
+	{
+		if ( DatumGetBool(column->bv_values[INCLUSION_CONTAINS_EMPTY]) )
+			PG_RETURN_BOOL(FALSE);
+		column->bv_values[INCLUSION_CONTAINS_EMPTY] = BoolGetDatum(TRUE);
+		PG_RETURN_BOOL(TRUE);
+	}
+
+	box_key = (BOX2DF*)DatumGetPointer(column->bv_values[INCLUSION_UNION]);
+	if ( box2df_contains(box_key, &box_geom) )
+		PG_RETURN_BOOL(FALSE);
+
+	/* The summary owns a copy of its box, grow it in place */
+	box2df_merge(box_key, &box_geom);
+	PG_RETURN_BOOL(TRUE);
+}
+
+/*
+** BRIN support function. Union of the boxes of two page ranges.
+*/
+PG_FUNCTION_INFO_V1(gserialized_brin_merge_2d);
+Datum gserialized_brin_merge_2d(PG_FUNCTION_ARGS)
+{
+	BOX2DF *a = (BOX2DF*)PG_GETARG_POINTER(0);
+	BOX2DF *b = (BOX2DF*)PG_GETARG_POINTER(1);
+	BOX2DF *result = box2df_copy(a);
+
+	box2df_merge(result, b);
+	PG_RETURN_POINTER(result);
+}
+
+/*
+** '&&' operator function between a stored box and a geometry.
+*/
+PG_FUNCTION_INFO_V1(gserialized_brin_overlaps_2d);
+Datum gserialized_brin_overlaps_2d(PG_FUNCTION_ARGS)
+{
+	BOX2DF *key = (BOX2DF*)PG_GETARG_POINTER(0);
+	BOX2DF query;
+
+	if ( gserialized_datum_get_box2df_p(PG_GETARG_DATUM(1), &query) == LW_SUCCESS &&
+	     box2df_overlaps(key, &query) )
+		PG_RETURN_BOOL(TRUE);
+
+	PG_RETURN_BOOL(FALSE);
+}
+
+/*
+** '~' operator function between a stored box and a geometry.
+*/
+PG_FUNCTION_INFO_V1(gserialized_brin_contains_2d);
+Datum gserialized_brin_contains_2d(PG_FUNCTION_ARGS)
+{
+	BOX2DF *key = (BOX2DF*)PG_GETARG_POINTER(0);
+	BOX2DF query;
+
+	if ( gserialized_datum_get_box2df_p(PG_GETARG_DATUM(1), &query) == LW_SUCCESS &&
+	     box2df_contains(key, &query) )
+		PG_RETURN_BOOL(TRUE);
+
+	PG_RETURN_BOOL(FALSE);
+}
+#endif /* POSTGIS_PGSQL_VERSION >= 95 */
+
+
+#if POSTGIS_PGSQL_VERSION >= 96
+/***********************************************************************
+* SP-GiST 2-D Index Support Functions
+**
+** A quad-tree over the space of boxes. A box is a point in 4-D space
+** (xmin, xmax, ymin, ymax), and every inner node splits that space
+** into 16 orthants around a centroid box, the medians of the boxes it
+** was built from. Unlike the R-Tree nodes, orthants never overlap, so
+** a search descends only where a match can be, which suits points and
+** other small boxes best.
+**
+** An SP-GiST leaf holds the indexed value itself, so the leaves are
+** the geometries and their boxes are read off them. That is cheap for
+** points and other small geometries, the ones this index is meant for.
+** The searches keep the range of values each coordinate can take below
+** the node they are at, in the traversal values PostgreSQL 9.6 added.
+** Empty geometries get the inverted box and never match.
+*/
+
+typedef struct
+{
+	double xmin_low, xmin_high;
+	double xmax_low, xmax_high;
+	double ymin_low, ymin_high;
+	double ymax_low, ymax_high;
+} RectBox2DF;
+
+/* Orthant of the centroid a box falls in, one bit per coordinate */
+static uint8
+box2df_spgist_quadrant(const BOX2DF *centroid, const BOX2DF *box)
+{
+	uint8 quadrant = 0;
+
+	if ( box->xmin > centroid->xmin ) quadrant |= 0x8;
+	if ( box->xmax > centroid->xmax ) quadrant |= 0x4;
+	if ( box->ymin > centroid->ymin ) quadrant |= 0x2;
+	if ( box->ymax > centroid->ymax ) quadrant |= 0x1;
+
+	return quadrant;
+}
+
+static RectBox2DF*
+rectbox2df_init(void)
+{
+	RectBox2DF *rect_box = palloc(sizeof(RectBox2DF));
+
+	rect_box->xmin_low = rect_box->xmax_low = -1 * HUGE_VAL;
+	rect_box->ymin_low = rect_box->ymax_low = -1 * HUGE_VAL;
+	rect_box->xmin_high = rect_box->xmax_high = HUGE_VAL;
+	rect_box->ymin_high = rect_box->ymax_high = HUGE_VAL;
+
+	return rect_box;
+}
+
+/* Ranges below one orthant of a node */
+static RectBox2DF*
+rectbox2df_next(const RectBox2DF *rect_box, const BOX2DF *centroid, uint8 quadrant)
+{
+	RectBox2DF *next = palloc(sizeof(RectBox2DF));
+
+	memcpy(next, rect_box, sizeof(RectBox2DF));
+
+	if ( quadrant & 0x8 )
+		next->xmin_low = centroid->xmin;
+	else
+		next->xmin_high = centroid->xmin;
+
+	if ( quadrant & 0x4 )
+		next->xmax_low = centroid->xmax;
+	else
+		next->xmax_high = centroid->xmax;
+
+	if ( quadrant & 0x2 )
+		next->ymin_low = centroid->ymin;
+	else
+		next->ymin_high = centroid->ymin;
+
+	if ( quadrant & 0x1 )
+		next->ymax_low = centroid->ymax;
+	else
+		next->ymax_high = centroid->ymax;
+
+	return next;
+}
+
+/* Can a box in the ranges overlap the query? */
+static bool
+rectbox2df_overlaps(const RectBox2DF *r, const BOX2DF *q)
+{
+	return r->xmin_low <= q->xmax && r->xmax_high >= q->xmin &&
+	       r->ymin_low <= q->ymax && r->ymax_high >= q->ymin;
+}
+
+/* Can a box in the ranges contain the query? */
+static bool
+rectbox2df_contains(const RectBox2DF *r, const BOX2DF *q)
+{
+	return r->xmin_low <= q->xmin && r->xmax_high >= q->xmax &&
+	       r->ymin_low <= q->ymin && r->ymax_high >= q->ymax;
+}
+
+/* Can a box in the ranges be within the query? */
+static bool
+rectbox2df_within(const RectBox2DF *r, const BOX2DF *q)
+{
+	return r->xmin_high >= q->xmin && r->xmax_low <= q->xmax &&
+	       r->ymin_high >= q->ymin && r->ymax_low <= q->ymax;
+}
+
+/* Box of a leaf geometry, inverted for an empty */
+static void
+spgist_leaf_box2df(Datum leaf, BOX2DF *box)
+{
+	if ( gserialized_datum_get_box2df_p(leaf, box) == LW_FAILURE )
+		box2df_set_inverted(box);
+}
+
+/*
+** The prefixes are box2df, which lives in the same schema as the
+** support functions.
+*/
+static Oid
+box2df_type_oid(FunctionCallInfo fcinfo)
+{
+	Oid nsp = get_func_namespace(fcinfo->flinfo->fn_oid);
+	List *name = list_make2(makeString(get_namespace_name(nsp)), makeString("box2df"));
+
+	return typenameTypeId(NULL, makeTypeNameFromNameList(name));
+}
+
+/*
+** SP-GiST support function. Describe the tree.
+*/
+PG_FUNCTION_INFO_V1(gserialized_spgist_config_2d);
+Datum gserialized_spgist_config_2d(PG_FUNCTION_ARGS)
+{
+	spgConfigOut *cfg = (spgConfigOut *) PG_GETARG_POINTER(1);
+
+	cfg->prefixType = box2df_type_oid(fcinfo);
+	cfg->labelType = VOIDOID;
+	cfg->canReturnData = false;
+	cfg->longValuesOK = false;
+
+	PG_RETURN_VOID();
+}
+
+/*
+** SP-GiST support function. Send a new box down the orthant it falls in.
+*/
+PG_FUNCTION_INFO_V1(gserialized_spgist_choose_2d);
+Datum gserialized_spgist_choose_2d(PG_FUNCTION_ARGS)
+{
+	spgChooseIn *in = (spgChooseIn *) PG_GETARG_POINTER(0);
+	spgChooseOut *out = (spgChooseOut *) PG_GETARG_POINTER(1);
+	BOX2DF *centroid = (BOX2DF*)DatumGetPointer(in->prefixDatum);
+	BOX2DF box;
+
+	out->resultType = spgMatchNode;
+	out->result.matchNode.levelAdd = 0;
+	out->result.matchNode.restDatum = in->leafDatum;
+
+	/* The core picks the node of an all-the-same tuple */
+	if ( ! in->allTheSame )
+	{
+		spgist_leaf_box2df(in->leafDatum, &box);
+		out->result.matchNode.nodeN = box2df_spgist_quadrant(centroid, &box);
+	}
+
+	PG_RETURN_VOID();
+}
+
+static int
+float_cmp(const void *a, const void *b)
+{
+	float fa = *(const float*)a;
+	float fb = *(const float*)b;
+	return fa < fb ? -1 : (fa > fb ? 1 : 0);
+}
+
+/*
+** SP-GiST support function. Split a full leaf page around the box
+** of the median of every coordinate.
+*/
+PG_FUNCTION_INFO_V1(gserialized_spgist_picksplit_2d);
+Datum gserialized_spgist_picksplit_2d(PG_FUNCTION_ARGS)
+{
+	spgPickSplitIn *in = (spgPickSplitIn *) PG_GETARG_POINTER(0);
+	spgPickSplitOut *out = (spgPickSplitOut *) PG_GETARG_POINTER(1);
+	BOX2DF *centroid = palloc(sizeof(BOX2DF));
+	BOX2DF *boxes = palloc(sizeof(BOX2DF) * in->nTuples);
+	float *xmins = palloc(sizeof(float) * in->nTuples);
+	float *xmaxs = palloc(sizeof(float) * in->nTuples);
+	float *ymins = palloc(sizeof(float) * in->nTuples);
+	float *ymaxs = palloc(sizeof(float) * in->nTuples);
+	int median = in->nTuples / 2;
+	int i;
+
+	POSTGIS_DEBUGF(4, "[SPGIST] 'picksplit' entered with %d tuples", in->nTuples);
+
+	for ( i = 0; i < in->nTuples; i++ )
+	{
+		spgist_leaf_box2df(in->datums[i], &boxes[i]);
+		xmins[i] = boxes[i].xmin;
+		xmaxs[i] = boxes[i].xmax;
+		ymins[i] = boxes[i].ymin;
+		ymaxs[i] = boxes[i].ymax;
+	}
+
+	qsort(xmins, in->nTuples, sizeof(float), float_cmp);
+	qsort(xmaxs, in->nTuples, sizeof(float), float_cmp);
+	qsort(ymins, in->nTuples, sizeof(float), float_cmp);
+	qsort(ymaxs, in->nTuples, sizeof(float), float_cmp);
+
+	centroid->xmin = xmins[median];
+	centroid->xmax = xmaxs[median];
+	centroid->ymin = ymins[median];
+	centroid->ymax = ymaxs[median];
+
+	out->hasPrefix = true;
+	out->prefixDatum = PointerGetDatum(centroid);
+	out->nNodes = 16;
+	out->nodeLabels = NULL;
+	out->mapTuplesToNodes = palloc(sizeof(int) * in->nTuples);
+	out->leafTupleDatums = palloc(sizeof(Datum) * in->nTuples);
+
+	for ( i = 0; i < in->nTuples; i++ )
+	{
+		out->leafTupleDatums[i] = in->datums[i];
+		out->mapTuplesToNodes[i] = box2df_spgist_quadrant(centroid, &boxes[i]);
+	}
+
+	pfree(boxes);
+	pfree(xmins);
+	pfree(xmaxs);
+	pfree(ymins);
+	pfree(ymaxs);
+
+	PG_RETURN_VOID();
+}
+
+/*
+** SP-GiST support function. Pick the orthants of an inner node where
+** a match can be.
+*/
+PG_FUNCTION_INFO_V1(gserialized_spgist_inner_consistent_2d);
+Datum gserialized_spgist_inner_consistent_2d(PG_FUNCTION_ARGS)
+{
+	spgInnerConsistentIn *in = (spgInnerConsistentIn *) PG_GETARG_POINTER(0);
+	spgInnerConsistentOut *out = (spgInnerConsistentOut *) PG_GETARG_POINTER(1);
+	BOX2DF *centroid, *queries = NULL;
+	RectBox2DF *rect_box;
+	MemoryContext old_ctx;
+	int i, j;
+
+	rect_box = in->traversalValue ? (RectBox2DF*)in->traversalValue : rectbox2df_init();
+
+	if ( in->nkeys > 0 )
+		queries = palloc(sizeof(BOX2DF) * in->nkeys);
+	for ( j = 0; j < in->nkeys; j++ )
+	{
+		/* Nothing matches an empty query */
+		if ( gserialized_datum_get_box2df_p(in->scankeys[j].sk_argument, &queries[j]) == LW_FAILURE )
+		{
+			out->nNodes = 0;
+			PG_RETURN_VOID();
+		}
+	}
+
+
+	out->nNodes = 0;
+	out->nodeNumbers = palloc(sizeof(int) * in->nNodes);
+	out->traversalValues = palloc(sizeof(void*) * in->nNodes);
+
+	/* The ranges outlive this call, they go with the nodes into the scan queue */
+	old_ctx = MemoryContextSwitchTo(in->traversalMemoryContext);
+
+	centroid = (BOX2DF*)DatumGetPointer(in->prefixDatum);
+
+	for ( i = 0; i < in->nNodes; i++ )
+	{
+		RectBox2DF *next_rect_box;
+		bool flag = true;
+
+		/* Nodes of an all-the-same tuple share the ranges of their parent */
+		if ( in->allTheSame )
+		{
+			next_rect_box = palloc(sizeof(RectBox2DF));
+			memcpy(next_rect_box, rect_box, sizeof(RectBox2DF));
+		}
+		else
+		{
+			next_rect_box = rectbox2df_next(rect_box, centroid, i);
+		}
+
+		for ( j = 0; flag && j < in->nkeys; j++ )
+		{
+			StrategyNumber strategy = in->scankeys[j].sk_strategy;
+
+			switch ( strategy )
+			{
+				case RTOverlapStrategyNumber:
+					flag = rectbox2df_overlaps(next_rect_box, &queries[j]);
+					break;
+				case RTSameStrategyNumber:
+				case RTContainsStrategyNumber:
+					flag = rectbox2df_contains(next_rect_box, &queries[j]);
+					break;
+				case RTContainedByStrategyNumber:
+					flag = rectbox2df_within(next_rect_box, &queries[j]);
+					break;
+				default:
+					elog(ERROR, "unrecognized strategy number: %d", strategy);
+			}
+		}
+
+		if ( ! flag )
+		{
+			pfree(next_rect_box);
+			continue;
+		}
+
+		out->traversalValues[out->nNodes] = next_rect_box;
+		out->nodeNumbers[out->nNodes] = i;
+		out->nNodes++;
+	}
+
+	MemoryContextSwitchTo(old_ctx);
+
+	PG_RETURN_VOID();
+}
+
+/*
+** SP-GiST support function. Test the box of a leaf geometry. The
+** operators only look at boxes, so there is nothing to recheck.
+*/
+PG_FUNCTION_INFO_V1(gserialized_spgist_leaf_consistent_2d);
+Datum gserialized_spgist_leaf_consistent_2d(PG_FUNCTION_ARGS)
+{
+	spgLeafConsistentIn *in = (spgLeafConsistentIn *) PG_GETARG_POINTER(0);
+	spgLeafConsistentOut *out = (spgLeafConsistentOut *) PG_GETARG_POINTER(1);
+	BOX2DF leaf_box, *key = &leaf_box;
+	bool empty, flag;
+	int j;
+
+	spgist_leaf_box2df(in->leafDatum, key);
+	empty = key->xmin > key->xmax;
+	flag = ! empty;
+
+	out->recheck = false;
+	out->leafValue = (Datum) 0;
+
+	for ( j = 0; flag && j < in->nkeys; j++ )
+	{
+		StrategyNumber strategy = in->scankeys[j].sk_strategy;
+		BOX2DF query;
+
+		if ( gserialized_datum_get_box2df_p(in->scankeys[j].sk_argument, &query) == LW_FAILURE )
+			PG_RETURN_BOOL(false);
+
+		switch ( strategy )
+		{
+			case RTOverlapStrategyNumber:
+				flag = box2df_overlaps(key, &query);
+				break;
+			case RTSameStrategyNumber:
+				flag = box2df_equals(key, &query);
+				break;
+			case RTContainsStrategyNumber:
+				flag = box2df_contains(key, &query);
+				break;
+			case RTContainedByStrategyNumber:
+				flag = box2df_within(key, &query);
+				break;
+			default:
+				elog(ERROR, "unrecognized strategy number: %d", strategy);
+		}
+	}
+
+	/* Scans with no conditions return the empties too */
+	if ( empty && in->nkeys == 0 )
+		flag = true;
+
+
+	PG_RETURN_BOOL(flag);
+}
+#endif /* POSTGIS_PGSQL_VERSION >= 96 */
+
 #if KOROTKOV_SPLIT > 0
 /*
  * Adjust BOX2DF b boundaries with insertion of addon.
@@ -29,6 +29,10 @@
 
 #include "../postgis_config.h"
 
+#if POSTGIS_PGSQL_VERSION >= 95
+#include "access/brin_tuple.h"  /* For BRIN */
+#endif
+
 #include "liblwgeom.h"         /* For standard geometry types. */
 #include "lwgeom_pg.h"       /* For debugging macros. */
 #include "gserialized_gist.h"	     /* For utility functions. */
@@ -81,6 +85,13 @@ Datum gserialized_overlaps(PG_FUNCTION_ARGS);
 Datum gserialized_contains(PG_FUNCTION_ARGS);
 Datum gserialized_within(PG_FUNCTION_ARGS);
 
+/*
+** BRIN prototypes
+*/
+Datum gserialized_brin_add_value(PG_FUNCTION_ARGS);
+Datum gserialized_brin_merge(PG_FUNCTION_ARGS);
+Datum gserialized_brin_overlaps(PG_FUNCTION_ARGS);
+
 /*
 ** GIDX true/false test function type
 */
@@ -1268,6 +1279,117 @@ Datum gserialized_gist_picksplit(PG_FUNCTION_ARGS)
 
 }
 
+#if POSTGIS_PGSQL_VERSION >= 95
+/***********************************************************************
+* BRIN N-D Index Support Functions
+**
+** The BRIN inclusion operator class keeps one GIDX per range of table
+** pages, the union of the boxes of all the rows in it. Empty geometries
+** have the "unknown" GIDX, which overlaps nothing and merges into
+** anything, and set the "contains empty" flag of their range.
+*/
+
+/*
+** BRIN support function. Grow the box of a page range to take in a
+** new geometry or geography. Returns true if the summary has changed.
+*/
+PG_FUNCTION_INFO_V1(gserialized_brin_add_value);
+Datum gserialized_brin_add_value(PG_FUNCTION_ARGS)
+{
+	BrinValues *column = (BrinValues *) PG_GETARG_POINTER(1);
+	Datum newval = PG_GETARG_DATUM(2);
+	bool isnull = PG_GETARG_BOOL(3);
+	char boxmem[GIDX_MAX_SIZE];
+	GIDX *gidx_geom = (GIDX*)boxmem;
+	GIDX *gidx_key, *gidx_union;
+
+	POSTGIS_DEBUG(4, "[BRIN] 'add_value' function called");
+
+	if ( isnull )
+	{
+		if ( column->bv_hasnulls )
+			PG_RETURN_BOOL(FALSE);
+		column->bv_hasnulls = TRUE;
+		PG_RETURN_BOOL(TRUE);
+	}
+
+	if ( gserialized_datum_get_gidx_p(newval, gidx_geom) == LW_FAILURE )
+		gidx_set_unknown(gidx_geom);
+
+	/* First value of the range */
+	if ( column->bv_allnulls )
+	{
+		column->bv_values[INCLUSION_UNION] = PointerGetDatum(gidx_copy(gidx_geom));
+		column->bv_values[INCLUSION_UNMERGEABLE] = BoolGetDatum(FALSE);
+		column->bv_values[INCLUSION_CONTAINS_EMPTY] = BoolGetDatum(gidx_is_unknown(gidx_geom));
+		column->bv_allnulls = FALSE;
+		PG_RETURN_BOOL(TRUE);
+	}
+
+	if ( gidx_is_unknown(gidx_geom) )
+	{
+		if ( DatumGetBool(column->bv_values[INCLUSION_CONTAINS_EMPTY]) )
+			PG_RETURN_BOOL(FALSE);
+		column->bv_values[INCLUSION_CONTAINS_EMPTY] = BoolGetDatum(TRUE);
+		PG_RETURN_BOOL(TRUE);
+	}
+
+	gidx_key = (GIDX*)DatumGetPointer(column->bv_values[INCLUSION_UNION]);
+	if ( gidx_contains(gidx_key, gidx_geom) )
+		PG_RETURN_BOOL(FALSE);
+
+	/* The new box may have more dimensions, so build a new union */
+	if ( gidx_is_unknown(gidx_key) )
+	{
+		gidx_union = gidx_copy(gidx_geom);
+	}
+	else
+	{
+		gidx_union = gidx_copy(gidx_key);
+		gidx_merge(&gidx_union, gidx_geom);
+	}
+	pfree(gidx_key);
+	column->bv_values[INCLUSION_UNION] = PointerGetDatum(gidx_union);
+	PG_RETURN_BOOL(TRUE);
+}
+
+/*
+** BRIN support function. Union of the boxes of two page ranges.
+*/
+PG_FUNCTION_INFO_V1(gserialized_brin_merge);
+Datum gserialized_brin_merge(PG_FUNCTION_ARGS)
+{
+	GIDX *a = (GIDX*)PG_GETARG_POINTER(0);
+	GIDX *b = (GIDX*)PG_GETARG_POINTER(1);
+	GIDX *result;
+
+	if ( gidx_is_unknown(a) )
+		PG_RETURN_POINTER(gidx_copy(b));
+
+	result = gidx_copy(a);
+	gidx_merge(&result, b);
+	PG_RETURN_POINTER(result);
+}
+
+/*
+** '&&' and '&&&' operator function between a stored box and a
+** geometry or geography.
+*/
+PG_FUNCTION_INFO_V1(gserialized_brin_overlaps);
+Datum gserialized_brin_overlaps(PG_FUNCTION_ARGS)
+{
+	GIDX *key = (GIDX*)PG_GETARG_POINTER(0);
+	char boxmem[GIDX_MAX_SIZE];
+	GIDX *query = (GIDX*)boxmem;
+
+	if ( gserialized_datum_get_gidx_p(PG_GETARG_DATUM(1), query) == LW_SUCCESS &&
+	     gidx_overlaps(key, query) )
+		PG_RETURN_BOOL(TRUE);
+
+	PG_RETURN_BOOL(FALSE);
+}
+#endif /* POSTGIS_PGSQL_VERSION >= 95 */
+
 /*
 ** The GIDX key must be defined as a PostgreSQL type, even though it is only
 ** ever used internally. These no-op stubs are used to bind the type.
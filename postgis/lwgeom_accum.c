@@ -13,9 +13,12 @@
 #include "postgres.h"
 #include "fmgr.h"
 #include "funcapi.h"
+#include "miscadmin.h"
+#include "access/htup_details.h"
 #include "access/tupmacs.h"
 #include "utils/array.h"
 #include "utils/lsyscache.h"
+#include "utils/memutils.h"
 
 #include "../postgis_config.h"
 
@@ -27,6 +30,12 @@ Datum PGISDirectFunctionCall1(PGFunction func, Datum arg1);
 Datum pgis_geometry_accum_transfn(PG_FUNCTION_ARGS);
 Datum pgis_geometry_accum_finalfn(PG_FUNCTION_ARGS);
 Datum pgis_geometry_union_finalfn(PG_FUNCTION_ARGS);
+Datum pgis_geometry_union_parallel_transfn(PG_FUNCTION_ARGS);
+Datum pgis_geometry_union_parallel_combinefn(PG_FUNCTION_ARGS);
+Datum pgis_geometry_union_parallel_serialfn(PG_FUNCTION_ARGS);
+Datum pgis_geometry_union_parallel_deserialfn(PG_FUNCTION_ARGS);
+Datum pgis_geometry_union_parallel_finalfn(PG_FUNCTION_ARGS);
+Datum postgis_union_stats(PG_FUNCTION_ARGS);
 Datum pgis_geometry_collect_finalfn(PG_FUNCTION_ARGS);
 Datum pgis_twkb_accum_finalfn(PG_FUNCTION_ARGS);
 Datum pgis_twkb_accum_transfn(PG_FUNCTION_ARGS);
@@ -317,6 +326,428 @@ pgis_geometry_union_finalfn(PG_FUNCTION_ARGS)
 	PG_RETURN_DATUM(result);
 }
 
+/**
+** ST_Union does not keep every input until the final function.
+** Inputs are buffered until they use work_mem, then unioned into
+** a partial result. Partial results are merged like the digits
+** of a binary counter, two partials of the same rank making one
+** of the next rank, so every input goes through a logarithmic
+** number of unions and at most one partial per rank is held.
+**
+** The state can be serialized and combined, so on PostgreSQL 9.6
+** and later the aggregate runs in parallel workers, each of them
+** unioning its share of the rows.
+*/
+
+#define UNION_MAX_RANKS 48
+
+typedef struct
+{
+	Oid typoid;        /* Input type, to build arrays of it */
+	int nbatch;        /* Inputs buffered */
+	int maxbatch;
+	GSERIALIZED **batch;
+	Size batch_memory; /* Bytes of the buffered inputs */
+	GSERIALIZED *partials[UNION_MAX_RANKS]; /* Union of 2^rank batches, or NULL */
+	Size memory;       /* Bytes of inputs and partials held */
+	Size peak_memory;
+}
+union_state;
+
+/* Serialized state, followed by the union of its geometries if any */
+typedef struct
+{
+	Oid typoid;
+	uint64 peak_memory;
+}
+union_state_header;
+
+/* Backend-wide counters for postgis_union_stats() */
+typedef struct
+{
+	int64 aggregates;
+	int64 batches;
+	int64 merges;
+	int64 last_peak_memory;
+	int64 peak_memory;
+}
+union_stats_t;
+
+static union_stats_t union_stats = { 0, 0, 0, 0, 0 };
+
+static union_state*
+union_state_new(Oid typoid)
+{
+	union_state *state = palloc0(sizeof(union_state));
+	state->typoid = typoid;
+	state->maxbatch = 16;
+	state->batch = palloc(sizeof(GSERIALIZED*) * state->maxbatch);
+	return state;
+}
+
+/**
+** Union of a list of geometries through the array union, so the
+** aggregate handles NULLs, empties and SRIDs just like ST_Union(geometry[]).
+** Returns NULL for no result, allocated in the current memory context.
+*/
+static GSERIALIZED*
+union_geometry_list(Oid typoid, GSERIALIZED **geoms, int ngeoms)
+{
+	Datum *elems = palloc(sizeof(Datum) * ngeoms);
+	ArrayType *array;
+	Datum result;
+	int i;
+
+	for ( i = 0; i < ngeoms; i++ )
+		elems[i] = PointerGetDatum(geoms[i]);
+
+	array = construct_array(elems, ngeoms, typoid, -1, false, 'd');
+	result = PGISDirectFunctionCall1(pgis_union_geometry_array, PointerGetDatum(array));
+	if ( ! result )
+		return NULL;
+
+	return (GSERIALIZED*)PG_DETOAST_DATUM(result);
+}
+
+static void
+union_state_track_memory(union_state *state)
+{
+	if ( state->memory > state->peak_memory )
+		state->peak_memory = state->memory;
+}
+
+/* Union the buffered inputs into a rank 0 partial and carry it up */
+static void
+union_state_flush(union_state *state, MemoryContext aggcontext)
+{
+	MemoryContext tmpcontext, oldcontext;
+	GSERIALIZED *partial;
+	GSERIALIZED *pair[2];
+	int i, rank;
+
+	if ( state->nbatch == 0 )
+		return;
+
+	/* The conversions to and from GEOS leave a lot behind, drop it all at once */
+	tmpcontext = AllocSetContextCreate(CurrentMemoryContext,
+	                                   "PostGIS ST_Union batch",
+	                                   ALLOCSET_DEFAULT_MINSIZE,
+	                                   ALLOCSET_DEFAULT_INITSIZE,
+	                                   ALLOCSET_DEFAULT_MAXSIZE);
+	oldcontext = MemoryContextSwitchTo(tmpcontext);
+
+	partial = union_geometry_list(state->typoid, state->batch, state->nbatch);
+	union_stats.batches++;
+
+	for ( i = 0; i < state->nbatch; i++ )
+		pfree(state->batch[i]);
+	state->memory -= state->batch_memory;
+	state->batch_memory = 0;
+	state->nbatch = 0;
+
+	/* Past the last rank, which takes 2^47 batches, keep merging into it */
+	rank = 0;
+	while ( partial && state->partials[rank] )
+	{
+		pair[0] = state->partials[rank];
+		pair[1] = partial;
+		partial = union_geometry_list(state->typoid, pair, 2);
+		union_stats.merges++;
+
+		state->memory -= VARSIZE(state->partials[rank]);
+		pfree(state->partials[rank]);
+		state->partials[rank] = NULL;
+		if ( rank < UNION_MAX_RANKS - 1 )
+			rank++;
+	}
+
+	if ( partial )
+	{
+		MemoryContextSwitchTo(aggcontext);
+		state->partials[rank] = palloc(VARSIZE(partial));
+		memcpy(state->partials[rank], partial, VARSIZE(partial));
+		state->memory += VARSIZE(partial);
+		union_state_track_memory(state);
+	}
+
+	MemoryContextSwitchTo(oldcontext);
+	MemoryContextDelete(tmpcontext);
+}
+
+/* Buffer a copy of geom, unioning the batch once it fills work_mem */
+static void
+union_state_add(union_state *state, const GSERIALIZED *geom, MemoryContext aggcontext)
+{
+	MemoryContext oldcontext = MemoryContextSwitchTo(aggcontext);
+	Size size = VARSIZE(geom);
+
+	if ( state->nbatch == state->maxbatch )
+	{
+		state->maxbatch *= 2;
+		state->batch = repalloc(state->batch, sizeof(GSERIALIZED*) * state->maxbatch);
+	}
+	state->batch[state->nbatch] = palloc(size);
+	memcpy(state->batch[state->nbatch], geom, size);
+	state->nbatch++;
+	state->batch_memory += size;
+	state->memory += size;
+	union_state_track_memory(state);
+
+	MemoryContextSwitchTo(oldcontext);
+
+	if ( state->batch_memory >= (Size)work_mem * 1024L )
+		union_state_flush(state, aggcontext);
+}
+
+/**
+** Union of everything in the state, without changing it: window
+** aggregates call the final function more than once. Older partials
+** go first, and an aggregate that never filled a batch unions its
+** inputs in their original order.
+*/
+static GSERIALIZED*
+union_state_union(const union_state *state)
+{
+	GSERIALIZED **geoms = palloc(sizeof(GSERIALIZED*) * (state->nbatch + UNION_MAX_RANKS));
+	int ngeoms = 0;
+	int i;
+
+	for ( i = UNION_MAX_RANKS - 1; i >= 0; i-- )
+	{
+		if ( state->partials[i] )
+			geoms[ngeoms++] = state->partials[i];
+	}
+	for ( i = 0; i < state->nbatch; i++ )
+		geoms[ngeoms++] = state->batch[i];
+
+	if ( ngeoms == 0 )
+		return NULL;
+
+	return union_geometry_list(state->typoid, geoms, ngeoms);
+}
+
+/**
+** The ST_Union transfer function buffers and unions its inputs in
+** the aggregate memory context. NULL inputs are skipped.
+*/
+PG_FUNCTION_INFO_V1(pgis_geometry_union_parallel_transfn);
+Datum
+pgis_geometry_union_parallel_transfn(PG_FUNCTION_ARGS)
+{
+	MemoryContext aggcontext, oldcontext;
+	union_state *state;
+	Oid typoid;
+
+	if ( ! AggCheckCallContext(fcinfo, &aggcontext) )
+	{
+		/* cannot be called directly because of internal-type argument */
+		elog(ERROR, "pgis_geometry_union_parallel_transfn called in non-aggregate context");
+		aggcontext = NULL;  /* keep compiler quiet */
+	}
+
+	state = PG_ARGISNULL(0) ? NULL : (union_state*) PG_GETARG_POINTER(0);
+
+	if ( PG_ARGISNULL(1) )
+	{
+		if ( ! state )
+			PG_RETURN_NULL();
+		PG_RETURN_POINTER(state);
+	}
+
+	if ( ! state )
+	{
+		typoid = get_fn_expr_argtype(fcinfo->flinfo, 1);
+		if ( typoid == InvalidOid )
+			ereport(ERROR,
+			        (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+			         errmsg("could not determine input data type")));
+
+		oldcontext = MemoryContextSwitchTo(aggcontext);
+		state = union_state_new(typoid);
+		MemoryContextSwitchTo(oldcontext);
+	}
+
+	union_state_add(state, (GSERIALIZED*)PG_DETOAST_DATUM(PG_GETARG_DATUM(1)), aggcontext);
+
+	PG_RETURN_POINTER(state);
+}
+
+/**
+** The combine function feeds the geometries of the second state
+** into the first, which may not exist yet.
+*/
+PG_FUNCTION_INFO_V1(pgis_geometry_union_parallel_combinefn);
+Datum
+pgis_geometry_union_parallel_combinefn(PG_FUNCTION_ARGS)
+{
+	MemoryContext aggcontext, oldcontext;
+	union_state *state1, *state2;
+	int i;
+
+	if ( ! AggCheckCallContext(fcinfo, &aggcontext) )
+	{
+		elog(ERROR, "pgis_geometry_union_parallel_combinefn called in non-aggregate context");
+		aggcontext = NULL;  /* keep compiler quiet */
+	}
+
+	state1 = PG_ARGISNULL(0) ? NULL : (union_state*) PG_GETARG_POINTER(0);
+	state2 = PG_ARGISNULL(1) ? NULL : (union_state*) PG_GETARG_POINTER(1);
+
+	if ( ! state2 )
+	{
+		if ( ! state1 )
+			PG_RETURN_NULL();
+		PG_RETURN_POINTER(state1);
+	}
+
+	/* The second state may live in a short-lived context, never hand it back */
+	if ( ! state1 )
+	{
+		oldcontext = MemoryContextSwitchTo(aggcontext);
+		state1 = union_state_new(state2->typoid);
+		MemoryContextSwitchTo(oldcontext);
+	}
+
+	for ( i = UNION_MAX_RANKS - 1; i >= 0; i-- )
+	{
+		if ( state2->partials[i] )
+			union_state_add(state1, state2->partials[i], aggcontext);
+	}
+	for ( i = 0; i < state2->nbatch; i++ )
+		union_state_add(state1, state2->batch[i], aggcontext);
+
+	if ( state2->peak_memory > state1->peak_memory )
+		state1->peak_memory = state2->peak_memory;
+
+	PG_RETURN_POINTER(state1);
+}
+
+/**
+** The serialization function unions the whole state, so that
+** workers hand a single geometry to the leader.
+*/
+PG_FUNCTION_INFO_V1(pgis_geometry_union_parallel_serialfn);
+Datum
+pgis_geometry_union_parallel_serialfn(PG_FUNCTION_ARGS)
+{
+	union_state *state;
+	union_state_header header;
+	GSERIALIZED *geom;
+	Size size;
+	bytea *result;
+
+	if ( ! AggCheckCallContext(fcinfo, NULL) )
+		elog(ERROR, "pgis_geometry_union_parallel_serialfn called in non-aggregate context");
+
+	state = (union_state*) PG_GETARG_POINTER(0);
+	geom = union_state_union(state);
+
+	header.typoid = state->typoid;
+	header.peak_memory = state->peak_memory;
+
+	size = VARHDRSZ + sizeof(union_state_header) + (geom ? VARSIZE(geom) : 0);
+	result = palloc(size);
+	SET_VARSIZE(result, size);
+	memcpy(VARDATA(result), &header, sizeof(union_state_header));
+	if ( geom )
+		memcpy(VARDATA(result) + sizeof(union_state_header), geom, VARSIZE(geom));
+
+	PG_RETURN_BYTEA_P(result);
+}
+
+PG_FUNCTION_INFO_V1(pgis_geometry_union_parallel_deserialfn);
+Datum
+pgis_geometry_union_parallel_deserialfn(PG_FUNCTION_ARGS)
+{
+	bytea *serialized;
+	union_state *state;
+	union_state_header header;
+	Size size;
+
+	if ( ! AggCheckCallContext(fcinfo, NULL) )
+		elog(ERROR, "pgis_geometry_union_parallel_deserialfn called in non-aggregate context");
+
+	serialized = PG_GETARG_BYTEA_P(0);
+	size = VARSIZE(serialized) - VARHDRSZ;
+	if ( size < sizeof(union_state_header) )
+		elog(ERROR, "pgis_geometry_union_parallel_deserialfn: invalid state of %lu bytes", (unsigned long)size);
+
+	memcpy(&header, VARDATA(serialized), sizeof(union_state_header));
+	state = union_state_new(header.typoid);
+	state->peak_memory = header.peak_memory;
+
+	/* Copy the geometry out, the bytea gives it no alignment */
+	size -= sizeof(union_state_header);
+	if ( size > 0 )
+	{
+		state->batch[0] = palloc(size);
+		memcpy(state->batch[0], VARDATA(serialized) + sizeof(union_state_header), size);
+		state->nbatch = 1;
+		state->batch_memory = state->memory = size;
+	}
+
+	PG_RETURN_POINTER(state);
+}
+
+/**
+** The final function unions what is left, and records the memory
+** the aggregate held for postgis_union_stats().
+*/
+PG_FUNCTION_INFO_V1(pgis_geometry_union_parallel_finalfn);
+Datum
+pgis_geometry_union_parallel_finalfn(PG_FUNCTION_ARGS)
+{
+	union_state *state;
+	GSERIALIZED *result;
+
+	if (PG_ARGISNULL(0))
+		PG_RETURN_NULL();   /* returns null iff no input values */
+
+	state = (union_state*) PG_GETARG_POINTER(0);
+
+	union_stats.aggregates++;
+	union_stats.last_peak_memory = state->peak_memory;
+	if ( union_stats.last_peak_memory > union_stats.peak_memory )
+		union_stats.peak_memory = union_stats.last_peak_memory;
+
+	result = union_state_union(state);
+	if ( ! result )
+		PG_RETURN_NULL();
+
+	PG_RETURN_POINTER(result);
+}
+
+/**
+ * postgis_union_stats(OUT aggregates, OUT batches, OUT merges, OUT last_peak_memory, OUT peak_memory)
+ * Report the ST_Union aggregate counters accumulated by this backend.
+ */
+PG_FUNCTION_INFO_V1(postgis_union_stats);
+Datum postgis_union_stats(PG_FUNCTION_ARGS)
+{
+	TupleDesc tupdesc;
+	HeapTuple tuple;
+	Datum values[5];
+	bool isnull[5] = { false, false, false, false, false };
+
+	if ( get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE )
+	{
+		ereport(ERROR, (
+		            errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+		            errmsg("function returning record called in context "
+		                   "that cannot accept type record")));
+	}
+	tupdesc = BlessTupleDesc(tupdesc);
+
+	values[0] = Int64GetDatum(union_stats.aggregates);
+	values[1] = Int64GetDatum(union_stats.batches);
+	values[2] = Int64GetDatum(union_stats.merges);
+	values[3] = Int64GetDatum(union_stats.last_peak_memory);
+	values[4] = Int64GetDatum(union_stats.peak_memory);
+
+	tuple = heap_form_tuple(tupdesc, values, isnull);
+	PG_RETURN_DATUM(HeapTupleGetDatum(tuple));
+}
+
 /**
 * The "collect" final function passes the geometry[] to a geometrycollection
 * conversion before returning the result.
@@ -284,18 +284,18 @@ PG_FUNCTION_INFO_V1(LWGEOM_to_BOX3D);
 Datum LWGEOM_to_BOX3D(PG_FUNCTION_ARGS)
 {
 	GSERIALIZED *geom = (GSERIALIZED *)PG_DETOAST_DATUM(PG_GETARG_DATUM(0));
-	LWGEOM *lwgeom = lwgeom_from_gserialized(geom);
 	GBOX gbox;
 	BOX3D *result;
-	int rv = lwgeom_calculate_gbox(lwgeom, &gbox);
+	/* Read the coordinates in place, no need to deserialize */
+	int rv = gserialized_calculate_gbox_cartesian_p(geom, &gbox);
 
 	if ( rv == LW_FAILURE )
 		PG_RETURN_NULL();
 		
 	result = box3d_from_gbox(&gbox);
-	result->srid = lwgeom->srid;
+	result->srid = gserialized_get_srid(geom);
 
-	lwgeom_free(lwgeom);
+	PG_FREE_IF_COPY(geom, 0);
 	PG_RETURN_POINTER(result);
 }
 
@@ -22,6 +22,10 @@
 #include "utils/geo_decls.h"
 
 #include "../postgis_config.h"
+
+#if POSTGIS_PGSQL_VERSION >= 95
+#include "utils/sortsupport.h"
+#endif
 #include "liblwgeom.h"
 #include "lwgeom_pg.h"
 
@@ -37,6 +41,14 @@ Datum lwgeom_eq(PG_FUNCTION_ARGS);
 Datum lwgeom_ge(PG_FUNCTION_ARGS);
 Datum lwgeom_gt(PG_FUNCTION_ARGS);
 Datum lwgeom_cmp(PG_FUNCTION_ARGS);
+Datum lwgeom_hilbert_lt(PG_FUNCTION_ARGS);
+Datum lwgeom_hilbert_le(PG_FUNCTION_ARGS);
+Datum lwgeom_hilbert_eq(PG_FUNCTION_ARGS);
+Datum lwgeom_hilbert_ge(PG_FUNCTION_ARGS);
+Datum lwgeom_hilbert_gt(PG_FUNCTION_ARGS);
+Datum lwgeom_hilbert_cmp(PG_FUNCTION_ARGS);
+Datum lwgeom_hilbert_sortsupport(PG_FUNCTION_ARGS);
+Datum ST_GeoHilbertKey(PG_FUNCTION_ARGS);
 
 
 #define BTREE_SRID_MISMATCH_SEVERITY ERROR
@@ -395,3 +407,168 @@ Datum lwgeom_cmp(PG_FUNCTION_ARGS)
 	PG_RETURN_INT32(0);
 }
 
+
+/*
+** Space-filling curve order. The order above sorts on xmin first,
+** so features next to each other on the map can end up far apart
+** in a sort. This one sorts on the position of the box center along
+** a Hilbert curve, so CLUSTER or an ORDER BY keep neighbours on
+** neighbouring pages. Empty geometries sort first, and geometries
+** whose centers share a cell of the curve compare equal.
+*/
+
+/*
+** Hilbert key of a geometry datum, LW_FAILURE if it is empty. Only
+** the head of big geometries is read, where their box is.
+*/
+static int
+gserialized_datum_get_hilbert_key(Datum d, uint64_t *key)
+{
+	GSERIALIZED *head = gserialized_datum_get_head(d);
+	GSERIALIZED *g;
+	GBOX box;
+	POINT2D center;
+	int result;
+
+	if ( gserialized_has_bbox(head) )
+	{
+		result = gserialized_get_gbox_p(head, &box);
+	}
+	else
+	{
+		/* Points carry no box, they are small enough to read whole */
+		g = gserialized_datum_get_full(d, head);
+		result = gserialized_get_gbox_p(g, &box);
+		if ( g != head )
+			pfree(g);
+	}
+
+	if ( (Pointer)head != DatumGetPointer(d) )
+		pfree(head);
+
+	if ( result == LW_FAILURE )
+		return LW_FAILURE;
+
+	center.x = (box.xmin + box.xmax) / 2.0;
+	center.y = (box.ymin + box.ymax) / 2.0;
+	*key = hilbert_float_point_as_int(&center);
+	return LW_SUCCESS;
+}
+
+static int
+lwgeom_hilbert_cmp_datum(Datum d1, Datum d2)
+{
+	uint64_t key1 = 0, key2 = 0;
+	int empty1 = gserialized_datum_get_hilbert_key(d1, &key1) == LW_FAILURE;
+	int empty2 = gserialized_datum_get_hilbert_key(d2, &key2) == LW_FAILURE;
+
+	if ( empty1 || empty2 )
+		return empty2 - empty1;
+
+	return key1 < key2 ? -1 : (key1 > key2 ? 1 : 0);
+}
+
+PG_FUNCTION_INFO_V1(lwgeom_hilbert_lt);
+Datum lwgeom_hilbert_lt(PG_FUNCTION_ARGS)
+{
+	PG_RETURN_BOOL(lwgeom_hilbert_cmp_datum(PG_GETARG_DATUM(0), PG_GETARG_DATUM(1)) < 0);
+}
+
+PG_FUNCTION_INFO_V1(lwgeom_hilbert_le);
+Datum lwgeom_hilbert_le(PG_FUNCTION_ARGS)
+{
+	PG_RETURN_BOOL(lwgeom_hilbert_cmp_datum(PG_GETARG_DATUM(0), PG_GETARG_DATUM(1)) <= 0);
+}
+
+PG_FUNCTION_INFO_V1(lwgeom_hilbert_eq);
+Datum lwgeom_hilbert_eq(PG_FUNCTION_ARGS)
+{
+	PG_RETURN_BOOL(lwgeom_hilbert_cmp_datum(PG_GETARG_DATUM(0), PG_GETARG_DATUM(1)) == 0);
+}
+
+PG_FUNCTION_INFO_V1(lwgeom_hilbert_ge);
+Datum lwgeom_hilbert_ge(PG_FUNCTION_ARGS)
+{
+	PG_RETURN_BOOL(lwgeom_hilbert_cmp_datum(PG_GETARG_DATUM(0), PG_GETARG_DATUM(1)) >= 0);
+}
+
+PG_FUNCTION_INFO_V1(lwgeom_hilbert_gt);
+Datum lwgeom_hilbert_gt(PG_FUNCTION_ARGS)
+{
+	PG_RETURN_BOOL(lwgeom_hilbert_cmp_datum(PG_GETARG_DATUM(0), PG_GETARG_DATUM(1)) > 0);
+}
+
+PG_FUNCTION_INFO_V1(lwgeom_hilbert_cmp);
+Datum lwgeom_hilbert_cmp(PG_FUNCTION_ARGS)
+{
+	PG_RETURN_INT32(lwgeom_hilbert_cmp_datum(PG_GETARG_DATUM(0), PG_GETARG_DATUM(1)));
+}
+
+#if POSTGIS_PGSQL_VERSION >= 95
+static int
+lwgeom_hilbert_cmp_full(Datum d1, Datum d2, SortSupport ssup)
+{
+	return lwgeom_hilbert_cmp_datum(d1, d2);
+}
+
+#if SIZEOF_DATUM == 8
+/*
+** Sorts compare the keys themselves, and only go back to the
+** geometries on ties, as empties and the first cell both get 0.
+*/
+static Datum
+lwgeom_hilbert_abbrev_convert(Datum original, SortSupport ssup)
+{
+	uint64_t key = 0;
+	gserialized_datum_get_hilbert_key(original, &key);
+	return (Datum)key;
+}
+
+static int
+lwgeom_hilbert_cmp_abbrev(Datum d1, Datum d2, SortSupport ssup)
+{
+	return d1 < d2 ? -1 : (d1 > d2 ? 1 : 0);
+}
+
+static bool
+lwgeom_hilbert_abbrev_abort(int memtupcount, SortSupport ssup)
+{
+	return false;
+}
+#endif
+
+PG_FUNCTION_INFO_V1(lwgeom_hilbert_sortsupport);
+Datum lwgeom_hilbert_sortsupport(PG_FUNCTION_ARGS)
+{
+	SortSupport ssup = (SortSupport) PG_GETARG_POINTER(0);
+
+	ssup->comparator = lwgeom_hilbert_cmp_full;
+#if SIZEOF_DATUM == 8
+	if ( ssup->abbreviate )
+	{
+		ssup->comparator = lwgeom_hilbert_cmp_abbrev;
+		ssup->abbrev_converter = lwgeom_hilbert_abbrev_convert;
+		ssup->abbrev_abort = lwgeom_hilbert_abbrev_abort;
+		ssup->abbrev_full_comparator = lwgeom_hilbert_cmp_full;
+	}
+#endif
+
+	PG_RETURN_VOID();
+}
+#endif
+
+/**
+* ST_GeoHilbertKey(geometry) returns the position of the center of the
+* box along the Hilbert curve through the grid of float coordinates,
+* shifted so that bigint order follows the curve. NULL for empties.
+*/
+PG_FUNCTION_INFO_V1(ST_GeoHilbertKey);
+Datum ST_GeoHilbertKey(PG_FUNCTION_ARGS)
+{
+	uint64_t key;
+
+	if ( gserialized_datum_get_hilbert_key(PG_GETARG_DATUM(0), &key) == LW_FAILURE )
+		PG_RETURN_NULL();
+
+	PG_RETURN_INT64((int64)(key ^ UINT64CONST(0x8000000000000000)));
+}
@@ -1280,6 +1280,157 @@ int point_in_multipolygon(LWMPOLY *mpolygon, LWPOINT *point)
 	return result;
 }
 
+/*
+ * Same as point_in_multipolygon, but reads the rings of a serialized
+ * polygon or multipolygon in place instead of deserializing it first.
+ * return -1 iff point outside (multi)polygon
+ * return 0 iff point on (multi)polygon boundary
+ * return 1 iff point inside (multi)polygon
+ */
+int point_in_gserialized_polygon(const GSERIALIZED *gpoly, LWPOINT *point)
+{
+	GSERIALIZED_ITERATOR it;
+	POINTARRAY ring;
+	int result = -1;
+	int skip = LW_FALSE;
+	int in_ring;
+	POINT2D pt;
+
+	POSTGIS_DEBUG(2, "point_in_gserialized_polygon called.");
+
+	getPoint2d_p(point->point, 0, &pt);
+	/* assume bbox short-circuit has already been attempted */
+
+	gserialized_iterator_init(&it, gpoly);
+	while ( gserialized_iterator_next(&it, &ring) )
+	{
+		if ( it.ring == 0 )
+		{
+			/* Inside the previous polygon and none of its holes */
+			if ( result != -1 )
+				return result;
+
+			in_ring = point_in_ring(&ring, &pt);
+			if ( in_ring == -1 ) /* outside the exterior ring */
+			{
+				POSTGIS_DEBUG(3, "point_in_gserialized_polygon: outside exterior ring.");
+				skip = LW_TRUE;
+				continue;
+			}
+			if ( in_ring == 0 )
+			{
+				return 0;
+			}
+			result = in_ring;
+			skip = LW_FALSE;
+		}
+		else if ( ! skip )
+		{
+			in_ring = point_in_ring(&ring, &pt);
+			if (in_ring == 1) /* inside a hole => outside the polygon */
+			{
+				POSTGIS_DEBUGF(3, "point_in_gserialized_polygon: within hole %d.", it.ring);
+				result = -1;
+				skip = LW_TRUE;
+			}
+			else if (in_ring == 0) /* on the edge of a hole */
+			{
+				POSTGIS_DEBUGF(3, "point_in_gserialized_polygon: on edge of hole %d.", it.ring);
+				return 0;
+			}
+		}
+	}
+	return result;
+}
+
+/*
+ * Batched point_in_multipolygon_rtree for all the points of a multipoint,
+ * using the rings kept next to the cached rtrees. Each ring is tested
+ * once against all the points still undecided, with
+ * ptarray_contains_points. Fills results with
+ * -1 iff point outside (multi)polygon (empty points too)
+ * 0 iff point on (multi)polygon boundary
+ * 1 iff point inside (multi)polygon
+ */
+void points_in_multipolygon_cache(const RTREE_POLY_CACHE *cache, const LWMPOINT *mpoint, int *results)
+{
+	int n = mpoint->ngeoms;
+	POINT2D *pts = lwalloc(sizeof(POINT2D) * n);
+	int *open = lwalloc(sizeof(int) * n);   /* points not decided yet */
+	int *cand = lwalloc(sizeof(int) * n);   /* points inside the current shell */
+	int *status = lwalloc(sizeof(int) * n);
+	int nopen = 0, ncand, ring = 0;
+	int i, j, k, p, r;
+
+	POSTGIS_DEBUGF(2, "points_in_multipolygon_cache called for %d points.", n);
+
+	for ( i = 0; i < n; i++ )
+	{
+		results[i] = -1;
+		if ( ! lwpoint_is_empty(mpoint->geoms[i]) )
+			open[nopen++] = i;
+	}
+
+	for ( p = 0; p < cache->polyCount && nopen > 0; p++ )
+	{
+		for ( j = 0; j < nopen; j++ )
+			getPoint2d_p(mpoint->geoms[open[j]]->point, 0, &pts[j]);
+
+		/* Exterior ring: settle the points on it, keep the ones inside */
+		ptarray_contains_points(cache->rings[ring], pts, nopen, status);
+		ncand = 0;
+		for ( j = 0; j < nopen; j++ )
+		{
+			if ( status[j] == LW_BOUNDARY )
+			{
+				results[open[j]] = 0;
+			}
+			else if ( status[j] == LW_INSIDE )
+			{
+				cand[ncand] = open[j];
+				pts[ncand++] = pts[j];
+			}
+		}
+
+		/* Holes: inside one means outside this polygon, on one is the boundary */
+		for ( r = 1; r < cache->ringCounts[p] && ncand > 0; r++ )
+		{
+			ptarray_contains_points(cache->rings[ring + r], pts, ncand, status);
+			k = 0;
+			for ( j = 0; j < ncand; j++ )
+			{
+				if ( status[j] == LW_BOUNDARY )
+				{
+					results[cand[j]] = 0;
+				}
+				else if ( status[j] == LW_OUTSIDE )
+				{
+					cand[k] = cand[j];
+					pts[k++] = pts[j];
+				}
+			}
+			ncand = k;
+		}
+
+		for ( j = 0; j < ncand; j++ )
+			results[cand[j]] = 1;
+
+		/* Only the points still outside go on to the next polygon */
+		k = 0;
+		for ( j = 0; j < nopen; j++ )
+		{
+			if ( results[open[j]] == -1 )
+				open[k++] = open[j];
+		}
+		nopen = k;
+		ring += cache->ringCounts[p];
+	}
+
+	lwfree(pts);
+	lwfree(open);
+	lwfree(cand);
+	lwfree(status);
+}
 
 /*******************************************************************************
  * End of "Fast Winding Number Inclusion of a Point in a Polygon" derivative.
@@ -20,4 +20,6 @@ int point_in_polygon_rtree(RTREE_NODE **root, int ringCount, LWPOINT *point);
 int point_in_multipolygon_rtree(RTREE_NODE **root, int polyCount, int *ringCounts, LWPOINT *point);
 int point_in_polygon(LWPOLY *polygon, LWPOINT *point);
 int point_in_multipolygon(LWMPOLY *mpolygon, LWPOINT *pont);
+int point_in_gserialized_polygon(const GSERIALIZED *gpoly, LWPOINT *point);
+void points_in_multipolygon_cache(const RTREE_POLY_CACHE *cache, const LWMPOINT *mpoint, int *results);
 
@@ -12,12 +12,16 @@
 
 #include "postgres.h"
 #include "fmgr.h"
+#include "funcapi.h"
+#include "access/htup_details.h"
 #include "utils/elog.h"
 #include "utils/array.h"
 #include "utils/geo_decls.h"
 
 #include "liblwgeom_internal.h"
 #include "lwgeom_pg.h"
+#include "lwgeom_cache.h"
+#include "lwgeom_rectree.h"
 
 #include <math.h>
 #include <float.h>
@@ -38,6 +42,7 @@ Datum postgis_lib_version(PG_FUNCTION_ARGS);
 Datum postgis_svn_version(PG_FUNCTION_ARGS);
 Datum postgis_libxml_version(PG_FUNCTION_ARGS);
 Datum postgis_lib_build_date(PG_FUNCTION_ARGS);
+Datum postgis_geom_cache_stats(PG_FUNCTION_ARGS);
 Datum LWGEOM_length2d_linestring(PG_FUNCTION_ARGS);
 Datum LWGEOM_length_linestring(PG_FUNCTION_ARGS);
 Datum LWGEOM_perimeter2d_poly(PG_FUNCTION_ARGS);
@@ -206,16 +211,52 @@ Datum postgis_libxml_version(PG_FUNCTION_ARGS)
 	PG_RETURN_TEXT_P(result);
 }
 
+/**
+ * postgis_geom_cache_stats(OUT ident_hits, OUT hash_hits, OUT misses, OUT builds, OUT deferred, OUT wasted, OUT evictions, OUT copied, OUT shared_hits, OUT published)
+ * Report the geometry index cache counters accumulated by this backend.
+ */
+PG_FUNCTION_INFO_V1(postgis_geom_cache_stats);
+Datum postgis_geom_cache_stats(PG_FUNCTION_ARGS)
+{
+	const GeomCacheStats *stats = GetGeomCacheStats();
+	TupleDesc tupdesc;
+	HeapTuple tuple;
+	Datum values[10];
+	bool isnull[10] = { false, false, false, false, false, false, false, false, false, false };
+
+	if ( get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE )
+	{
+		ereport(ERROR, (
+		            errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+		            errmsg("function returning record called in context "
+		                   "that cannot accept type record")));
+	}
+	tupdesc = BlessTupleDesc(tupdesc);
+
+	values[0] = Int64GetDatum(stats->ident_hits);
+	values[1] = Int64GetDatum(stats->hash_hits);
+	values[2] = Int64GetDatum(stats->misses);
+	values[3] = Int64GetDatum(stats->builds);
+	values[4] = Int64GetDatum(stats->deferred);
+	values[5] = Int64GetDatum(stats->wasted);
+	values[6] = Int64GetDatum(stats->evictions);
+	values[7] = Int64GetDatum(stats->copied);
+	values[8] = Int64GetDatum(stats->shared_hits);
+	values[9] = Int64GetDatum(stats->published);
+
+	tuple = heap_form_tuple(tupdesc, values, isnull);
+	PG_RETURN_DATUM(HeapTupleGetDatum(tuple));
+}
+
 /** number of points in an object */
 PG_FUNCTION_INFO_V1(LWGEOM_npoints);
 Datum LWGEOM_npoints(PG_FUNCTION_ARGS)
 {
 	GSERIALIZED *geom = (GSERIALIZED *)PG_DETOAST_DATUM(PG_GETARG_DATUM(0));
-	LWGEOM *lwgeom = lwgeom_from_gserialized(geom);
 	int npoints = 0;
 
-	npoints = lwgeom_count_vertices(lwgeom);
-	lwgeom_free(lwgeom);
+	/* Count straight off the serialization, no need to deserialize */
+	npoints = gserialized_count_vertices(geom);
 
 	PG_FREE_IF_COPY(geom, 0);
 	PG_RETURN_INT32(npoints);
@@ -246,14 +287,13 @@ PG_FUNCTION_INFO_V1(LWGEOM_area_polygon);
 Datum LWGEOM_area_polygon(PG_FUNCTION_ARGS)
 {
 	GSERIALIZED *geom = (GSERIALIZED *)PG_DETOAST_DATUM(PG_GETARG_DATUM(0));
-	LWGEOM *lwgeom = lwgeom_from_gserialized(geom);
 	double area = 0.0;
 
 	POSTGIS_DEBUG(2, "in LWGEOM_area_polygon");
 
-	area = lwgeom_area(lwgeom);
+	/* Read the rings in place, no need to deserialize */
+	area = gserialized_area(geom);
 
-	lwgeom_free(lwgeom);	
 	PG_FREE_IF_COPY(geom, 0);
 	
 	PG_RETURN_FLOAT8(area);
@@ -270,9 +310,7 @@ PG_FUNCTION_INFO_V1(LWGEOM_length2d_linestring);
 Datum LWGEOM_length2d_linestring(PG_FUNCTION_ARGS)
 {
 	GSERIALIZED *geom = (GSERIALIZED *)PG_DETOAST_DATUM(PG_GETARG_DATUM(0));
-	LWGEOM *lwgeom = lwgeom_from_gserialized(geom);
-	double dist = lwgeom_length_2d(lwgeom);
-	lwgeom_free(lwgeom);
+	double dist = gserialized_length_2d(geom);
 	PG_FREE_IF_COPY(geom, 0);
 	PG_RETURN_FLOAT8(dist);
 }
@@ -678,6 +716,31 @@ Datum LWGEOM_longestline2d(PG_FUNCTION_ARGS)
 	PG_FREE_IF_COPY(geom2, 1);
 	PG_RETURN_POINTER(result);
 }
+/*
+* Check, from the heads of the two geometry arguments, whether their
+* objects are certainly more than tolerance apart: either is empty, or
+* their boxes are. The boxes are rounded outwards, so they are never
+* further apart than the objects inside them.
+*/
+static int
+gserialized_beyond_distance2d(FunctionCallInfo fcinfo, GSERIALIZED *head1, GSERIALIZED *head2, double tolerance)
+{
+	GBOX box1, box2;
+	double dx, dy;
+
+	if ( gserialized_is_empty(head1) || gserialized_is_empty(head2) )
+		return LW_TRUE;
+
+	if ( ! ( gserialized_head_get_gbox_p(PG_GETARG_DATUM(0), head1, &box1) &&
+	         gserialized_head_get_gbox_p(PG_GETARG_DATUM(1), head2, &box2) ) )
+		return LW_FALSE;
+
+	dx = FP_MAX(0.0, FP_MAX(box1.xmin - box2.xmax, box2.xmin - box1.xmax));
+	dy = FP_MAX(0.0, FP_MAX(box1.ymin - box2.ymax, box2.ymin - box1.ymax));
+
+	return sqrt(dx * dx + dy * dy) > tolerance;
+}
+
 /**
  Minimum 2d distance between objects in geom1 and geom2.
  */
@@ -685,21 +748,33 @@ PG_FUNCTION_INFO_V1(LWGEOM_mindistance2d);
 Datum LWGEOM_mindistance2d(PG_FUNCTION_ARGS)
 {
 	double mindist;
-	GSERIALIZED *geom1 = (GSERIALIZED*)PG_DETOAST_DATUM(PG_GETARG_DATUM(0));
-	GSERIALIZED *geom2 = (GSERIALIZED*)PG_DETOAST_DATUM(PG_GETARG_DATUM(1));
-	LWGEOM *lwgeom1 = lwgeom_from_gserialized(geom1);
-	LWGEOM *lwgeom2 = lwgeom_from_gserialized(geom2);
+	GSERIALIZED *geom1 = gserialized_datum_get_head(PG_GETARG_DATUM(0));
+	GSERIALIZED *geom2 = gserialized_datum_get_head(PG_GETARG_DATUM(1));
 
-	if (lwgeom1->srid != lwgeom2->srid)
+	if (gserialized_get_srid(geom1) != gserialized_get_srid(geom2))
 	{
 		elog(ERROR,"Operation on two GEOMETRIES with different SRIDs\n");
 		PG_RETURN_NULL();
 	}
 
-	mindist = lwgeom_mindistance2d(lwgeom1, lwgeom2);
+	/* There is no distance to an empty geometry */
+	if ( gserialized_is_empty(geom1) || gserialized_is_empty(geom2) )
+		PG_RETURN_NULL();
 
-	lwgeom_free(lwgeom1);
-	lwgeom_free(lwgeom2);
+	geom1 = gserialized_datum_get_full(PG_GETARG_DATUM(0), geom1);
+	geom2 = gserialized_datum_get_full(PG_GETARG_DATUM(1), geom2);
+
+	/* Do the brute force calculation if the cached calculation doesn't tick over */
+	if ( LW_FAILURE == geometry_distance_cache(fcinfo, geom1, geom2, &mindist) )
+	{
+		LWGEOM *lwgeom1 = lwgeom_from_gserialized(geom1);
+		LWGEOM *lwgeom2 = lwgeom_from_gserialized(geom2);
+
+		mindist = lwgeom_mindistance2d(lwgeom1, lwgeom2);
+
+		lwgeom_free(lwgeom1);
+		lwgeom_free(lwgeom2);
+	}
 
 	PG_FREE_IF_COPY(geom1, 0);
 	PG_FREE_IF_COPY(geom2, 1);
@@ -720,11 +795,10 @@ PG_FUNCTION_INFO_V1(LWGEOM_dwithin);
 Datum LWGEOM_dwithin(PG_FUNCTION_ARGS)
 {
 	double mindist;
-	GSERIALIZED *geom1 = (GSERIALIZED*)PG_DETOAST_DATUM(PG_GETARG_DATUM(0));
-	GSERIALIZED *geom2 = (GSERIALIZED*)PG_DETOAST_DATUM(PG_GETARG_DATUM(1));
+	int dwithin = LW_FALSE;
+	GSERIALIZED *geom1 = gserialized_datum_get_head(PG_GETARG_DATUM(0));
+	GSERIALIZED *geom2 = gserialized_datum_get_head(PG_GETARG_DATUM(1));
 	double tolerance = PG_GETARG_FLOAT8(2);	
-	LWGEOM *lwgeom1 = lwgeom_from_gserialized(geom1);
-	LWGEOM *lwgeom2 = lwgeom_from_gserialized(geom2);
 
 	if ( tolerance < 0 )
 	{
@@ -732,19 +806,36 @@ Datum LWGEOM_dwithin(PG_FUNCTION_ARGS)
 		PG_RETURN_NULL();
 	}
 
-	if (lwgeom1->srid != lwgeom2->srid)
+	if (gserialized_get_srid(geom1) != gserialized_get_srid(geom2))
 	{
 		elog(ERROR,"Operation on two GEOMETRIES with different SRIDs\n");
 		PG_RETURN_NULL();
 	}
 
-	mindist = lwgeom_mindistance2d_tolerance(lwgeom1,lwgeom2,tolerance);
+	if ( gserialized_beyond_distance2d(fcinfo, geom1, geom2, tolerance) )
+		PG_RETURN_BOOL(LW_FALSE);
+
+	geom1 = gserialized_datum_get_full(PG_GETARG_DATUM(0), geom1);
+	geom2 = gserialized_datum_get_full(PG_GETARG_DATUM(1), geom2);
+
+	/* Do the brute force calculation if the cached calculation doesn't tick over */
+	if ( LW_FAILURE == geometry_dwithin_cache(fcinfo, geom1, geom2, tolerance, &dwithin) )
+	{
+		LWGEOM *lwgeom1 = lwgeom_from_gserialized(geom1);
+		LWGEOM *lwgeom2 = lwgeom_from_gserialized(geom2);
+
+		mindist = lwgeom_mindistance2d_tolerance(lwgeom1,lwgeom2,tolerance);
+		/*empty geometries cases should be right handled since return from underlying
+		 functions should be MAXFLOAT which causes false as answer*/
+		dwithin = (tolerance >= mindist);
+
+		lwgeom_free(lwgeom1);
+		lwgeom_free(lwgeom2);
+	}
 
 	PG_FREE_IF_COPY(geom1, 0);
 	PG_FREE_IF_COPY(geom2, 1);
-	/*empty geometries cases should be right handled since return from underlying
-	 functions should be MAXFLOAT which causes false as answer*/
-	PG_RETURN_BOOL(tolerance >= mindist);
+	PG_RETURN_BOOL(dwithin);
 }
 
 /**
@@ -960,11 +1051,11 @@ PG_FUNCTION_INFO_V1(LWGEOM_dwithin3d);
 Datum LWGEOM_dwithin3d(PG_FUNCTION_ARGS)
 {
 	double mindist;
-	GSERIALIZED *geom1 = (GSERIALIZED*)PG_DETOAST_DATUM(PG_GETARG_DATUM(0));
-	GSERIALIZED *geom2 = (GSERIALIZED*)PG_DETOAST_DATUM(PG_GETARG_DATUM(1));
+	GSERIALIZED *geom1 = gserialized_datum_get_head(PG_GETARG_DATUM(0));
+	GSERIALIZED *geom2 = gserialized_datum_get_head(PG_GETARG_DATUM(1));
 	double tolerance = PG_GETARG_FLOAT8(2);	
-	LWGEOM *lwgeom1 = lwgeom_from_gserialized(geom1);
-	LWGEOM *lwgeom2 = lwgeom_from_gserialized(geom2);
+	LWGEOM *lwgeom1;
+	LWGEOM *lwgeom2;
 
 	if ( tolerance < 0 )
 	{
@@ -972,12 +1063,21 @@ Datum LWGEOM_dwithin3d(PG_FUNCTION_ARGS)
 		PG_RETURN_NULL();
 	}
 
-	if (lwgeom1->srid != lwgeom2->srid)
+	if (gserialized_get_srid(geom1) != gserialized_get_srid(geom2))
 	{
 		elog(ERROR,"Operation on two GEOMETRIES with different SRIDs\n");
 		PG_RETURN_NULL();
 	}
 
+	/* Objects further apart in 2d are further apart in 3d too */
+	if ( gserialized_beyond_distance2d(fcinfo, geom1, geom2, tolerance) )
+		PG_RETURN_BOOL(LW_FALSE);
+
+	geom1 = gserialized_datum_get_full(PG_GETARG_DATUM(0), geom1);
+	geom2 = gserialized_datum_get_full(PG_GETARG_DATUM(1), geom2);
+	lwgeom1 = lwgeom_from_gserialized(geom1);
+	lwgeom2 = lwgeom_from_gserialized(geom2);
+
 	mindist = lwgeom_mindistance3d_tolerance(lwgeom1,lwgeom2,tolerance);
 
 	PG_FREE_IF_COPY(geom1, 0);
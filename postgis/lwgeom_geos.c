@@ -17,6 +17,7 @@
 #include "fmgr.h"
 #include "miscadmin.h"
 #include "utils/array.h"
+#include "catalog/pg_type.h"
 
 #include "utils/builtins.h"
 #include "utils/hsearch.h"
@@ -1684,6 +1685,24 @@ void errorIfGeometryCollection(GSERIALIZED *g1, GSERIALIZED *g2)
 	}
 }
 
+/*
+* Detoast no more of the two geometry arguments of a predicate than the
+* checks ahead of the bounding box short-circuit need: SRID, type,
+* emptiness and cached box. Collections are detoasted in full, so
+* errorIfGeometryCollection can quote them.
+*/
+static void
+get_predicate_heads(FunctionCallInfo fcinfo, GSERIALIZED **geom1, GSERIALIZED **geom2)
+{
+	*geom1 = gserialized_datum_get_head(PG_GETARG_DATUM(0));
+	*geom2 = gserialized_datum_get_head(PG_GETARG_DATUM(1));
+
+	if ( gserialized_get_type(*geom1) == COLLECTIONTYPE )
+		*geom1 = gserialized_datum_get_full(PG_GETARG_DATUM(0), *geom1);
+	if ( gserialized_get_type(*geom2) == COLLECTIONTYPE )
+		*geom2 = gserialized_datum_get_full(PG_GETARG_DATUM(1), *geom2);
+}
+
 PG_FUNCTION_INFO_V1(isvalid);
 Datum isvalid(PG_FUNCTION_ARGS)
 {
@@ -1929,8 +1948,7 @@ Datum overlaps(PG_FUNCTION_ARGS)
 	bool result;
 	GBOX box1, box2;
 
-	geom1 = (GSERIALIZED *)PG_DETOAST_DATUM(PG_GETARG_DATUM(0));
-	geom2 = (GSERIALIZED *)PG_DETOAST_DATUM(PG_GETARG_DATUM(1));
+	get_predicate_heads(fcinfo, &geom1, &geom2);
 
 	errorIfGeometryCollection(geom1,geom2);
 	error_if_srid_mismatch(gserialized_get_srid(geom1), gserialized_get_srid(geom2));
@@ -1944,8 +1962,8 @@ Datum overlaps(PG_FUNCTION_ARGS)
 	 * geom1 bounding box we can prematurely return FALSE.
 	 * Do the test IFF BOUNDING BOX AVAILABLE.
 	 */
-	if ( gserialized_get_gbox_p(geom1, &box1) &&
-	        gserialized_get_gbox_p(geom2, &box2) )
+	if ( gserialized_head_get_gbox_p(PG_GETARG_DATUM(0), geom1, &box1) &&
+	     gserialized_head_get_gbox_p(PG_GETARG_DATUM(1), geom2, &box2) )
 	{
 		if ( gbox_overlaps_2d(&box1, &box2) == LW_FALSE )
 		{
@@ -1953,6 +1971,9 @@ Datum overlaps(PG_FUNCTION_ARGS)
 		}
 	}
 
+	geom1 = gserialized_datum_get_full(PG_GETARG_DATUM(0), geom1);
+	geom2 = gserialized_datum_get_full(PG_GETARG_DATUM(1), geom2);
+
 	initGEOS(lwnotice, lwgeom_geos_error);
 
 	g1 = (GEOSGeometry *)POSTGIS2GEOS(geom1);
@@ -1996,14 +2017,12 @@ Datum contains(PG_FUNCTION_ARGS)
 	GEOSGeometry *g1, *g2;
 	GBOX box1, box2;
 	int type1, type2;
-	LWGEOM *lwgeom;
 	LWPOINT *point;
 	RTREE_POLY_CACHE *poly_cache;
 	int result;
 	PrepGeomCache *prep_cache;
 
-	geom1 = (GSERIALIZED *)  PG_DETOAST_DATUM(PG_GETARG_DATUM(0));
-	geom2 = (GSERIALIZED *)  PG_DETOAST_DATUM(PG_GETARG_DATUM(1));
+	get_predicate_heads(fcinfo, &geom1, &geom2);
 
 	errorIfGeometryCollection(geom1,geom2);
 	error_if_srid_mismatch(gserialized_get_srid(geom1), gserialized_get_srid(geom2));
@@ -2019,8 +2038,8 @@ Datum contains(PG_FUNCTION_ARGS)
 	** geom1 bounding box we can prematurely return FALSE.
 	** Do the test IFF BOUNDING BOX AVAILABLE.
 	*/
-	if ( gserialized_get_gbox_p(geom1, &box1) &&
-	     gserialized_get_gbox_p(geom2, &box2) )
+	if ( gserialized_head_get_gbox_p(PG_GETARG_DATUM(0), geom1, &box1) &&
+	     gserialized_head_get_gbox_p(PG_GETARG_DATUM(1), geom2, &box2) )
 	{
 		if ( ( box2.xmin < box1.xmin ) || ( box2.xmax > box1.xmax ) ||
 		     ( box2.ymin < box1.ymin ) || ( box2.ymax > box1.ymax ) )
@@ -2029,6 +2048,9 @@ Datum contains(PG_FUNCTION_ARGS)
 		}
 	}
 
+	geom1 = gserialized_datum_get_full(PG_GETARG_DATUM(0), geom1);
+	geom2 = gserialized_datum_get_full(PG_GETARG_DATUM(1), geom2);
+
 	/*
 	** short-circuit 2: if geom2 is a point and geom1 is a polygon
 	** call the point-in-polygon function.
@@ -2038,32 +2060,21 @@ Datum contains(PG_FUNCTION_ARGS)
 	if ((type1 == POLYGONTYPE || type1 == MULTIPOLYGONTYPE) && type2 == POINTTYPE)
 	{
 		POSTGIS_DEBUG(3, "Point in Polygon test requested...short-circuiting.");
-		lwgeom = lwgeom_from_gserialized(geom1);
 		point = lwgeom_as_lwpoint(lwgeom_from_gserialized(geom2));
 
-		POSTGIS_DEBUGF(3, "Precall point_in_multipolygon_rtree %p, %p", lwgeom, point);
+		POSTGIS_DEBUGF(3, "Precall point_in_multipolygon_rtree %p", point);
 
-		poly_cache = GetRtreeCache(fcinfo, geom1);
+		poly_cache = GetRtreeCache(fcinfo, geom1, NULL);
 
 		if ( poly_cache && poly_cache->ringIndices )
 		{
 			result = point_in_multipolygon_rtree(poly_cache->ringIndices, poly_cache->polyCount, poly_cache->ringCounts, point);
 		}
-		else if ( type1 == POLYGONTYPE )
-		{
-			result = point_in_polygon((LWPOLY*)lwgeom, point);
-		}
-		else if ( type1 == MULTIPOLYGONTYPE )
-		{
-			result = point_in_multipolygon((LWMPOLY*)lwgeom, point);
-		}
 		else
 		{
-			/* Gulp! Should not be here... */
-			elog(ERROR,"Type isn't poly or multipoly!");
-			PG_RETURN_NULL();
+			/* Walk the rings in place, no need to deserialize */
+			result = point_in_gserialized_polygon(geom1, point);
 		}
-		lwgeom_free(lwgeom);
 		lwpoint_free(point);
 		PG_FREE_IF_COPY(geom1, 0);
 		PG_FREE_IF_COPY(geom2, 1);
@@ -2081,6 +2092,45 @@ Datum contains(PG_FUNCTION_ARGS)
 		POSTGIS_DEBUGF(3, "Contains: type1: %d, type2: %d", type1, type2);
 	}
 
+	/*
+	** short-circuit 3: if geom2 is a multipoint and the rings of polygon
+	** geom1 are cached, test all the points in one batch.
+	*/
+	if ((type1 == POLYGONTYPE || type1 == MULTIPOLYGONTYPE) && type2 == MULTIPOINTTYPE)
+	{
+		poly_cache = GetRtreeCache(fcinfo, geom1, NULL);
+
+		if ( poly_cache && poly_cache->rings )
+		{
+			LWMPOINT *mpoint = lwgeom_as_lwmpoint(lwgeom_from_gserialized(geom2));
+			int *results = palloc(sizeof(int) * mpoint->ngeoms);
+			int found_inside = LW_FALSE;
+			int found_outside = LW_FALSE;
+			int i;
+
+			POSTGIS_DEBUG(3, "Multipoint in cached polygon test requested...short-circuiting.");
+			points_in_multipolygon_cache(poly_cache, mpoint, results);
+			for ( i = 0; i < mpoint->ngeoms; i++ )
+			{
+				if ( lwpoint_is_empty(mpoint->geoms[i]) )
+					continue;
+				if ( results[i] == -1 )
+				{
+					found_outside = LW_TRUE;
+					break;
+				}
+				if ( results[i] == 1 )
+					found_inside = LW_TRUE;
+			}
+			pfree(results);
+			lwmpoint_free(mpoint);
+			PG_FREE_IF_COPY(geom1, 0);
+			PG_FREE_IF_COPY(geom2, 1);
+			/* No point outside and at least one in the interior */
+			PG_RETURN_BOOL(found_inside && ! found_outside);
+		}
+	}
+
 	initGEOS(lwnotice, lwgeom_geos_error);
 
 	prep_cache = GetPrepGeomCache( fcinfo, geom1, 0 );
@@ -2131,6 +2181,167 @@ Datum contains(PG_FUNCTION_ARGS)
 
 }
 
+/**
+* ST_ContainsMany(geometry, geometry[]) returns boolean[]
+*
+* Same answers as ST_Contains against every element of the array, but
+* the call overhead, the detoast of the container and the index build
+* are paid once per array instead of once per row. Point elements of a
+* polygon container go through one set of ring rtrees, anything else
+* through one prepared GEOS geometry, both built on first use.
+* NULL elements give NULL.
+*/
+PG_FUNCTION_INFO_V1(containsmany);
+Datum containsmany(PG_FUNCTION_ARGS)
+{
+	GSERIALIZED *geom1 = (GSERIALIZED *)PG_DETOAST_DATUM(PG_GETARG_DATUM(0));
+	ArrayType *array = PG_GETARG_ARRAYTYPE_P(1);
+	ArrayType *result;
+	GBOX box1, box2;
+	int type1, empty1, has_box1;
+	int nelems, i;
+	Datum *values;
+	bool *nulls;
+	bits8 *bitmap;
+	int bitmask;
+	size_t offset;
+	LWGEOM *lwgeom1 = NULL;
+	RTREE_POLY_CACHE *poly_cache = NULL;
+	GEOSGeometry *g1 = NULL;
+	const GEOSPreparedGeometry *prepared = NULL;
+
+	nelems = ArrayGetNItems(ARR_NDIM(array), ARR_DIMS(array));
+	if ( nelems == 0 )
+		PG_RETURN_ARRAYTYPE_P(construct_empty_array(BOOLOID));
+
+	type1 = gserialized_get_type(geom1);
+	empty1 = gserialized_is_empty(geom1);
+	has_box1 = gserialized_get_gbox_p(geom1, &box1);
+
+	values = palloc(sizeof(Datum) * nelems);
+	nulls = palloc(sizeof(bool) * nelems);
+
+	offset = 0;
+	bitmap = ARR_NULLBITMAP(array);
+	bitmask = 1;
+	for ( i = 0; i < nelems; i++ )
+	{
+		/* NULL in, NULL out */
+		if ( bitmap && (*bitmap & bitmask) == 0 )
+		{
+			values[i] = (Datum) 0;
+			nulls[i] = true;
+		}
+		else
+		{
+			GSERIALIZED *geom2 = (GSERIALIZED *)(ARR_DATA_PTR(array)+offset);
+			int type2 = gserialized_get_type(geom2);
+			int contained;
+
+			offset += INTALIGN(VARSIZE(geom2));
+
+			errorIfGeometryCollection(geom1,geom2);
+			error_if_srid_mismatch(gserialized_get_srid(geom1), gserialized_get_srid(geom2));
+
+			/* A.Contains(Empty) == FALSE */
+			if ( empty1 || gserialized_is_empty(geom2) )
+			{
+				contained = LW_FALSE;
+			}
+			/* B has to be inside the box of A */
+			else if ( has_box1 && gserialized_get_gbox_p(geom2, &box2) &&
+			          ( ( box2.xmin < box1.xmin ) || ( box2.xmax > box1.xmax ) ||
+			            ( box2.ymin < box1.ymin ) || ( box2.ymax > box1.ymax ) ) )
+			{
+				contained = LW_FALSE;
+			}
+			/* Point in polygon, as in contains() */
+			else if ( (type1 == POLYGONTYPE || type1 == MULTIPOLYGONTYPE) && type2 == POINTTYPE )
+			{
+				LWPOINT *point = lwgeom_as_lwpoint(lwgeom_from_gserialized(geom2));
+
+				if ( ! poly_cache )
+				{
+					lwgeom1 = lwgeom_from_gserialized(geom1);
+					poly_cache = RTreePolyCacheBuild(lwgeom1);
+				}
+				contained = ( point_in_multipolygon_rtree(poly_cache->ringIndices, poly_cache->polyCount, poly_cache->ringCounts, point) == 1 );
+				lwpoint_free(point);
+			}
+			else
+			{
+				GEOSGeometry *g2;
+
+				if ( ! prepared )
+				{
+					initGEOS(lwnotice, lwgeom_geos_error);
+					g1 = (GEOSGeometry *)POSTGIS2GEOS(geom1);
+					if ( 0 == g1 )   /* exception thrown at construction */
+					{
+						lwerror("First argument geometry could not be converted to GEOS: %s", lwgeom_geos_errmsg);
+						PG_RETURN_NULL();
+					}
+					prepared = GEOSPrepare(g1);
+					if ( ! prepared )
+					{
+						lwerror("GEOSPrepare: %s", lwgeom_geos_errmsg);
+						PG_RETURN_NULL();
+					}
+				}
+				g2 = (GEOSGeometry *)POSTGIS2GEOS(geom2);
+				if ( 0 == g2 )   /* exception thrown at construction */
+				{
+					lwerror("Second argument geometry could not be converted to GEOS: %s", lwgeom_geos_errmsg);
+					PG_RETURN_NULL();
+				}
+				contained = GEOSPreparedContains(prepared, g2);
+				GEOSGeom_destroy(g2);
+				if ( contained == 2 )
+				{
+					lwerror("GEOSContains: %s", lwgeom_geos_errmsg);
+					PG_RETURN_NULL(); /* never get here */
+				}
+			}
+
+			values[i] = BoolGetDatum(contained ? true : false);
+			nulls[i] = false;
+		}
+
+		/* Advance NULL bitmap */
+		if ( bitmap )
+		{
+			bitmask <<= 1;
+			if ( bitmask == 0x100 )
+			{
+				bitmap++;
+				bitmask = 1;
+			}
+		}
+	}
+
+	if ( prepared )
+	{
+		GEOSPreparedGeom_destroy(prepared);
+		GEOSGeom_destroy(g1);
+	}
+	if ( poly_cache )
+	{
+		RTreePolyCacheFree(poly_cache);
+		lwgeom_free(lwgeom1);
+	}
+
+	/* Same shape as the input */
+	result = construct_md_array(values, nulls, ARR_NDIM(array), ARR_DIMS(array),
+	                            ARR_LBOUND(array), BOOLOID, 1, true, 'c');
+
+	pfree(values);
+	pfree(nulls);
+	PG_FREE_IF_COPY(geom1, 0);
+	PG_FREE_IF_COPY(array, 1);
+
+	PG_RETURN_ARRAYTYPE_P(result);
+}
+
 PG_FUNCTION_INFO_V1(containsproperly);
 Datum containsproperly(PG_FUNCTION_ARGS)
 {
@@ -2140,8 +2351,7 @@ Datum containsproperly(PG_FUNCTION_ARGS)
 	GBOX 			box1, box2;
 	PrepGeomCache *	prep_cache;
 
-	geom1 = (GSERIALIZED *)  PG_DETOAST_DATUM(PG_GETARG_DATUM(0));
-	geom2 = (GSERIALIZED *)  PG_DETOAST_DATUM(PG_GETARG_DATUM(1));
+	get_predicate_heads(fcinfo, &geom1, &geom2);
 
 	errorIfGeometryCollection(geom1,geom2);
 	error_if_srid_mismatch(gserialized_get_srid(geom1), gserialized_get_srid(geom2));
@@ -2155,14 +2365,17 @@ Datum containsproperly(PG_FUNCTION_ARGS)
 	* geom1 bounding box we can prematurely return FALSE.
 	* Do the test IFF BOUNDING BOX AVAILABLE.
 	*/
-	if ( gserialized_get_gbox_p(geom1, &box1) &&
-	        gserialized_get_gbox_p(geom2, &box2) )
+	if ( gserialized_head_get_gbox_p(PG_GETARG_DATUM(0), geom1, &box1) &&
+	     gserialized_head_get_gbox_p(PG_GETARG_DATUM(1), geom2, &box2) )
 	{
 		if (( box2.xmin < box1.xmin ) || ( box2.xmax > box1.xmax ) ||
 		        ( box2.ymin < box1.ymin ) || ( box2.ymax > box1.ymax ))
 			PG_RETURN_BOOL(FALSE);
 	}
 
+	geom1 = gserialized_datum_get_full(PG_GETARG_DATUM(0), geom1);
+	geom2 = gserialized_datum_get_full(PG_GETARG_DATUM(1), geom2);
+
 	initGEOS(lwnotice, lwgeom_geos_error);
 
 	prep_cache = GetPrepGeomCache( fcinfo, geom1, 0 );
@@ -2225,13 +2438,11 @@ Datum covers(PG_FUNCTION_ARGS)
 	int result;
 	GBOX box1, box2;
 	int type1, type2;
-	LWGEOM *lwgeom;
 	LWPOINT *point;
 	RTREE_POLY_CACHE *poly_cache;
 	PrepGeomCache *prep_cache;
 
-	geom1 = (GSERIALIZED *)  PG_DETOAST_DATUM(PG_GETARG_DATUM(0));
-	geom2 = (GSERIALIZED *)  PG_DETOAST_DATUM(PG_GETARG_DATUM(1));
+	get_predicate_heads(fcinfo, &geom1, &geom2);
 
 	/* A.Covers(Empty) == FALSE */
 	if ( gserialized_is_empty(geom1) || gserialized_is_empty(geom2) )
@@ -2245,8 +2456,8 @@ Datum covers(PG_FUNCTION_ARGS)
 	 * geom1 bounding box we can prematurely return FALSE.
 	 * Do the test IFF BOUNDING BOX AVAILABLE.
 	 */
-	if ( gserialized_get_gbox_p(geom1, &box1) &&
-	        gserialized_get_gbox_p(geom2, &box2) )
+	if ( gserialized_head_get_gbox_p(PG_GETARG_DATUM(0), geom1, &box1) &&
+	     gserialized_head_get_gbox_p(PG_GETARG_DATUM(1), geom2, &box2) )
 	{
 		if (( box2.xmin < box1.xmin ) || ( box2.xmax > box1.xmax ) ||
 		    ( box2.ymin < box1.ymin ) || ( box2.ymax > box1.ymax ))
@@ -2254,6 +2465,10 @@ Datum covers(PG_FUNCTION_ARGS)
 			PG_RETURN_BOOL(FALSE);
 		}
 	}
+
+	geom1 = gserialized_datum_get_full(PG_GETARG_DATUM(0), geom1);
+	geom2 = gserialized_datum_get_full(PG_GETARG_DATUM(1), geom2);
+
 	/*
 	 * short-circuit 2: if geom2 is a point and geom1 is a polygon
 	 * call the point-in-polygon function.
@@ -2264,33 +2479,22 @@ Datum covers(PG_FUNCTION_ARGS)
 	{
 		POSTGIS_DEBUG(3, "Point in Polygon test requested...short-circuiting.");
 
-		lwgeom = lwgeom_from_gserialized(geom1);
 		point = lwgeom_as_lwpoint(lwgeom_from_gserialized(geom2));
 
-		POSTGIS_DEBUGF(3, "Precall point_in_multipolygon_rtree %p, %p", lwgeom, point);
+		POSTGIS_DEBUGF(3, "Precall point_in_multipolygon_rtree %p", point);
 
-		poly_cache = GetRtreeCache(fcinfo, geom1);
+		poly_cache = GetRtreeCache(fcinfo, geom1, NULL);
 
 		if ( poly_cache && poly_cache->ringIndices )
 		{
 			result = point_in_multipolygon_rtree(poly_cache->ringIndices, poly_cache->polyCount, poly_cache->ringCounts, point);
 		}
-		else if ( type1 == POLYGONTYPE )
-		{
-			result = point_in_polygon((LWPOLY*)lwgeom, point);
-		}
-		else if ( type1 == MULTIPOLYGONTYPE )
-		{
-			result = point_in_multipolygon((LWMPOLY*)lwgeom, point);
-		}
 		else
 		{
-			/* Gulp! Should not be here... */
-			elog(ERROR,"Type isn't poly or multipoly!");
-			PG_RETURN_NULL();
+			/* Walk the rings in place, no need to deserialize */
+			result = point_in_gserialized_polygon(geom1, point);
 		}
 
-		lwgeom_free(lwgeom);
 		lwpoint_free(point);
 		PG_FREE_IF_COPY(geom1, 0);
 		PG_FREE_IF_COPY(geom2, 1);
@@ -2379,14 +2583,12 @@ Datum coveredby(PG_FUNCTION_ARGS)
 	GEOSGeometry *g1, *g2;
 	int result;
 	GBOX box1, box2;
-	LWGEOM *lwgeom;
 	LWPOINT *point;
 	int type1, type2;
 	RTREE_POLY_CACHE *poly_cache;
 	char *patt = "**F**F***";
 
-	geom1 = (GSERIALIZED *)PG_DETOAST_DATUM(PG_GETARG_DATUM(0));
-	geom2 = (GSERIALIZED *)PG_DETOAST_DATUM(PG_GETARG_DATUM(1));
+	get_predicate_heads(fcinfo, &geom1, &geom2);
 
 	errorIfGeometryCollection(geom1,geom2);
 	error_if_srid_mismatch(gserialized_get_srid(geom1), gserialized_get_srid(geom2));
@@ -2400,8 +2602,8 @@ Datum coveredby(PG_FUNCTION_ARGS)
 	 * geom2 bounding box we can prematurely return FALSE.
 	 * Do the test IFF BOUNDING BOX AVAILABLE.
 	 */
-	if ( gserialized_get_gbox_p(geom1, &box1) &&
-	        gserialized_get_gbox_p(geom2, &box2) )
+	if ( gserialized_head_get_gbox_p(PG_GETARG_DATUM(0), geom1, &box1) &&
+	     gserialized_head_get_gbox_p(PG_GETARG_DATUM(1), geom2, &box2) )
 	{
 		if ( ( box1.xmin < box2.xmin ) || ( box1.xmax > box2.xmax ) ||
 		        ( box1.ymin < box2.ymin ) || ( box1.ymax > box2.ymax ) )
@@ -2411,6 +2613,10 @@ Datum coveredby(PG_FUNCTION_ARGS)
 
 		POSTGIS_DEBUG(3, "bounding box short-circuit missed.");
 	}
+
+	geom1 = gserialized_datum_get_full(PG_GETARG_DATUM(0), geom1);
+	geom2 = gserialized_datum_get_full(PG_GETARG_DATUM(1), geom2);
+
 	/*
 	 * short-circuit 2: if geom1 is a point and geom2 is a polygon
 	 * call the point-in-polygon function.
@@ -2422,30 +2628,19 @@ Datum coveredby(PG_FUNCTION_ARGS)
 		POSTGIS_DEBUG(3, "Point in Polygon test requested...short-circuiting.");
 
 		point = lwgeom_as_lwpoint(lwgeom_from_gserialized(geom1));
-		lwgeom = lwgeom_from_gserialized(geom2);
 
-		poly_cache = GetRtreeCache(fcinfo, geom2);
+		poly_cache = GetRtreeCache(fcinfo, NULL, geom2);
 
 		if ( poly_cache && poly_cache->ringIndices )
 		{
 			result = point_in_multipolygon_rtree(poly_cache->ringIndices, poly_cache->polyCount, poly_cache->ringCounts, point);
 		}
-		else if ( type2 == POLYGONTYPE )
-		{
-			result = point_in_polygon((LWPOLY*)lwgeom, point);
-		}
-		else if ( type2 == MULTIPOLYGONTYPE )
-		{
-			result = point_in_multipolygon((LWMPOLY*)lwgeom, point);
-		}
 		else
 		{
-			/* Gulp! Should not be here... */
-			elog(ERROR,"Type isn't poly or multipoly!");
-			PG_RETURN_NULL();
+			/* Walk the rings in place, no need to deserialize */
+			result = point_in_gserialized_polygon(geom2, point);
 		}
 
-		lwgeom_free(lwgeom);
 		lwpoint_free(point);
 		PG_FREE_IF_COPY(geom1, 0);
 		PG_FREE_IF_COPY(geom2, 1);
@@ -2506,8 +2701,7 @@ Datum crosses(PG_FUNCTION_ARGS)
 	int result;
 	GBOX box1, box2;
 
-	geom1 = (GSERIALIZED *)PG_DETOAST_DATUM(PG_GETARG_DATUM(0));
-	geom2 = (GSERIALIZED *)PG_DETOAST_DATUM(PG_GETARG_DATUM(1));
+	get_predicate_heads(fcinfo, &geom1, &geom2);
 
 	errorIfGeometryCollection(geom1,geom2);
 	error_if_srid_mismatch(gserialized_get_srid(geom1), gserialized_get_srid(geom2));
@@ -2521,8 +2715,8 @@ Datum crosses(PG_FUNCTION_ARGS)
 	 * geom1 bounding box we can prematurely return FALSE.
 	 * Do the test IFF BOUNDING BOX AVAILABLE.
 	 */
-	if ( gserialized_get_gbox_p(geom1, &box1) &&
-	     gserialized_get_gbox_p(geom2, &box2) )
+	if ( gserialized_head_get_gbox_p(PG_GETARG_DATUM(0), geom1, &box1) &&
+	     gserialized_head_get_gbox_p(PG_GETARG_DATUM(1), geom2, &box2) )
 	{
 		if ( gbox_overlaps_2d(&box1, &box2) == LW_FALSE )
 		{
@@ -2530,6 +2724,9 @@ Datum crosses(PG_FUNCTION_ARGS)
 		}
 	}
 
+	geom1 = gserialized_datum_get_full(PG_GETARG_DATUM(0), geom1);
+	geom2 = gserialized_datum_get_full(PG_GETARG_DATUM(1), geom2);
+
 	initGEOS(lwnotice, lwgeom_geos_error);
 
 	g1 = (GEOSGeometry *)POSTGIS2GEOS(geom1);
@@ -2575,12 +2772,10 @@ Datum geos_intersects(PG_FUNCTION_ARGS)
 	GBOX box1, box2;
 	int type1, type2, polytype;
 	LWPOINT *point;
-	LWGEOM *lwgeom;
 	RTREE_POLY_CACHE *poly_cache;
 	PrepGeomCache *prep_cache;
 
-	geom1 = (GSERIALIZED *)PG_DETOAST_DATUM(PG_GETARG_DATUM(0));
-	geom2 = (GSERIALIZED *)PG_DETOAST_DATUM(PG_GETARG_DATUM(1));
+	get_predicate_heads(fcinfo, &geom1, &geom2);
 
 	errorIfGeometryCollection(geom1,geom2);
 	error_if_srid_mismatch(gserialized_get_srid(geom1), gserialized_get_srid(geom2));
@@ -2594,8 +2789,8 @@ Datum geos_intersects(PG_FUNCTION_ARGS)
 	 * geom1 bounding box we can prematurely return FALSE.
 	 * Do the test IFF BOUNDING BOX AVAILABLE.
 	 */
-	if ( gserialized_get_gbox_p(geom1, &box1) &&
-	        gserialized_get_gbox_p(geom2, &box2) )
+	if ( gserialized_head_get_gbox_p(PG_GETARG_DATUM(0), geom1, &box1) &&
+	     gserialized_head_get_gbox_p(PG_GETARG_DATUM(1), geom2, &box2) )
 	{
 		if ( gbox_overlaps_2d(&box1, &box2) == LW_FALSE )
 		{
@@ -2603,6 +2798,9 @@ Datum geos_intersects(PG_FUNCTION_ARGS)
 		}
 	}
 
+	geom1 = gserialized_datum_get_full(PG_GETARG_DATUM(0), geom1);
+	geom2 = gserialized_datum_get_full(PG_GETARG_DATUM(1), geom2);
+
 	/*
 	 * short-circuit 2: if the geoms are a point and a polygon,
 	 * call the point_outside_polygon function.
@@ -2617,40 +2815,31 @@ Datum geos_intersects(PG_FUNCTION_ARGS)
 		if ( type1 == POINTTYPE )
 		{
 			point = lwgeom_as_lwpoint(lwgeom_from_gserialized(geom1));
-			lwgeom = lwgeom_from_gserialized(geom2);
 			serialized_poly = geom2;
 			polytype = type2;
 		}
 		else
 		{
 			point = lwgeom_as_lwpoint(lwgeom_from_gserialized(geom2));
-			lwgeom = lwgeom_from_gserialized(geom1);
 			serialized_poly = geom1;
 			polytype = type1;
 		}
 
-		poly_cache = GetRtreeCache(fcinfo, serialized_poly);
+		if ( type1 == POINTTYPE )
+			poly_cache = GetRtreeCache(fcinfo, NULL, geom2);
+		else
+			poly_cache = GetRtreeCache(fcinfo, geom1, NULL);
 
 		if ( poly_cache && poly_cache->ringIndices )
 		{
 			result = point_in_multipolygon_rtree(poly_cache->ringIndices, poly_cache->polyCount, poly_cache->ringCounts, point);
 		}
-		else if ( polytype == POLYGONTYPE )
-		{
-			result = point_in_polygon((LWPOLY*)lwgeom, point);
-		}
-		else if ( polytype == MULTIPOLYGONTYPE )
-		{
-			result = point_in_multipolygon((LWMPOLY*)lwgeom, point);
-		}
 		else
 		{
-			/* Gulp! Should not be here... */
-			elog(ERROR,"Type isn't poly or multipoly!");
-			PG_RETURN_NULL();
+			/* Walk the rings in place, no need to deserialize */
+			result = point_in_gserialized_polygon(serialized_poly, point);
 		}
 
-		lwgeom_free(lwgeom);
 		lwpoint_free(point);
 		PG_FREE_IF_COPY(geom1, 0);
 		PG_FREE_IF_COPY(geom2, 1);
@@ -2664,6 +2853,46 @@ Datum geos_intersects(PG_FUNCTION_ARGS)
 		}
 	}
 
+	/*
+	 * short-circuit 3: a multipoint against a polygon whose rings are
+	 * cached, test all the points in one batch.
+	 */
+	if ( (type1 == MULTIPOINTTYPE && (type2 == POLYGONTYPE || type2 == MULTIPOLYGONTYPE)) ||
+	     (type2 == MULTIPOINTTYPE && (type1 == POLYGONTYPE || type1 == MULTIPOLYGONTYPE)))
+	{
+		GSERIALIZED *serialized_mpoint = (type1 == MULTIPOINTTYPE) ? geom1 : geom2;
+		serialized_poly = (type1 == MULTIPOINTTYPE) ? geom2 : geom1;
+
+		if ( type1 == MULTIPOINTTYPE )
+			poly_cache = GetRtreeCache(fcinfo, NULL, geom2);
+		else
+			poly_cache = GetRtreeCache(fcinfo, geom1, NULL);
+
+		if ( poly_cache && poly_cache->rings )
+		{
+			LWMPOINT *mpoint = lwgeom_as_lwmpoint(lwgeom_from_gserialized(serialized_mpoint));
+			int *results = palloc(sizeof(int) * mpoint->ngeoms);
+			int i;
+
+			POSTGIS_DEBUG(3, "Multipoint in cached polygon test requested...short-circuiting.");
+			points_in_multipolygon_cache(poly_cache, mpoint, results);
+			result = -1;
+			for ( i = 0; i < mpoint->ngeoms; i++ )
+			{
+				if ( results[i] != -1 ) /* not outside */
+				{
+					result = results[i];
+					break;
+				}
+			}
+			pfree(results);
+			lwmpoint_free(mpoint);
+			PG_FREE_IF_COPY(geom1, 0);
+			PG_FREE_IF_COPY(geom2, 1);
+			PG_RETURN_BOOL(result != -1);
+		}
+	}
+
 	initGEOS(lwnotice, lwgeom_geos_error);
 	prep_cache = GetPrepGeomCache( fcinfo, geom1, geom2 );
 
@@ -2736,8 +2965,7 @@ Datum touches(PG_FUNCTION_ARGS)
 	bool result;
 	GBOX box1, box2;
 
-	geom1 = (GSERIALIZED *)PG_DETOAST_DATUM(PG_GETARG_DATUM(0));
-	geom2 = (GSERIALIZED *)PG_DETOAST_DATUM(PG_GETARG_DATUM(1));
+	get_predicate_heads(fcinfo, &geom1, &geom2);
 
 	errorIfGeometryCollection(geom1,geom2);
 	error_if_srid_mismatch(gserialized_get_srid(geom1), gserialized_get_srid(geom2));
@@ -2751,8 +2979,8 @@ Datum touches(PG_FUNCTION_ARGS)
 	 * geom1 bounding box we can prematurely return FALSE.
 	 * Do the test IFF BOUNDING BOX AVAILABLE.
 	 */
-	if ( gserialized_get_gbox_p(geom1, &box1) &&
-	        gserialized_get_gbox_p(geom2, &box2) )
+	if ( gserialized_head_get_gbox_p(PG_GETARG_DATUM(0), geom1, &box1) &&
+	     gserialized_head_get_gbox_p(PG_GETARG_DATUM(1), geom2, &box2) )
 	{
 		if ( gbox_overlaps_2d(&box1, &box2) == LW_FALSE )
 		{
@@ -2760,6 +2988,9 @@ Datum touches(PG_FUNCTION_ARGS)
 		}
 	}
 
+	geom1 = gserialized_datum_get_full(PG_GETARG_DATUM(0), geom1);
+	geom2 = gserialized_datum_get_full(PG_GETARG_DATUM(1), geom2);
+
 	initGEOS(lwnotice, lwgeom_geos_error);
 
 	g1 = (GEOSGeometry *)POSTGIS2GEOS(geom1 );
@@ -2804,8 +3035,7 @@ Datum disjoint(PG_FUNCTION_ARGS)
 	bool result;
 	GBOX box1, box2;
 
-	geom1 = (GSERIALIZED *)PG_DETOAST_DATUM(PG_GETARG_DATUM(0));
-	geom2 = (GSERIALIZED *)PG_DETOAST_DATUM(PG_GETARG_DATUM(1));
+	get_predicate_heads(fcinfo, &geom1, &geom2);
 
 	errorIfGeometryCollection(geom1,geom2);
 	error_if_srid_mismatch(gserialized_get_srid(geom1), gserialized_get_srid(geom2));
@@ -2819,8 +3049,8 @@ Datum disjoint(PG_FUNCTION_ARGS)
 	 * geom1 bounding box we can prematurely return TRUE.
 	 * Do the test IFF BOUNDING BOX AVAILABLE.
 	 */
-	if ( gserialized_get_gbox_p(geom1, &box1) &&
-	        gserialized_get_gbox_p(geom2, &box2) )
+	if ( gserialized_head_get_gbox_p(PG_GETARG_DATUM(0), geom1, &box1) &&
+	     gserialized_head_get_gbox_p(PG_GETARG_DATUM(1), geom2, &box2) )
 	{
 		if ( gbox_overlaps_2d(&box1, &box2) == LW_FALSE )
 		{
@@ -2828,6 +3058,9 @@ Datum disjoint(PG_FUNCTION_ARGS)
 		}
 	}
 
+	geom1 = gserialized_datum_get_full(PG_GETARG_DATUM(0), geom1);
+	geom2 = gserialized_datum_get_full(PG_GETARG_DATUM(1), geom2);
+
 	initGEOS(lwnotice, lwgeom_geos_error);
 
 	g1 = (GEOSGeometry *)POSTGIS2GEOS(geom1);
@@ -3022,8 +3255,7 @@ Datum ST_Equals(PG_FUNCTION_ARGS)
 	bool result;
 	GBOX box1, box2;
 
-	geom1 = (GSERIALIZED *)PG_DETOAST_DATUM(PG_GETARG_DATUM(0));
-	geom2 = (GSERIALIZED *)PG_DETOAST_DATUM(PG_GETARG_DATUM(1));
+	get_predicate_heads(fcinfo, &geom1, &geom2);
 
 	errorIfGeometryCollection(geom1,geom2);
 	error_if_srid_mismatch(gserialized_get_srid(geom1), gserialized_get_srid(geom2));
@@ -3038,8 +3270,8 @@ Datum ST_Equals(PG_FUNCTION_ARGS)
 	 *
 	 * TODO: use gbox_same_2d instead (not available at time of writing)
 	 */
-	if ( gserialized_get_gbox_p(geom1, &box1) &&
-	     gserialized_get_gbox_p(geom2, &box2) )
+	if ( gserialized_head_get_gbox_p(PG_GETARG_DATUM(0), geom1, &box1) &&
+	     gserialized_head_get_gbox_p(PG_GETARG_DATUM(1), geom2, &box2) )
 	{
 		if ( gbox_overlaps_2d(&box1, &box2) == LW_FALSE )
 		{
@@ -3047,6 +3279,9 @@ Datum ST_Equals(PG_FUNCTION_ARGS)
 		}
 	}
 
+	geom1 = gserialized_datum_get_full(PG_GETARG_DATUM(0), geom1);
+	geom2 = gserialized_datum_get_full(PG_GETARG_DATUM(1), geom2);
+
 	initGEOS(lwnotice, lwgeom_geos_error);
 
 	g1 = (GEOSGeometry *)POSTGIS2GEOS(geom1);
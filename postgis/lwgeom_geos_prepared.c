@@ -401,7 +401,9 @@ static GeomCacheMethods PrepGeomCacheMethods =
 	PREP_CACHE_ENTRY,
 	PrepGeomCacheBuilder,
 	PrepGeomCacheCleaner,
-	PrepGeomCacheAllocator
+	PrepGeomCacheAllocator,
+	NULL,
+	NULL
 };
 
 
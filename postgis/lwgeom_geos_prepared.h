@@ -23,28 +23,33 @@
 #include "lwgeom_pg.h"
 #include "liblwgeom.h"
 #include "lwgeom_geos.h"
+#include "lwgeom_cache.h"
 
 /*
 * Cache structure. We use GSERIALIZED as keys so no transformations
-* are needed before we memcmp them with other keys. We store the
-* size to avoid having to calculate the size every time.
+* are needed before we compare them with other keys. We store the
+* size, hash and argument identity so most lookups don't have to
+* read the whole key.
 * The argnum gives the number of function arguments we are caching.
 * Intersects requires that both arguments be checked for cacheability,
 * while Contains only requires that the containing argument be checked.
 * Both the Geometry and the PreparedGeometry have to be cached,
 * because the PreparedGeometry contains a reference to the geometry.
 * 
-* Note that the first 6 entries are part of the common GeomCache
+* Note that the first 9 entries are part of the common GeomCache
 * structure and have to remain in order to allow the overall caching
 * system to share code (the cache checking code is common between
 * prepared geometry, circtrees, recttrees, and rtrees).
 */
 typedef struct {
 	int                         type;       // <GeomCache>
-	GSERIALIZED*                geom1;      // 
-	GSERIALIZED*                geom2;      // 
-	size_t                      geom1_size; // 
-	size_t                      geom2_size; // 
+	GSERIALIZED*                key;        // 
+	size_t                      key_size;   // 
+	uint64                      hash;       // 
+	GeomCacheIdent              ident;      // 
+	uint32                      lastused;   // 
+	uint32                      hits;       // 
+	uint32                      uses;       // 
 	int32                       argnum;     // </GeomCache>
 	MemoryContext               context_statement;
 	MemoryContext               context_callback;
@@ -58,8 +63,9 @@ typedef struct {
 ** Function will create cache if none exists, and prepare geometries in
 ** cache if necessary, or pull an existing cache if possible.
 **
-** If you are only caching one argument (e.g., in contains) supply 0 as the
-** value for pg_geom2.
+** pg_geom1 and pg_geom2 are the first and second arguments of the calling
+** function. If you are only caching one argument (e.g., in contains) supply
+** 0 as the value for pg_geom2.
 */
 PrepGeomCache *GetPrepGeomCache(FunctionCallInfoData *fcinfo, GSERIALIZED *pg_geom1, GSERIALIZED *pg_geom2);
 
@@ -53,6 +53,7 @@ Datum LWGEOM_in(PG_FUNCTION_ARGS)
 	LWGEOM_PARSER_RESULT lwg_parser_result;
 	LWGEOM *lwgeom;
 	GSERIALIZED *ret;
+	LWARENA *arena, *oldarena;
 	int srid = 0;
 
 	if ( (PG_NARGS()>2) && (!PG_ARGISNULL(2)) ) {
@@ -89,6 +90,10 @@ Datum LWGEOM_in(PG_FUNCTION_ARGS)
 		}
 	}
 	
+	/* The intermediate LWGEOM is built in an arena and dropped in one go */
+	arena = lwarena_create(strlen(str));
+	oldarena = lwarena_switch(arena);
+
 	/* WKB? Let's find out. */
 	if ( str[0] == '0' )
 	{
@@ -100,25 +105,25 @@ Datum LWGEOM_in(PG_FUNCTION_ARGS)
 		if ( srid ) lwgeom_set_srid(lwgeom, srid);
 		/* Add a bbox if necessary */
 		if ( lwgeom_needs_bbox(lwgeom) ) lwgeom_add_bbox(lwgeom);
-		pfree(wkb);
-		ret = geometry_serialize(lwgeom);
-		lwgeom_free(lwgeom);
 	}
 	/* WKT then. */
 	else
 	{
 		if ( lwgeom_parse_wkt(&lwg_parser_result, str, LW_PARSER_CHECK_ALL) == LW_FAILURE )
 		{
+			lwarena_switch(oldarena);
 			PG_PARSER_ERROR(lwg_parser_result);
 			PG_RETURN_NULL();
 		}
 		lwgeom = lwg_parser_result.geom;
 		if ( lwgeom_needs_bbox(lwgeom) )
 			lwgeom_add_bbox(lwgeom);		
-		ret = geometry_serialize(lwgeom);
-		lwgeom_parser_result_free(&lwg_parser_result);
 	}
 
+	lwarena_switch(oldarena);
+	ret = geometry_serialize(lwgeom);
+	lwarena_destroy(arena);
+
 	if ( geom_typmod >= 0 )
 	{
 		postgis_valid_typmod(ret, geom_typmod);
@@ -467,6 +472,30 @@ Datum TWKBFromLWGEOM(PG_FUNCTION_ARGS)
 	PG_RETURN_BYTEA_P(result);
 }
 
+PG_FUNCTION_INFO_V1(LWGEOMFromTWKB);
+Datum LWGEOMFromTWKB(PG_FUNCTION_ARGS)
+{
+	bytea *bytea_twkb = (bytea*)PG_GETARG_BYTEA_P(0);
+	GSERIALIZED *geom;
+	LWGEOM *lwgeom;
+	uint8_t *twkb = (uint8_t*)VARDATA(bytea_twkb);
+	size_t twkb_size = VARSIZE(bytea_twkb)-VARHDRSZ;
+	/* TWKB is compact, leave room for the decoded coordinates */
+	LWARENA *arena = lwarena_create(8 * twkb_size);
+	LWARENA *oldarena = lwarena_switch(arena);
+
+	lwgeom = lwgeom_from_twkb(twkb, twkb_size, LW_PARSER_CHECK_ALL);
+
+	if ( lwgeom_needs_bbox(lwgeom) )
+		lwgeom_add_bbox(lwgeom);
+
+	lwarena_switch(oldarena);
+	geom = geometry_serialize(lwgeom);
+	lwarena_destroy(arena);
+	PG_FREE_IF_COPY(bytea_twkb, 0);
+	PG_RETURN_POINTER(geom);
+}
+
 /* puts a bbox inside the geometry */
 PG_FUNCTION_INFO_V1(LWGEOM_addBBOX);
 Datum LWGEOM_addBBOX(PG_FUNCTION_ARGS)
@@ -544,11 +573,15 @@ Datum LWGEOM_recv(PG_FUNCTION_ARGS)
 	int32 geom_typmod = -1;
 	GSERIALIZED *geom;
 	LWGEOM *lwgeom;
+	LWARENA *arena, *oldarena;
 
 	if ( (PG_NARGS()>2) && (!PG_ARGISNULL(2)) ) {
 		geom_typmod = PG_GETARG_INT32(2);
 	}
 	
+	arena = lwarena_create(buf->len);
+	oldarena = lwarena_switch(arena);
+
 	lwgeom = lwgeom_from_wkb((uint8_t*)buf->data, buf->len, LW_PARSER_CHECK_ALL);
 
 	if ( lwgeom_needs_bbox(lwgeom) )
@@ -557,8 +590,9 @@ Datum LWGEOM_recv(PG_FUNCTION_ARGS)
 	/* Set cursor to the end of buffer (so the backend is happy) */
 	buf->cursor = buf->len;
 
+	lwarena_switch(oldarena);
 	geom = geometry_serialize(lwgeom);
-	lwgeom_free(lwgeom);
+	lwarena_destroy(arena);
 
 	if ( geom_typmod >= 0 )
 	{
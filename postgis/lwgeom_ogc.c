@@ -754,14 +754,23 @@ Datum LWGEOM_from_text(PG_FUNCTION_ARGS)
 	LWGEOM_PARSER_RESULT lwg_parser_result;
 	GSERIALIZED *geom_result = NULL;
 	LWGEOM *lwgeom;
+	LWARENA *arena, *oldarena;
 
 	POSTGIS_DEBUG(2, "LWGEOM_from_text");
 	POSTGIS_DEBUGF(3, "wkt: [%s]", wkt);
 
+	/* The parsed LWGEOM is built in an arena and dropped in one go */
+	arena = lwarena_create(strlen(wkt));
+	oldarena = lwarena_switch(arena);
+
 	if (lwgeom_parse_wkt(&lwg_parser_result, wkt, LW_PARSER_CHECK_ALL) == LW_FAILURE)
+	{
+		lwarena_switch(oldarena);
 		PG_PARSER_ERROR(lwg_parser_result);
+	}
 
 	lwgeom = lwg_parser_result.geom;
+	lwarena_switch(oldarena);
 
 	if ( lwgeom->srid != SRID_UNKNOWN )
 	{
@@ -773,7 +782,7 @@ Datum LWGEOM_from_text(PG_FUNCTION_ARGS)
 		lwgeom_set_srid(lwgeom, PG_GETARG_INT32(1));
 
 	geom_result = geometry_serialize(lwgeom);
-	lwgeom_parser_result_free(&lwg_parser_result);
+	lwarena_destroy(arena);
 
 	PG_RETURN_POINTER(geom_result);
 }
@@ -795,14 +804,18 @@ Datum LWGEOM_from_WKB(PG_FUNCTION_ARGS)
 	GSERIALIZED *geom;
 	LWGEOM *lwgeom;
 	uint8_t *wkb = (uint8_t*)VARDATA(bytea_wkb);
+	size_t wkb_size = VARSIZE(bytea_wkb)-VARHDRSZ;
+	LWARENA *arena = lwarena_create(wkb_size);
+	LWARENA *oldarena = lwarena_switch(arena);
 	
-	lwgeom = lwgeom_from_wkb(wkb, VARSIZE(bytea_wkb)-VARHDRSZ, LW_PARSER_CHECK_ALL);
+	lwgeom = lwgeom_from_wkb(wkb, wkb_size, LW_PARSER_CHECK_ALL);
 	
 	if ( lwgeom_needs_bbox(lwgeom) )
 		lwgeom_add_bbox(lwgeom);
 	
+	lwarena_switch(oldarena);
 	geom = geometry_serialize(lwgeom);
-	lwgeom_free(lwgeom);
+	lwarena_destroy(arena);
 	PG_FREE_IF_COPY(bytea_wkb, 0);
 	
 	if ( gserialized_get_srid(geom) != SRID_UNKNOWN )
@@ -0,0 +1,341 @@
+/**********************************************************************
+ *
+ * PostGIS - Spatial Types for PostgreSQL
+ * http://postgis.net
+ *
+ * This is free software; you can redistribute and/or modify it under
+ * the terms of the GNU General Public Licence. See the COPYING file.
+ *
+ **********************************************************************/
+
+#include "postgres.h"
+#include "fmgr.h"
+
+#include "../postgis_config.h"
+#include "lwgeom_pg.h"
+#include "lwgeom_rectree.h"
+#include "lwgeom_rtree.h"
+
+
+/*
+* Specific tree types include all the generic slots and 
+* their own slots for their trees. The RectTreeGeomCache 
+* is the planar sibling of the CircTreeGeomCache in 
+* geography_measurement_trees.c.
+*/
+typedef struct {
+	int                     type;       // <GeomCache>
+	GSERIALIZED*                key;        // 
+	size_t                      key_size;   // 
+	uint64                      hash;       // 
+	GeomCacheIdent              ident;      // 
+	uint32                      lastused;   // 
+	uint32                      hits;       // 
+	uint32                      uses;       // 
+	int32                       argnum;     // </GeomCache>
+	RECT_NODE*                  index;
+	POINTARRAY*                 probes;     /* One vertex per component, for containment tests */
+} RectTreeGeomCache;
+
+
+/**
+* Collect the first vertex of every component of a geometry. If no
+* edges of two geometries cross, a component is inside a polygon if
+* and only if any one of its vertices is, so these are enough to 
+* test for containment.
+*/
+static POINTARRAY*
+lwgeom_component_probes(const LWGEOM* lwgeom)
+{
+	POINTARRAY* pa = ptarray_construct_empty(0, 0, 1);
+	POINT4D p4d;
+	int i;
+
+	if ( lwgeom_is_collection(lwgeom) )
+	{
+		const LWCOLLECTION* col = (const LWCOLLECTION*)lwgeom;
+		for ( i = 0; i < col->ngeoms; i++ )
+		{
+			if ( LW_SUCCESS == lwgeom_startpoint(col->geoms[i], &p4d) )
+				ptarray_append_point(pa, &p4d, LW_TRUE);
+		}
+	}
+	else if ( LW_SUCCESS == lwgeom_startpoint(lwgeom, &p4d) )
+	{
+		ptarray_append_point(pa, &p4d, LW_TRUE);
+	}
+	return pa;
+}
+
+static void
+RectTreeClear(RectTreeGeomCache* rect_cache)
+{
+	if ( rect_cache->index )
+	{
+		rect_tree_free(rect_cache->index);
+		rect_cache->index = 0;
+	}
+	if ( rect_cache->probes )
+	{
+		ptarray_free(rect_cache->probes);
+		rect_cache->probes = 0;
+	}
+}
+
+/**
+* Builder, freeer and public accessor for cached RECT_NODE trees
+*/
+static int
+RectTreeBuilder(const LWGEOM* lwgeom, GeomCache* cache)
+{
+	RectTreeGeomCache* rect_cache = (RectTreeGeomCache*)cache;
+	RECT_NODE* tree = lwgeom_calculate_rect_tree(lwgeom);
+
+	RectTreeClear(rect_cache);
+	if ( ! tree )
+		return LW_FAILURE;
+
+	rect_cache->index = tree;
+	rect_cache->probes = lwgeom_component_probes(lwgeom);
+	return LW_SUCCESS;
+}
+
+static int
+RectTreeFreer(GeomCache* cache)
+{
+	RectTreeGeomCache* rect_cache = (RectTreeGeomCache*)cache;
+	if ( rect_cache->index )
+		rect_cache->argnum = 0;
+	RectTreeClear(rect_cache);
+	return LW_SUCCESS;
+}
+
+/**
+* Flattener and attacher, for the trees shared between backends
+* (see lwgeom_shared_cache.h)
+*/
+static void*
+RectTreeFlattener(const GeomCache* cache, size_t* size)
+{
+	const RectTreeGeomCache* rect_cache = (const RectTreeGeomCache*)cache;
+	if ( ! rect_cache->index )
+		return NULL;
+	return rect_tree_flatten(rect_cache->index, size);
+}
+
+static int
+RectTreeAttacher(const LWGEOM* lwgeom, GeomCache* cache, const void* buf, size_t size)
+{
+	RectTreeGeomCache* rect_cache = (RectTreeGeomCache*)cache;
+	RECT_NODE* tree = rect_tree_unflatten(buf, size);
+
+	RectTreeClear(rect_cache);
+	if ( ! tree )
+		return LW_FAILURE;
+
+	rect_cache->index = tree;
+	rect_cache->probes = lwgeom_component_probes(lwgeom);
+	return LW_SUCCESS;
+}
+
+static GeomCache*
+RectTreeAllocator(void)
+{
+	RectTreeGeomCache* cache = palloc(sizeof(RectTreeGeomCache));
+	memset(cache, 0, sizeof(RectTreeGeomCache));
+	return (GeomCache*)cache;
+}
+
+static GeomCacheMethods RectTreeCacheMethods =
+{
+	RECT_CACHE_ENTRY,
+	RectTreeBuilder,
+	RectTreeFreer,
+	RectTreeAllocator,
+	RectTreeFlattener,
+	RectTreeAttacher
+};
+
+static RectTreeGeomCache*
+GetRectTreeGeomCache(FunctionCallInfoData* fcinfo, const GSERIALIZED* g1, const GSERIALIZED* g2)
+{
+	return (RectTreeGeomCache*)GetGeomCache(fcinfo, &RectTreeCacheMethods, g1, g2);
+}
+
+
+/**
+* The tree distance is an edge-to-edge distance, so we only
+* take the tree path for types where "inside" can be resolved
+* with a polygon containment test on top of that.
+*/
+static int
+rect_tree_supports_type(int type)
+{
+	switch ( type )
+	{
+		case POINTTYPE:
+		case LINETYPE:
+		case POLYGONTYPE:
+		case MULTIPOINTTYPE:
+		case MULTILINETYPE:
+		case MULTIPOLYGONTYPE:
+			return LW_TRUE;
+		default:
+			return LW_FALSE;
+	}
+}
+
+/**
+* Is any of the probe points strictly inside the polygonal tree?
+*/
+static int
+RectTreePIP(const RECT_NODE* tree, int tree_type, const POINTARRAY* probes)
+{
+	POINT2D pt;
+	int i;
+
+	if ( tree_type != POLYGONTYPE && tree_type != MULTIPOLYGONTYPE )
+		return LW_FALSE;
+
+	for ( i = 0; i < probes->npoints; i++ )
+	{
+		getPoint2d_p(probes, i, &pt);
+		if ( rect_tree_polygon_contains_point(tree, &pt) )
+			return LW_TRUE;
+	}
+	return LW_FALSE;
+}
+
+
+static int
+geometry_distance_cache_tolerance(FunctionCallInfoData* fcinfo, const GSERIALIZED* g1, const GSERIALIZED* g2, double tolerance, double* distance)
+{
+	RectTreeGeomCache* tree_cache = NULL;
+
+	int type1 = gserialized_get_type(g1);
+	int type2 = gserialized_get_type(g2);
+
+	Assert(distance);
+
+	/* Two points? Get outa here... */
+	if ( type1 == POINTTYPE && type2 == POINTTYPE )
+		return LW_FAILURE;
+
+	/* Curves and heterogeneous collections take the slow road */
+	if ( ! ( rect_tree_supports_type(type1) && rect_tree_supports_type(type2) ) )
+		return LW_FAILURE;
+
+	/* Fetch/build our cache, if appropriate, etc... */
+	tree_cache = GetRectTreeGeomCache(fcinfo, g1, g2);
+
+	/* OK, we have an index at the ready! Use it for the one tree argument and */
+	/* fill in the other tree argument */
+	if ( tree_cache && tree_cache->argnum && tree_cache->index )
+	{
+		RECT_NODE* recttree_cached = tree_cache->index;
+		RECT_NODE* recttree = NULL;
+		POINTARRAY* probes = NULL;
+		const GSERIALIZED* g;
+		LWGEOM* lwgeom = NULL;
+		int geomtype_cached;
+		int geomtype;
+
+		/* We need to dynamically build a tree for the uncached side of the function call */
+		if ( tree_cache->argnum == 1 )
+		{
+			g = g2;
+			geomtype_cached = type1;
+			geomtype = type2;
+		}
+		else if ( tree_cache->argnum == 2 )
+		{
+			g = g1;
+			geomtype_cached = type2;
+			geomtype = type1;
+		}
+		else
+		{
+			lwerror("geometry_distance_cache this cannot happen!");
+			return LW_FAILURE;
+		}
+
+		lwgeom = lwgeom_from_gserialized(g);
+		recttree = lwgeom_calculate_rect_tree(lwgeom);
+
+		/* Empty uncached side, let the brute force code sort it out */
+		if ( ! recttree )
+		{
+			lwgeom_free(lwgeom);
+			return LW_FAILURE;
+		}
+
+		probes = lwgeom_component_probes(lwgeom);
+		if ( RectTreePIP(recttree_cached, geomtype_cached, probes) ||
+		     RectTreePIP(recttree, geomtype, tree_cache->probes) )
+		{
+			*distance = 0.0;
+		}
+		else
+		{
+			*distance = rect_tree_distance_tree(recttree_cached, recttree, tolerance);
+		}
+
+		ptarray_free(probes);
+		rect_tree_free(recttree);
+		lwgeom_free(lwgeom);
+		return LW_SUCCESS;
+	}
+	else
+	{
+		return LW_FAILURE;
+	}
+}
+
+
+int
+geometry_distance_cache(FunctionCallInfoData* fcinfo, const GSERIALIZED* g1, const GSERIALIZED* g2, double* distance)
+{
+	return geometry_distance_cache_tolerance(fcinfo, g1, g2, 0.0, distance);
+}
+
+int
+geometry_dwithin_cache(FunctionCallInfoData* fcinfo, const GSERIALIZED* g1, const GSERIALIZED* g2, double tolerance, int* dwithin)
+{
+	double distance;
+	if ( LW_SUCCESS == geometry_distance_cache_tolerance(fcinfo, g1, g2, tolerance, &distance) )
+	{
+		*dwithin = (distance <= tolerance ? LW_TRUE : LW_FALSE);
+		return LW_SUCCESS;
+	}
+	return LW_FAILURE;
+}
+
+
+/**
+* ST_AddIndexTree(geometry) builds the trees that ST_Distance and
+* ST_DWithin (rect tree), and the point in polygon tests of
+* ST_Intersects and friends (ring trees), would build on the
+* geometry, and shares them with every backend. Returns true if
+* they are shared, now or before.
+*/
+PG_FUNCTION_INFO_V1(LWGEOM_add_index_tree);
+Datum LWGEOM_add_index_tree(PG_FUNCTION_ARGS)
+{
+	GSERIALIZED *geom = (GSERIALIZED*)PG_DETOAST_DATUM(PG_GETARG_DATUM(0));
+	int type = gserialized_get_type(geom);
+	int result;
+
+	/* Nothing the trees would be used for */
+	if ( gserialized_is_empty(geom) || ! rect_tree_supports_type(type) )
+	{
+		PG_FREE_IF_COPY(geom, 0);
+		PG_RETURN_BOOL(FALSE);
+	}
+
+	result = GeomCachePublishIndex(&RectTreeCacheMethods, geom);
+	if ( result && (type == POLYGONTYPE || type == MULTIPOLYGONTYPE) )
+		result = PublishRtreeCache(geom);
+
+	PG_FREE_IF_COPY(geom, 0);
+	PG_RETURN_BOOL(result);
+}
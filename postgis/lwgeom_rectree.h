@@ -0,0 +1,6 @@
+#include "liblwgeom_internal.h"
+#include "lwtree.h"
+#include "lwgeom_cache.h"
+
+int geometry_distance_cache(FunctionCallInfoData* fcinfo, const GSERIALIZED* g1, const GSERIALIZED* g2, double* distance);
+int geometry_dwithin_cache(FunctionCallInfoData* fcinfo, const GSERIALIZED* g1, const GSERIALIZED* g2, double tolerance, int* dwithin);
@@ -43,6 +43,8 @@ RTreeFree(RTREE_NODE* root)
 {
 	POSTGIS_DEBUGF(2, "RTreeFree called for %p", root);
 
+	if (!root)
+		return;
 	if (root->leftNode)
 		RTreeFree(root->leftNode);
 	if (root->rightNode)
@@ -69,13 +71,17 @@ RTreeCacheClear(RTREE_POLY_CACHE* cache)
 		for (r = 0; r < cache->ringCounts[g]; r++)
 		{
 			RTreeFree(cache->ringIndices[i]);
+			/* The ring only references the cached serialization */
+			ptarray_free(cache->rings[i]);
 			i++;
 		}
 	}
 	lwfree(cache->ringIndices);
 	lwfree(cache->ringCounts);
+	lwfree(cache->rings);
 	cache->ringIndices = 0;
 	cache->ringCounts = 0;
+	cache->rings = 0;
 	cache->polyCount = 0;
 }
 
@@ -294,32 +300,32 @@ RTreeMergeMultiLines(LWMLINE *line1, LWMLINE *line2)
 
 
 /**
-* Callback function sent into the GetGeomCache generic caching system. Given a
-* LWGEOM* this function builds and stores an RTREE_POLY_CACHE into the provided
-* GeomCache object.
+* The LWGEOM handed to the builder does not outlive the call, but its
+* point lists point into the serialization held by the cache. Keep a
+* read-only header on each ring in the cache context.
 */
-static int 
-RTreeBuilder(const LWGEOM* lwgeom, GeomCache* cache)
+static POINTARRAY*
+RTreeRingReference(const POINTARRAY *ring)
+{
+	return ptarray_construct_reference_data(FLAGS_GET_Z(ring->flags), FLAGS_GET_M(ring->flags),
+	                                        ring->npoints, ring->serialized_pointlist);
+}
+
+/**
+* Builds the ring rtrees of a polygon or multipolygon.
+*/
+RTREE_POLY_CACHE*
+RTreePolyCacheBuild(const LWGEOM* lwgeom)
 {
 	int i, p, r;
 	LWMPOLY *mpoly;
 	LWPOLY *poly;
 	int nrings;
-	RTreeGeomCache* rtree_cache = (RTreeGeomCache*)cache;
 	RTREE_POLY_CACHE* currentCache;
-	
-	if ( ! cache )
-		return LW_FAILURE;
 
-	if ( rtree_cache->index )
-	{
-		lwerror("RTreeBuilder asked to build index where one already exists.");
-		return LW_FAILURE;
-	}
-	
 	if (lwgeom->type == MULTIPOLYGONTYPE)
 	{
-		POSTGIS_DEBUG(2, "RTreeBuilder MULTIPOLYGON");
+		POSTGIS_DEBUG(2, "RTreePolyCacheBuild MULTIPOLYGON");
 		mpoly = (LWMPOLY *)lwgeom;
 		nrings = 0;
 		/*
@@ -334,6 +340,7 @@ RTreeBuilder(const LWGEOM* lwgeom, GeomCache* cache)
 			nrings += mpoly->geoms[i]->nrings;
 		}
 		currentCache->ringIndices = lwalloc(sizeof(RTREE_NODE *) * nrings);
+		currentCache->rings = lwalloc(sizeof(POINTARRAY *) * nrings);
 		/*
 		** Load the array in geometry order, each outer ring followed by the inner rings
                 ** associated with that outer ring
@@ -344,14 +351,15 @@ RTreeBuilder(const LWGEOM* lwgeom, GeomCache* cache)
 			for ( r = 0; r < mpoly->geoms[p]->nrings; r++ )
 			{
 				currentCache->ringIndices[i] = RTreeCreate(mpoly->geoms[p]->rings[r]);
+				currentCache->rings[i] = RTreeRingReference(mpoly->geoms[p]->rings[r]);
 				i++;
 			}
 		}
-		rtree_cache->index = currentCache;
+		return currentCache;
 	}
 	else if ( lwgeom->type == POLYGONTYPE )
 	{
-		POSTGIS_DEBUG(2, "RTreeBuilder POLYGON");
+		POSTGIS_DEBUG(2, "RTreePolyCacheBuild POLYGON");
 		poly = (LWPOLY *)lwgeom;
 		currentCache = RTreeCacheCreate();
 		currentCache->polyCount = 1;
@@ -361,18 +369,55 @@ RTreeBuilder(const LWGEOM* lwgeom, GeomCache* cache)
 		** Just load the rings on in order
 		*/
 		currentCache->ringIndices = lwalloc(sizeof(RTREE_NODE *) * poly->nrings);
+		currentCache->rings = lwalloc(sizeof(POINTARRAY *) * poly->nrings);
 		for ( i = 0; i < poly->nrings; i++ )
 		{
 			currentCache->ringIndices[i] = RTreeCreate(poly->rings[i]);
+			currentCache->rings[i] = RTreeRingReference(poly->rings[i]);
 		}
-		rtree_cache->index = currentCache;
+		return currentCache;
 	}
-	else
+
+	/* Uh oh, shouldn't be here. */
+	lwerror("RTreePolyCacheBuild got asked to build index on non-polygon");
+	return NULL;
+}
+
+/**
+* Frees an index built by RTreePolyCacheBuild.
+*/
+void
+RTreePolyCacheFree(RTREE_POLY_CACHE* cache)
+{
+	if ( ! cache )
+		return;
+	RTreeCacheClear(cache);
+	lwfree(cache);
+}
+
+/**
+* Callback function sent into the GetGeomCache generic caching system. Given a
+* LWGEOM* this function builds and stores an RTREE_POLY_CACHE into the provided
+* GeomCache object.
+*/
+static int 
+RTreeBuilder(const LWGEOM* lwgeom, GeomCache* cache)
+{
+	RTreeGeomCache* rtree_cache = (RTreeGeomCache*)cache;
+	
+	if ( ! cache )
+		return LW_FAILURE;
+
+	if ( rtree_cache->index )
 	{
-		/* Uh oh, shouldn't be here. */
-		lwerror("RTreeBuilder got asked to build index on non-polygon");
+		lwerror("RTreeBuilder asked to build index where one already exists.");
 		return LW_FAILURE;
 	}
+
+	rtree_cache->index = RTreePolyCacheBuild(lwgeom);
+	if ( ! rtree_cache->index )
+		return LW_FAILURE;
+
 	return LW_SUCCESS;	
 }
 
@@ -390,14 +435,298 @@ RTreeFreer(GeomCache* cache)
 	
 	if ( rtree_cache->index )
 	{
-		RTreeCacheClear(rtree_cache->index);
-		lwfree(rtree_cache->index);
+		RTreePolyCacheFree(rtree_cache->index);
 		rtree_cache->index = 0;
 		rtree_cache->argnum = 0;
 	}
 	return LW_SUCCESS;
 }
 
+/*
+* Layout of a flattened RTREE_POLY_CACHE: a header, the ring
+* count of each polygon, the root record of each ring, then the
+* node records of all rings, with the segment end points inline.
+*/
+#define RTREE_FLAT_MAGIC 0x52545245 /* "RTRE" */
+
+typedef struct
+{
+	uint32 magic;
+	int32 polyCount;
+	int32 ringCount;
+	int32 nodeCount;
+}
+RTREE_FLAT;
+
+typedef struct
+{
+	double min;
+	double max;
+	int32 left;       /* Child records, -1 for none. Leaves have neither */
+	int32 right;
+	POINT2D segment[2];
+}
+RTREE_NODE_FLAT;
+
+#define RTREE_FLAT_NODES_OFFSET(polyCount, ringCount) \
+	MAXALIGN(sizeof(RTREE_FLAT) + ((polyCount) + (ringCount)) * sizeof(int32))
+
+/*
+* RTreeCreate pairs up the nodes of a ring level by level, so no 
+* ring tree is deeper than the number of bits of its segment count.
+*/
+#define RTREE_FLAT_MAX_DEPTH 64
+
+static int
+RTreeCountNodes(const RTREE_NODE* node)
+{
+	if ( ! node )
+		return 0;
+	return 1 + RTreeCountNodes(node->leftNode) + RTreeCountNodes(node->rightNode);
+}
+
+static int32
+RTreeFlattenNode(const RTREE_NODE* node, RTREE_NODE_FLAT* records, int32* next)
+{
+	int32 i;
+	RTREE_NODE_FLAT* r;
+
+	if ( ! node )
+		return -1;
+
+	i = (*next)++;
+	r = &(records[i]);
+	r->min = node->interval->min;
+	r->max = node->interval->max;
+	r->left = RTreeFlattenNode(node->leftNode, records, next);
+	r->right = RTreeFlattenNode(node->rightNode, records, next);
+	if ( node->segment )
+	{
+		getPoint2d_p(node->segment->points, 0, &(r->segment[0]));
+		getPoint2d_p(node->segment->points, 1, &(r->segment[1]));
+	}
+	return i;
+}
+
+/*
+* Check that the records from i down are the tree RTreeCreate builds
+* on the ring pa, from its segment number *segment on. Records are
+* in depth-first order, so each node must be record *next, which 
+* also keeps a bad buffer from making a loop or sharing a subtree.
+*/
+static int
+RTreeCheckFlatNode(const RTREE_NODE_FLAT* records, int32 nodeCount, int32 i, int32* next,
+                   const POINTARRAY* pa, int* segment, int depth)
+{
+	const RTREE_NODE_FLAT* r;
+	const RTREE_NODE_FLAT* left;
+	const RTREE_NODE_FLAT* right;
+	POINT2D p0, p1;
+
+	if ( i != *next || i >= nodeCount || depth > RTREE_FLAT_MAX_DEPTH )
+		return LW_FALSE;
+	(*next)++;
+	r = &(records[i]);
+
+	/* Leaves hold the segments of the ring, in order */
+	if ( r->left < 0 && r->right < 0 )
+	{
+		if ( *segment + 1 >= pa->npoints )
+			return LW_FALSE;
+		getPoint2d_p(pa, *segment, &p0);
+		getPoint2d_p(pa, *segment + 1, &p1);
+		(*segment)++;
+		return p0.x == r->segment[0].x && p0.y == r->segment[0].y &&
+		       p1.x == r->segment[1].x && p1.y == r->segment[1].y &&
+		       r->min == FP_MIN(p0.y, p1.y) && r->max == FP_MAX(p0.y, p1.y);
+	}
+
+	/* Interior nodes have both children, and span them */
+	if ( r->left < 0 || r->right < 0 ||
+	     ! RTreeCheckFlatNode(records, nodeCount, r->left, next, pa, segment, depth + 1) ||
+	     ! RTreeCheckFlatNode(records, nodeCount, r->right, next, pa, segment, depth + 1) )
+		return LW_FALSE;
+	left = &(records[r->left]);
+	right = &(records[r->right]);
+	return r->min == FP_MIN(left->min, right->min) && r->max == FP_MAX(left->max, right->max);
+}
+
+static RTREE_NODE*
+RTreeUnflattenNode(const RTREE_NODE_FLAT* records, int32 i)
+{
+	const RTREE_NODE_FLAT* r;
+	RTREE_NODE* node;
+
+	if ( i < 0 )
+		return NULL;
+
+	r = &(records[i]);
+	node = lwalloc(sizeof(RTREE_NODE));
+	node->interval = lwalloc(sizeof(RTREE_INTERVAL));
+	node->interval->min = r->min;
+	node->interval->max = r->max;
+	node->leftNode = RTreeUnflattenNode(records, r->left);
+	node->rightNode = RTreeUnflattenNode(records, r->right);
+	node->segment = NULL;
+	if ( ! node->leftNode && ! node->rightNode )
+	{
+		/* The segment points are read in place */
+		POINTARRAY* npa = ptarray_construct_reference_data(0, 0, 2, (uint8_t*)r->segment);
+		node->segment = lwline_construct(SRID_UNKNOWN, NULL, npa);
+	}
+	return node;
+}
+
+/**
+* Copies the ring trees of an index into one buffer, that can be
+* shared with other backends. The rings themselves are not copied,
+* they are in the geometry.
+*/
+static void*
+RTreePolyCacheFlatten(const RTREE_POLY_CACHE* index, size_t* size)
+{
+	RTREE_FLAT* flat;
+	int32* ints;
+	RTREE_NODE_FLAT* records;
+	int32 i, ringCount = 0, nodeCount = 0, next = 0;
+	size_t offset;
+
+	if ( ! index )
+		return NULL;
+
+	for ( i = 0; i < index->polyCount; i++ )
+		ringCount += index->ringCounts[i];
+	for ( i = 0; i < ringCount; i++ )
+		nodeCount += RTreeCountNodes(index->ringIndices[i]);
+
+	offset = RTREE_FLAT_NODES_OFFSET(index->polyCount, ringCount);
+	*size = offset + nodeCount * sizeof(RTREE_NODE_FLAT);
+	flat = lwalloc(*size);
+	memset(flat, 0, *size);
+	flat->magic = RTREE_FLAT_MAGIC;
+	flat->polyCount = index->polyCount;
+	flat->ringCount = ringCount;
+	flat->nodeCount = nodeCount;
+
+	ints = (int32*)(flat + 1);
+	records = (RTREE_NODE_FLAT*)((uint8*)flat + offset);
+	for ( i = 0; i < index->polyCount; i++ )
+		ints[i] = index->ringCounts[i];
+	for ( i = 0; i < ringCount; i++ )
+		ints[index->polyCount + i] = RTreeFlattenNode(index->ringIndices[i], records, &next);
+
+	return flat;
+}
+
+/**
+* Rebuilds the index of lwgeom on a buffer made by RTreePolyCacheFlatten,
+* reading the segments from the buffer. NULL if the buffer is not the
+* index of lwgeom, node for node and coordinate for coordinate, in which
+* case the caller builds the index instead.
+*/
+static RTREE_POLY_CACHE*
+RTreePolyCacheAttach(const LWGEOM* lwgeom, const void* buf, size_t size)
+{
+	const RTREE_FLAT* flat = buf;
+	const int32* ints;
+	const RTREE_NODE_FLAT* records;
+	RTREE_POLY_CACHE* index;
+	LWPOLY** polys;
+	LWPOLY* poly;
+	int i, p, r, npolys, segment;
+	int32 next;
+	size_t offset;
+
+	if ( lwgeom->type == MULTIPOLYGONTYPE )
+	{
+		polys = ((LWMPOLY*)lwgeom)->geoms;
+		npolys = ((LWMPOLY*)lwgeom)->ngeoms;
+	}
+	else if ( lwgeom->type == POLYGONTYPE )
+	{
+		poly = (LWPOLY*)lwgeom;
+		polys = &poly;
+		npolys = 1;
+	}
+	else
+		return NULL;
+
+	/* Check the buffer is the index of this very geometry */
+	if ( size < sizeof(RTREE_FLAT) || flat->magic != RTREE_FLAT_MAGIC || flat->polyCount != npolys )
+		return NULL;
+	for ( p = 0, i = 0; p < npolys; p++ )
+		i += polys[p]->nrings;
+	if ( i != flat->ringCount || flat->nodeCount <= 0 )
+		return NULL;
+	offset = RTREE_FLAT_NODES_OFFSET(flat->polyCount, flat->ringCount);
+	if ( size < offset || (size - offset) / sizeof(RTREE_NODE_FLAT) != (size_t)flat->nodeCount ||
+	     (size - offset) % sizeof(RTREE_NODE_FLAT) )
+		return NULL;
+	ints = (const int32*)(flat + 1);
+	records = (const RTREE_NODE_FLAT*)((const uint8*)flat + offset);
+
+	for ( p = 0, i = 0, next = 0; p < npolys; p++ )
+	{
+		if ( ints[p] != polys[p]->nrings )
+			return NULL;
+		for ( r = 0; r < polys[p]->nrings; r++, i++ )
+		{
+			segment = 0;
+			if ( ! RTreeCheckFlatNode(records, flat->nodeCount, ints[npolys + i], &next,
+			                          polys[p]->rings[r], &segment, 0) ||
+			     segment != polys[p]->rings[r]->npoints - 1 )
+				return NULL;
+		}
+	}
+	if ( next != flat->nodeCount )
+		return NULL;
+
+	index = RTreeCacheCreate();
+	index->polyCount = npolys;
+	index->ringCounts = lwalloc(sizeof(int) * npolys);
+	index->ringIndices = lwalloc(sizeof(RTREE_NODE *) * flat->ringCount);
+	index->rings = lwalloc(sizeof(POINTARRAY *) * flat->ringCount);
+	for ( p = 0, i = 0; p < npolys; p++ )
+	{
+		index->ringCounts[p] = polys[p]->nrings;
+		for ( r = 0; r < polys[p]->nrings; r++, i++ )
+		{
+			index->ringIndices[i] = RTreeUnflattenNode(records, ints[npolys + i]);
+			index->rings[i] = RTreeRingReference(polys[p]->rings[r]);
+		}
+	}
+
+	return index;
+}
+
+/**
+* Callback function sent into the GetGeomCache generic caching system. 
+* Copies the ring trees of the cached index into one buffer.
+*/
+static void*
+RTreeFlattener(const GeomCache* cache, size_t* size)
+{
+	const RTREE_POLY_CACHE* index = ((const RTreeGeomCache*)cache)->index;
+	if ( ! index )
+		return NULL;
+	return RTreePolyCacheFlatten(index, size);
+}
+
+/**
+* Callback function sent into the GetGeomCache generic caching system. 
+* Rebuilds the index of lwgeom on a buffer made by RTreeFlattener.
+*/
+static int
+RTreeAttacher(const LWGEOM* lwgeom, GeomCache* cache, const void* buf, size_t size)
+{
+	RTreeGeomCache* rtree_cache = (RTreeGeomCache*)cache;
+
+	if ( rtree_cache->index )
+		return LW_FAILURE;
+	rtree_cache->index = RTreePolyCacheAttach(lwgeom, buf, size);
+	return rtree_cache->index ? LW_SUCCESS : LW_FAILURE;
+}
+
 static GeomCache*
 RTreeAllocator(void)
 {
@@ -411,13 +740,15 @@ static GeomCacheMethods RTreeCacheMethods =
 	RTREE_CACHE_ENTRY,
 	RTreeBuilder,
 	RTreeFreer,
-	RTreeAllocator
+	RTreeAllocator,
+	RTreeFlattener,
+	RTreeAttacher
 };
 
 RTREE_POLY_CACHE*
-GetRtreeCache(FunctionCallInfoData* fcinfo, GSERIALIZED* g1)
+GetRtreeCache(FunctionCallInfoData* fcinfo, GSERIALIZED* g1, GSERIALIZED* g2)
 {
-	RTreeGeomCache* cache = (RTreeGeomCache*)GetGeomCache(fcinfo, &RTreeCacheMethods, g1, NULL);
+	RTreeGeomCache* cache = (RTreeGeomCache*)GetGeomCache(fcinfo, &RTreeCacheMethods, g1, g2);
 	RTREE_POLY_CACHE* index = NULL;
 
 	if ( cache )
@@ -426,6 +757,12 @@ GetRtreeCache(FunctionCallInfoData* fcinfo, GSERIALIZED* g1)
 	return index;
 }
 
+int
+PublishRtreeCache(const GSERIALIZED* g)
+{
+	return GeomCachePublishIndex(&RTreeCacheMethods, g);
+}
+
 
 /**
 * Retrieves a collection of line segments given the root and crossing value.
@@ -2,6 +2,7 @@
 #define _LWGEOM_RTREE_H 1
 
 #include "liblwgeom.h"
+#include "lwgeom_cache.h"
 
 /**
 * Representation for the y-axis interval spanned by an edge.
@@ -35,6 +36,8 @@ typedef struct
 	RTREE_NODE **ringIndices;
 	int* ringCounts;
 	int polyCount;
+	/* Rings in the same order as ringIndices, for the batched tests */
+	POINTARRAY **rings;
 }
 RTREE_POLY_CACHE;
 
@@ -42,10 +45,13 @@ RTREE_POLY_CACHE;
 
 typedef struct {
 	int                         type;       // <GeomCache>
-	GSERIALIZED*                geom1;      // 
-	GSERIALIZED*                geom2;      // 
-	size_t                      geom1_size; // 
-	size_t                      geom2_size; // 
+	GSERIALIZED*                key;        // 
+	size_t                      key_size;   // 
+	uint64                      hash;       // 
+	GeomCacheIdent              ident;      // 
+	uint32                      lastused;   // 
+	uint32                      hits;       // 
+	uint32                      uses;       // 
 	int32                       argnum;     // </GeomCache>
 	RTREE_POLY_CACHE*           index;
 } RTreeGeomCache;
@@ -58,11 +64,29 @@ LWMLINE *RTreeFindLineSegments(RTREE_NODE *root, double value);
 
 
 /**
-* Checks for a cache hit against the provided geometry and returns
+* Builds the ring rtrees of a polygon or multipolygon outside of the
+* function call cache, for callers that test many points in one go.
+* The rings reference the point lists of lwgeom, which has to outlive
+* the index. Free with RTreePolyCacheFree.
+*/
+RTREE_POLY_CACHE* RTreePolyCacheBuild(const LWGEOM* lwgeom);
+void RTreePolyCacheFree(RTREE_POLY_CACHE* cache);
+
+
+/**
+* Checks for a cache hit against the provided geometries and returns
 * a pre-built index structure (RTREE_POLY_CACHE) if one exists. Otherwise
-* builds a new one and returns that.
+* builds a new one and returns that. g1 and g2 are the first and second
+* arguments of the calling function; pass NULL for one that should
+* not be indexed.
+*/
+RTREE_POLY_CACHE* GetRtreeCache(FunctionCallInfoData* fcinfo, GSERIALIZED* g1, GSERIALIZED* g2);
+
+/**
+* Builds the index of a polygon or multipolygon and shares it with
+* every backend, see GeomCachePublishIndex.
 */
-RTREE_POLY_CACHE* GetRtreeCache(FunctionCallInfoData* fcinfo, GSERIALIZED* g1);
+int PublishRtreeCache(const GSERIALIZED* g);
 
 
 #endif /* !defined _LWGEOM_RTREE_H */
@@ -12,8 +12,14 @@
 
 #include "postgres.h"
 #include "fmgr.h"
+#include "funcapi.h"
+#include "commands/trigger.h"
+#include "utils/inval.h"
 
 #include "../postgis_config.h"
+#if POSTGIS_PGSQL_VERSION >= 93
+#include "access/htup_details.h"
+#endif
 #include "liblwgeom.h"
 #include "lwgeom_transform.h"
 
@@ -21,6 +27,8 @@
 Datum transform(PG_FUNCTION_ARGS);
 Datum transform_geom(PG_FUNCTION_ARGS);
 Datum postgis_proj_version(PG_FUNCTION_ARGS);
+Datum postgis_proj_cache_stats(PG_FUNCTION_ARGS);
+Datum postgis_srs_invalidate(PG_FUNCTION_ARGS);
 
 
 
@@ -207,3 +215,52 @@ Datum postgis_proj_version(PG_FUNCTION_ARGS)
 	text *result = cstring2text(ver);
 	PG_RETURN_POINTER(result);
 }
+
+/**
+ * postgis_proj_cache_stats(OUT hits, OUT misses, OUT evictions, OUT init_time)
+ * Report the projection cache counters accumulated by this backend.
+ */
+PG_FUNCTION_INFO_V1(postgis_proj_cache_stats);
+Datum postgis_proj_cache_stats(PG_FUNCTION_ARGS)
+{
+	const PROJ4CacheStats *stats = GetPROJ4CacheStats();
+	TupleDesc tupdesc;
+	HeapTuple tuple;
+	Datum values[4];
+	bool isnull[4] = { false, false, false, false };
+
+	if ( get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE )
+	{
+		ereport(ERROR, (
+		            errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+		            errmsg("function returning record called in context "
+		                   "that cannot accept type record")));
+	}
+	tupdesc = BlessTupleDesc(tupdesc);
+
+	values[0] = Int64GetDatum(stats->hits);
+	values[1] = Int64GetDatum(stats->misses);
+	values[2] = Int64GetDatum(stats->evictions);
+	values[3] = Float8GetDatum(stats->init_time);
+
+	tuple = heap_form_tuple(tupdesc, values, isnull);
+	PG_RETURN_DATUM(HeapTupleGetDatum(tuple));
+}
+
+/**
+ * Statement trigger on spatial_ref_sys. Row changes send no cache
+ * invalidation of their own, so send a relcache one for the table:
+ * every backend drops its cached proj4text when it sees it.
+ */
+PG_FUNCTION_INFO_V1(postgis_srs_invalidate);
+Datum postgis_srs_invalidate(PG_FUNCTION_ARGS)
+{
+	TriggerData *trigdata = (TriggerData *) fcinfo->context;
+
+	if ( ! CALLED_AS_TRIGGER(fcinfo) )
+		elog(ERROR, "postgis_srs_invalidate: not called by trigger manager");
+
+	CacheInvalidateRelcache(trigdata->tg_relation);
+
+	return PointerGetDatum(NULL);
+}
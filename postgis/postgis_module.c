@@ -12,6 +12,7 @@
 
 #include "postgres.h"
 #include "fmgr.h"
+#include "miscadmin.h"
 #include "utils/elog.h"
 #include "utils/guc.h"
 #include "libpq/pqsignal.h"
@@ -20,6 +21,8 @@
 
 #include "lwgeom_log.h"
 #include "lwgeom_pg.h"
+#include "lwgeom_cache.h"
+#include "lwgeom_shared_cache.h"
 #include "geos_c.h"
 #include "lwgeom_backend_api.h"
 
@@ -93,6 +96,114 @@ _PG_init(void)
    );
 #endif
 
+  /* Size of the per-statement projection cache */
+  DefineCustomIntVariable(
+    "postgis.proj_cache_size", /* name */
+    "Sets the number of projections cached by each ST_Transform call site.", /* short_desc */
+    "Statements reprojecting among more SRIDs than this evict the least recently used projection.", /* long_desc */
+    &proj4_cache_size, /* valueAddr */
+    PROJ4_CACHE_ITEMS_MIN, PROJ4_CACHE_ITEMS_MAX, /* min-max */
+    PROJ4_CACHE_ITEMS, /* bootValue */
+    PGC_USERSET, /* GucContext context */
+    0, /* int flags */
+#if POSTGIS_PGSQL_VERSION >= 91
+    NULL, /* GucIntCheckHook check_hook */
+#endif
+    NULL, /* GucIntAssignHook assign_hook */
+    NULL  /* GucShowHook show_hook */
+   );
+
+  /* Size of the per-statement geometry index caches */
+  DefineCustomIntVariable(
+    "postgis.geom_cache_size", /* name */
+    "Sets the number of geometries each cached index slot remembers per call site.", /* short_desc */
+    "Joins repeating more distinct geometries than this evict the least recently used index.", /* long_desc */
+    &geom_cache_size, /* valueAddr */
+    GEOM_CACHE_ITEMS_MIN, GEOM_CACHE_ITEMS_MAX, /* min-max */
+    GEOM_CACHE_ITEMS, /* bootValue */
+    PGC_USERSET, /* GucContext context */
+    0, /* int flags */
+#if POSTGIS_PGSQL_VERSION >= 91
+    NULL, /* GucIntCheckHook check_hook */
+#endif
+    NULL, /* GucIntAssignHook assign_hook */
+    NULL  /* GucShowHook show_hook */
+   );
+
+  DefineCustomIntVariable(
+    "postgis.geom_cache_memory", /* name */
+    "Sets the memory of cached geometries each index slot may hold per call site.", /* short_desc */
+    "Counts the serialized size of the cached geometries.", /* long_desc */
+    &geom_cache_memory, /* valueAddr */
+    GEOM_CACHE_MEMORY_MIN, GEOM_CACHE_MEMORY_MAX, /* min-max */
+    GEOM_CACHE_MEMORY, /* bootValue */
+    PGC_USERSET, /* GucContext context */
+    GUC_UNIT_KB, /* int flags */
+#if POSTGIS_PGSQL_VERSION >= 91
+    NULL, /* GucIntCheckHook check_hook */
+#endif
+    NULL, /* GucIntAssignHook assign_hook */
+    NULL  /* GucShowHook show_hook */
+   );
+
+  DefineCustomIntVariable(
+    "postgis.geom_cache_build_hits", /* name */
+    "Sets the number of repeats before a cached geometry gets its index, 0 to decide adaptively.", /* short_desc */
+    "The adaptive rule weighs the geometry size against how often cached geometries have repeated.", /* long_desc */
+    &geom_cache_build_hits, /* valueAddr */
+    GEOM_CACHE_BUILD_HITS_MIN, GEOM_CACHE_BUILD_HITS_MAX, /* min-max */
+    GEOM_CACHE_BUILD_HITS, /* bootValue */
+    PGC_USERSET, /* GucContext context */
+    0, /* int flags */
+#if POSTGIS_PGSQL_VERSION >= 91
+    NULL, /* GucIntCheckHook check_hook */
+#endif
+    NULL, /* GucIntAssignHook assign_hook */
+    NULL  /* GucShowHook show_hook */
+   );
+
+  /*
+   * Indexes shared between backends, these size shared memory. Like
+   * any PGC_POSTMASTER setting they can only be defined while the
+   * library is preloaded, not when a session loads it on first use.
+   */
+  if ( process_shared_preload_libraries_in_progress )
+  {
+    DefineCustomIntVariable(
+      "postgis.geom_cache_shared_entries", /* name */
+      "Sets the number of geometry indexes that backends can share, 0 to disable sharing.", /* short_desc */
+      "Only takes effect when postgis is in shared_preload_libraries.", /* long_desc */
+      &geom_shared_cache_entries, /* valueAddr */
+      GEOM_SHARED_CACHE_ENTRIES_MIN, GEOM_SHARED_CACHE_ENTRIES_MAX, /* min-max */
+      GEOM_SHARED_CACHE_ENTRIES, /* bootValue */
+      PGC_POSTMASTER, /* GucContext context */
+      0, /* int flags */
+#if POSTGIS_PGSQL_VERSION >= 91
+      NULL, /* GucIntCheckHook check_hook */
+#endif
+      NULL, /* GucIntAssignHook assign_hook */
+      NULL  /* GucShowHook show_hook */
+     );
+
+    DefineCustomIntVariable(
+      "postgis.geom_cache_shared_memory", /* name */
+      "Sets the memory of geometry indexes that backends can share.", /* short_desc */
+      "Counts the shared indexes and the geometries they were built on.", /* long_desc */
+      &geom_shared_cache_memory, /* valueAddr */
+      GEOM_SHARED_CACHE_MEMORY_MIN, GEOM_SHARED_CACHE_MEMORY_MAX, /* min-max */
+      GEOM_SHARED_CACHE_MEMORY, /* bootValue */
+      PGC_SIGHUP, /* GucContext context */
+      GUC_UNIT_KB, /* int flags */
+#if POSTGIS_PGSQL_VERSION >= 91
+      NULL, /* GucIntCheckHook check_hook */
+#endif
+      NULL, /* GucIntAssignHook assign_hook */
+      NULL  /* GucShowHook show_hook */
+     );
+  }
+
+  GeomSharedCacheInit();
+
     /* install PostgreSQL handlers */
     pg_install_lwgeom_handlers();
 
@@ -261,3 +261,40 @@ select 'emptyCollectionArea', st_area('GEOMETRYCOLLECTION EMPTY');
 
 -- 
 select 'spheroidLength1', round(st_length_spheroid('MULTILINESTRING((-118.584 38.374,-118.583 38.5),(-71.05957 42.3589 , -71.061 43))'::geometry,'SPHEROID["GRS_1980",6378137,298.257222101]'::spheroid)::numeric,5);
+
+-- Do cached rect tree distances agree with the brute force answers?
+SELECT c, ST_Distance(ply, pt) FROM
+( VALUES
+('geom_distance_cached_1a', 'POLYGON((0 0, 0 10, 10 10, 10 0, 0 0))'::geometry, 'POINT(5 5)'::geometry),
+('geom_distance_cached_1b', 'POLYGON((0 0, 0 10, 10 10, 10 0, 0 0))'::geometry, 'POINT(5 5)'::geometry),
+('geom_distance_cached_1c', 'POLYGON((0 0, 0 10, 10 10, 10 0, 0 0))'::geometry, 'POINT(5 5)'::geometry),
+('geom_distance_cached_1d', 'POLYGON((0 0, 0 10, 10 10, 10 0, 0 0))'::geometry, 'POINT(13 14)'::geometry),
+('geom_distance_cached_1e', 'POLYGON((0 0, 0 10, 10 10, 10 0, 0 0))'::geometry, 'MULTIPOINT(20 20, 5 5)'::geometry),
+('geom_distance_cached_1f', 'POLYGON((0 0, 0 10, 10 10, 10 0, 0 0))'::geometry, 'LINESTRING(-3 -4, -6 -8)'::geometry)
+) AS u(c,ply,pt);
+
+-- Holes are respected when the polygon side is cached
+SELECT c, ST_Distance(ply, pt) FROM
+( VALUES
+('geom_distance_cached_2a', 'POLYGON((0 0, 0 10, 10 10, 10 0, 0 0),(2 2, 2 8, 8 8, 8 2, 2 2))'::geometry, 'POINT(5 5)'::geometry),
+('geom_distance_cached_2b', 'POLYGON((0 0, 0 10, 10 10, 10 0, 0 0),(2 2, 2 8, 8 8, 8 2, 2 2))'::geometry, 'POINT(5 5)'::geometry),
+('geom_distance_cached_2c', 'POLYGON((0 0, 0 10, 10 10, 10 0, 0 0),(2 2, 2 8, 8 8, 8 2, 2 2))'::geometry, 'POINT(5 3)'::geometry)
+) AS u(c,ply,pt);
+
+-- Does tolerance based distance work cached?
+SELECT c, ST_DWithin(ply, pt, 1.5) FROM
+( VALUES
+('geom_dwithin_cached_1a', 'POLYGON((0 0, 0 10, 10 10, 10 0, 0 0))'::geometry, 'POINT(11 5)'::geometry),
+('geom_dwithin_cached_1b', 'POLYGON((0 0, 0 10, 10 10, 10 0, 0 0))'::geometry, 'POINT(11 5)'::geometry),
+('geom_dwithin_cached_1c', 'POLYGON((0 0, 0 10, 10 10, 10 0, 0 0))'::geometry, 'POINT(12 5)'::geometry),
+('geom_dwithin_cached_1d', 'POLYGON((0 0, 0 10, 10 10, 10 0, 0 0))'::geometry, 'POINT(5 5)'::geometry)
+) AS u(c,ply,pt);
+
+-- Measures read straight off the serialized form
+SELECT 'serialized_measures', ST_NPoints(g), ST_Area(g), ST_Length(g), ST_XMin(g), ST_YMax(g) FROM (SELECT
+ 'GEOMETRYCOLLECTION(POINT(-5 1),LINESTRING(0 0,3 4),MULTIPOLYGON(((0 0,10 0,10 10,0 10,0 0),(2 2,2 4,4 4,4 2,2 2)),((20 0,22 0,22 2,20 2,20 0))))'::geometry AS g) AS u;
+SELECT 'serialized_pip_1', ST_Contains('MULTIPOLYGON(((0 0,10 0,10 10,0 10,0 0),(2 2,2 4,4 4,4 2,2 2)),((20 0,22 0,22 2,20 2,20 0)))'::geometry, 'POINT(3 3)'::geometry);
+SELECT 'serialized_pip_2', ST_Contains('MULTIPOLYGON(((0 0,10 0,10 10,0 10,0 0),(2 2,2 4,4 4,4 2,2 2)),((20 0,22 0,22 2,20 2,20 0)))'::geometry, 'POINT(1 1)'::geometry);
+SELECT 'serialized_pip_3', ST_Contains('MULTIPOLYGON(((0 0,10 0,10 10,0 10,0 0),(2 2,2 4,4 4,4 2,2 2)),((20 0,22 0,22 2,20 2,20 0)))'::geometry, 'POINT(21 1)'::geometry);
+SELECT 'serialized_pip_4', ST_Intersects('MULTIPOLYGON(((0 0,10 0,10 10,0 10,0 0),(2 2,2 4,4 4,4 2,2 2)),((20 0,22 0,22 2,20 2,20 0)))'::geometry, 'POINT(2 3)'::geometry);
+SELECT 'serialized_pip_5', ST_Covers('POLYGON((0 0,10 0,10 10,0 10,0 0),(2 2,2 4,4 4,4 2,2 2))'::geometry, 'POINT(3 3)'::geometry);
@@ -0,0 +1,41 @@
+-- BRIN indexes on a grid of points stored along a Hilbert curve,
+-- so every range of pages covers a compact patch of the grid
+
+CREATE TABLE test_brin AS
+  SELECT x * 100 + y AS num, ST_MakePoint(x, y) AS geom, ST_MakePoint(x - 50, y - 50)::geography AS geog
+  FROM generate_series(0, 99) x, generate_series(0, 99) y
+  ORDER BY ST_GeoHilbertKey(ST_MakePoint(x, y));
+INSERT INTO test_brin VALUES (-1, NULL, NULL), (-2, 'POINT EMPTY', 'POINT EMPTY');
+
+SET enable_seqscan = off;
+
+-- 2D
+CREATE INDEX brin_2d ON test_brin USING brin (geom) WITH (pages_per_range = 1);
+SELECT 'brin_2d_overlaps', count(*) FROM test_brin WHERE geom && ST_MakeEnvelope(9.5, 9.5, 20.5, 20.5);
+SELECT 'brin_2d_within', count(*) FROM test_brin WHERE geom @ ST_MakeEnvelope(9.5, 9.5, 20.5, 20.5);
+SELECT 'brin_2d_contains', num FROM test_brin WHERE geom ~ 'POINT(15 15)'::geometry;
+SELECT 'brin_2d_same', num FROM test_brin WHERE geom ~= 'POINT(15 15)'::geometry;
+SELECT 'brin_2d_nulls', count(*) FROM test_brin WHERE geom IS NULL;
+SELECT 'brin_2d_notnulls', count(*) FROM test_brin WHERE geom IS NOT NULL;
+
+-- New rows are found before and after their ranges are summarized
+INSERT INTO test_brin VALUES (-3, 'POINT(200 200)', 'POINT(150 50)');
+SELECT 'brin_2d_insert', num FROM test_brin WHERE geom && ST_MakeEnvelope(199, 199, 201, 201);
+SELECT 'brin_2d_summarize', brin_summarize_new_values('brin_2d') >= 0;
+SELECT 'brin_2d_summarized', num FROM test_brin WHERE geom && ST_MakeEnvelope(199, 199, 201, 201);
+DROP INDEX brin_2d;
+
+-- ND
+CREATE INDEX brin_nd ON test_brin USING brin (geom brin_geometry_inclusion_ops_nd) WITH (pages_per_range = 1);
+SELECT 'brin_nd_overlaps', count(*) FROM test_brin WHERE geom &&& ST_MakeEnvelope(9.5, 9.5, 20.5, 20.5);
+SELECT 'brin_nd_notnulls', count(*) FROM test_brin WHERE geom IS NOT NULL;
+DROP INDEX brin_nd;
+
+-- Geography
+CREATE INDEX brin_geog ON test_brin USING brin (geog) WITH (pages_per_range = 1);
+SELECT 'brin_geog_overlaps', num FROM test_brin WHERE geog && 'POINT(-35 -35)'::geography;
+SELECT 'brin_geog_insert', num FROM test_brin WHERE geog && 'POINT(150 50)'::geography;
+DROP INDEX brin_geog;
+
+RESET enable_seqscan;
+DROP TABLE test_brin;
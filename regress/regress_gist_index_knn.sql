@@ -0,0 +1,32 @@
+-- Nearest neighbours by exact distance out of the 2D GiST index,
+-- on shapes whose box centers are in a different order
+
+CREATE TABLE test_knn AS
+  SELECT x * 100 + y AS num, ST_MakePoint(1000 + x, 1000 + y) AS geom
+  FROM generate_series(0, 99) x, generate_series(0, 99) y;
+INSERT INTO test_knn VALUES
+  (-1, 'LINESTRING(0 10, 100 10)'),
+  (-2, 'POINT(5 5)'),
+  (-3, 'POLYGON((20 -50, 30 -50, 30 50, 20 50, 20 -50))'),
+  (-4, 'POINT(15 0)'),
+  (-5, 'POINT EMPTY'),
+  (-6, NULL),
+  (-7, 'POINT(16777218 0)');
+
+CREATE INDEX gist_knn ON test_knn USING gist (geom);
+SET enable_seqscan = off;
+
+SELECT 'knn', num, round((geom <-> 'POINT(0 0)'::geometry)::numeric, 2)
+  FROM test_knn ORDER BY geom <-> 'POINT(0 0)'::geometry LIMIT 4;
+SELECT 'knn_far', num FROM test_knn ORDER BY geom <-> 'POINT(1050.2 1050.1)'::geometry LIMIT 2;
+
+-- The box distance of a far point rounds above the exact one in float
+SELECT 'knn_float', num, geom <-> 'POINT(0.3 0)'::geometry
+  FROM test_knn WHERE num < -5 ORDER BY geom <-> 'POINT(0.3 0)'::geometry LIMIT 1;
+
+-- No distance to an empty geometry
+SELECT 'knn_empty', num, geom <-> 'POINT(0 0)'::geometry IS NULL
+  FROM test_knn WHERE num = -5;
+
+RESET enable_seqscan;
+DROP TABLE test_knn;
@@ -149,3 +149,51 @@ select 'ST_PointN6', ST_AsText(ST_PointN('POLYGON((0 0, 1 1, 0 1, 0 0))'::geomet
 
 -- issues with EMPTY --
 select 'ST_Buffer(empty)', ST_AsText(ST_Buffer('POLYGON EMPTY'::geometry, 0.5));
+
+-- Bounding box short-circuits on out-of-line toasted inputs
+CREATE TEMP TABLE toasted (id int, g geometry);
+ALTER TABLE toasted ALTER COLUMN g SET STORAGE EXTERNAL;
+INSERT INTO toasted VALUES
+  (1, ST_Buffer('POINT(0 0)'::geometry, 10, 500)),
+  (2, ST_Buffer('POINT(100 0)'::geometry, 10, 500)),
+  (3, ST_SetSRID(ST_Buffer('POINT(100 0)'::geometry, 10, 500), 4326));
+SELECT 'toasted1', a.id, b.id, ST_Intersects(a.g, b.g), ST_Contains(a.g, b.g),
+  ST_Disjoint(a.g, b.g), ST_DWithin(a.g, b.g, 79), ST_DWithin(a.g, b.g, 81),
+  ST_Distance(a.g, b.g) BETWEEN 79 AND 81
+  FROM toasted a, toasted b WHERE a.id < 3 AND b.id < 3 ORDER BY 2, 3;
+SELECT 'toasted2', ST_Intersects(a.g, b.g) FROM toasted a, toasted b WHERE a.id = 1 AND b.id = 3;
+DROP TABLE toasted;
+
+-- ST_Union aggregate unioning in work_mem sized batches
+CREATE TEMP TABLE union_grid AS
+  SELECT ST_MakeEnvelope(x, y, x + 1.5, y + 1.5) AS g
+  FROM generate_series(0, 39) x, generate_series(0, 49) y;
+SET work_mem = 64;
+SELECT 'union_agg1', ST_Area(ST_Union(g)), ST_NumGeometries(ST_Union(g)) FROM union_grid;
+SELECT 'union_agg2', aggregates > 0, batches > 1, merges > 0, last_peak_memory BETWEEN 65536 AND 200000 FROM postgis_union_stats();
+SELECT 'union_agg3', ST_Equals(ST_Union(g), (SELECT ST_Union(array_agg(g)) FROM union_grid)) FROM union_grid;
+RESET work_mem;
+SELECT 'union_agg4', ST_AsText(ST_Union(g)) FROM (VALUES (NULL::geometry), ('POINT EMPTY'), (NULL)) v(g);
+SELECT 'union_agg5', ST_Union(g) IS NULL FROM (VALUES (NULL::geometry), (NULL)) v(g);
+SELECT 'union_agg6', ST_AsText(ST_Union(g)) FROM (VALUES ('POINT(1 2)'::geometry)) v(g);
+DROP TABLE union_grid;
+
+-- ST_Union(geometry[]) of many inputs
+SELECT 'union_many1', ST_Area(u), ST_NumGeometries(u) FROM (
+  SELECT ST_Union(array_agg(ST_MakeEnvelope(x, y, x + 1.5, y + 1.5) ORDER BY (x * 7919 + y * 104729) % 2003)) AS u
+  FROM generate_series(0, 39) x, generate_series(0, 49) y) foo;
+SELECT 'union_many2', ST_GeometryType(u), ST_NumGeometries(u), ST_Area(u) FROM (
+  SELECT ST_Union(array_agg(g)) AS u FROM (
+    SELECT ST_MakeEnvelope(3 * i, 0, 3 * i + 1, 1) AS g FROM generate_series(0, 99) i
+    UNION ALL SELECT ST_MakePoint(3 * i + 0.5, 0.5) FROM generate_series(0, 99) i
+    UNION ALL SELECT ST_MakePoint(3 * i + 2, 5) FROM generate_series(0, 49) i
+    UNION ALL SELECT NULL::geometry
+    UNION ALL SELECT 'POLYGON EMPTY'::geometry) foo) bar;
+
+-- Hilbert curve order
+SELECT 'hilbert_key1', string_agg(n, ',' ORDER BY ST_GeoHilbertKey(g)) FROM (VALUES
+  ('ne', 'POINT(1 1)'::geometry), ('sw', 'POINT(-1 -1)'), ('se', 'POINT(1 -1)'), ('nw', 'POINT(-1 1)')) v(n, g);
+SELECT 'hilbert_key2', string_agg(n, ',' ORDER BY g USING #<) FROM (VALUES
+  ('ne', 'POINT(1 1)'::geometry), ('sw', 'POINT(-1 -1)'), ('se', 'POINT(1 -1)'), ('nw', 'POINT(-1 1)'), ('empty', 'POINT EMPTY')) v(n, g);
+SELECT 'hilbert_key3', ST_GeoHilbertKey('POINT EMPTY') IS NULL, 'POINT EMPTY'::geometry #< 'POINT(0 0)';
+SELECT 'hilbert_key4', 'POINT(1 1)'::geometry #= 'LINESTRING(0 0,2 2)', 'POINT(1 1)'::geometry #= 'POINT(1 2)';
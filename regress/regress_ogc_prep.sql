@@ -296,3 +296,63 @@ SELECT 'covers311', ST_Covers('POLYGON((0 0, 0 10, 10 10, 10 0, 0 0))', p) FROM
 ('LINESTRING(1 10, 10 10, 10 8)'),('LINESTRING(1 10, 10 10, 10 8)'),('LINESTRING(1 10, 10 10, 10 8)')
 ) AS v(p);
 
+
+-- Multipoints against a cached polygon with a hole
+SELECT 'intersects400', ST_Intersects('POLYGON((0 0, 0 10, 10 10, 10 0, 0 0),(2 2, 2 8, 8 8, 8 2, 2 2))', p) FROM ( VALUES 
+('MULTIPOINT(5 5, 20 20)'),('MULTIPOINT(5 5, 20 20)'),('MULTIPOINT(5 5, 20 20)')
+) AS v(p);
+SELECT 'intersects401', ST_Intersects('POLYGON((0 0, 0 10, 10 10, 10 0, 0 0),(2 2, 2 8, 8 8, 8 2, 2 2))', p) FROM ( VALUES 
+('MULTIPOINT(5 5, 1 1)'),('MULTIPOINT(5 5, 1 1)'),('MULTIPOINT(5 5, 1 1)')
+) AS v(p);
+SELECT 'intersects402', ST_Intersects('POLYGON((0 0, 0 10, 10 10, 10 0, 0 0),(2 2, 2 8, 8 8, 8 2, 2 2))', p) FROM ( VALUES 
+('MULTIPOINT(20 20, 2 5)'),('MULTIPOINT(20 20, 2 5)'),('MULTIPOINT(20 20, 2 5)')
+) AS v(p);
+
+SELECT 'contains400', ST_Contains('POLYGON((0 0, 0 10, 10 10, 10 0, 0 0),(2 2, 2 8, 8 8, 8 2, 2 2))', p) FROM ( VALUES 
+('MULTIPOINT(1 1, 9 9)'),('MULTIPOINT(1 1, 9 9)'),('MULTIPOINT(1 1, 9 9)')
+) AS v(p);
+SELECT 'contains401', ST_Contains('POLYGON((0 0, 0 10, 10 10, 10 0, 0 0),(2 2, 2 8, 8 8, 8 2, 2 2))', p) FROM ( VALUES 
+('MULTIPOINT(1 1, 5 5)'),('MULTIPOINT(1 1, 5 5)'),('MULTIPOINT(1 1, 5 5)')
+) AS v(p);
+SELECT 'contains402', ST_Contains('POLYGON((0 0, 0 10, 10 10, 10 0, 0 0),(2 2, 2 8, 8 8, 8 2, 2 2))', p) FROM ( VALUES 
+('MULTIPOINT(0 0, 2 5)'),('MULTIPOINT(0 0, 2 5)'),('MULTIPOINT(0 0, 2 5)')
+) AS v(p);
+SELECT 'contains403', ST_Contains('POLYGON((0 0, 0 10, 10 10, 10 0, 0 0),(2 2, 2 8, 8 8, 8 2, 2 2))', p) FROM ( VALUES 
+('MULTIPOINT(1 1, 0 5)'),('MULTIPOINT(1 1, 0 5)'),('MULTIPOINT(1 1, 0 5)')
+) AS v(p);
+
+-- ST_ContainsMany: rtree for points, prepared geometry for the rest
+SELECT 'containsmany1', ST_ContainsMany('POLYGON((0 0, 0 10, 10 10, 10 0, 0 0),(2 2, 2 8, 8 8, 8 2, 2 2))',
+  ARRAY['POINT(1 1)', 'POINT(5 5)', 'POINT(0 5)', NULL, 'POINT(20 20)', 'LINESTRING(1 1, 1 9)', 'LINESTRING(1 1, 5 5)', 'POINT EMPTY']::geometry[]);
+SELECT 'containsmany2', ST_ContainsMany('LINESTRING(0 0, 10 0)', ARRAY['POINT(5 0)', 'POINT(0 0)', 'POINT(5 1)']::geometry[]);
+SELECT 'containsmany3', ST_ContainsMany('POLYGON((0 0, 0 10, 10 10, 10 0, 0 0))', '{}'::geometry[]);
+
+-- Interleaved cached polygons, more of them than the cache holds
+SET postgis.geom_cache_size = 2;
+SELECT 'geomcache1', a.id, b.id, ST_Contains(a.g, b.g), ST_Intersects(a.g, b.g) FROM 
+( VALUES (1, 'POLYGON((0 0, 0 10, 10 10, 10 0, 0 0))'::geometry), (2, 'POLYGON((5 5, 5 15, 15 15, 15 5, 5 5))'), (3, 'POLYGON((0 0, 0 2, 2 2, 2 0, 0 0))') ) AS a(id, g),
+( VALUES (1, 'POINT(1 1)'::geometry), (2, 'POINT(7 7)'), (3, 'POINT(12 12)'), (4, 'POINT(1 1)'), (5, 'POINT(7 7)') ) AS b(id, g)
+ORDER BY a.id, b.id;
+RESET postgis.geom_cache_size;
+
+-- A constant polygon is found again by identity, without hashing it
+CREATE TEMP TABLE geom_cache_before AS SELECT * FROM postgis_geom_cache_stats();
+SELECT 'geomcache2', count(*) FROM ( VALUES ('POINT(1 1)'::geometry), ('POINT(5 5)'), ('POINT(9 9)'), ('POINT(2 8)'), ('POINT(8 2)') ) AS v(p)
+WHERE ST_Contains('POLYGON((0 0, 0 10, 10 10, 10 0, 0 0))', p);
+SELECT 'geomcache2a', a.ident_hits - b.ident_hits, a.hash_hits - b.hash_hits, a.misses - b.misses, a.builds - b.builds FROM postgis_geom_cache_stats() a, geom_cache_before b;
+DROP TABLE geom_cache_before;
+
+-- Fixed build threshold: the index is built on the third repeat
+SET postgis.geom_cache_build_hits = 3;
+CREATE TEMP TABLE geom_cache_before AS SELECT * FROM postgis_geom_cache_stats();
+SELECT 'geomcache3', count(*) FROM ( VALUES ('POINT(1 1)'::geometry), ('POINT(5 5)'), ('POINT(9 9)'), ('POINT(2 8)'), ('POINT(8 2)') ) AS v(p)
+WHERE ST_Contains('POLYGON((0 0, 0 10, 10 10, 10 0, 0 0))', p);
+SELECT 'geomcache3a', a.ident_hits - b.ident_hits, a.misses - b.misses, a.deferred - b.deferred, a.builds - b.builds FROM postgis_geom_cache_stats() a, geom_cache_before b;
+DROP TABLE geom_cache_before;
+RESET postgis.geom_cache_build_hits;
+
+-- Trees are only published to the cache shared between backends, which
+-- needs shared_preload_libraries; geometries themselves are never changed
+SELECT 'indextree1', ST_AddIndexTree('POLYGON((0 0, 0 10, 10 10, 10 0, 0 0),(2 2, 2 8, 8 8, 8 2, 2 2))'::geometry),
+  ST_AddIndexTree('POINT EMPTY'::geometry), ST_AddIndexTree('POLYGON((0 0, 0 1, 1 1, 1 0, 0 0))'::geography),
+  ST_AddIndexTree('POINT EMPTY'::geography);
@@ -36,5 +36,17 @@ SELECT ST_transform(ST_GeomFromEWKT('SRID=0;POINT(0 0)'),100002);
 --- test #8: Transforming to same SRID
 SELECT 8,ST_AsEWKT(ST_transform(ST_GeomFromEWKT('SRID=100002;POINT(0 0)'),100002));
 
+--- test #9: one call site cycling through more SRIDs than the cache holds
+CREATE TEMP TABLE proj_cache_before AS SELECT * FROM postgis_proj_cache_stats();
+SET postgis.proj_cache_size = 2;
+SELECT 9,count(ST_transform(ST_GeomFromEWKT('SRID=100002;POINT(16 48)'),s)) FROM (VALUES (100001),(999000),(100001),(999000)) AS v(s);
+SELECT '9a',a.hits - b.hits,a.misses - b.misses,a.evictions - b.evictions FROM postgis_proj_cache_stats() a, proj_cache_before b;
+RESET postgis.proj_cache_size;
+DROP TABLE proj_cache_before;
+
+--- test #10: an edited spatial_ref_sys row is read again, not served from the cache
+UPDATE spatial_ref_sys SET proj4text = '+proj=longlat +ellps=WGS84 +datum=WGS84 +no_defs ' WHERE srid = 100001;
+SELECT 10,ST_AsEWKT(ST_SnapToGrid(ST_transform(ST_GeomFromEWKT('SRID=100002;POINT(16 48)'),100001),0.0001));
+
 DELETE FROM spatial_ref_sys WHERE srid >= 100000;
 
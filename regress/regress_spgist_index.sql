@@ -0,0 +1,24 @@
+-- SP-GiST quad-tree on a grid of points, a few boxes and an empty
+
+CREATE TABLE test_spgist AS
+  SELECT x * 100 + y AS num, ST_MakePoint(x, y) AS geom
+  FROM generate_series(0, 99) x, generate_series(0, 99) y;
+INSERT INTO test_spgist VALUES
+  (-1, NULL), (-2, 'POINT EMPTY'), (-3, ST_MakeEnvelope(9.5, 9.5, 20.5, 20.5)), (-4, 'LINESTRING(14 14, 16 16)');
+
+CREATE INDEX spgist_2d ON test_spgist USING spgist (geom);
+SET enable_seqscan = off;
+
+SELECT 'spgist_overlaps', count(*) FROM test_spgist WHERE geom && ST_MakeEnvelope(9.5, 9.5, 20.5, 20.5);
+SELECT 'spgist_within', count(*) FROM test_spgist WHERE geom @ ST_MakeEnvelope(9.5, 9.5, 20.5, 20.5);
+SELECT 'spgist_contains', num FROM test_spgist WHERE geom ~ 'POINT(15 15)'::geometry ORDER BY num;
+SELECT 'spgist_same', num FROM test_spgist WHERE geom ~= 'POINT(15 15)'::geometry ORDER BY num;
+SELECT 'spgist_empty', count(*) FROM test_spgist WHERE geom && 'POINT EMPTY'::geometry;
+SELECT 'spgist_notnulls', count(*) FROM test_spgist WHERE geom IS NOT NULL;
+
+-- New rows go down the existing tree
+INSERT INTO test_spgist VALUES (-5, 'POINT(200 200)');
+SELECT 'spgist_insert', num FROM test_spgist WHERE geom && ST_MakeEnvelope(199, 199, 201, 201);
+
+RESET enable_seqscan;
+DROP TABLE test_spgist;
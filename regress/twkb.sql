@@ -82,3 +82,23 @@ select 'POLYGON((1 1, 1 2, 2 2, 2 1, 1 1))'::text g, -543 id
 
 
 
+--Round trips through ST_GeomFromTWKB
+select st_astext(st_geomfromtwkb(ST_AsTWKB(g::geometry,precission,id,true))) from
+(select 'POINT(78 -78)'::text g, 0 precission, -10 id) foo;
+select st_astext(st_geomfromtwkb(ST_AsTWKB(g::geometry,precission))) from
+(select 'LINESTRING(120.54 10.78, -50.2 20.878, 300.789 -21)'::text g, 2 precission) foo;
+select st_astext(st_geomfromtwkb(ST_AsTWKB(g::geometry,precission,id))) from
+(select 'POLYGON((1 1, 1 20, 20 20, 20 1, 1 1),(3 3,3 4, 4 4,4 3,3 3))'::text g, 0 precission, 1 id) foo;
+select st_astext(st_geomfromtwkb(ST_AsTWKB(g::geometry,precission))) from
+(select 'MULTIPOLYGON(((1 1, 1 2, 2 2, 2 1, 1 1)),((3 3,3 4,4 4,4 3,3 3)))'::text g, 0 precission) foo;
+select st_astext(st_geomfromtwkb(ST_AsTWKB(g::geometry,precission))) from
+(select 'GEOMETRYCOLLECTION(POINT(1 1),LINESTRING EMPTY)'::text g, 0 precission) foo;
+select st_astext(st_geomfromtwkb(ST_AsTWKBagg(g::geometry,0,id))) from
+(
+select 'POINT(1 1)'::text g, 3 id
+union all
+select 'POINT(2 2)'::text g, 2 id
+) foo;
+--Malformed TWKB
+select st_geomfromtwkb('\x0142d80403f00114d302'::bytea);
+select st_geomfromtwkb('\x0142'::bytea);